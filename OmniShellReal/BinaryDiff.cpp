@@ -0,0 +1,482 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// BinaryDiff.cpp
+#include "BinaryDiff.h"
+#include "BinaryImage.h"
+#include "FileScanner.h"
+#include "JobManager.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace BinaryDiff {
+    namespace {
+        constexpr size_t COMPARE_BLOCK = 64 * 1024;
+
+        // Content-defined chunking: a boundary falls where the gear hash of the last 64 bytes has its top
+        // 8 bits clear, so chunks average about 256 bytes past the minimum and realign after an insertion.
+        constexpr size_t MIN_CHUNK = 64;
+        constexpr size_t MAX_CHUNK = 4096;
+        constexpr uint64_t CHUNK_MASK = 0xFFull << 56;
+
+        constexpr size_t WINDOW = 16;                   // bytes per rolling-hash window in function similarity
+        constexpr uint64_t WINDOW_BASE = 0x100000001B3ull;
+        constexpr size_t FUNCTIONS_PER_TASK = 64;
+
+        constexpr std::array<uint64_t, 256> MakeGear() {
+            std::array<uint64_t, 256> table{};
+            uint64_t x = 0x9E3779B97F4A7C15ull;
+            for (auto& v : table) {     // splitmix64, from a fixed seed so boundaries are stable across runs
+                x += 0x9E3779B97F4A7C15ull;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                v = z ^ (z >> 31);
+            }
+            return table;
+        }
+        constexpr std::array<uint64_t, 256> GEAR = MakeGear();
+
+        uint64_t Load64(const unsigned char* p) {
+            uint64_t v;
+            std::memcpy(&v, p, 8);
+            return v;
+        }
+
+        // Calls onRange(offset, length) for every maximal run of differing bytes. Equal blocks cost one
+        // memcmp; only blocks that differ are walked, a word at a time.
+        template<typename F>
+        bool ForEachDifference(const unsigned char* a, const unsigned char* b, size_t n, F&& onRange) {
+            for (size_t block = 0; block < n; block += COMPARE_BLOCK) {
+                const size_t end = std::min(n, block + COMPARE_BLOCK);
+                if (std::memcmp(a + block, b + block, end - block) == 0) continue;
+                size_t i = block;
+                while (i < end) {
+                    while (i + 8 <= end && Load64(a + i) == Load64(b + i)) i += 8;
+                    while (i < end && a[i] == b[i]) ++i;
+                    if (i >= end) break;
+                    size_t j = i + 1;
+                    while (j < end && a[j] != b[j]) ++j;
+                    if (!onRange(i, j - i)) return false;
+                    i = j;
+                }
+            }
+            return true;
+        }
+
+        // Appends a range, joining it to the previous one when the gap between them is small enough. Only
+        // a range that cannot be joined counts against 'limit'; false if it was dropped for that reason.
+        bool AddRange(std::vector<Range>& ranges, uint64_t offset, uint64_t length, uint64_t gap,
+            size_t limit = std::numeric_limits<size_t>::max()) {
+            if (!ranges.empty() && offset <= ranges.back().offset + ranges.back().length + gap) {
+                ranges.back().length = offset + length - ranges.back().offset;
+                return true;
+            }
+            if (ranges.size() >= limit) return false;
+            ranges.push_back({ offset, length });
+            return true;
+        }
+
+        template<typename F>
+        void RunBatches(size_t count, size_t perTask, F&& body) {
+            const size_t tasks = (count + perTask - 1) / perTask;
+            auto run = [&](size_t task) {
+                const size_t end = std::min(count, (task + 1) * perTask);
+                for (size_t k = task * perTask; k < end; ++k) body(k);
+            };
+            if (tasks <= 1) {
+                if (tasks) run(0);
+                return;
+            }
+            std::vector<TaskHandle> handles;
+            handles.reserve(tasks);
+            for (size_t task = 0; task < tasks; ++task) handles.push_back(JobManager::SubmitJob([&run, task]() { run(task); }));
+            for (const auto& h : handles) JobManager::Wait(h);
+        }
+
+        struct Chunk {
+            uint64_t offset;
+            uint64_t length;
+            uint64_t hash;
+        };
+
+        std::vector<Chunk> ChunksOf(std::span<const unsigned char> data) {
+            std::vector<Chunk> chunks;
+            chunks.reserve(data.size() / 256 + 1);
+            size_t start = 0;
+            uint64_t h = 0;
+            for (size_t i = 0; i < data.size(); ++i) {
+                h = (h << 1) + GEAR[data[i]];
+                const size_t length = i + 1 - start;
+                if ((length >= MIN_CHUNK && (h & CHUNK_MASK) == 0) || length >= MAX_CHUNK) {
+                    chunks.push_back({ start, length, FileScanner::HashBytes(data.subspan(start, length)) });
+                    start = i + 1;
+                    h = 0;
+                }
+            }
+            if (start < data.size()) {
+                chunks.push_back({ start, data.size() - start, FileScanner::HashBytes(data.subspan(start)) });
+            }
+            return chunks;
+        }
+
+        // 'offset2' places the second block in its file, so changed ranges are reported as file offsets.
+        void CompareBlocks(std::span<const unsigned char> a, std::span<const unsigned char> b, uint64_t offset2, uint64_t gap, BlockDelta& out) {
+            const auto chunks1 = ChunksOf(a);
+            const auto chunks2 = ChunksOf(b);
+            std::unordered_set<uint64_t> hashes1, hashes2;
+            hashes1.reserve(chunks1.size());
+            hashes2.reserve(chunks2.size());
+            for (const auto& c : chunks1) hashes1.insert(c.hash);
+            for (const auto& c : chunks2) hashes2.insert(c.hash);
+            for (const auto& c : chunks2) {
+                if (hashes1.count(c.hash)) out.sharedBytes += c.length;
+                else AddRange(out.changed, offset2 + c.offset, c.length, gap);
+            }
+            for (const auto& c : chunks1) {
+                if (!hashes2.count(c.hash)) out.removedBytes += c.length;
+            }
+        }
+
+        struct Input {
+            std::shared_ptr<const BinaryImage> image;
+            MappedFile mapped;
+            std::span<const unsigned char> bytes;
+        };
+
+        bool Load(const std::string& path, Input& in, bool wantImage, std::string* error) {
+            if (wantImage) in.image = BinaryImage::Open(path);
+            if (in.image) {
+                in.bytes = in.image->bytes();
+                return true;
+            }
+            std::string why;
+            if (!in.mapped.open(path, &why)) {
+                if (error) *error = path + ": " + why;
+                return false;
+            }
+            in.bytes = in.mapped.bytes();
+            return true;
+        }
+
+        void CompareSections(const Input& in1, const Input& in2, const DiffOptions& options, DiffReport& report) {
+            if (!in1.image || !in2.image) {
+                BlockDelta whole;
+                whole.name = "(file)";
+                whole.size1 = in1.bytes.size();
+                whole.size2 = in2.bytes.size();
+                CompareBlocks(in1.bytes, in2.bytes, 0, options.mergeGap, whole);
+                report.sections.push_back(std::move(whole));
+                return;
+            }
+            // Pair sections by name, in order, so duplicate names still line up. Sections with no bytes in
+            // the file (.bss) have nothing to compare.
+            struct Pair {
+                const ImageSection* first = nullptr;
+                const ImageSection* second = nullptr;
+            };
+            std::vector<Pair> pairs;
+            std::vector<bool> used(in2.image->sections().size(), false);
+            for (const auto& s1 : in1.image->sections()) {
+                if (!s1.size) continue;
+                Pair p{ &s1, nullptr };
+                const auto& list2 = in2.image->sections();
+                for (size_t k = 0; k < list2.size(); ++k) {
+                    if (!used[k] && list2[k].size && list2[k].name == s1.name) {
+                        used[k] = true;
+                        p.second = &list2[k];
+                        break;
+                    }
+                }
+                pairs.push_back(p);
+            }
+            const auto& list2 = in2.image->sections();
+            for (size_t k = 0; k < list2.size(); ++k) {
+                if (!used[k] && list2[k].size) pairs.push_back({ nullptr, &list2[k] });
+            }
+
+            report.sections.resize(pairs.size());
+            RunBatches(pairs.size(), 1, [&](size_t k) {
+                const ImageSection* s1 = pairs[k].first;
+                const ImageSection* s2 = pairs[k].second;
+                BlockDelta& out = report.sections[k];
+                out.name = std::string(s1 ? s1->name : s2->name);
+                const auto a = s1 ? in1.bytes.subspan(static_cast<size_t>(s1->offset), static_cast<size_t>(s1->size)) : std::span<const unsigned char>{};
+                const auto b = s2 ? in2.bytes.subspan(static_cast<size_t>(s2->offset), static_cast<size_t>(s2->size)) : std::span<const unsigned char>{};
+                out.size1 = a.size();
+                out.size2 = b.size();
+                CompareBlocks(a, b, s2 ? s2->offset : 0, options.mergeGap, out);
+                });
+        }
+
+        struct Body {
+            std::string name;
+            uint64_t address = 0;
+            std::span<const unsigned char> bytes;
+            uint64_t hash = 0;
+        };
+
+        // Each function runs to the next function start or the end of its section.
+        std::vector<Body> BodiesOf(const BinaryImage& image) {
+            const auto fns = image.functions();
+            std::vector<Body> bodies;
+            bodies.reserve(fns.size());
+            for (size_t k = 0; k < fns.size(); ++k) {
+                auto code = image.bytesAt(fns[k].address);
+                if (code.empty()) continue;
+                if (k + 1 < fns.size() && fns[k + 1].address - fns[k].address < code.size()) {
+                    code = code.first(static_cast<size_t>(fns[k + 1].address - fns[k].address));
+                }
+                Body body;
+                if (!fns[k].name.empty()) {
+                    body.name = std::string(fns[k].name);
+                }
+                else {
+                    std::ostringstream name;
+                    name << (fns[k].address == image.entry() ? "<entry>" : "sub_") << std::hex;
+                    if (fns[k].address != image.entry()) name << fns[k].address;
+                    body.name = name.str();
+                }
+                body.address = fns[k].address;
+                body.bytes = code;
+                body.hash = FileScanner::HashBytes(code);
+                bodies.push_back(std::move(body));
+            }
+            return bodies;
+        }
+
+        std::vector<uint64_t> WindowHashes(std::span<const unsigned char> data) {
+            std::vector<uint64_t> hashes;
+            if (data.size() < WINDOW) return hashes;
+            uint64_t top = 1;   // WINDOW_BASE^(WINDOW-1)
+            for (size_t i = 1; i < WINDOW; ++i) top *= WINDOW_BASE;
+            uint64_t h = 0;
+            for (size_t i = 0; i < WINDOW; ++i) h = h * WINDOW_BASE + data[i];
+            hashes.reserve(data.size() - WINDOW + 1);
+            hashes.push_back(h);
+            for (size_t i = WINDOW; i < data.size(); ++i) {
+                h = (h - data[i - WINDOW] * top) * WINDOW_BASE + data[i];
+                hashes.push_back(h);
+            }
+            std::sort(hashes.begin(), hashes.end());
+            hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+            return hashes;
+        }
+
+        double Similarity(std::span<const unsigned char> a, std::span<const unsigned char> b) {
+            const auto ha = WindowHashes(a);
+            const auto hb = WindowHashes(b);
+            if (ha.empty() || hb.empty()) return 0.0;
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < ha.size() && j < hb.size();) {
+                if (ha[i] < hb[j]) ++i;
+                else if (hb[j] < ha[i]) ++j;
+                else { ++common; ++i; ++j; }
+            }
+            return static_cast<double>(common) / static_cast<double>(std::max(ha.size(), hb.size()));
+        }
+
+        void CompareFunctions(const BinaryImage& image1, const BinaryImage& image2, DiffReport& report) {
+            const auto bodies1 = BodiesOf(image1);
+            const auto bodies2 = BodiesOf(image2);
+            std::vector<bool> paired1(bodies1.size(), false), paired2(bodies2.size(), false);
+            std::vector<std::pair<size_t, size_t>> pairs;
+
+            // By name first, then unmatched bodies by content, which finds renamed or unnamed functions
+            // that only moved.
+            std::unordered_map<std::string_view, std::vector<size_t>> byName;
+            for (size_t k = bodies2.size(); k-- > 0;) byName[bodies2[k].name].push_back(k);
+            for (size_t k = 0; k < bodies1.size(); ++k) {
+                auto it = byName.find(bodies1[k].name);
+                if (it == byName.end() || it->second.empty()) continue;
+                const size_t other = it->second.back();
+                it->second.pop_back();
+                pairs.emplace_back(k, other);
+                paired1[k] = paired2[other] = true;
+            }
+            std::unordered_multimap<uint64_t, size_t> byHash;
+            for (size_t k = 0; k < bodies2.size(); ++k) {
+                if (!paired2[k]) byHash.emplace(bodies2[k].hash, k);
+            }
+            for (size_t k = 0; k < bodies1.size(); ++k) {
+                if (paired1[k]) continue;
+                auto [first, last] = byHash.equal_range(bodies1[k].hash);
+                for (auto it = first; it != last; ++it) {
+                    if (paired2[it->second] || bodies2[it->second].bytes.size() != bodies1[k].bytes.size()) continue;
+                    pairs.emplace_back(k, it->second);
+                    paired1[k] = paired2[it->second] = true;
+                    break;
+                }
+            }
+
+            std::vector<FunctionDelta> deltas(pairs.size());
+            RunBatches(pairs.size(), FUNCTIONS_PER_TASK, [&](size_t k) {
+                const Body& a = bodies1[pairs[k].first];
+                const Body& b = bodies2[pairs[k].second];
+                FunctionDelta& d = deltas[k];
+                d.name = b.name;
+                d.address1 = a.address;
+                d.address2 = b.address;
+                d.size1 = a.bytes.size();
+                d.size2 = b.bytes.size();
+                const bool equal = a.hash == b.hash && a.bytes.size() == b.bytes.size()
+                    && std::memcmp(a.bytes.data(), b.bytes.data(), a.bytes.size()) == 0;
+                if (equal) {
+                    d.status = (a.address == b.address) ? FunctionDelta::Status::Same : FunctionDelta::Status::Moved;
+                }
+                else {
+                    d.status = FunctionDelta::Status::Changed;
+                    d.similarity = Similarity(a.bytes, b.bytes);
+                }
+                });
+
+            for (auto& d : deltas) {
+                if (d.status == FunctionDelta::Status::Same) ++report.sameFunctions;
+                else report.functions.push_back(std::move(d));
+            }
+            for (size_t k = 0; k < bodies1.size(); ++k) {
+                if (paired1[k]) continue;
+                FunctionDelta d;
+                d.name = bodies1[k].name;
+                d.status = FunctionDelta::Status::Removed;
+                d.address1 = bodies1[k].address;
+                d.size1 = bodies1[k].bytes.size();
+                d.similarity = 0.0;
+                report.functions.push_back(std::move(d));
+            }
+            for (size_t k = 0; k < bodies2.size(); ++k) {
+                if (paired2[k]) continue;
+                FunctionDelta d;
+                d.name = bodies2[k].name;
+                d.status = FunctionDelta::Status::Added;
+                d.address2 = bodies2[k].address;
+                d.size2 = bodies2[k].bytes.size();
+                d.similarity = 0.0;
+                report.functions.push_back(std::move(d));
+            }
+            std::sort(report.functions.begin(), report.functions.end(), [](const FunctionDelta& x, const FunctionDelta& y) { return x.name < y.name; });
+        }
+
+        const char* StatusName(FunctionDelta::Status status) {
+            switch (status) {
+            case FunctionDelta::Status::Same:    return "same";
+            case FunctionDelta::Status::Moved:   return "moved";
+            case FunctionDelta::Status::Changed: return "changed";
+            case FunctionDelta::Status::Added:   return "added";
+            default:                             return "removed";
+            }
+        }
+    }
+
+    std::optional<uint64_t> FirstDifference(const std::string& path1, const std::string& path2, std::string* error) {
+        Input in1, in2;
+        if (!Load(path1, in1, false, error) || !Load(path2, in2, false, error)) return std::nullopt;
+        const size_t common = std::min(in1.bytes.size(), in2.bytes.size());
+        std::optional<uint64_t> first;
+        ForEachDifference(in1.bytes.data(), in2.bytes.data(), common, [&](size_t offset, size_t) {
+            first = offset;
+            return false;
+            });
+        if (!first && in1.bytes.size() != in2.bytes.size()) first = common;
+        return first;
+    }
+
+    std::optional<DiffReport> Compare(const std::string& path1, const std::string& path2, const DiffOptions& options, std::string* error) {
+        const bool wantImages = options.sections || options.functions;
+        Input in1, in2;
+        if (!Load(path1, in1, wantImages, error) || !Load(path2, in2, wantImages, error)) return std::nullopt;
+        in1.mapped.adviseSequential();
+        in2.mapped.adviseSequential();
+
+        DiffReport report;
+        ByteDelta& delta = report.bytes;
+        delta.size1 = in1.bytes.size();
+        delta.size2 = in2.bytes.size();
+        const size_t common = std::min(in1.bytes.size(), in2.bytes.size());
+        ForEachDifference(in1.bytes.data(), in2.bytes.data(), common, [&](size_t offset, size_t length) {
+            delta.differingBytes += length;
+            if (!AddRange(delta.ranges, offset, length, options.mergeGap, options.maxRanges)) delta.truncated = true;
+            return true;
+            });
+        if (delta.size1 != delta.size2) {
+            const uint64_t extra = std::max(delta.size1, delta.size2) - common;
+            delta.differingBytes += extra;
+            if (!AddRange(delta.ranges, common, extra, options.mergeGap, options.maxRanges)) delta.truncated = true;
+        }
+
+        if (options.sections) CompareSections(in1, in2, options, report);
+        if (options.functions && in1.image && in2.image) CompareFunctions(*in1.image, *in2.image, report);
+        return report;
+    }
+
+    std::string FormatReport(const DiffReport& report, size_t maxLines) {
+        std::ostringstream out;
+        const ByteDelta& d = report.bytes;
+        out << "Sizes: " << d.size1 << " vs " << d.size2 << " bytes\n";
+        if (d.differingBytes == 0 && d.size1 == d.size2) {
+            out << "Files are identical.\n";
+        }
+        else if (d.ranges.empty()) {
+            out << d.differingBytes << " bytes differ (ranges not recorded)\n";
+        }
+        else {
+            out << d.differingBytes << " bytes differ in " << d.ranges.size() << (d.truncated ? "+" : "") << " ranges, first at 0x"
+                << std::hex << d.ranges.front().offset << std::dec << "\n";
+            for (size_t k = 0; k < d.ranges.size() && k < maxLines; ++k) {
+                out << "  0x" << std::hex << d.ranges[k].offset << "-0x" << (d.ranges[k].offset + d.ranges[k].length)
+                    << std::dec << " (" << d.ranges[k].length << " bytes)\n";
+            }
+            if (d.ranges.size() > maxLines) out << "  (+" << (d.ranges.size() - maxLines) << " more ranges)\n";
+        }
+
+        if (!report.sections.empty()) {
+            out << "Sections:\n";
+            for (const auto& s : report.sections) {
+                out << "  " << s.name << ": ";
+                if (!s.size1) out << "added (" << s.size2 << " bytes)\n";
+                else if (!s.size2) out << "removed (" << s.size1 << " bytes)\n";
+                else {
+                    out << s.size1 << " -> " << s.size2 << " bytes, " << std::fixed << std::setprecision(1)
+                        << (100.0 * static_cast<double>(s.sharedBytes) / static_cast<double>(s.size2)) << "% shared";
+                    if (!s.changed.empty()) out << ", " << s.changed.size() << " changed ranges";
+                    if (s.removedBytes) out << ", " << s.removedBytes << " bytes removed";
+                    out << "\n";
+                }
+            }
+        }
+
+        if (report.sameFunctions || !report.functions.empty()) {
+            size_t counts[5] = {};
+            for (const auto& f : report.functions) ++counts[static_cast<size_t>(f.status)];
+            out << "Functions: " << report.sameFunctions << " same, " << counts[1] << " moved, " << counts[2] << " changed, "
+                << counts[3] << " added, " << counts[4] << " removed\n";
+            size_t shown = 0;
+            for (const auto& f : report.functions) {
+                if (shown++ == maxLines) {
+                    out << "  (+" << (report.functions.size() - maxLines) << " more)\n";
+                    break;
+                }
+                out << "  " << std::left << std::setw(8) << StatusName(f.status) << std::right << f.name << std::hex;
+                if (f.status != FunctionDelta::Status::Added) out << "  0x" << f.address1;
+                if (f.status == FunctionDelta::Status::Moved || f.status == FunctionDelta::Status::Changed) out << " ->";
+                if (f.status != FunctionDelta::Status::Removed) out << " 0x" << f.address2;
+                out << std::dec;
+                if (f.status == FunctionDelta::Status::Changed) {
+                    out << "  " << f.size1 << " -> " << f.size2 << " bytes, " << std::fixed << std::setprecision(0)
+                        << (100.0 * f.similarity) << "% similar";
+                }
+                out << "\n";
+            }
+        }
+        return out.str();
+    }
+}
@@ -0,0 +1,77 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// BinaryDiff.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Compares two files in full rather than stopping at the first mismatch. Both files are mapped, and
+// the byte comparison runs memcmp (vectorised by the C library) over 64 KiB blocks, narrowing down
+// only the blocks that differ. For ELF and PE images it can also pair up sections and functions and
+// compare them with rolling hashes, so code that merely moved between builds is recognised.
+namespace BinaryDiff {
+
+    struct Range {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    // Byte-for-byte delta at equal offsets. Bytes past the end of the shorter file form the last range.
+    struct ByteDelta {
+        uint64_t size1 = 0;
+        uint64_t size2 = 0;
+        uint64_t differingBytes = 0;
+        std::vector<Range> ranges;
+        bool truncated = false;         // more than DiffOptions::maxRanges ranges; differingBytes is still exact
+    };
+
+    // A section (or the whole file, for non-images) compared by content-defined chunks, so an insertion
+    // only costs the chunks around it instead of everything after it.
+    struct BlockDelta {
+        std::string name;
+        uint64_t size1 = 0;             // 0 if the section is new
+        uint64_t size2 = 0;             // 0 if the section was removed
+        uint64_t sharedBytes = 0;       // bytes of the second file's section found in the first's
+        uint64_t removedBytes = 0;      // bytes of the first file's section found nowhere in the second's
+        std::vector<Range> changed;     // file offsets in the second file not found in the first
+    };
+
+    struct FunctionDelta {
+        enum class Status { Same, Moved, Changed, Added, Removed };
+
+        std::string name;
+        Status status = Status::Same;
+        uint64_t address1 = 0;
+        uint64_t address2 = 0;
+        uint64_t size1 = 0;
+        uint64_t size2 = 0;
+        double similarity = 1.0;        // share of 16-byte windows the two bodies have in common
+    };
+
+    struct DiffOptions {
+        uint64_t mergeGap = 0;          // join ranges separated by at most this many equal bytes
+        size_t maxRanges = 100000;
+        bool sections = false;
+        bool functions = false;         // functions are bounded by the next symbol, so stripped images give few
+    };
+
+    struct DiffReport {
+        ByteDelta bytes;
+        std::vector<BlockDelta> sections;
+        std::vector<FunctionDelta> functions;   // every function but the unchanged ones, by name
+        size_t sameFunctions = 0;
+    };
+
+    // Offset of the first differing byte (the shorter size if one file is a prefix of the other), or
+    // nullopt if the files are identical or cannot be read ('error' tells which).
+    std::optional<uint64_t> FirstDifference(const std::string& path1, const std::string& path2, std::string* error = nullptr);
+
+    std::optional<DiffReport> Compare(const std::string& path1, const std::string& path2, const DiffOptions& options, std::string* error = nullptr);
+
+    // Human-readable report, listing at most 'maxLines' ranges or functions per part.
+    std::string FormatReport(const DiffReport& report, size_t maxLines = 50);
+}
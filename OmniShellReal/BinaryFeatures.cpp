@@ -0,0 +1,253 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// BinaryFeatures.cpp
+#include "BinaryFeatures.h"
+#include "BinaryImage.h"
+#include "FileScanner.h"
+#include "MappedFile.h"
+#include "ScanCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <span>
+#include <sstream>
+
+namespace BinaryFeatures {
+    namespace {
+        constexpr size_t CACHED_FEATURES = 64;
+        constexpr size_t MAX_STRING_FEATURE = 256;   // longer strings are hashed by their first 256 characters
+        constexpr size_t MAX_API_STRING = 64;
+        constexpr size_t COMPARE_BLOCK = size_t(1) << 20;
+
+        struct Rule {
+            std::string_view api;
+            std::string_view behavior;
+        };
+        constexpr Rule RULES[] = {
+            { "CreateRemoteThread", "Code Injection" },
+            { "GetProcAddress", "Dynamic API Resolution" },
+            { "dlsym", "Dynamic API Resolution" },
+            { "WriteProcessMemory", "Memory Tampering" },
+            { "socket", "Network Activity" },
+            { "WSASocket", "Network Activity" },
+            { "RegCreateKey", "Registry Manipulation" },
+            { "RegSetValue", "Registry Manipulation" },
+        };
+
+        enum FeatureKind : uint64_t { Import = 1, Library, Export, String };
+
+        struct CachedFeatures {
+            std::filesystem::path path;
+            FileIdentity id;
+            std::shared_ptr<const FeatureSet> features;
+        };
+        std::mutex g_cacheMutex;
+        std::list<CachedFeatures> g_cache;      // most recently used first
+
+        void AddFeature(FeatureSet& set, FeatureKind kind, std::string_view text) {
+            uint64_t h = FileScanner::HashBytes({ reinterpret_cast<const unsigned char*>(text.data()), text.size() });
+            h ^= kind * 0x9E3779B97F4A7C15ull;
+            h = (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ull;
+            set.vector[(h >> 32) % VECTOR_SIZE] += 1.0f;
+            set.total += 1.0;
+        }
+
+        bool Printable(unsigned char c) { return (c >= 0x20 && c < 0x7F) || c == '\t'; }
+
+        bool Identifier(std::string_view s) {
+            return s.size() <= MAX_API_STRING && std::all_of(s.begin(), s.end(), [](char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+                });
+        }
+
+        void AddString(FeatureSet& set, std::string_view s) {
+            ++set.stringCount;
+            AddFeature(set, String, s.substr(0, MAX_STRING_FEATURE));
+            if (Identifier(s) && !BehaviorOf(s).empty()) set.apiStrings.emplace_back(s);
+        }
+
+        // One pass over the bytes collects both ASCII runs and UTF-16LE runs (printable byte, then zero)
+        // at either alignment. A UTF-16 string's characters are not ASCII runs, as each is one byte long.
+        void ScanStrings(std::span<const unsigned char> b, FeatureSet& set) {
+            const size_t n = b.size();
+            size_t asciiStart = 0;
+            size_t wideStart[2] = { 0, 1 };
+            size_t wideLength[2] = { 0, 0 };
+            std::string wide;
+            auto endWide = [&](size_t parity) {
+                if (wideLength[parity] >= MIN_STRING) {
+                    wide.clear();
+                    for (size_t k = 0; k < wideLength[parity]; ++k) wide.push_back(static_cast<char>(b[wideStart[parity] + 2 * k]));
+                    AddString(set, wide);
+                }
+                wideLength[parity] = 0;
+            };
+            for (size_t i = 0; i < n; ++i) {
+                const bool printable = Printable(b[i]);
+                if (!printable) {
+                    if (i - asciiStart >= MIN_STRING) AddString(set, { reinterpret_cast<const char*>(b.data() + asciiStart), i - asciiStart });
+                    asciiStart = i + 1;
+                }
+                const size_t parity = i & 1;
+                if (printable && i + 1 < n && b[i + 1] == 0) {
+                    if (wideLength[parity]++ == 0) wideStart[parity] = i;
+                }
+                else if (wideLength[parity]) {
+                    endWide(parity);
+                }
+            }
+            if (n - asciiStart >= MIN_STRING) AddString(set, { reinterpret_cast<const char*>(b.data() + asciiStart), n - asciiStart });
+            endWide(0);
+            endWide(1);
+        }
+
+        void SortUnique(std::vector<std::string>& v) {
+            std::sort(v.begin(), v.end());
+            v.erase(std::unique(v.begin(), v.end()), v.end());
+        }
+
+        std::shared_ptr<FeatureSet> Compute(const std::filesystem::path& path, std::span<const unsigned char> bytes, uint64_t hash) {
+            auto set = std::make_shared<FeatureSet>();
+            set->contentHash = hash;
+            set->fileSize = bytes.size();
+            ScanStrings(bytes, *set);
+            SortUnique(set->apiStrings);
+
+            if (auto image = BinaryImage::Open(path)) {
+                set->image = true;
+                for (const auto& imp : image->imports()) {
+                    AddFeature(*set, Import, imp.name);
+                    if (!imp.library.empty()) AddFeature(*set, Library, imp.library);
+                    set->imports.push_back(imp.library.empty() ? std::string(imp.name) : std::string(imp.library) + "!" + std::string(imp.name));
+                }
+                const bool pe = image->format() == ImageFormat::PE;
+                for (const auto& sym : image->symbols()) {
+                    if (!sym.dynamic || sym.name.empty() || (!pe && sym.section == 0)) continue;
+                    AddFeature(*set, Export, sym.name);
+                    set->exports.emplace_back(sym.name);
+                }
+                SortUnique(set->imports);
+                SortUnique(set->exports);
+
+                // Every symbol and import name, local .symtab ones included, also appears as a string in
+                // the image's string tables; only the strings left over are names resolved at run time.
+                std::vector<std::string_view> names;
+                for (const auto& sym : image->symbols()) names.push_back(sym.name);
+                for (const auto& imp : image->imports()) names.push_back(imp.name);
+                std::sort(names.begin(), names.end());
+                std::erase_if(set->apiStrings, [&](const std::string& s) { return std::binary_search(names.begin(), names.end(), std::string_view(s)); });
+            }
+            return set;
+        }
+
+        // Whether the file the cached 'entry' was computed from, if still unchanged, holds exactly 'bytes'.
+        // Read rather than mapped, so a file truncated meanwhile is a mismatch and not a SIGBUS.
+        bool SameContent(const CachedFeatures& entry, std::span<const unsigned char> bytes) {
+            FileIdentity now;
+            if (!ScanCache::Identify(entry.path, now) || now != entry.id || now.size != bytes.size()) return false;
+            std::ifstream in(entry.path, std::ios::binary);
+            std::vector<char> block(COMPARE_BLOCK);
+            for (size_t at = 0; at < bytes.size();) {
+                const size_t n = std::min(COMPARE_BLOCK, bytes.size() - at);
+                if (!in.read(block.data(), static_cast<std::streamsize>(n)) || std::memcmp(block.data(), bytes.data() + at, n) != 0) return false;
+                at += n;
+            }
+            return true;
+        }
+
+        std::string_view ImportName(std::string_view import) {
+            const size_t bang = import.find('!');
+            return bang == std::string_view::npos ? import : import.substr(bang + 1);
+        }
+    }
+
+    std::string_view BehaviorOf(std::string_view api) {
+        for (const auto& rule : RULES) {
+            if (api.starts_with(rule.api)) return rule.behavior;
+        }
+        return {};
+    }
+
+    std::shared_ptr<const FeatureSet> Extract(const std::string& pathString, std::string* error) {
+        const std::filesystem::path path(pathString);
+        FileIdentity id;
+        if (!ScanCache::Identify(path, id)) {
+            if (error) *error = "cannot stat " + pathString;
+            return nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_cacheMutex);
+            for (auto it = g_cache.begin(); it != g_cache.end(); ++it) {
+                if (it->path != path) continue;
+                if (it->id == id) {
+                    g_cache.splice(g_cache.begin(), g_cache, it);
+                    return g_cache.front().features;
+                }
+                g_cache.erase(it);
+                break;
+            }
+        }
+
+        MappedFile file;
+        if (!file.open(path, error)) return nullptr;
+        file.adviseSequential();
+        const uint64_t hash = FileScanner::HashBytes(file.bytes());
+
+        // The same content under another name (a copy, a quarantined file) reuses its features, once the
+        // bytes are confirmed equal: HashBytes is not collision resistant, and a crafted file must not
+        // inherit another file's features.
+        std::vector<CachedFeatures> candidates;
+        {
+            std::lock_guard<std::mutex> lock(g_cacheMutex);
+            for (const auto& entry : g_cache) {
+                if (entry.features->contentHash == hash && entry.features->fileSize == file.size()) candidates.push_back(entry);
+            }
+        }
+        std::shared_ptr<const FeatureSet> features;
+        for (const auto& candidate : candidates) {
+            if (SameContent(candidate, file.bytes())) {
+                features = candidate.features;
+                break;
+            }
+        }
+        if (!features) features = Compute(path, file.bytes(), hash);
+
+        std::lock_guard<std::mutex> lock(g_cacheMutex);
+        g_cache.push_front({ path, id, features });
+        if (g_cache.size() > CACHED_FEATURES) g_cache.pop_back();
+        return features;
+    }
+
+    std::vector<BehaviorHit> DetectBehaviors(const FeatureSet& features) {
+        std::vector<BehaviorHit> hits;
+        for (const auto& imp : features.imports) {
+            const std::string_view name = ImportName(imp);
+            const std::string_view behavior = BehaviorOf(name);
+            if (!behavior.empty()) hits.push_back({ behavior, std::string(name), false });
+        }
+        for (const auto& s : features.apiStrings) hits.push_back({ BehaviorOf(s), s, true });
+        return hits;
+    }
+
+    std::string FormatBehaviors(const std::vector<BehaviorHit>& hits) {
+        std::ostringstream report;
+        std::vector<std::string_view> done;
+        for (const auto& hit : hits) {
+            if (std::find(done.begin(), done.end(), hit.behavior) != done.end()) continue;
+            done.push_back(hit.behavior);
+            report << "[!] " << hit.behavior << " Detected (";
+            const char* separator = "";
+            for (const auto& other : hits) {
+                if (other.behavior != hit.behavior) continue;
+                report << separator << other.api << (other.byName ? " by name" : "");
+                separator = ", ";
+            }
+            report << ")\n";
+        }
+        return report.str();
+    }
+}
@@ -0,0 +1,58 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// BinaryFeatures.h
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What the malware heuristics and the AI analyzer look at, pulled from the parsed image in one pass
+// instead of searched for in a disassembly listing: the imports, the exported symbols and the
+// printable strings, folded into a fixed-size hashed feature vector. Results are cached by content
+// hash, so re-analysing a copy of a file costs one hash and one comparison of its bytes, and
+// re-analysing an unchanged file costs nothing.
+namespace BinaryFeatures {
+
+    constexpr size_t VECTOR_SIZE = 1024;
+    constexpr size_t MIN_STRING = 5;        // shortest printable run kept as a string
+
+    struct FeatureSet {
+        uint64_t contentHash = 0;           // FileScanner::HashBytes of the whole file
+        uint64_t fileSize = 0;
+        bool image = false;                 // parsed as ELF or PE; otherwise strings only
+        std::vector<std::string> imports;   // "library!name" when the library is known, sorted
+        std::vector<std::string> exports;   // sorted
+        uint64_t stringCount = 0;           // ASCII and UTF-16LE runs of at least MIN_STRING characters
+        std::vector<std::string> apiStrings;    // strings naming a watched API that are none of the image's own
+                                                // symbol or import names (see DetectBehaviors), sorted
+
+        // Feature hashing: each import, library, export and string token adds 1 to one bucket.
+        std::array<float, VECTOR_SIZE> vector{};
+        double total = 0.0;                 // sum of 'vector'
+    };
+
+    // A watched API found in the imports or, for names resolved at run time, in the strings.
+    struct BehaviorHit {
+        std::string_view behavior;          // e.g. "Code Injection"
+        std::string api;
+        bool byName = false;                // only found as a string, not imported
+    };
+
+    // Features of 'path', from the cache when the file or its content was seen before. nullptr and
+    // 'error' if the file cannot be read.
+    std::shared_ptr<const FeatureSet> Extract(const std::string& path, std::string* error = nullptr);
+
+    // The behavior a watched API belongs to, or empty. Prefix matches cover the A/W/Ex variants.
+    std::string_view BehaviorOf(std::string_view api);
+
+    // Every watched API in the imports and API strings, imports first.
+    std::vector<BehaviorHit> DetectBehaviors(const FeatureSet& features);
+
+    // One "[!] <behavior> Detected" line per behavior, naming the APIs that triggered it.
+    std::string FormatBehaviors(const std::vector<BehaviorHit>& hits);
+}
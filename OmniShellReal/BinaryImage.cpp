@@ -0,0 +1,491 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// BinaryImage.cpp
+#include "BinaryImage.h"
+#include "ScanCache.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <list>
+
+namespace {
+    // ELF constants, spelled out so the parser does not depend on <elf.h> or <windows.h>.
+    constexpr uint16_t ET_DYN_TYPE = 3;
+    constexpr uint32_t PT_LOAD_TYPE = 1;
+    constexpr uint32_t PT_INTERP_TYPE = 3;
+    constexpr uint32_t SHT_SYMTAB_TYPE = 2;
+    constexpr uint32_t SHT_RELA_TYPE = 4;
+    constexpr uint32_t SHT_REL_TYPE = 9;
+    constexpr uint32_t SHT_NOBITS_TYPE = 8;
+    constexpr uint32_t SHT_DYNSYM_TYPE = 11;
+    constexpr uint64_t SHF_ALLOC_FLAG = 0x2;
+    constexpr uint64_t SHF_EXECINSTR_FLAG = 0x4;
+    constexpr uint16_t SHN_XINDEX_VALUE = 0xFFFF;
+    constexpr uint8_t STT_FUNC_TYPE = 2;
+    constexpr uint16_t EM_ARM_MACHINE = 40;
+
+    // PE/COFF constants.
+    constexpr uint16_t PE32_MAGIC = 0x10B;
+    constexpr uint16_t PE32_PLUS_MAGIC = 0x20B;
+    constexpr uint16_t FILE_DLL = 0x2000;
+    constexpr uint16_t DLL_DYNAMIC_BASE = 0x40;
+    constexpr uint32_t SCN_CNT_CODE = 0x20;
+    constexpr uint32_t SCN_MEM_EXECUTE = 0x20000000;
+    constexpr uint64_t COFF_SYMBOL_SIZE = 18;
+    constexpr uint8_t COFF_CLASS_EXTERNAL = 2;
+    constexpr uint8_t COFF_CLASS_STATIC = 3;
+
+    constexpr size_t OPEN_IMAGES = 8;   // images remembered for reuse by Open()
+
+    // Weak, so a mapping lives only as long as some caller still uses the image: an idle mapping would
+    // keep the file from being replaced on Windows, and risk SIGBUS on POSIX if it were truncated.
+    struct CachedImage {
+        std::filesystem::path path;
+        FileIdentity id;
+        std::weak_ptr<const BinaryImage> image;
+    };
+    std::mutex g_openMutex;
+    std::list<CachedImage> g_openImages;    // most recently used first
+}
+
+template<typename T>
+T BinaryImage::read(uint64_t offset) const {
+    if (!inRange(offset, sizeof(T))) return 0;
+    T value;
+    std::memcpy(&value, file.data() + offset, sizeof(T));
+    if constexpr (sizeof(T) > 1) {
+        if (big != (std::endian::native == std::endian::big)) value = std::byteswap(value);
+    }
+    return value;
+}
+
+std::string_view BinaryImage::cString(uint64_t offset, uint64_t limit) const {
+    limit = std::min<uint64_t>(limit, file.size());
+    if (offset >= limit) return {};
+    const char* start = reinterpret_cast<const char*>(file.data() + offset);
+    const void* nul = std::memchr(start, 0, static_cast<size_t>(limit - offset));
+    return { start, nul ? static_cast<size_t>(static_cast<const char*>(nul) - start) : static_cast<size_t>(limit - offset) };
+}
+
+std::shared_ptr<const BinaryImage> BinaryImage::Open(const std::filesystem::path& path, std::string* error) {
+    FileIdentity id;
+    if (!ScanCache::Identify(path, id)) {
+        if (error) *error = "cannot stat " + path.string();
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_openMutex);
+        for (auto it = g_openImages.begin(); it != g_openImages.end(); ++it) {
+            if (it->path != path) continue;
+            if (it->id == id) {
+                if (auto image = it->image.lock()) {
+                    g_openImages.splice(g_openImages.begin(), g_openImages, it);
+                    return image;
+                }
+            }
+            g_openImages.erase(it);
+            break;
+        }
+    }
+
+    std::shared_ptr<BinaryImage> image(new BinaryImage());
+    image->filePath = path;
+    if (!image->file.open(path, error) || !image->parseHeaders(error)) return nullptr;
+
+    std::lock_guard<std::mutex> lock(g_openMutex);
+    std::erase_if(g_openImages, [](const CachedImage& c) { return c.image.expired(); });
+    g_openImages.push_front({ path, id, image });
+    if (g_openImages.size() > OPEN_IMAGES) g_openImages.pop_back();
+    return image;
+}
+
+bool BinaryImage::parseHeaders(std::string* error) {
+    auto fail = [&](const char* why) {
+        if (error) *error = why;
+        return false;
+    };
+    const auto b = file.bytes();
+    if (b.size() >= 16 && b[0] == 0x7F && b[1] == 'E' && b[2] == 'L' && b[3] == 'F') {
+        fmt = ImageFormat::ELF;
+        if ((b[4] != 1 && b[4] != 2) || (b[5] != 1 && b[5] != 2)) return fail("unsupported ELF class or byte order");
+        wide = b[4] == 2;
+        big = b[5] == 2;
+        const uint16_t type = read<uint16_t>(16);
+        machineId = read<uint16_t>(18);
+        uint64_t phoff, shoff;
+        uint16_t phentsize, phnum, shentsize, shnum, shstrndx;
+        if (wide) {
+            entryAddress = read<uint64_t>(24);
+            phoff = read<uint64_t>(32);
+            shoff = read<uint64_t>(40);
+            phentsize = read<uint16_t>(54);
+            phnum = read<uint16_t>(56);
+            shentsize = read<uint16_t>(58);
+            shnum = read<uint16_t>(60);
+            shstrndx = read<uint16_t>(62);
+        }
+        else {
+            entryAddress = read<uint32_t>(24);
+            phoff = read<uint32_t>(28);
+            shoff = read<uint32_t>(32);
+            phentsize = read<uint16_t>(42);
+            phnum = read<uint16_t>(44);
+            shentsize = read<uint16_t>(46);
+            shnum = read<uint16_t>(48);
+            shstrndx = read<uint16_t>(50);
+        }
+        if (shoff && shentsize != (wide ? 64 : 40)) return fail("unexpected ELF section header size");
+        if (phoff && phentsize != (wide ? 56 : 32)) return fail("unexpected ELF program header size");
+
+        // More than 0xFF00 sections: the real count and name-table index live in section 0.
+        uint64_t count = shnum;
+        if (shoff && shnum == 0) count = wide ? read<uint64_t>(shoff + 32) : read<uint32_t>(shoff + 20);
+        sectionNamesIndex = (shstrndx == SHN_XINDEX_VALUE) ? read<uint32_t>(shoff + (wide ? 40 : 24)) : shstrndx;
+        if (shoff) count = std::min<uint64_t>(count, inRange(shoff, 0) ? (file.size() - shoff) / shentsize : 0);
+        sectionTableOffset = shoff;
+        sectionCount = static_cast<uint32_t>(count);
+
+        bool interpreter = false;
+        uint64_t lowest = UINT64_MAX;
+        for (uint16_t i = 0; i < phnum; ++i) {
+            const uint64_t ph = phoff + uint64_t(i) * phentsize;
+            const uint32_t ptype = read<uint32_t>(ph);
+            if (ptype == PT_INTERP_TYPE) interpreter = true;
+            if (ptype == PT_LOAD_TYPE) lowest = std::min<uint64_t>(lowest, wide ? read<uint64_t>(ph + 16) : read<uint32_t>(ph + 8));
+        }
+        base = (lowest == UINT64_MAX) ? 0 : (lowest & ~uint64_t(0xFFF));
+        // ET_DYN covers both shared objects and PIE executables; only the latter ask for an interpreter.
+        pic = type == ET_DYN_TYPE;
+        library = type == ET_DYN_TYPE && !interpreter;
+        return true;
+    }
+
+    if (b.size() >= 0x40 && b[0] == 'M' && b[1] == 'Z') {
+        fmt = ImageFormat::PE;
+        big = false;
+        const uint64_t nt = read<uint32_t>(0x3C);
+        if (read<uint32_t>(nt) != 0x00004550) return fail("missing PE signature");
+        const uint64_t coff = nt + 4;
+        machineId = read<uint16_t>(coff);
+        const uint16_t sections = read<uint16_t>(coff + 2);
+        peSymbolTable = read<uint32_t>(coff + 8);
+        peSymbolCount = read<uint32_t>(coff + 12);
+        const uint16_t optionalSize = read<uint16_t>(coff + 16);
+        const uint16_t characteristics = read<uint16_t>(coff + 18);
+        const uint64_t opt = coff + 20;
+        const uint16_t magic = read<uint16_t>(opt);
+        if (magic != PE32_MAGIC && magic != PE32_PLUS_MAGIC) return fail("unknown PE optional header");
+        wide = magic == PE32_PLUS_MAGIC;
+        entryAddress = read<uint32_t>(opt + 16);
+        base = wide ? read<uint64_t>(opt + 24) : read<uint32_t>(opt + 28);
+        library = (characteristics & FILE_DLL) != 0;
+        pic = (read<uint16_t>(opt + 70) & DLL_DYNAMIC_BASE) != 0;
+        const uint64_t exportDirectory = wide ? 112 : 96;
+        if (optionalSize >= exportDirectory + 8) peExportRva = read<uint32_t>(opt + exportDirectory);
+        if (optionalSize >= exportDirectory + 16) peImportRva = read<uint32_t>(opt + exportDirectory + 8);
+        sectionTableOffset = opt + optionalSize;
+        sectionCount = sections;
+        if (peSymbolTable && !inRange(peSymbolTable, uint64_t(peSymbolCount) * COFF_SYMBOL_SIZE)) peSymbolCount = 0;
+        return true;
+    }
+
+    return fail("not an ELF or PE image");
+}
+
+void BinaryImage::parseSections() const {
+    if (fmt == ImageFormat::ELF) {
+        if (!sectionTableOffset) return;
+        const uint64_t entry = wide ? 64 : 40;
+        sectionList.reserve(sectionCount);
+        std::vector<uint32_t> nameOffsets;
+        for (uint32_t i = 0; i < sectionCount; ++i) {
+            const uint64_t sh = sectionTableOffset + i * entry;
+            ImageSection s;
+            nameOffsets.push_back(read<uint32_t>(sh));
+            s.type = read<uint32_t>(sh + 4);
+            if (wide) {
+                s.flags = read<uint64_t>(sh + 8);
+                s.address = read<uint64_t>(sh + 16);
+                s.offset = read<uint64_t>(sh + 24);
+                s.memorySize = read<uint64_t>(sh + 32);
+                s.link = read<uint32_t>(sh + 40);
+                s.entrySize = read<uint64_t>(sh + 56);
+            }
+            else {
+                s.flags = read<uint32_t>(sh + 8);
+                s.address = read<uint32_t>(sh + 12);
+                s.offset = read<uint32_t>(sh + 16);
+                s.memorySize = read<uint32_t>(sh + 20);
+                s.link = read<uint32_t>(sh + 24);
+                s.entrySize = read<uint32_t>(sh + 36);
+            }
+            s.size = (s.type == SHT_NOBITS_TYPE || !inRange(s.offset, s.memorySize)) ? 0 : s.memorySize;
+            s.executable = (s.flags & SHF_EXECINSTR_FLAG) != 0;
+            sectionList.push_back(s);
+        }
+        if (sectionNamesIndex < sectionList.size()) {
+            const ImageSection& names = sectionList[sectionNamesIndex];
+            for (size_t i = 0; i < sectionList.size(); ++i) {
+                sectionList[i].name = cString(names.offset + nameOffsets[i], names.offset + names.size);
+            }
+        }
+        return;
+    }
+
+    const uint64_t stringTable = peSymbolTable + uint64_t(peSymbolCount) * COFF_SYMBOL_SIZE;
+    const uint64_t stringLimit = stringTable + read<uint32_t>(stringTable);
+    sectionList.reserve(sectionCount);
+    for (uint32_t i = 0; i < sectionCount; ++i) {
+        const uint64_t sh = sectionTableOffset + uint64_t(i) * 40;
+        if (!inRange(sh, 40)) break;
+        ImageSection s;
+        s.name = cString(sh, sh + 8);
+        // Long names (object files) are "/<decimal offset>" into the COFF string table.
+        if (s.name.size() > 1 && s.name[0] == '/' && peSymbolTable) {
+            uint32_t at = 0;
+            auto [p, ec] = std::from_chars(s.name.data() + 1, s.name.data() + s.name.size(), at);
+            if (ec == std::errc()) s.name = cString(stringTable + at, stringLimit);
+        }
+        s.memorySize = read<uint32_t>(sh + 8);
+        s.address = read<uint32_t>(sh + 12);
+        const uint64_t raw = read<uint32_t>(sh + 16);
+        s.offset = read<uint32_t>(sh + 20);
+        s.flags = read<uint32_t>(sh + 36);
+        // Raw data is padded to the file alignment; the virtual size says how much of it is real.
+        s.size = (s.memorySize && s.memorySize < raw) ? s.memorySize : raw;
+        if (!inRange(s.offset, s.size)) s.size = 0;
+        s.executable = (s.flags & (SCN_CNT_CODE | SCN_MEM_EXECUTE)) != 0;
+        sectionList.push_back(s);
+    }
+}
+
+const std::vector<ImageSection>& BinaryImage::sections() const {
+    std::call_once(sectionsOnce, [this] { parseSections(); });
+    return sectionList;
+}
+
+// Non-allocated ELF sections (debug info, .comment) all sit at address 0 and are not part of the image.
+const ImageSection* BinaryImage::sectionAt(uint64_t address) const {
+    for (const auto& s : sections()) {
+        if (fmt == ImageFormat::ELF && !(s.flags & SHF_ALLOC_FLAG)) continue;
+        if (s.size && address >= s.address && address - s.address < s.size) return &s;
+    }
+    return nullptr;
+}
+
+std::optional<uint64_t> BinaryImage::fileOffsetOf(uint64_t address) const {
+    const ImageSection* s = sectionAt(address);
+    if (!s) return std::nullopt;
+    return s->offset + (address - s->address);
+}
+
+std::span<const unsigned char> BinaryImage::bytesAt(uint64_t address) const {
+    const ImageSection* s = sectionAt(address);
+    if (!s) return {};
+    return bytes().subspan(static_cast<size_t>(s->offset + (address - s->address)), static_cast<size_t>(s->size - (address - s->address)));
+}
+
+bool BinaryImage::hasSymbolTable() const {
+    if (fmt == ImageFormat::PE) return peSymbolCount > 0;
+    const auto& list = sections();
+    return std::any_of(list.begin(), list.end(), [](const ImageSection& s) { return s.type == SHT_SYMTAB_TYPE; });
+}
+
+void BinaryImage::parseElfSymbols(const ImageSection& table, const ImageSection& strings, bool dynamic) const {
+    const uint64_t entry = wide ? 24 : 16;
+    if (table.entrySize && table.entrySize != entry) return;
+    const uint64_t count = table.size / entry;
+    for (uint64_t i = 1; i < count; ++i) {   // entry 0 is the reserved null symbol
+        const uint64_t at = table.offset + i * entry;
+        ImageSymbol sym;
+        sym.dynamic = dynamic;
+        const uint32_t nameOffset = read<uint32_t>(at);
+        uint8_t info;
+        if (wide) {
+            info = read<uint8_t>(at + 4);
+            sym.section = read<uint16_t>(at + 6);
+            sym.value = read<uint64_t>(at + 8);
+            sym.size = read<uint64_t>(at + 16);
+        }
+        else {
+            sym.value = read<uint32_t>(at + 4);
+            sym.size = read<uint32_t>(at + 8);
+            info = read<uint8_t>(at + 12);
+            sym.section = read<uint16_t>(at + 14);
+        }
+        sym.type = info & 0xF;
+        sym.name = cString(strings.offset + nameOffset, strings.offset + strings.size);
+        symbolList.push_back(sym);
+    }
+}
+
+void BinaryImage::parsePeSymbols() const {
+    const uint64_t stringTable = peSymbolTable + uint64_t(peSymbolCount) * COFF_SYMBOL_SIZE;
+    const uint64_t stringLimit = stringTable + read<uint32_t>(stringTable);
+    for (uint32_t i = 0; i < peSymbolCount; ++i) {
+        const uint64_t at = peSymbolTable + uint64_t(i) * COFF_SYMBOL_SIZE;
+        ImageSymbol sym;
+        sym.name = (read<uint32_t>(at) == 0) ? cString(stringTable + read<uint32_t>(at + 4), stringLimit) : cString(at, at + 8);
+        sym.value = read<uint32_t>(at + 8);
+        const int16_t section = static_cast<int16_t>(read<uint16_t>(at + 12));
+        sym.section = section > 0 ? static_cast<uint32_t>(section) : 0;
+        sym.type = read<uint8_t>(at + 16);
+        symbolList.push_back(sym);
+        i += read<uint8_t>(at + 17);   // skip auxiliary records
+    }
+}
+
+void BinaryImage::parsePeExports() const {
+    const auto dir = fileOffsetOf(peExportRva);
+    if (!dir) return;
+    const uint32_t functionCount = read<uint32_t>(*dir + 20);
+    const uint32_t nameCount = read<uint32_t>(*dir + 24);
+    const auto functions = fileOffsetOf(read<uint32_t>(*dir + 28));
+    const auto names = fileOffsetOf(read<uint32_t>(*dir + 32));
+    const auto ordinals = fileOffsetOf(read<uint32_t>(*dir + 36));
+    if (!functions || !names || !ordinals) return;
+    for (uint32_t i = 0; i < nameCount; ++i) {
+        const uint16_t ordinal = read<uint16_t>(*ordinals + uint64_t(i) * 2);
+        if (ordinal >= functionCount) continue;
+        const auto nameAt = fileOffsetOf(read<uint32_t>(*names + uint64_t(i) * 4));
+        if (!nameAt) continue;
+        ImageSymbol sym;
+        sym.name = cString(*nameAt, file.size());
+        sym.value = read<uint32_t>(*functions + uint64_t(ordinal) * 4);
+        sym.dynamic = true;
+        const auto& list = sections();
+        for (size_t k = 0; k < list.size(); ++k) {
+            if (sym.value >= list[k].address && sym.value - list[k].address < std::max(list[k].memorySize, list[k].size)) {
+                sym.section = static_cast<uint32_t>(k + 1);
+                break;
+            }
+        }
+        symbolList.push_back(sym);
+    }
+}
+
+void BinaryImage::parseSymbols() const {
+    const auto& list = sections();
+    if (fmt == ImageFormat::ELF) {
+        for (const auto& s : list) {
+            if ((s.type == SHT_SYMTAB_TYPE || s.type == SHT_DYNSYM_TYPE) && s.link < list.size()) {
+                parseElfSymbols(s, list[s.link], s.type == SHT_DYNSYM_TYPE);
+            }
+        }
+        return;
+    }
+    if (peSymbolCount) parsePeSymbols();
+    if (peExportRva) parsePeExports();
+}
+
+const std::vector<ImageSymbol>& BinaryImage::symbols() const {
+    std::call_once(symbolsOnce, [this] { parseSymbols(); });
+    return symbolList;
+}
+
+// Relocations against undefined dynamic symbols: the relocated word is the symbol's GOT slot, which
+// is what PLT stubs and -fno-plt calls jump through.
+void BinaryImage::parseElfImports(const ImageSection& relocations, bool addends) const {
+    const auto& list = sections();
+    if (relocations.link >= list.size()) return;
+    const ImageSection& table = list[relocations.link];
+    if (table.type != SHT_DYNSYM_TYPE || table.link >= list.size()) return;
+    const ImageSection& strings = list[table.link];
+    const uint64_t entry = wide ? (addends ? 24 : 16) : (addends ? 12 : 8);
+    const uint64_t symbolEntry = wide ? 24 : 16;
+    for (uint64_t at = relocations.offset; at + entry <= relocations.offset + relocations.size; at += entry) {
+        const uint64_t slot = wide ? read<uint64_t>(at) : read<uint32_t>(at);
+        const uint64_t symbol = wide ? (read<uint64_t>(at + 8) >> 32) : (read<uint32_t>(at + 4) >> 8);
+        if (symbol == 0 || symbol * symbolEntry >= table.size) continue;
+        const uint64_t sym = table.offset + symbol * symbolEntry;
+        if (read<uint16_t>(sym + (wide ? 6 : 14)) != 0) continue;   // defined here, not imported
+        ImageImport imp;
+        imp.name = cString(strings.offset + read<uint32_t>(sym), strings.offset + strings.size);
+        imp.slot = slot;
+        if (!imp.name.empty()) importList.push_back(imp);
+    }
+}
+
+void BinaryImage::parseImports() const {
+    if (fmt == ImageFormat::ELF) {
+        for (const auto& s : sections()) {
+            if (s.type == SHT_RELA_TYPE || s.type == SHT_REL_TYPE) parseElfImports(s, s.type == SHT_RELA_TYPE);
+        }
+    }
+    else if (peImportRva) {
+        // IMAGE_IMPORT_DESCRIPTORs, one per DLL, ended by an all-zero entry. Names come from the lookup
+        // table (OriginalFirstThunk) because the IAT may already hold bound addresses.
+        const uint64_t thunkSize = wide ? 8 : 4;
+        const uint64_t ordinalFlag = wide ? (1ull << 63) : (1ull << 31);
+        for (uint64_t rva = peImportRva;; rva += 20) {
+            const auto at = fileOffsetOf(rva);
+            if (!at || !inRange(*at, 20)) break;
+            const uint32_t lookup = read<uint32_t>(*at);
+            const uint32_t nameRva = read<uint32_t>(*at + 12);
+            const uint32_t iat = read<uint32_t>(*at + 16);
+            if (!nameRva && !iat) break;
+            const auto libraryAt = fileOffsetOf(nameRva);
+            const std::string_view library = libraryAt ? cString(*libraryAt, file.size()) : std::string_view{};
+            const auto thunks = fileOffsetOf(lookup ? lookup : iat);
+            if (!thunks) continue;
+            for (uint64_t i = 0;; ++i) {
+                const uint64_t thunk = wide ? read<uint64_t>(*thunks + i * thunkSize) : read<uint32_t>(*thunks + i * thunkSize);
+                if (!thunk) break;
+                if (thunk & ordinalFlag) continue;   // imported by ordinal: no name to report
+                const auto hintName = fileOffsetOf(thunk & 0x7FFFFFFF);
+                if (!hintName) break;
+                ImageImport imp;
+                imp.name = cString(*hintName + 2, file.size());
+                imp.library = library;
+                imp.slot = iat + i * thunkSize;
+                importList.push_back(imp);
+            }
+        }
+    }
+    std::sort(importList.begin(), importList.end(), [](const ImageImport& a, const ImageImport& b) { return a.slot < b.slot; });
+}
+
+const std::vector<ImageImport>& BinaryImage::imports() const {
+    std::call_once(importsOnce, [this] { parseImports(); });
+    return importList;
+}
+
+std::vector<ImageFunction> BinaryImage::functions() const {
+    std::vector<ImageFunction> list;
+    const auto& sectionList = sections();
+    for (const auto& sym : symbols()) {
+        ImageFunction fn;
+        fn.name = sym.name;
+        if (fmt == ImageFormat::ELF) {
+            if (sym.type != STT_FUNC_TYPE || !sym.section || !sym.value) continue;
+            // ARM: bit 0 marks Thumb code, not part of the address.
+            fn.address = (machineId == EM_ARM_MACHINE) ? (sym.value & ~uint64_t(1)) : sym.value;
+        }
+        else if (sym.dynamic) {
+            fn.address = sym.value;
+        }
+        else {
+            // COFF symbols are section-relative; only code symbols of external or static class name functions.
+            if (!sym.section || sym.section > sectionList.size() || !sectionList[sym.section - 1].executable) continue;
+            if (sym.type != COFF_CLASS_EXTERNAL && sym.type != COFF_CLASS_STATIC) continue;
+            fn.address = sectionList[sym.section - 1].address + sym.value;
+        }
+        list.push_back(fn);
+    }
+    ImageFunction start;
+    start.address = entryAddress;
+    list.push_back(start);
+    std::stable_sort(list.begin(), list.end(), [](const ImageFunction& a, const ImageFunction& b) { return a.address < b.address; });
+    // Keep one entry per address, preferring a named one.
+    std::vector<ImageFunction> unique;
+    for (const auto& fn : list) {
+        if (!unique.empty() && unique.back().address == fn.address) {
+            if (unique.back().name.empty()) unique.back().name = fn.name;
+            continue;
+        }
+        unique.push_back(fn);
+    }
+    return unique;
+}
@@ -0,0 +1,146 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// BinaryImage.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+
+enum class ImageFormat { ELF, PE };
+
+// One section header. 'name' points into the mapped file.
+struct ImageSection {
+    std::string_view name;
+    uint64_t address = 0;       // virtual address (ELF) or RVA (PE)
+    uint64_t offset = 0;        // in the file
+    uint64_t size = 0;          // bytes in the file; 0 for .bss-like sections
+    uint64_t memorySize = 0;    // bytes once loaded
+    uint32_t type = 0;          // sh_type (ELF); 0 for PE
+    uint64_t flags = 0;         // sh_flags (ELF) or Characteristics (PE)
+    uint32_t link = 0;          // sh_link (ELF): the string table of a symbol table
+    uint64_t entrySize = 0;     // sh_entsize (ELF)
+    bool executable = false;
+};
+
+// One symbol. 'name' points into the mapped file.
+struct ImageSymbol {
+    std::string_view name;
+    uint64_t value = 0;         // address (ELF) or RVA (PE exports); section-relative for COFF symbols
+    uint64_t size = 0;
+    uint32_t section = 0;       // section index, or 0 if undefined/absolute
+    uint8_t type = 0;           // ELF STT_* or COFF storage class
+    bool dynamic = false;       // from .dynsym or the PE export table
+};
+
+// A function the image imports. 'slot' is the address (same space as ImageSection::address) of the
+// pointer the loader fills in: the IAT entry (PE) or the GOT entry named by a relocation (ELF).
+struct ImageImport {
+    std::string_view name;
+    std::string_view library;   // PE only; ELF does not record which object provides a symbol
+    uint64_t slot = 0;
+};
+
+// A known function start: the entry point or a function symbol, in ImageSection::address space.
+struct ImageFunction {
+    uint64_t address = 0;
+    std::string_view name;      // empty for an unnamed entry point
+};
+
+/**
+ * @class BinaryImage
+ * @brief An ELF or PE file mapped read-only, with its headers decoded once and its tables on demand.
+ *
+ * Open() validates the file header and the fields every caller needs (machine, entry, image base).
+ * The section table and the symbol and string tables are decoded on first use and kept; names are
+ * string_views into the mapping, so nothing is copied. Fields are read at explicit offsets with
+ * bounds checks and byte-order conversion, so truncated or big-endian files are handled without
+ * casting the mapping to structs. Handles ELF32/ELF64 in either byte order and PE32/PE32+.
+ *
+ * Instances are immutable and thread-safe. Open() hands out the image it already has for a file while
+ * any caller still holds it, so concurrent users (Probe, the symbol and section listings, the
+ * disassembler) share one mapping and one parse; the mapping is released with the last holder.
+ */
+class BinaryImage {
+public:
+    // A shared image of 'path', reused while the file is unchanged and the image still held. nullptr (and 'error') if the file
+    // cannot be mapped or is neither ELF nor PE.
+    static std::shared_ptr<const BinaryImage> Open(const std::filesystem::path& path, std::string* error = nullptr);
+
+    ImageFormat format() const { return fmt; }
+    bool is64() const { return wide; }
+    bool bigEndian() const { return big; }
+    uint16_t machine() const { return machineId; }   // e_machine or IMAGE_FILE_HEADER::Machine
+    uint64_t entry() const { return entryAddress; }   // virtual address (ELF) or RVA (PE)
+    uint64_t imageBase() const { return base; }       // lowest PT_LOAD address (ELF) or ImageBase (PE)
+    bool isLibrary() const { return library; }
+    bool positionIndependent() const { return pic; }
+    bool hasSymbolTable() const;                      // .symtab (ELF) or a COFF symbol table (PE)
+
+    std::span<const unsigned char> bytes() const { return file.bytes(); }
+    const std::filesystem::path& path() const { return filePath; }
+
+    const std::vector<ImageSection>& sections() const;
+    const std::vector<ImageSymbol>& symbols() const;
+    const std::vector<ImageImport>& imports() const;   // sorted by slot
+    // The entry point and every function symbol, sorted by address, one entry per address (the first name wins).
+    std::vector<ImageFunction> functions() const;
+
+    // The file bytes backing 'address' (same address space as ImageSection::address), up to the end of
+    // its section; empty if no section maps it.
+    std::span<const unsigned char> bytesAt(uint64_t address) const;
+
+private:
+    BinaryImage() = default;
+    bool parseHeaders(std::string* error);
+    void parseSections() const;
+    void parseSymbols() const;
+    void parseElfSymbols(const ImageSection& table, const ImageSection& strings, bool dynamic) const;
+    void parsePeSymbols() const;
+    void parsePeExports() const;
+    void parseImports() const;
+    void parseElfImports(const ImageSection& relocations, bool addends) const;
+
+    // Bounds-checked, byte-order-aware reads; out-of-range reads yield 0.
+    template<typename T> T read(uint64_t offset) const;
+    bool inRange(uint64_t offset, uint64_t size) const { return offset <= file.size() && size <= file.size() - offset; }
+    std::string_view cString(uint64_t offset, uint64_t limit) const;
+    const ImageSection* sectionAt(uint64_t address) const;
+    std::optional<uint64_t> fileOffsetOf(uint64_t address) const;
+
+    MappedFile file;
+    std::filesystem::path filePath;
+    ImageFormat fmt = ImageFormat::ELF;
+    bool wide = false;
+    bool big = false;
+    uint16_t machineId = 0;
+    uint64_t entryAddress = 0;
+    uint64_t base = 0;
+    bool library = false;
+    bool pic = false;
+
+    // ELF: section header table. PE: where the headers' tables live.
+    uint64_t sectionTableOffset = 0;
+    uint32_t sectionCount = 0;
+    uint32_t sectionNamesIndex = 0;
+    uint64_t peSymbolTable = 0;
+    uint32_t peSymbolCount = 0;
+    uint64_t peExportRva = 0;
+    uint64_t peImportRva = 0;
+
+    mutable std::once_flag sectionsOnce;
+    mutable std::vector<ImageSection> sectionList;
+    mutable std::once_flag symbolsOnce;
+    mutable std::vector<ImageSymbol> symbolList;
+    mutable std::once_flag importsOnce;
+    mutable std::vector<ImageImport> importList;
+};
@@ -140,7 +140,7 @@ namespace BinaryManip {
 
     std::vector<std::string> DiscoverSymbols(const std::string& path);
     std::vector<std::string> ListSections(const std::string& path);
-    std::vector<std::string> QuickCFG(const std::string& path); // coarse basic-block map
+    std::vector<std::string> QuickCFG(const std::string& path); // one line per recovered function
 
     // ADDED: New advanced analysis function declarations
     std::optional<size_t> FindFirstDifference(const std::string& file1_path, const std::string& file2_path);
@@ -5,14 +5,207 @@ Copyright © 2025 Cadell Richard Anderson
 // =================================================================
 #include "BinaryTranslator.h"
 #include "BinaryManip.h"    
+#include "BinaryFeatures.h"
+#include "BinaryImage.h"
+#include "ControlFlowGraph.h"
+#include "MappedFile.h"
+#include "JobManager.h"
 #include <capstone/capstone.h>
-#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <optional>
+#include <span>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #include <windows.h>
 
 #pragma comment(lib, "capstone.lib")
 
+namespace {
+    using BinaryTranslator::Instruction;
+
+    constexpr uint64_t MIN_CHUNK_BYTES = 256 * 1024;   // smaller pieces cost more to schedule than they save
+    constexpr uint64_t RAW_CODE_ADDRESS = 0x1000;      // where raw (non-image) code is shown to start
+
+    struct CapstoneTarget {
+        cs_arch arch;
+        cs_mode mode;
+        unsigned step;      // bytes to skip past something Capstone cannot decode
+        bool x86;
+    };
+
+    std::optional<CapstoneTarget> TargetFor(BinaryManip::Arch arch, bool wide, bool big) {
+        const int endian = big ? CS_MODE_BIG_ENDIAN : CS_MODE_LITTLE_ENDIAN;
+        switch (arch) {
+        case BinaryManip::Arch::X86:   return CapstoneTarget{ CS_ARCH_X86, CS_MODE_32, 1, true };
+        case BinaryManip::Arch::X64:   return CapstoneTarget{ CS_ARCH_X86, CS_MODE_64, 1, true };
+        case BinaryManip::Arch::ARM:   return CapstoneTarget{ CS_ARCH_ARM, cs_mode(CS_MODE_ARM | endian), 4, false };
+        case BinaryManip::Arch::ARM64: return CapstoneTarget{ CS_ARCH_ARM64, CS_MODE_ARM, 4, false };
+        case BinaryManip::Arch::PPC:   return CapstoneTarget{ CS_ARCH_PPC, cs_mode((wide ? CS_MODE_64 : CS_MODE_32) | endian), 4, false };
+        case BinaryManip::Arch::MIPS:  return CapstoneTarget{ CS_ARCH_MIPS, cs_mode((wide ? CS_MODE_MIPS64 : CS_MODE_MIPS32) | endian), 4, false };
+        default:                       return std::nullopt;
+        }
+    }
+
+    // One piece of a section, decoded by one task into its own buffers and merged afterwards.
+    struct Chunk {
+        uint64_t address = 0;
+        uint64_t end = 0;
+        std::span<const unsigned char> code;    // from 'address' to the end of the section
+        std::vector<Instruction> instructions;
+        std::vector<std::string> mnemonics;
+        std::string operandText;
+        uint64_t undecoded = 0;
+        bool failed = false;
+        std::string error;                      // why, when 'failed'
+    };
+
+    // Cuts a section into pieces of at least MIN_CHUNK_BYTES at function starts, where a linear sweep is
+    // known to be in step with the instruction stream.
+    void SplitSection(std::span<const unsigned char> code, uint64_t address, const std::vector<uint64_t>& starts, std::vector<Chunk>& chunks) {
+        const uint64_t end = address + code.size();
+        auto add = [&](uint64_t from, uint64_t to) {
+            Chunk chunk;
+            chunk.address = from;
+            chunk.end = to;
+            chunk.code = code.subspan(static_cast<size_t>(from - address));
+            chunks.push_back(std::move(chunk));
+        };
+        uint64_t begin = address;
+        for (auto it = std::upper_bound(starts.begin(), starts.end(), address); it != starts.end() && *it < end; ++it) {
+            if (*it - begin < MIN_CHUNK_BYTES) continue;
+            add(begin, *it);
+            begin = *it;
+        }
+        add(begin, end);
+    }
+
+    uint32_t ImportAt(const BinaryImage& image, uint64_t slot) {
+        const auto& imports = image.imports();
+        auto it = std::lower_bound(imports.begin(), imports.end(), slot, [](const ImageImport& imp, uint64_t s) { return imp.slot < s; });
+        return (it != imports.end() && it->slot == slot) ? static_cast<uint32_t>(it - imports.begin()) + 1 : 0;
+    }
+
+    // The pointer slot read by an x86 "call [mem]" (FF 15) or "jmp [mem]" (FF 25), after any bnd, ds or
+    // REX.W prefix: RIP-relative on x64, absolute on x86 ('base' turns a PE VA back into an RVA). 0 for
+    // any other encoding.
+    uint64_t SlotOf(const unsigned char* code, size_t size, uint64_t address, bool wide, uint64_t base) {
+        size_t k = 0;
+        while (k < 2 && k < size && (code[k] == 0xF2 || code[k] == 0x3E || code[k] == 0x48)) ++k;
+        if (k + 6 > size || code[k] != 0xFF || (code[k + 1] != 0x15 && code[k + 1] != 0x25)) return 0;
+        const uint32_t disp = uint32_t(code[k + 2]) | uint32_t(code[k + 3]) << 8 | uint32_t(code[k + 4]) << 16 | uint32_t(code[k + 5]) << 24;
+        if (wide) return address + k + 6 + static_cast<int64_t>(static_cast<int32_t>(disp));
+        return uint64_t(disp) - base;
+    }
+
+    // A direct call into a PLT stub or an import thunk: an optional endbr, then "jmp [slot]".
+    uint32_t ImportThroughStub(const BinaryImage& image, uint64_t target, bool wide, uint64_t base) {
+        const auto code = image.bytesAt(target);
+        const bool endbr = code.size() >= 4 && code[0] == 0xF3 && code[1] == 0x0F && code[2] == 0x1E && (code[3] == 0xFA || code[3] == 0xFB);
+        const size_t skip = endbr ? 4 : 0;
+        const uint64_t slot = SlotOf(code.data() + skip, code.size() - skip, target + skip, wide, base);
+        return slot ? ImportAt(image, slot) : 0;
+    }
+
+    // The destination of a direct branch, which Capstone prints as the last operand: "0x401000",
+    // "#0x1f00" (ARM) or a small decimal. 0 for register and memory operands.
+    uint64_t DirectTarget(std::string_view ops) {
+        const size_t comma = ops.rfind(", ");
+        if (comma != std::string_view::npos) ops.remove_prefix(comma + 2);
+        if (!ops.empty() && ops.front() == '#') ops.remove_prefix(1);
+        int radix = 10;
+        if (ops.starts_with("0x")) {
+            ops.remove_prefix(2);
+            radix = 16;
+        }
+        uint64_t value = 0;
+        auto [p, ec] = std::from_chars(ops.data(), ops.data() + ops.size(), value, radix);
+        return (!ops.empty() && ec == std::errc() && p == ops.data() + ops.size()) ? value : 0;
+    }
+
+    bool IsUnconditional(const CapstoneTarget& target, const cs_insn& insn) {
+        if (target.x86) return insn.id == X86_INS_JMP || insn.id == X86_INS_LJMP;
+        static constexpr std::string_view always[] = { "b", "br", "bx", "j", "jr", "ba", "bctr" };
+        return std::find(std::begin(always), std::end(always), std::string_view(insn.mnemonic)) != std::end(always);
+    }
+
+    // Linear sweep over one chunk with a single reusable cs_insn. Undecodable bytes are stepped over so
+    // data in a code section does not end the chunk. Failures are recorded in the chunk rather than
+    // thrown: on the pool an exception would only be logged, and the chunk would look complete.
+    void DisassembleChunk(const CapstoneTarget& target, const BinaryImage* image, Chunk& chunk) {
+        csh handle;
+        if (cs_open(target.arch, target.mode, &handle) != CS_ERR_OK) {
+            chunk.failed = true;
+            chunk.error = "Error initializing Capstone";
+            return;
+        }
+        cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);   // needed for the call/jump/return groups
+        cs_insn* insn = cs_malloc(handle);
+        if (!insn) {
+            chunk.failed = true;
+            chunk.error = "Capstone could not allocate an instruction";
+            cs_close(&handle);
+            return;
+        }
+        const bool wide = (target.mode & CS_MODE_64) != 0;
+        const uint64_t base = (image && image->format() == ImageFormat::PE) ? image->imageBase() : 0;
+
+        try {
+            std::unordered_map<std::string, uint16_t> mnemonicIds;
+            const uint8_t* code = chunk.code.data();
+            size_t size = chunk.code.size();
+            uint64_t address = chunk.address;
+            chunk.instructions.reserve(static_cast<size_t>(chunk.end - chunk.address) / 4);
+            while (size && address < chunk.end) {
+                if (!cs_disasm_iter(handle, &code, &size, &address, insn)) {
+                    const size_t skip = std::min<size_t>(target.step, size);
+                    code += skip;
+                    size -= skip;
+                    address += skip;
+                    chunk.undecoded += skip;
+                    continue;
+                }
+                Instruction out;
+                out.address = insn->address;
+                out.size = static_cast<uint8_t>(insn->size);
+                out.id = static_cast<uint16_t>(insn->id);
+                auto [it, added] = mnemonicIds.try_emplace(insn->mnemonic, static_cast<uint16_t>(chunk.mnemonics.size()));
+                if (added) chunk.mnemonics.emplace_back(insn->mnemonic);
+                out.mnemonic = it->second;
+                const std::string_view ops(insn->op_str);
+                out.operands = static_cast<uint32_t>(chunk.operandText.size());
+                out.operandLength = static_cast<uint16_t>(ops.size());
+                chunk.operandText.append(ops);
+
+                if (cs_insn_group(handle, insn, CS_GRP_CALL)) out.flags |= Instruction::Call;
+                else if (cs_insn_group(handle, insn, CS_GRP_JUMP)) out.flags |= Instruction::Jump | (IsUnconditional(target, *insn) ? 0 : Instruction::Conditional);
+                if (cs_insn_group(handle, insn, CS_GRP_RET) || cs_insn_group(handle, insn, CS_GRP_IRET)) out.flags |= Instruction::Return;
+                if (cs_insn_group(handle, insn, CS_GRP_INT)) out.flags |= Instruction::Interrupt;
+                if (out.flags & (Instruction::Call | Instruction::Jump)) {
+                    out.target = DirectTarget(ops);
+                    if (image && target.x86) {
+                        if (out.target) out.import = ImportThroughStub(*image, out.target, wide, base);
+                        else if (const uint64_t slot = SlotOf(insn->bytes, insn->size, insn->address, wide, base)) out.import = ImportAt(*image, slot);
+                    }
+                }
+                chunk.instructions.push_back(out);
+            }
+        }
+        catch (const std::exception& e) {
+            chunk.failed = true;
+            chunk.error = std::string("Disassembly failed: ") + e.what();
+        }
+        catch (...) {
+            chunk.failed = true;
+            chunk.error = "Disassembly failed";
+        }
+        cs_free(insn, 1);
+        cs_close(&handle);
+    }
+}
+
 std::string BinaryTranslator::ExtractMetadata(const std::string& binaryPath) {
     auto info = BinaryManip::Probe(binaryPath);
     std::ostringstream meta;
@@ -24,9 +217,10 @@ std::string BinaryTranslator::ExtractMetadata(const std::string& binaryPath) {
     }
 
     // Extract file size
-    std::ifstream file(binaryPath, std::ios::binary | std::ios::ate);
-    if (file) {
-        meta << "  Size: " << file.tellg() << " bytes\n";
+    std::error_code sizeError;
+    const auto size = std::filesystem::file_size(binaryPath, sizeError);
+    if (!sizeError) {
+        meta << "  Size: " << size << " bytes\n";
     }
 
     meta << "  OS: " << (info->os == BinaryManip::OS::Windows ? "Windows" : "Linux/Other") << "\n";
@@ -39,56 +233,189 @@ std::string BinaryTranslator::ExtractMetadata(const std::string& binaryPath) {
     return meta.str();
 }
 
-std::string BinaryTranslator::DisassembleCapstone(const std::string& binaryPath) {
-    std::ifstream file(binaryPath, std::ios::binary);
-    if (!file) return "[Error: Could not open binary file]";
-    std::vector<uint8_t> code((std::istreambuf_iterator<char>(file)), {});
+const ImageImport* BinaryTranslator::InstructionTable::importOf(const Instruction& insn) const {
+    if (!insn.import || !image) return nullptr;
+    return &image->imports()[insn.import - 1];
+}
 
-    csh handle;
-    cs_insn* insn;
-    size_t count;
+std::shared_ptr<const BinaryTranslator::InstructionTable> BinaryTranslator::Disassemble(const std::string& binaryPath, std::string* error) {
+    auto fail = [error](std::string why) -> std::shared_ptr<const InstructionTable> {
+        if (error) *error = std::move(why);
+        return nullptr;
+    };
 
-    std::ostringstream output;
+    auto table = std::make_shared<InstructionTable>();
+    std::vector<Chunk> chunks;
+    std::optional<CapstoneTarget> target;
+    MappedFile raw;
+    table->image = BinaryImage::Open(binaryPath);
+    if (table->image) {
+        const BinaryImage& image = *table->image;
+        const auto info = BinaryManip::Probe(binaryPath);
+        target = TargetFor(info ? info->arch : BinaryManip::Arch::Unknown, image.is64(), image.bigEndian());
+        if (!target) return fail("Unsupported architecture");
+        std::vector<uint64_t> starts;
+        for (const auto& fn : image.functions()) starts.push_back(fn.address);
+        for (const auto& section : image.sections()) {
+            if (!section.executable || !section.size) continue;
+            CodeRegion region;
+            region.name = section.name;
+            region.address = section.address;
+            region.size = section.size;
+            table->regions.push_back(region);
+            SplitSection(image.bytes().subspan(static_cast<size_t>(section.offset), static_cast<size_t>(section.size)), section.address, starts, chunks);
+        }
+    }
+    else {
+        // Not an image: treat the whole file as x86-64 code, as before.
+        if (!raw.open(binaryPath)) return fail("Could not open binary file");
+        target = TargetFor(BinaryManip::Arch::X64, true, false);
+        CodeRegion region;
+        region.name = "raw";
+        region.address = RAW_CODE_ADDRESS;
+        region.size = raw.size();
+        table->regions.push_back(region);
+        SplitSection(raw.bytes(), RAW_CODE_ADDRESS, {}, chunks);
+    }
 
-    if (cs_open(CS_ARCH_X86, CS_MODE_64, &handle) != CS_ERR_OK)
-        return "[Error initializing Capstone]";
+    const BinaryImage* image = table->image.get();
+    if (chunks.size() == 1) {
+        DisassembleChunk(*target, image, chunks.front());
+    }
+    else {
+        std::vector<TaskHandle> tasks;
+        tasks.reserve(chunks.size());
+        for (auto& chunk : chunks) {
+            tasks.push_back(JobManager::SubmitJob([&target, image, c = &chunk]() {
+                try {
+                    DisassembleChunk(*target, image, *c);
+                }
+                catch (...) {
+                    c->failed = true; // out of memory even for the error message
+                }
+                }));
+        }
+        for (const auto& task : tasks) JobManager::Wait(task);
+    }
 
-    count = cs_disasm(handle, code.data(), code.size(), 0x1000, 0, &insn);
-    if (count > 0) {
-        for (size_t i = 0; i < count; i++) {
-            output << "0x" << std::hex << insn[i].address << ":\t" << insn[i].mnemonic << "\t" << insn[i].op_str << "\n";
+    // Merge in address order, re-interning each chunk's mnemonics into the table's list.
+    std::sort(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) { return a.address < b.address; });
+    size_t count = 0, text = 0;
+    for (const auto& chunk : chunks) {
+        if (chunk.failed) return fail(chunk.error.empty() ? "Disassembly failed" : chunk.error);
+        count += chunk.instructions.size();
+        text += chunk.operandText.size();
+    }
+    table->instructions.reserve(count);
+    table->operandText.reserve(text);
+    std::unordered_map<std::string, uint16_t> mnemonicIds;
+    for (const auto& chunk : chunks) {
+        std::vector<uint16_t> remap(chunk.mnemonics.size());
+        for (size_t k = 0; k < chunk.mnemonics.size(); ++k) {
+            auto [it, added] = mnemonicIds.try_emplace(chunk.mnemonics[k], static_cast<uint16_t>(table->mnemonics.size()));
+            if (added) table->mnemonics.push_back(chunk.mnemonics[k]);
+            remap[k] = it->second;
         }
-        cs_free(insn, count);
+        const uint32_t textBase = static_cast<uint32_t>(table->operandText.size());
+        table->operandText += chunk.operandText;
+        for (Instruction insn : chunk.instructions) {
+            insn.mnemonic = remap[insn.mnemonic];
+            insn.operands += textBase;
+            table->instructions.push_back(insn);
+        }
+        table->undecodedBytes += chunk.undecoded;
     }
-    else {
-        output << "[Failed to disassemble binary]";
+
+    std::sort(table->regions.begin(), table->regions.end(), [](const CodeRegion& a, const CodeRegion& b) { return a.address < b.address; });
+    auto byAddress = [](const Instruction& insn, uint64_t a) { return insn.address < a; };
+    for (auto& region : table->regions) {
+        auto first = std::lower_bound(table->instructions.begin(), table->instructions.end(), region.address, byAddress);
+        auto last = std::lower_bound(first, table->instructions.end(), region.address + region.size, byAddress);
+        region.first = static_cast<size_t>(first - table->instructions.begin());
+        region.count = static_cast<size_t>(last - first);
+    }
+    return table;
+}
+
+std::string BinaryTranslator::FormatInstructions(const InstructionTable& table) {
+    std::string out;
+    out.reserve(table.instructions.size() * 40);
+    char hex[16];
+    for (const auto& region : table.regions) {
+        if (table.image) {
+            out += "; ";
+            out += region.name;
+            out += '\n';
+        }
+        for (size_t i = region.first; i < region.first + region.count; ++i) {
+            const Instruction& insn = table.instructions[i];
+            const auto end = std::to_chars(hex, hex + sizeof hex, insn.address, 16).ptr;
+            out += "0x";
+            out.append(hex, end);
+            out += ":\t";
+            out += table.mnemonic(insn);
+            out += '\t';
+            out += table.operands(insn);
+            if (const ImageImport* imp = table.importOf(insn)) {
+                out += "\t; ";
+                out += imp->name;
+            }
+            out += '\n';
+        }
     }
+    return out;
+}
 
-    cs_close(&handle);
-    return output.str();
+std::string BinaryTranslator::DisassembleCapstone(const std::string& binaryPath) {
+    std::string error;
+    auto table = Disassemble(binaryPath, &error);
+    if (!table) return "[Error: " + error + "]";
+    if (table->instructions.empty()) return "[Failed to disassemble binary]";
+    return FormatInstructions(*table);
 }
 
 std::string BinaryTranslator::Decompile(const std::string& binaryPath) {
     std::ostringstream oss;
-    std::string asmCode = DisassembleCapstone(binaryPath);
     oss << "// Decompiled pseudocode of " << binaryPath << "\n";
+    std::string error;
+    auto table = Disassemble(binaryPath, &error);
+    if (!table) {
+        oss << "[Error: " << error << "]\n";
+        return oss.str();
+    }
+    std::string asmCode = FormatInstructions(*table);
     oss << asmCode << "\n";
-    oss << ClassifyMalwareBehavior(asmCode) << "\n";
-    oss << ReconstructControlFlow(asmCode);
+    auto features = BinaryFeatures::Extract(binaryPath);
+    oss << ClassifyMalwareBehavior(*table, features.get()) << "\n";
+    oss << ReconstructControlFlow(table);
     return oss.str();
 }
 
-std::string BinaryTranslator::ClassifyMalwareBehavior(const std::string& asmCode) {
-    std::ostringstream report;
-    if (asmCode.find("CreateRemoteThread") != std::string::npos) report << "[!] Detected Injection Behavior\n";
-    if (asmCode.find("GetProcAddress") != std::string::npos) report << "[!] Detected Dynamic API Resolution\n";
-    if (asmCode.find("WriteProcessMemory") != std::string::npos) report << "[!] Memory Tampering Detected\n";
-    return report.str();
+// Looks at the imports the code actually calls or jumps to, rather than names that merely appear
+// somewhere in the listing, plus API names the file only holds as strings (resolved at run time).
+std::string BinaryTranslator::ClassifyMalwareBehavior(const InstructionTable& table, const BinaryFeatures::FeatureSet* features) {
+    std::vector<BinaryFeatures::BehaviorHit> hits;
+    std::vector<bool> called(table.image ? table.image->imports().size() : 0, false);
+    for (const auto& insn : table.instructions) {
+        const ImageImport* imp = table.importOf(insn);
+        if (!imp || called[insn.import - 1]) continue;
+        called[insn.import - 1] = true;
+        const std::string_view behavior = BinaryFeatures::BehaviorOf(imp->name);
+        if (!behavior.empty()) hits.push_back({ behavior, std::string(imp->name), false });
+    }
+    if (features) {
+        for (auto& hit : BinaryFeatures::DetectBehaviors(*features)) {
+            if (hit.byName) hits.push_back(std::move(hit));
+        }
+    }
+    return BinaryFeatures::FormatBehaviors(hits);
 }
 
-std::string BinaryTranslator::ReconstructControlFlow(const std::string& asmCode) {
+std::string BinaryTranslator::ReconstructControlFlow(std::shared_ptr<const InstructionTable> table) {
+    auto cfg = ControlFlowGraph::Build(std::move(table));
     std::ostringstream graph;
-    graph << "\n// Control Flow Graph (approximate)\n";
-    graph << "main -> sub_func_1 -> sub_func_2 -> exit\n"; // placeholder
+    graph << "\n// Control Flow Graph: " << cfg->functions().size() << " functions, " << cfg->blockCount()
+        << " blocks, " << cfg->edgeCount() << " edges\n";
+    for (const auto& line : cfg->describe()) graph << line << "\n";
     return graph.str();
 }
@@ -4,12 +4,66 @@ Copyright © 2025 Cadell Richard Anderson
 // BinaryTranslator.h
 // =================================================================
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+class BinaryImage;
+struct ImageImport;
+namespace BinaryFeatures { struct FeatureSet; }
 
 namespace BinaryTranslator {
+
+    // One decoded instruction. Its text lives in the owning table, which keeps an entry at 32 bytes.
+    struct Instruction {
+        enum Flags : uint8_t { Call = 1, Jump = 2, Conditional = 4, Return = 8, Interrupt = 16 };
+
+        uint64_t address = 0;       // same address space as ImageSection::address (RVA for PE)
+        uint64_t target = 0;        // destination of a direct call or jump, else 0
+        uint32_t operands = 0;      // offset into InstructionTable::operandText
+        uint32_t import = 0;        // 1 + index into BinaryImage::imports() for calls/jumps to an import, else 0
+        uint16_t operandLength = 0;
+        uint16_t mnemonic = 0;      // index into InstructionTable::mnemonics
+        uint16_t id = 0;            // Capstone instruction id
+        uint8_t size = 0;
+        uint8_t flags = 0;
+    };
+
+    // A contiguous run of code that was disassembled: an executable section, or the whole file for raw code.
+    struct CodeRegion {
+        std::string_view name;
+        uint64_t address = 0;
+        uint64_t size = 0;
+        size_t first = 0;           // index of its first instruction
+        size_t count = 0;
+    };
+
+    struct InstructionTable {
+        std::shared_ptr<const BinaryImage> image;   // null when the file was not an ELF or PE image
+        std::vector<Instruction> instructions;      // by address
+        std::vector<CodeRegion> regions;            // by address
+        std::vector<std::string> mnemonics;
+        std::string operandText;
+        uint64_t undecodedBytes = 0;                // skipped because Capstone could not decode them
+
+        std::string_view mnemonic(const Instruction& insn) const { return mnemonics[insn.mnemonic]; }
+        std::string_view operands(const Instruction& insn) const { return std::string_view(operandText).substr(insn.operands, insn.operandLength); }
+        const ImageImport* importOf(const Instruction& insn) const;
+    };
+
+    // Disassembles the executable sections of an ELF or PE image (the whole file, as x86-64, for anything
+    // else), split at function symbols and decoded in parallel. nullptr and 'error' on failure.
+    std::shared_ptr<const InstructionTable> Disassemble(const std::string& binaryPath, std::string* error = nullptr);
+    // One "0xaddr:\tmnemonic\toperands" line per instruction, with the import named on calls through one.
+    std::string FormatInstructions(const InstructionTable& table);
+
     std::string Decompile(const std::string& binaryPath);
     std::string ExtractMetadata(const std::string& binaryPath);
     std::string DisassembleCapstone(const std::string& binaryPath);
-    std::string ClassifyMalwareBehavior(const std::string& asmCode);
-    std::string ReconstructControlFlow(const std::string& asmCode);
+    // Behaviors from the imports the code calls and, if 'features' is given, API names held only as strings.
+    std::string ClassifyMalwareBehavior(const InstructionTable& table, const BinaryFeatures::FeatureSet* features = nullptr);
+    // Recovers the control-flow graph (see ControlFlowGraph) and lists its functions.
+    std::string ReconstructControlFlow(std::shared_ptr<const InstructionTable> table);
 }
@@ -6,15 +6,36 @@ Copyright © 2025 Cadell Richard Anderson
 
 #include "onecloud_c_api.h"
 #include "CloudError.h" 
+#include "types.h"
 #include <string>
 #include <vector>
 #include <memory>
 #include <expected>
 #include <filesystem>
 #include <span>
+#include <functional>
 
 namespace onecloud {
 
+    // Maps the C API error codes back onto the C++ enum (the numeric values differ).
+    inline CloudError to_cloud_error(OneCloud_Error err) {
+        switch (err) {
+        case ONECLOUD_SUCCESS: return CloudError::Success;
+        case ONECLOUD_ERROR_CONTAINER_NOT_FOUND: return CloudError::ContainerNotFound;
+        case ONECLOUD_ERROR_INVALID_PASSWORD: return CloudError::InvalidPassword;
+        case ONECLOUD_ERROR_INVALID_CONTAINER_FORMAT: return CloudError::InvalidContainerFormat;
+        case ONECLOUD_ERROR_ACCESS_DENIED: return CloudError::AccessDenied;
+        case ONECLOUD_ERROR_FILE_EXISTS: return CloudError::FileExists;
+        case ONECLOUD_ERROR_FILE_NOT_FOUND: return CloudError::FileNotFound;
+        case ONECLOUD_ERROR_IO_ERROR: return CloudError::IOError;
+        case ONECLOUD_ERROR_OUT_OF_MEMORY: return CloudError::OutOfMemory;
+        case ONECLOUD_ERROR_ENCRYPTION_FAILED: return CloudError::EncryptionFailed;
+        case ONECLOUD_ERROR_BUFFER_TOO_SMALL: return CloudError::BufferTooSmall;
+        case ONECLOUD_ERROR_COMPRESSION_FAILED: return CloudError::CompressionFailed;
+        default: return CloudError::Unknown;
+        }
+    }
+
     // This is the C++ friendly wrapper around the C API
     class CloudAPI {
     private:
@@ -40,7 +61,7 @@ namespace onecloud {
             if (err == ONECLOUD_SUCCESS) {
                 return CloudAPI(handle);
             }
-            return std::unexpected(static_cast<CloudError>(err));
+            return std::unexpected(to_cloud_error(err));
         }
 
         static std::expected<CloudAPI, CloudError> open(const std::filesystem::path& path, const std::string& password) {
@@ -49,25 +70,59 @@ namespace onecloud {
             if (err == ONECLOUD_SUCCESS) {
                 return CloudAPI(handle);
             }
-            return std::unexpected(static_cast<CloudError>(err));
+            return std::unexpected(to_cloud_error(err));
         }
 
         // --- File Operations ---
         std::expected<std::vector<std::byte>, CloudError> read_file(const std::string& virtual_path) {
-            uint8_t* data = nullptr;
-            size_t size = 0;
-            OneCloud_Error err = onecloud_storage_read_file(m_handle.get(), virtual_path.c_str(), &data, &size);
+            auto size = file_size(virtual_path);
+            if (!size) {
+                return std::unexpected(size.error());
+            }
+
+            // Decompress directly into the returned vector instead of copying out of a C buffer.
+            std::vector<std::byte> result(static_cast<size_t>(*size));
+            auto read = read_file_into(virtual_path, result);
+            if (!read) {
+                return std::unexpected(read.error());
+            }
+            result.resize(*read);
+            return result;
+        }
+
+        std::expected<uint64_t, CloudError> file_size(const std::string& virtual_path) const {
+            uint64_t size = 0;
+            OneCloud_Error err = onecloud_storage_get_file_size(m_handle.get(), virtual_path.c_str(), &size);
             if (err != ONECLOUD_SUCCESS) {
-                return std::unexpected(static_cast<CloudError>(err));
+                return std::unexpected(to_cloud_error(err));
             }
+            return size;
+        }
 
-            // CORRECTED: Added reinterpret_cast to handle the type conversion from uint8_t* to std::byte*
-            const auto* byte_ptr_begin = reinterpret_cast<const std::byte*>(data);
-            const auto* byte_ptr_end = reinterpret_cast<const std::byte*>(data + size);
-            std::vector<std::byte> result(byte_ptr_begin, byte_ptr_end);
+        // Reads into a caller-owned buffer; returns the number of bytes written.
+        std::expected<size_t, CloudError> read_file_into(const std::string& virtual_path, std::span<std::byte> buffer) {
+            size_t written = 0;
+            OneCloud_Error err = onecloud_storage_read_file_into(m_handle.get(), virtual_path.c_str(),
+                reinterpret_cast<uint8_t*>(buffer.data()), buffer.size(), &written);
+            if (err != ONECLOUD_SUCCESS) {
+                return std::unexpected(to_cloud_error(err));
+            }
+            return written;
+        }
 
-            onecloud_free_data_buffer(data); // Free the buffer allocated by the C API
-            return result;
+        // Streams the file through 'sink' one decompressed chunk at a time. Return false from the sink to abort.
+        std::expected<void, CloudError> read_file_chunked(const std::string& virtual_path,
+            const std::function<bool(std::span<const std::byte>)>& sink) {
+            auto trampoline = [](const uint8_t* data, size_t size, void* user_data) -> int {
+                auto& fn = *static_cast<const std::function<bool(std::span<const std::byte>)>*>(user_data);
+                return fn(std::span<const std::byte>(reinterpret_cast<const std::byte*>(data), size)) ? 0 : 1;
+                };
+            OneCloud_Error err = onecloud_storage_read_file_stream(m_handle.get(), virtual_path.c_str(), trampoline,
+                const_cast<void*>(static_cast<const void*>(&sink)));
+            if (err == ONECLOUD_SUCCESS) {
+                return {};
+            }
+            return std::unexpected(to_cloud_error(err));
         }
 
         std::expected<void, CloudError> write_file(const std::string& virtual_path, std::span<const std::byte> data) {
@@ -75,7 +130,7 @@ namespace onecloud {
             if (err == ONECLOUD_SUCCESS) {
                 return {};
             }
-            return std::unexpected(static_cast<CloudError>(err));
+            return std::unexpected(to_cloud_error(err));
         }
 
         std::expected<void, CloudError> delete_file(const std::string& virtual_path) {
@@ -83,7 +138,7 @@ namespace onecloud {
             if (err == ONECLOUD_SUCCESS) {
                 return {};
             }
-            return std::unexpected(static_cast<CloudError>(err));
+            return std::unexpected(to_cloud_error(err));
         }
 
         std::expected<std::vector<std::string>, CloudError> list_files() const {
@@ -91,7 +146,7 @@ namespace onecloud {
             size_t count = 0;
             OneCloud_Error err = onecloud_storage_list_files(m_handle.get(), &list, &count);
             if (err != ONECLOUD_SUCCESS) {
-                return std::unexpected(static_cast<CloudError>(err));
+                return std::unexpected(to_cloud_error(err));
             }
             std::vector<std::string> result;
             result.reserve(count);
@@ -101,6 +156,71 @@ namespace onecloud {
             onecloud_free_file_list(list, count); // Free the list allocated by the C API
             return result;
         }
+
+        std::expected<void, CloudError> set_compression_level(int level) {
+            OneCloud_Error err = onecloud_storage_set_compression_level(m_handle.get(), level);
+            if (err == ONECLOUD_SUCCESS) {
+                return {};
+            }
+            return std::unexpected(to_cloud_error(err));
+        }
+
+        // Returns the ID of the newly trained dictionary.
+        std::expected<uint32_t, CloudError> train_dictionary(size_t max_dictionary_bytes = 0) {
+            uint32_t id = 0;
+            OneCloud_Error err = onecloud_storage_train_dictionary(m_handle.get(), max_dictionary_bytes, &id);
+            if (err != ONECLOUD_SUCCESS) {
+                return std::unexpected(to_cloud_error(err));
+            }
+            return id;
+        }
+
+        std::expected<OneCloud_CompressionStats, CloudError> compression_stats() const {
+            OneCloud_CompressionStats stats{};
+            OneCloud_Error err = onecloud_storage_get_compression_stats(m_handle.get(), &stats);
+            if (err != ONECLOUD_SUCCESS) {
+                return std::unexpected(to_cloud_error(err));
+            }
+            return stats;
+        }
+
+        std::expected<OneCloud_CompactionStats, CloudError> compact() {
+            OneCloud_CompactionStats stats{};
+            OneCloud_Error err = onecloud_storage_compact(m_handle.get(), &stats);
+            if (err != ONECLOUD_SUCCESS) {
+                return std::unexpected(to_cloud_error(err));
+            }
+            return stats;
+        }
+
+        // One page of a directory listing; pass the last returned name as 'start_after' to get the next page.
+        std::expected<std::vector<DirEntry>, CloudError> list_directory(const std::string& directory,
+            const std::string& start_after = {}, size_t limit = 0) const {
+            std::vector<DirEntry> entries;
+            auto collect = [](const char* name, uint64_t size, int is_directory, void* user_data) -> int {
+                static_cast<std::vector<DirEntry>*>(user_data)->push_back(DirEntry{ name, is_directory != 0, size });
+                return 0;
+                };
+            OneCloud_Error err = onecloud_storage_list_directory(m_handle.get(), directory.c_str(), start_after.c_str(), limit, collect, &entries);
+            if (err != ONECLOUD_SUCCESS) {
+                return std::unexpected(to_cloud_error(err));
+            }
+            return entries;
+        }
+
+        std::expected<std::vector<std::string>, CloudError> find_files(const ListOptions& options) const {
+            std::vector<std::string> paths;
+            auto collect = [](const char* name, uint64_t, int, void* user_data) -> int {
+                static_cast<std::vector<std::string>*>(user_data)->emplace_back(name);
+                return 0;
+                };
+            OneCloud_Error err = onecloud_storage_find_files(m_handle.get(), options.prefix.c_str(), options.glob.c_str(),
+                options.start_after.c_str(), options.limit, collect, &paths);
+            if (err != ONECLOUD_SUCCESS) {
+                return std::unexpected(to_cloud_error(err));
+            }
+            return paths;
+        }
     };
 
 } // namespace onecloud
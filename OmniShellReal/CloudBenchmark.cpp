@@ -0,0 +1,443 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// CloudBenchmark.cpp
+
+#include "CloudBenchmark.h"
+#include "CloudStorage.h"
+#include "CryptoProvider.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace onecloud {
+
+    namespace {
+        using Clock = std::chrono::steady_clock;
+        using Contents = std::map<std::string, std::vector<std::byte>>;
+
+        constexpr const char* BENCH_PASSWORD = "omni-benchmark";
+        constexpr size_t PAYLOAD_BLOCK = 4096;
+        constexpr size_t SMALL_FILE_BYTES = 256;
+        constexpr int OPEN_REPEATS = 3;
+        // Small chunks make every fault-injection file span several of them without large payloads.
+        constexpr size_t FAULT_CHUNK_SIZE = 64 * 1024;
+        // Only the container header is ever rewritten in place; everything after it is append-only.
+        constexpr size_t MAX_HEADER_BYTES = 64;
+
+        double secondsSince(Clock::time_point start) {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        double megabytesPerSecond(uint64_t bytes, double seconds) {
+            return seconds > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+        }
+
+        // Log-like text for the compressible share and random bytes for the rest, decided per 4 KB block,
+        // so every chunk size sees roughly the same mix.
+        void fillPayload(std::span<std::byte> out, double compressible_fraction, std::mt19937_64& rng) {
+            std::bernoulli_distribution text(std::clamp(compressible_fraction, 0.0, 1.0));
+            std::string line;
+            for (size_t block = 0; block < out.size(); block += PAYLOAD_BLOCK) {
+                auto dest = out.subspan(block, std::min(PAYLOAD_BLOCK, out.size() - block));
+                if (text(rng)) {
+                    for (size_t filled = 0; filled < dest.size(); filled += line.size()) {
+                        line = "2025-01-01T00:00:" + std::to_string(rng() % 60) + " INFO worker=" + std::to_string(rng() % 16)
+                            + " event=chunk_written bytes=" + std::to_string(rng() % 65536) + "\n";
+                        line.resize(std::min(line.size(), dest.size() - filled));
+                        std::memcpy(dest.data() + filled, line.data(), line.size());
+                    }
+                }
+                else {
+                    for (size_t i = 0; i < dest.size(); i += sizeof(uint64_t)) {
+                        const uint64_t word = rng();
+                        std::memcpy(dest.data() + i, &word, std::min(sizeof(word), dest.size() - i));
+                    }
+                }
+            }
+        }
+
+        std::vector<std::byte> makePayload(size_t size, double compressible_fraction, std::mt19937_64& rng) {
+            std::vector<std::byte> data(size);
+            fillPayload(data, compressible_fraction, rng);
+            return data;
+        }
+
+        // Runs body(i) on 'threads' threads and returns the wall time in seconds, or the first error.
+        template<typename Fn>
+        std::expected<double, CloudError> timeParallel(unsigned threads, Fn&& body) {
+            std::vector<std::expected<void, CloudError>> results(threads);
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            const auto start = Clock::now();
+            for (unsigned i = 0; i < threads; ++i) {
+                workers.emplace_back([&, i] {
+                    try {
+                        results[i] = body(i);
+                    }
+                    catch (const std::bad_alloc&) {
+                        results[i] = std::unexpected(CloudError::OutOfMemory);
+                    }
+                    catch (...) {
+                        results[i] = std::unexpected(CloudError::Unknown);
+                    }
+                    });
+            }
+            for (auto& worker : workers) worker.join();
+            const double seconds = secondsSince(start);
+            for (const auto& result : results) {
+                if (!result) return std::unexpected(result.error());
+            }
+            return seconds;
+        }
+
+        std::filesystem::path scratchPath(const std::filesystem::path& dir, const std::string& name) {
+            auto path = dir / name;
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            return path;
+        }
+
+        void removeScratch(const std::filesystem::path& path) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+
+        std::string formatSize(size_t bytes) {
+            if (bytes == 0) return "-";
+            if (bytes % (1024 * 1024) == 0) return std::to_string(bytes / (1024 * 1024)) + "M";
+            return std::to_string(bytes / 1024) + "K";
+        }
+
+        std::expected<std::vector<std::byte>, CloudError> readImage(const std::filesystem::path& path) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) return std::unexpected(CloudError::IOError);
+            std::vector<std::byte> bytes(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return std::unexpected(CloudError::IOError);
+            return bytes;
+        }
+
+        bool writeImage(const std::filesystem::path& path, std::span<const std::byte> head, std::span<const std::byte> tail = {}) {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(head.data()), head.size());
+            file.write(reinterpret_cast<const char*>(tail.data()), tail.size());
+            return static_cast<bool>(file);
+        }
+
+        // Describes the first way 'storage' differs from 'expected', or nothing if it holds exactly those files.
+        std::optional<std::string> compareContents(CloudStorage& storage, const Contents& expected) {
+            auto listed = storage.listFiles();
+            if (!listed) return "listing failed";
+            if (listed->size() != expected.size()) {
+                return std::to_string(listed->size()) + " files listed, " + std::to_string(expected.size()) + " committed";
+            }
+            for (const auto& [path, data] : expected) {
+                auto read = storage.readFile(path);
+                if (!read) return path + " unreadable (error " + std::to_string(static_cast<int>(read.error())) + ")";
+                if (*read != data) return path + " differs";
+            }
+            return std::nullopt;
+        }
+
+        struct ImageCheck {
+            std::optional<CloudError> open_error;
+            std::optional<std::string> mismatch;
+        };
+
+        ImageCheck checkImage(const std::filesystem::path& image, const Contents& expected) {
+            ImageCheck check;
+            try {
+                auto storage = CloudStorage::open(image, BENCH_PASSWORD);
+                if (!storage) {
+                    check.open_error = storage.error();
+                    return check;
+                }
+                check.mismatch = compareContents(*storage, expected);
+            }
+            catch (const std::exception& e) {
+                check.mismatch = std::string("threw: ") + e.what();
+            }
+            return check;
+        }
+
+        std::string randomPath(std::mt19937_64& rng) {
+            return "dir" + std::to_string(rng() % 4) + "/file" + std::to_string(rng() % 1000) + ".bin";
+        }
+
+        std::string anyPath(const Contents& files, std::mt19937_64& rng) {
+            auto it = files.begin();
+            std::advance(it, rng() % files.size());
+            return it->first;
+        }
+    }
+
+    std::expected<std::vector<BenchmarkSample>, CloudError> CloudBenchmark::run(const BenchmarkOptions& options) {
+        std::error_code ec;
+        std::filesystem::create_directories(options.work_dir, ec);
+        if (ec) return std::unexpected(CloudError::IOError);
+
+        std::vector<BenchmarkSample> samples;
+        std::mt19937_64 rng(42);
+
+        // Key derivation: every create and open pays this once.
+        const auto salt = CryptoProvider::random_bytes(CryptoProvider::salt_length());
+        auto start = Clock::now();
+        for (int i = 0; i < OPEN_REPEATS; ++i) {
+            auto key = CryptoProvider::derive_key_from_password(BENCH_PASSWORD, salt);
+            if (!key) return std::unexpected(key.error());
+        }
+        const double kdf_ms = secondsSince(start) * 1000.0 / OPEN_REPEATS;
+        samples.push_back({ "kdf", 0, 1, 0, kdf_ms, "ms" });
+
+        const auto payload = makePayload(options.bytes_per_thread, options.compressible_fraction, rng);
+
+        for (size_t chunk_size : options.chunk_sizes) {
+            for (unsigned threads : options.thread_counts) {
+                if (threads == 0) continue;
+
+                // Containers are created (and their keys derived) before the clock starts.
+                std::vector<std::filesystem::path> paths;
+                std::vector<std::optional<CloudStorage>> containers(threads);
+                for (unsigned i = 0; i < threads; ++i) {
+                    paths.push_back(scratchPath(options.work_dir, "bench_" + std::to_string(chunk_size) + "_" + std::to_string(i) + ".ocv"));
+                    auto created = CloudStorage::create(paths.back(), BENCH_PASSWORD);
+                    if (!created) return std::unexpected(created.error());
+                    containers[i].emplace(std::move(*created));
+                    containers[i]->setChunkSize(chunk_size);
+                }
+                // What setChunkSize clamped the request to; both samples of the run report this size.
+                const size_t effective_chunk = containers[0]->chunkSize();
+
+                auto written = timeParallel(threads, [&](unsigned i) { return containers[i]->writeFile("payload.bin", payload); });
+                if (!written) return std::unexpected(written.error());
+                samples.push_back({ "write", effective_chunk, threads, 1, megabytesPerSecond(payload.size() * threads, *written), "MB/s" });
+
+                // Reopen so reads start from a cold chunk cache, and keep it cold.
+                for (unsigned i = 0; i < threads; ++i) {
+                    containers[i].reset();
+                    auto opened = CloudStorage::open(paths[i], BENCH_PASSWORD);
+                    if (!opened) return std::unexpected(opened.error());
+                    containers[i].emplace(std::move(*opened));
+                    containers[i]->setChunkCacheBudget(0);
+                }
+
+                auto read = timeParallel(threads, [&](unsigned i) {
+                    return containers[i]->readFileChunked("payload.bin", [](std::span<const std::byte>) { return true; });
+                    });
+                if (!read) return std::unexpected(read.error());
+                samples.push_back({ "read", effective_chunk, threads, 1, megabytesPerSecond(payload.size() * threads, *read), "MB/s" });
+
+                containers.clear();
+                for (const auto& path : paths) removeScratch(path);
+            }
+
+            // Compaction: two superseded versions and a deleted file are dropped, one live copy is moved.
+            auto path = scratchPath(options.work_dir, "bench_compact_" + std::to_string(chunk_size) + ".ocv");
+            {
+                auto storage = CloudStorage::create(path, BENCH_PASSWORD);
+                if (!storage) return std::unexpected(storage.error());
+                storage->setChunkSize(chunk_size);
+                for (const char* name : { "payload.bin", "payload.bin", "payload.bin", "deleted.bin" }) {
+                    auto result = storage->writeFile(name, payload);
+                    if (!result) return std::unexpected(result.error());
+                }
+                auto deleted = storage->deleteFile("deleted.bin");
+                if (!deleted) return std::unexpected(deleted.error());
+
+                start = Clock::now();
+                auto compacted = storage->compact();
+                if (!compacted) return std::unexpected(compacted.error());
+                samples.push_back({ "compact", storage->chunkSize(), 1, 1, megabytesPerSecond(compacted->bytes_after, secondsSince(start)), "MB/s" });
+            }
+            removeScratch(path);
+        }
+
+        // Open latency against file count. Files are imported in one batch so setup stays linear.
+        const auto small_files = makePayload(64 * 1024, options.compressible_fraction, rng);
+        for (size_t files : options.file_counts) {
+            auto path = scratchPath(options.work_dir, "bench_open_" + std::to_string(files) + ".ocv");
+            {
+                auto storage = CloudStorage::create(path, BENCH_PASSWORD);
+                if (!storage) return std::unexpected(storage.error());
+                storage->beginBatch();
+                for (size_t i = 0; i < files; ++i) {
+                    const size_t offset = (i * SMALL_FILE_BYTES) % (small_files.size() - SMALL_FILE_BYTES);
+                    auto result = storage->writeFile("files/" + std::to_string(i % 64) + "/" + std::to_string(i) + ".log",
+                        std::span<const std::byte>(small_files).subspan(offset, SMALL_FILE_BYTES));
+                    if (!result) return std::unexpected(result.error());
+                }
+                auto saved = storage->endBatch();
+                if (!saved) return std::unexpected(saved.error());
+            }
+
+            start = Clock::now();
+            for (int i = 0; i < OPEN_REPEATS; ++i) {
+                auto opened = CloudStorage::open(path, BENCH_PASSWORD);
+                if (!opened) return std::unexpected(opened.error());
+            }
+            const double open_ms = secondsSince(start) * 1000.0 / OPEN_REPEATS;
+            samples.push_back({ "open", 0, 1, files, open_ms, "ms" });
+            samples.push_back({ "manifest", 0, 1, files, std::max(0.0, open_ms - kdf_ms), "ms" });
+            removeScratch(path);
+        }
+
+        return samples;
+    }
+
+    std::expected<FaultInjectionReport, CloudError> CloudBenchmark::faultInjection(const FaultInjectionOptions& options) {
+        std::error_code ec;
+        std::filesystem::create_directories(options.work_dir, ec);
+        if (ec) return std::unexpected(CloudError::IOError);
+
+        const auto live_path = scratchPath(options.work_dir, "faultcheck_live.ocv");
+        const auto image_path = scratchPath(options.work_dir, "faultcheck_image.ocv");
+        auto leftover_path = image_path;
+        leftover_path += ".compact";
+
+        auto created = CloudStorage::create(live_path, BENCH_PASSWORD);
+        if (!created) return std::unexpected(created.error());
+        std::optional<CloudStorage> live(std::move(*created));
+        live->setChunkSize(FAULT_CHUNK_SIZE);
+
+        FaultInjectionReport report;
+        std::mt19937_64 rng(options.seed);
+        Contents committed;
+
+        for (unsigned iteration = 0; iteration < options.iterations; ++iteration) {
+            auto before = readImage(live_path);
+            if (!before) return std::unexpected(before.error());
+
+            // Apply one random operation to the live container and to the expected contents.
+            Contents next = committed;
+            std::string operation;
+            std::expected<void, CloudError> applied;
+            const unsigned pick = committed.empty() ? 0 : static_cast<unsigned>(rng() % 10);
+            if (pick < 4) {
+                operation = "write";
+                auto path = randomPath(rng);
+                next[path] = makePayload(rng() % 20000, 0.5, rng);
+                applied = live->writeFile(path, next[path]);
+            }
+            else if (pick < 6) {
+                operation = "replace";
+                auto path = anyPath(committed, rng);
+                next[path] = makePayload(FAULT_CHUNK_SIZE + rng() % (4 * FAULT_CHUNK_SIZE), 0.5, rng);
+                applied = live->writeFile(path, next[path]);
+            }
+            else if (pick < 7) {
+                operation = "delete";
+                auto path = anyPath(committed, rng);
+                next.erase(path);
+                applied = live->deleteFile(path);
+            }
+            else if (pick < 9) {
+                operation = "stream";
+                auto path = randomPath(rng);
+                next[path] = makePayload(rng() % (6 * FAULT_CHUNK_SIZE), 0.5, rng);
+                auto writer = live->beginWrite(path);
+                std::span<const std::byte> rest(next[path]);
+                while (applied && !rest.empty()) {
+                    const size_t piece = std::min<size_t>(rest.size(), 1 + rng() % (FAULT_CHUNK_SIZE / 2));
+                    applied = writer.write(rest.first(piece));
+                    rest = rest.subspan(piece);
+                }
+                if (applied) applied = writer.commit();
+            }
+            else {
+                operation = "compact";
+                auto compacted = live->compact();
+                if (!compacted) applied = std::unexpected(compacted.error());
+            }
+            if (!applied) return std::unexpected(applied.error());
+
+            auto after = readImage(live_path);
+            if (!after) return std::unexpected(after.error());
+            ++report.iterations;
+            const std::string label = "iteration " + std::to_string(iteration) + " (" + operation + ")";
+
+            if (operation == "compact") {
+                // The rename is the commit point: a crash before it leaves the original file and a partial
+                // ".compact" beside it, which must not be read and must be replaced by the next compaction.
+                const size_t cut = after->empty() ? 0 : static_cast<size_t>(rng() % after->size());
+                if (!writeImage(image_path, *before) || !writeImage(leftover_path, std::span<const std::byte>(*after).first(cut))) {
+                    return std::unexpected(CloudError::IOError);
+                }
+                auto check = checkImage(image_path, committed);
+                if (check.open_error || check.mismatch) {
+                    report.failures.push_back(label + ": original did not survive an interrupted compaction: "
+                        + (check.mismatch ? *check.mismatch : "error " + std::to_string(static_cast<int>(*check.open_error))));
+                }
+                else {
+                    std::optional<std::string> mismatch = "compaction over a leftover failed";
+                    auto reopened = CloudStorage::open(image_path, BENCH_PASSWORD);
+                    if (reopened && reopened->compact()) mismatch = compareContents(*reopened, committed);
+                    if (mismatch) report.failures.push_back(label + ": " + *mismatch);
+                    else ++report.recovered;
+                }
+                removeScratch(leftover_path);
+                committed = std::move(next);
+                continue;
+            }
+
+            // Everything past the header must be untouched: the format only ever appends.
+            const size_t prefix = std::min(before->size(), after->size());
+            if (after->size() < before->size() || !std::equal(before->begin() + std::min(prefix, MAX_HEADER_BYTES), before->end(), after->begin() + std::min(prefix, MAX_HEADER_BYTES))) {
+                report.failures.push_back(label + ": rewrote data in place instead of appending");
+                committed = std::move(next);
+                continue;
+            }
+
+            // saveManifest syncs the appended chunks and manifest before it rewrites the header, so a crash
+            // leaves either the old header with the appended bytes cut at any point, or (one time in four
+            // here) the new header with all of them. Both must open with exactly the committed files.
+            const size_t appended = after->size() - before->size();
+            const bool headerWritten = (rng() % 4) == 0;
+            const size_t cut = headerWritten ? appended : static_cast<size_t>(rng() % (appended + 1));
+            const auto tail = std::span<const std::byte>(*after).subspan(before->size(), cut);
+            const bool written = headerWritten ? writeImage(image_path, *after) : writeImage(image_path, *before, tail);
+            if (!written) return std::unexpected(CloudError::IOError);
+
+            auto check = checkImage(image_path, headerWritten ? next : committed);
+            const std::string where = label + " cut at " + std::to_string(cut) + "/" + std::to_string(appended)
+                + (headerWritten ? " with new header" : " with old header");
+            if (check.mismatch) {
+                report.failures.push_back(where + ": " + *check.mismatch);
+            }
+            else if (check.open_error) {
+                report.failures.push_back(where + ": did not open (error " + std::to_string(static_cast<int>(*check.open_error)) + ")");
+            }
+            else {
+                ++report.recovered;
+            }
+            committed = std::move(next);
+        }
+
+        live.reset();
+        removeScratch(live_path);
+        removeScratch(image_path);
+        return report;
+    }
+
+    std::string CloudBenchmark::format(std::span<const BenchmarkSample> samples) {
+        std::ostringstream os;
+        os << std::left << std::setw(10) << "metric" << std::setw(8) << "chunk" << std::setw(9) << "threads"
+            << std::setw(8) << "files" << std::right << std::setw(12) << "value" << "\n";
+        for (const auto& sample : samples) {
+            os << std::left << std::setw(10) << sample.metric
+                << std::setw(8) << formatSize(sample.chunk_size)
+                << std::setw(9) << sample.threads
+                << std::setw(8) << (sample.files ? std::to_string(sample.files) : "-")
+                << std::right << std::setw(12) << std::fixed << std::setprecision(1) << sample.value
+                << " " << sample.unit << "\n";
+        }
+        return os.str();
+    }
+
+} // namespace onecloud
@@ -0,0 +1,72 @@
+Copyright © 2025 Cadell Richard Anderson
+
+//CloudBenchmark.h
+
+#pragma once
+
+#include "CloudError.h"
+#include <string>
+#include <vector>
+#include <span>
+#include <filesystem>
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+
+namespace onecloud {
+
+    struct BenchmarkOptions {
+        std::filesystem::path work_dir;                 // Scratch containers are created here and removed afterwards.
+        std::vector<size_t> chunk_sizes = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+        std::vector<unsigned> thread_counts = { 1, 2, 4 };
+        uint64_t bytes_per_thread = 32ull * 1024 * 1024;
+        std::vector<size_t> file_counts = { 100, 1000, 10000 };
+        double compressible_fraction = 0.5;             // Share of the payload that is log-like text; the rest is random.
+    };
+
+    // One measurement. 'metric' is write, read, compact (MB/s), open, manifest or kdf (ms).
+    struct BenchmarkSample {
+        std::string metric;
+        size_t chunk_size = 0;
+        unsigned threads = 0;
+        size_t files = 0;
+        double value = 0.0;
+        std::string unit;
+    };
+
+    struct FaultInjectionOptions {
+        std::filesystem::path work_dir;
+        unsigned iterations = 50;
+        uint32_t seed = 1;
+    };
+
+    struct FaultInjectionReport {
+        unsigned iterations = 0;
+        unsigned recovered = 0;             // Crash images that opened with every committed file intact.
+        std::vector<std::string> failures;  // Images that lost committed data, did not open, or opened garbage.
+    };
+
+    /**
+     * @class CloudBenchmark
+     * @brief Throughput and crash-consistency measurements for OneCloud containers.
+     *
+     * Throughput runs give every thread its own container, so the numbers show how chunk encoding,
+     * encryption and I/O scale rather than contention on a single file.
+     *
+     * The fault-injection run mutates a live container and, after every operation, builds the
+     * image a crash part-way through it would have left. Since the appended bytes are synced
+     * before the header is rewritten, that is either the old header with the appended bytes cut
+     * at a random point, which must open with exactly the previously committed files, or the new
+     * header with all of them, which must open with the new state. An image that does not open
+     * is a failure.
+     */
+    class CloudBenchmark {
+    public:
+        static std::expected<std::vector<BenchmarkSample>, CloudError> run(const BenchmarkOptions& options);
+        static std::expected<FaultInjectionReport, CloudError> faultInjection(const FaultInjectionOptions& options);
+
+        // Renders samples as an aligned table.
+        static std::string format(std::span<const BenchmarkSample> samples);
+    };
+
+} // namespace onecloud
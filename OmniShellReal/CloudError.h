@@ -20,6 +20,8 @@ namespace onecloud {
         InvalidPassword = -13,
         OutOfMemory = -14,
         AccessDenied = -15,
+        BufferTooSmall = -16,
+        CompressionFailed = -17,
         Unknown = -100
     };
 
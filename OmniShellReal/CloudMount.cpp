@@ -0,0 +1,413 @@
+Copyright © 2025 Cadell Richard Anderson
+
+#include "CloudMount.h"
+#include "CloudStorage.h"
+#include "CryptoProvider.h"
+#include <sstream>
+
+// FUSE support is compiled in when the libfuse3 headers are found; the binary must then be linked
+// with libfuse3 (`pkg-config --cflags --libs fuse3`). -DHAVE_FUSE3=0 leaves it out.
+#if defined(__linux__) && !defined(HAVE_FUSE3) && __has_include(<fuse3/fuse.h>)
+#define HAVE_FUSE3 1
+#endif
+
+#if defined(__linux__) && defined(HAVE_FUSE3) && HAVE_FUSE3
+#define FUSE_USE_VERSION 31
+#if __has_include(<fuse3/fuse.h>)
+#include <fuse3/fuse.h>
+#else
+#include <fuse.h>
+#endif
+#include <cerrno>
+#include <sys/stat.h>
+#include <cstring>
+#include <chrono>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <atomic>
+#endif
+
+namespace onecloud {
+
+#if defined(__linux__) && defined(HAVE_FUSE3) && HAVE_FUSE3
+
+    class CloudMount::Impl {
+    public:
+        // Per-open-file state stored in fuse_file_info::fh.
+        struct OpenFile {
+            std::string path;
+            std::optional<CloudStorage::StreamWriter> writer;
+        };
+
+        std::filesystem::path containerPath;
+        std::filesystem::path mountPoint;
+        std::unique_ptr<CloudStorage> storage;
+
+        std::mutex mutex;
+        std::map<std::string, FileInfo> provisional;    // files created but not yet committed (no leading '/')
+        std::set<std::string> emptyDirs;                // directories created by mkdir that have no files yet
+        std::map<std::string, OpenFile*> openWriters;   // files currently being written
+
+        struct fuse* fuse = nullptr;
+        std::thread loopThread;
+
+        std::atomic<uint64_t> readCalls{ 0 };
+        std::atomic<uint64_t> bytesRead{ 0 };
+        std::atomic<uint64_t> bytesWritten{ 0 };
+
+        static Impl* self() { return static_cast<Impl*>(fuse_get_context()->private_data); }
+
+        static std::string toVirtual(const char* path) {
+            while (*path == '/') ++path;
+            return path;
+        }
+
+        static int toErrno(CloudError err) {
+            switch (err) {
+            case CloudError::FileNotFound: return -ENOENT;
+            case CloudError::FileExists: return -EEXIST;
+            case CloudError::AccessDenied: return -EACCES;
+            case CloudError::OutOfMemory: return -ENOMEM;
+            default: return -EIO;
+            }
+        }
+
+        static time_t toTimeT(int64_t stamp) {
+            using clock = std::chrono::system_clock;
+            return clock::to_time_t(clock::time_point(clock::duration(stamp)));
+        }
+
+        // Metadata comes straight from the container's sorted index, so no file table is mirrored here.
+        std::optional<FileInfo> lookupFile(const std::string& path) const {
+            auto it = provisional.find(path);
+            if (it != provisional.end()) return it->second;
+            if (auto info = storage->fileInfo(path)) return *info;
+            return std::nullopt;
+        }
+
+        bool isDir(const std::string& path) const {
+            return path.empty() || emptyDirs.count(path) || storage->isDirectory(path);
+        }
+
+        // --- FUSE callbacks ---
+
+        static int opGetattr(const char* path, struct stat* st, struct fuse_file_info*) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            std::memset(st, 0, sizeof(*st));
+            const std::string vpath = toVirtual(path);
+
+            if (auto info = m->lookupFile(vpath)) {
+                st->st_mode = S_IFREG | 0644;
+                st->st_nlink = 1;
+                auto w = m->openWriters.find(vpath);
+                st->st_size = static_cast<off_t>(w != m->openWriters.end() ? w->second->writer->size() : info->size);
+                st->st_mtime = toTimeT(info->last_write_time);
+                st->st_ctime = toTimeT(info->creation_time);
+                st->st_atime = st->st_mtime;
+                return 0;
+            }
+            if (m->isDir(vpath)) {
+                st->st_mode = S_IFDIR | 0755;
+                st->st_nlink = 2;
+                return 0;
+            }
+            return -ENOENT;
+        }
+
+        static int opReaddir(const char* path, void* buf, fuse_fill_dir_t filler, off_t, struct fuse_file_info*, enum fuse_readdir_flags) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            const std::string vpath = toVirtual(path);
+            if (!m->isDir(vpath)) return -ENOTDIR;
+
+            filler(buf, ".", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+            filler(buf, "..", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+
+            // The container lists one directory level by seeking past whole subtrees.
+            std::set<std::string> emitted;
+            if (m->storage->isDirectory(vpath)) {
+                auto entries = m->storage->listDirectory(vpath);
+                if (!entries) return toErrno(entries.error());
+                for (const auto& entry : *entries) {
+                    emitted.insert(entry.name);
+                    filler(buf, entry.name.c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+                }
+            }
+
+            // Add mount-local entries: uncommitted files and directories made by mkdir.
+            const std::string prefix = vpath.empty() ? std::string() : vpath + "/";
+            auto addLocal = [&](const std::string& path) {
+                if (path.compare(0, prefix.size(), prefix) != 0) return;
+                std::string name = path.substr(prefix.size());
+                if (name.empty() || name.find('/') != std::string::npos) return;
+                if (emitted.insert(name).second) {
+                    filler(buf, name.c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+                }
+                };
+            for (const auto& [path, info] : m->provisional) addLocal(path);
+            for (const auto& dir : m->emptyDirs) addLocal(dir);
+            return 0;
+        }
+
+        static int startWriter(Impl* m, const std::string& vpath, struct fuse_file_info* fi) {
+            if (m->openWriters.count(vpath)) return -EBUSY;
+            auto* of = new OpenFile{ vpath, std::nullopt };
+            of->writer.emplace(m->storage->beginWrite(vpath));
+            m->openWriters[vpath] = of;
+            fi->fh = reinterpret_cast<uint64_t>(of);
+            return 0;
+        }
+
+        static int opOpen(const char* path, struct fuse_file_info* fi) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            const std::string vpath = toVirtual(path);
+            auto info = m->lookupFile(vpath);
+            if (!info) return -ENOENT;
+
+            if ((fi->flags & O_ACCMODE) == O_RDONLY) {
+                // No keep_cache: a rewrite through another handle must not leave stale pages behind.
+                fi->fh = reinterpret_cast<uint64_t>(new OpenFile{ vpath, std::nullopt });
+                return 0;
+            }
+            // Chunks are immutable, so only whole-file rewrites are supported.
+            if ((fi->flags & O_TRUNC) || info->size == 0) {
+                return startWriter(m, vpath, fi);
+            }
+            return -ENOTSUP;
+        }
+
+        static int opCreate(const char* path, mode_t, struct fuse_file_info* fi) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            const std::string vpath = toVirtual(path);
+            if (vpath.empty() || m->isDir(vpath)) return -EISDIR;
+            int rc = startWriter(m, vpath, fi);
+            if (rc == 0) {
+                FileInfo provisional;
+                provisional.creation_time = std::chrono::system_clock::now().time_since_epoch().count();
+                provisional.last_write_time = provisional.creation_time;
+                m->provisional.emplace(vpath, provisional);
+            }
+            return rc;
+        }
+
+        static int opRead(const char*, char* buf, size_t size, off_t offset, struct fuse_file_info* fi) {
+            Impl* m = self();
+            auto* of = reinterpret_cast<OpenFile*>(fi->fh);
+            if (!of || of->writer) return -EBADF;
+            std::lock_guard<std::mutex> lock(m->mutex);
+            auto result = m->storage->readFileRange(of->path, static_cast<uint64_t>(offset),
+                std::span<std::byte>(reinterpret_cast<std::byte*>(buf), size));
+            if (!result) return toErrno(result.error());
+            m->readCalls++;
+            m->bytesRead += *result;
+            return static_cast<int>(*result);
+        }
+
+        static int opWrite(const char*, const char* buf, size_t size, off_t offset, struct fuse_file_info* fi) {
+            Impl* m = self();
+            auto* of = reinterpret_cast<OpenFile*>(fi->fh);
+            if (!of || !of->writer) return -EBADF;
+            std::lock_guard<std::mutex> lock(m->mutex);
+            if (static_cast<uint64_t>(offset) != of->writer->size()) return -ENOTSUP; // Sequential writes only.
+            auto result = of->writer->write(std::span<const std::byte>(reinterpret_cast<const std::byte*>(buf), size));
+            if (!result) return toErrno(result.error());
+            m->bytesWritten += size;
+            return static_cast<int>(size);
+        }
+
+        static int opRelease(const char*, struct fuse_file_info* fi) {
+            Impl* m = self();
+            auto* of = reinterpret_cast<OpenFile*>(fi->fh);
+            if (!of) return 0;
+            int rc = 0;
+            if (of->writer) {
+                std::lock_guard<std::mutex> lock(m->mutex);
+                m->openWriters.erase(of->path);
+                auto result = of->writer->commit();
+                if (!result) rc = toErrno(result.error());
+                m->provisional.erase(of->path);
+            }
+            delete of;
+            return rc;
+        }
+
+        static int opTruncate(const char* path, off_t size, struct fuse_file_info* fi) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            const std::string vpath = toVirtual(path);
+            auto* of = fi ? reinterpret_cast<OpenFile*>(fi->fh) : nullptr;
+            if (of && of->writer) {
+                return (size == 0 && of->writer->size() == 0) ? 0 : -ENOTSUP;
+            }
+            auto info = m->lookupFile(vpath);
+            if (!info) return -ENOENT;
+            if (size != 0) return -ENOTSUP;
+            if (info->size == 0) return 0;
+            auto result = m->storage->writeFile(vpath, {});
+            if (!result) return toErrno(result.error());
+            return 0;
+        }
+
+        static int opUnlink(const char* path) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            const std::string vpath = toVirtual(path);
+            if (m->openWriters.count(vpath)) return -EBUSY;
+            auto result = m->storage->deleteFile(vpath);
+            if (!result) return toErrno(result.error());
+            return 0;
+        }
+
+        static int opMkdir(const char* path, mode_t) {
+            Impl* m = self();
+            std::lock_guard<std::mutex> lock(m->mutex);
+            const std::string vpath = toVirtual(path);
+            if (m->lookupFile(vpath) || m->isDir(vpath)) return -EEXIST;
+            // Directories are implicit in file paths; this one only lives until a file is placed in it or we unmount.
+            m->emptyDirs.insert(vpath);
+            return 0;
+        }
+    };
+
+    CloudMount::CloudMount() : pImpl(std::make_unique<Impl>()) {}
+
+    CloudMount::~CloudMount() {
+        unmount();
+    }
+
+    bool CloudMount::supported() {
+        return true;
+    }
+
+    std::expected<std::unique_ptr<CloudMount>, CloudError> CloudMount::mount(
+        const std::filesystem::path& container_path,
+        const std::string& password,
+        const std::filesystem::path& mount_point)
+    {
+        auto opened = CloudStorage::open(container_path, password);
+        if (!opened) return std::unexpected(opened.error());
+
+        std::error_code ec;
+        if (!std::filesystem::is_directory(mount_point, ec)) {
+            return std::unexpected(CloudError::FileNotFound);
+        }
+
+        std::unique_ptr<CloudMount> mount(new CloudMount());
+        Impl& impl = *mount->pImpl;
+        impl.containerPath = container_path;
+        impl.mountPoint = mount_point;
+        impl.storage = std::make_unique<CloudStorage>(std::move(*opened));
+
+        static const fuse_operations ops = [] {
+            fuse_operations o{};
+            o.getattr = &Impl::opGetattr;
+            o.readdir = &Impl::opReaddir;
+            o.open = &Impl::opOpen;
+            o.create = &Impl::opCreate;
+            o.read = &Impl::opRead;
+            o.write = &Impl::opWrite;
+            o.release = &Impl::opRelease;
+            o.truncate = &Impl::opTruncate;
+            o.unlink = &Impl::opUnlink;
+            o.mkdir = &Impl::opMkdir;
+            return o;
+            }();
+
+        struct fuse_args args = FUSE_ARGS_INIT(0, nullptr);
+        fuse_opt_add_arg(&args, "omnishell");
+        fuse_opt_add_arg(&args, "-o");
+        fuse_opt_add_arg(&args, "fsname=onecloud");
+        impl.fuse = fuse_new(&args, &ops, sizeof(ops), &impl);
+        fuse_opt_free_args(&args);
+        if (!impl.fuse) return std::unexpected(CloudError::AccessDenied);
+
+        if (fuse_mount(impl.fuse, mount_point.string().c_str()) != 0) {
+            fuse_destroy(impl.fuse);
+            impl.fuse = nullptr;
+            return std::unexpected(CloudError::AccessDenied);
+        }
+
+        // Single-threaded loop; every callback also takes the mount mutex because CloudStorage is not thread-safe.
+        impl.loopThread = std::thread([f = impl.fuse] { fuse_loop(f); });
+        return mount;
+    }
+
+    void CloudMount::unmount() {
+        if (!pImpl || !pImpl->fuse) return;
+        // fuse_loop only checks the exit flag between requests, and fuse_unmount does not wake a loop
+        // blocked reading /dev/fuse if the unmount itself fails (e.g. EBUSY). A lookup of a name that
+        // cannot be cached sends it one last request; if the connection is already gone, the loop has
+        // returned and the stat just fails.
+        fuse_exit(pImpl->fuse);
+        if (pImpl->loopThread.joinable()) {
+            struct stat st;
+            ::stat((pImpl->mountPoint / ".onecloud-unmount").string().c_str(), &st);
+            pImpl->loopThread.join();
+        }
+        fuse_unmount(pImpl->fuse);
+        fuse_destroy(pImpl->fuse);
+        pImpl->fuse = nullptr;
+    }
+
+    std::string CloudMount::status() const {
+        std::ostringstream os;
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        os << pImpl->containerPath.string() << " -> " << pImpl->mountPoint.string()
+            << (pImpl->fuse ? " [mounted]" : " [unmounted]")
+            << " open_writers=" << pImpl->openWriters.size()
+            << " reads=" << pImpl->readCalls.load()
+            << " read_bytes=" << pImpl->bytesRead.load()
+            << " written_bytes=" << pImpl->bytesWritten.load();
+        auto cache = pImpl->storage->chunkCacheStats();
+        os << " cache_hits=" << cache.hits
+            << " cache_misses=" << cache.misses
+            << " prefetched=" << cache.prefetched
+            << " cache_mb=" << (cache.cached_bytes >> 20) << "/" << (cache.budget_bytes >> 20)
+            << " cipher=" << CryptoProvider::suite_name(pImpl->storage->cipherSuite());
+        return os.str();
+    }
+
+#else // No FUSE support in this build
+
+    class CloudMount::Impl {
+    public:
+        std::filesystem::path containerPath;
+        std::filesystem::path mountPoint;
+    };
+
+    CloudMount::CloudMount() : pImpl(std::make_unique<Impl>()) {}
+    CloudMount::~CloudMount() = default;
+
+    bool CloudMount::supported() {
+        return false;
+    }
+
+    std::expected<std::unique_ptr<CloudMount>, CloudError> CloudMount::mount(
+        const std::filesystem::path&, const std::string&, const std::filesystem::path&)
+    {
+        return std::unexpected(CloudError::AccessDenied);
+    }
+
+    void CloudMount::unmount() {}
+
+    std::string CloudMount::status() const {
+        return pImpl->containerPath.string() + " -> " + pImpl->mountPoint.string() + " [unsupported]";
+    }
+
+#endif
+
+    const std::filesystem::path& CloudMount::mountPoint() const {
+        return pImpl->mountPoint;
+    }
+
+    const std::filesystem::path& CloudMount::containerPath() const {
+        return pImpl->containerPath;
+    }
+
+} // namespace onecloud
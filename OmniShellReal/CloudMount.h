@@ -0,0 +1,54 @@
+Copyright © 2025 Cadell Richard Anderson
+
+//CloudMount.h
+
+#pragma once
+
+#include "CloudError.h"
+#include <string>
+#include <memory>
+#include <filesystem>
+#include <expected>
+
+namespace onecloud {
+
+    /**
+     * @class CloudMount
+     * @brief Exposes an open container as a directory tree through FUSE (Linux, when built with the
+     * libfuse3 headers and linked with libfuse3; see CloudMount.cpp).
+     *
+     * Reads are served by ranged chunk decryption, so opening a large capture only decodes the
+     * chunks that are actually touched. Writes are accepted sequentially and encoded one chunk at
+     * a time; the new file replaces the old version when it is closed.
+     */
+    class CloudMount {
+    public:
+        /**
+         * @brief Opens the container and mounts it at 'mount_point'. The FUSE loop runs on a background thread.
+         * @return The live mount, or a CloudError (AccessDenied if FUSE is unavailable or the mount fails).
+         */
+        static std::expected<std::unique_ptr<CloudMount>, CloudError> mount(
+            const std::filesystem::path& container_path,
+            const std::string& password,
+            const std::filesystem::path& mount_point);
+
+        // True when this build was compiled with FUSE support.
+        static bool supported();
+
+        ~CloudMount(); // Unmounts if still mounted.
+        CloudMount(const CloudMount&) = delete;
+        CloudMount& operator=(const CloudMount&) = delete;
+
+        void unmount();
+        const std::filesystem::path& mountPoint() const;
+        const std::filesystem::path& containerPath() const;
+        std::string status() const;
+
+    private:
+        CloudMount();
+
+        class Impl;
+        std::unique_ptr<Impl> pImpl;
+    };
+
+} // namespace onecloud
@@ -3,23 +3,44 @@ Copyright © 2025 Cadell Richard Anderson
 #include "CloudStorage.h"
 #include "ManifestSerializer.h"
 #include "CryptoProvider.h"
+#include "CompressionPolicy.h"
+#include "JobManager.h"
+#include "Trace.h"
 #include <zstd.h>
 #include <fstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <list>
+#include <unordered_map>
+#include <mutex>
 #include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <cstddef>
 #include <expected>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace onecloud {
 
     // --- Constants and Helper Structs ---
     namespace {
         constexpr uint32_t OCV_MAGIC_NUMBER = 0x4F435632; // "OCV2"
-        constexpr uint32_t OCV_FORMAT_VERSION = 1;
+        // Version 2: the flat manifest layout and the cipher suite in the header flags. Version 1
+        // containers are still read; their manifest is upgraded, and the header with it, on the next save.
+        constexpr uint32_t OCV_FORMAT_VERSION = 2;
+        constexpr uint32_t OCV_FORMAT_VERSION_1 = 1;
         constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024; // 4 MB chunks
+        constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+        constexpr size_t MAX_CHUNK_SIZE = 64 * 1024 * 1024;
+        constexpr uint64_t HEADER_FLAG_CIPHER_MASK = 0xFF; // Low byte of ContainerHeader::flags holds the CipherSuite.
 
 #pragma pack(push, 1)
         struct ContainerHeader {
@@ -31,6 +52,208 @@ namespace onecloud {
             unsigned char pwhash_salt[CryptoProvider::salt_length()];
         };
 #pragma pack(pop)
+
+        bool supportedFormat(const ContainerHeader& header) {
+            return header.magic_number == OCV_MAGIC_NUMBER &&
+                (header.format_version == OCV_FORMAT_VERSION_1 || header.format_version == OCV_FORMAT_VERSION);
+        }
+
+        // Forces everything written to 'path' so far (through any handle, once flushed) to stable storage.
+        bool syncFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+            HANDLE handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (handle == INVALID_HANDLE_VALUE) return false;
+            const bool ok = FlushFileBuffers(handle) != 0;
+            CloseHandle(handle);
+            return ok;
+#else
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return false;
+            const bool ok = ::fsync(fd) == 0;
+            ::close(fd);
+            return ok;
+#endif
+        }
+
+        // Makes a rename within 'directory' durable. Windows has no directory handle to flush; NTFS
+        // journals the rename itself.
+        bool syncDirectory(const std::filesystem::path& directory) {
+#ifdef _WIN32
+            (void)directory;
+            return true;
+#else
+            const int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0) return false;
+            const bool ok = ::fsync(fd) == 0;
+            ::close(fd);
+            return ok;
+#endif
+        }
+
+        // Directory listings skip a whole subtree "dir/..." by seeking to "dir" + ('/' + 1).
+        constexpr char AFTER_SEPARATOR = static_cast<char>('/' + 1);
+
+        // Glob match where '*' and '?' do not cross '/', '**' does, and [abc] / [a-z] / [!x] are classes.
+        bool globMatch(std::string_view pattern, std::string_view text) {
+            size_t p = 0;
+            size_t t = 0;
+            while (p < pattern.size()) {
+                char c = pattern[p];
+                if (c == '*') {
+                    bool crosses = (p + 1 < pattern.size() && pattern[p + 1] == '*');
+                    std::string_view rest = pattern.substr(p + (crosses ? 2 : 1));
+                    for (size_t k = t; ; ++k) {
+                        if (globMatch(rest, text.substr(k))) return true;
+                        if (k == text.size() || (!crosses && text[k] == '/')) return false;
+                    }
+                }
+                if (t == text.size()) return false;
+                if (c == '?') {
+                    if (text[t] == '/') return false;
+                }
+                else if (c == '[') {
+                    size_t close = pattern.find(']', p + 2);
+                    if (close == std::string_view::npos) {
+                        if (text[t] != '[') return false;
+                    }
+                    else {
+                        bool negate = (pattern[p + 1] == '!' || pattern[p + 1] == '^');
+                        bool matched = false;
+                        for (size_t k = p + (negate ? 2 : 1); k < close; ++k) {
+                            if (k + 2 < close && pattern[k + 1] == '-') {
+                                if (text[t] >= pattern[k] && text[t] <= pattern[k + 2]) matched = true;
+                                k += 2;
+                            }
+                            else if (text[t] == pattern[k]) {
+                                matched = true;
+                            }
+                        }
+                        if (matched == negate || text[t] == '/') return false;
+                        p = close;
+                    }
+                }
+                else if (c != text[t]) {
+                    return false;
+                }
+                ++p;
+                ++t;
+            }
+            return t == text.size();
+        }
+
+        constexpr size_t DEFAULT_CHUNK_CACHE_BYTES = 64 * 1024 * 1024; // 16 full chunks
+        constexpr size_t READAHEAD_CHUNKS = 2;
+
+        using ChunkPtr = std::shared_ptr<const std::vector<std::byte>>;
+
+        // Small files are the ones a trained dictionary helps; larger ones are not worth sampling for training.
+        constexpr size_t DICTIONARY_SAMPLE_MAX_FILE = 64 * 1024;
+        constexpr size_t DICTIONARY_TRAINING_BYTES = 16 * 1024 * 1024;
+
+        // Reads, decrypts and decodes one chunk into 'dest' (exactly chunk.original_size bytes).
+        // 'scratch' holds the ciphertext and is reused across calls to avoid a per-chunk allocation;
+        // it is decrypted in place, and raw chunks are decrypted straight into 'dest'.
+        std::expected<void, CloudError> decodeChunkFrom(std::ifstream& file, const onecloud::DataChunk& chunk,
+            std::span<const std::byte> key, CipherSuite suite, const CompressionPolicy& compression,
+            std::vector<std::byte>& scratch, std::span<std::byte> dest)
+        {
+            OMNI_TRACE_SCOPE_ARG("cloud", "decode_chunk", chunk.original_size);
+            if (dest.size() < chunk.original_size) return std::unexpected(CloudError::BufferTooSmall);
+
+            scratch.resize(chunk.compressed_size);
+            file.seekg(chunk.offset_in_container);
+            if (!file.read(reinterpret_cast<char*>(scratch.data()), scratch.size())) {
+                return std::unexpected(CloudError::IOError);
+            }
+
+            if (chunk.codec == ChunkCodec::Raw) {
+                auto plain = CryptoProvider::decrypt_into(scratch, key, suite, dest);
+                if (!plain) return std::unexpected(plain.error());
+                if (*plain != chunk.original_size) return std::unexpected(CloudError::InvalidContainerFormat);
+                return {};
+            }
+
+            auto plain = CryptoProvider::decrypt_into(scratch, key, suite, scratch);
+            if (!plain) return std::unexpected(plain.error());
+            return compression.decode(chunk, std::span<const std::byte>(scratch.data(), *plain), dest);
+        }
+
+        // Byte-budgeted LRU of decompressed chunks keyed by container offset. Chunks are append-only,
+        // so an offset always identifies the same contents. Locked because read-ahead workers insert into it.
+        class ChunkCache {
+        public:
+            ChunkPtr find(uint64_t offset) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = index_.find(offset);
+                if (it == index_.end()) {
+                    ++misses_;
+                    return nullptr;
+                }
+                lru_.splice(lru_.begin(), lru_, it->second);
+                ++hits_;
+                return it->second->second;
+            }
+
+            bool contains(uint64_t offset) const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return index_.count(offset) != 0;
+            }
+
+            void insert(uint64_t offset, ChunkPtr chunk) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!chunk || chunk->size() > budget_ || index_.count(offset)) return;
+                lru_.emplace_front(offset, std::move(chunk));
+                index_[offset] = lru_.begin();
+                bytes_ += lru_.front().second->size();
+                evictLocked();
+            }
+
+            // Compaction moves every chunk, so offsets no longer identify the same contents.
+            void clear() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                lru_.clear();
+                index_.clear();
+                bytes_ = 0;
+            }
+
+            void setBudget(size_t bytes) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                budget_ = bytes;
+                evictLocked();
+            }
+
+            size_t budget() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return budget_;
+            }
+
+            void fillStats(ChunkCacheStats& stats) const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats.hits = hits_;
+                stats.misses = misses_;
+                stats.cached_chunks = lru_.size();
+                stats.cached_bytes = bytes_;
+                stats.budget_bytes = budget_;
+            }
+
+        private:
+            void evictLocked() {
+                while (bytes_ > budget_ && !lru_.empty()) {
+                    bytes_ -= lru_.back().second->size();
+                    index_.erase(lru_.back().first);
+                    lru_.pop_back();
+                }
+            }
+
+            mutable std::mutex mutex_;
+            std::list<std::pair<uint64_t, ChunkPtr>> lru_;
+            std::unordered_map<uint64_t, std::list<std::pair<uint64_t, ChunkPtr>>::iterator> index_;
+            size_t bytes_ = 0;
+            size_t budget_ = DEFAULT_CHUNK_CACHE_BYTES;
+            uint64_t hits_ = 0;
+            uint64_t misses_ = 0;
+        };
     }
 
     // The actual implementation details are hidden here
@@ -38,10 +261,128 @@ namespace onecloud {
     public:
         std::filesystem::path containerPath;
         std::vector<std::byte> masterKey;
-        std::map<std::string, onecloud::FileEntry> manifestCache;
+        CipherSuite cipher = CipherSuite::ChaCha20Poly1305;
+        // The decompressed manifest, always held in the current layout, and an in-place view over it.
+        // Opening a container costs one decrypt + decompress; no per-entry allocation.
+        std::vector<std::byte> manifestBuffer;
+        ManifestView manifestView;
+        // Changes not yet folded into manifestBuffer by saveManifest().
+        std::map<std::string, onecloud::FileEntry, std::less<>> pendingEntries;
+        std::set<std::string, std::less<>> deletedPaths;
+        // Container-wide compression settings; saved in the manifest header.
+        CompressionPolicy compression;
+        int32_t compressionLevel = 0;
+        std::vector<CompressionDictionary> dictionaries;
+        size_t chunkSize = CHUNK_SIZE;
+
+        static ManifestRecord toRecord(const onecloud::FileEntry& entry) {
+            return { entry.path, entry.original_size, entry.creation_time, entry.last_write_time, entry.chunks };
+        }
+
+        // Finds a file, honouring unsaved changes. The record borrows from manifestBuffer/pendingEntries.
+        std::optional<ManifestRecord> lookup(std::string_view path) const {
+            auto pending = pendingEntries.find(path);
+            if (pending != pendingEntries.end()) return toRecord(pending->second);
+            if (deletedPaths.count(path)) return std::nullopt;
+            if (auto index = manifestView.find(path)) return manifestView.record(*index);
+            return std::nullopt;
+        }
+
+        // Visits live files with path >= 'from' in path order, merging the saved view with unsaved
+        // changes. 'fn' returns false to stop.
+        template<typename Fn>
+        void forEachRecordFrom(std::string_view from, Fn&& fn) const {
+            auto pending = pendingEntries.lower_bound(from);
+            for (uint32_t i = manifestView.lowerBound(from); i < manifestView.size(); ++i) {
+                const ManifestRecord rec = manifestView.record(i);
+                while (pending != pendingEntries.end() && std::string_view(pending->first) < rec.path) {
+                    if (!fn(toRecord(pending->second))) return;
+                    ++pending;
+                }
+                if (pending != pendingEntries.end() && std::string_view(pending->first) == rec.path) {
+                    if (!fn(toRecord(pending->second))) return;
+                    ++pending;
+                    continue;
+                }
+                if (deletedPaths.count(rec.path)) continue;
+                if (!fn(rec)) return;
+            }
+            for (; pending != pendingEntries.end(); ++pending) {
+                if (!fn(toRecord(pending->second))) return;
+            }
+        }
+
+        template<typename Fn>
+        void forEachRecord(Fn&& fn) const {
+            forEachRecordFrom({}, [&](const ManifestRecord& rec) { fn(rec); return true; });
+        }
+
+        // First live path >= 'from', if any.
+        std::optional<ManifestRecord> firstRecordFrom(std::string_view from) const {
+            std::optional<ManifestRecord> found;
+            forEachRecordFrom(from, [&](const ManifestRecord& rec) { found = rec; return false; });
+            return found;
+        }
+
+        void stageEntry(onecloud::FileEntry&& entry) {
+            deletedPaths.erase(entry.path);
+            std::string path = entry.path;
+            pendingEntries[std::move(path)] = std::move(entry);
+        }
 
         std::expected<void, CloudError> loadManifest();
         std::expected<void, CloudError> saveManifest();
+        // Saves the manifest unless a batch is open, in which case the change waits for endBatch().
+        std::expected<void, CloudError> commitChanges() {
+            return batching ? std::expected<void, CloudError>() : saveManifest();
+        }
+        bool batching = false;
+        // Serializes 'records' into 'manifest_buffer' and returns its compressed, encrypted form.
+        std::expected<std::vector<std::byte>, CloudError> sealManifest(std::span<const ManifestRecord> records,
+            std::span<const CompressionDictionary> dictionary_table, std::vector<std::byte>& manifest_buffer) const;
+
+        ~Impl() {
+            dropPrefetches();
+        }
+
+        std::expected<void, CloudError> decodeChunk(std::ifstream& file, const onecloud::DataChunk& chunk,
+            std::vector<std::byte>& scratch, std::span<std::byte> dest)
+        {
+            return decodeChunkFrom(file, chunk, masterKey, cipher, compression, scratch, dest);
+        }
+
+        // Encodes (per the compression policy), encrypts and appends one chunk at the stream's end, recording it in 'entry'.
+        std::expected<void, CloudError> encodeChunk(std::fstream& file, std::span<const std::byte> data, onecloud::FileEntry& entry);
+        // Reused by encodeChunk for the encoded and sealed forms of each chunk.
+        std::vector<std::byte> encodeScratch;
+        std::vector<std::byte> sealScratch;
+
+        // --- Decoded chunk cache and read-ahead ---
+        ChunkCache chunkCache;
+        // A read-ahead task on the shared pool and where it leaves its chunk (null if it failed or was
+        // cancelled before it ran).
+        struct Prefetch {
+            TaskHandle task;
+            std::shared_ptr<ChunkPtr> result;
+        };
+        std::map<uint64_t, Prefetch> inflight;
+        CancelToken prefetchCancel;
+        uint64_t prefetchIssued = 0;
+        // The end of the previous ranged read; a read starting exactly here is treated as sequential.
+        std::string lastReadPath;
+        uint64_t lastReadEnd = 0;
+
+        // Returns a decoded chunk from the cache, a finished read-ahead, or by decoding it now.
+        std::expected<ChunkPtr, CloudError> cachedChunk(std::ifstream& file, const onecloud::DataChunk& chunk, std::vector<std::byte>& scratch);
+        // Decodes up to READAHEAD_CHUNKS chunks starting at 'first' as low-priority pool tasks.
+        void prefetch(const ManifestRecord& entry, size_t first);
+        // Cancels the read-ahead that has not started and waits for the rest.
+        void dropPrefetches() {
+            prefetchCancel.cancel();
+            for (auto& pending : inflight) JobManager::Wait(pending.second.task);
+            inflight.clear();
+            prefetchCancel = CancelToken();
+        }
     };
 
     // --- CloudStorage Public Implementation ---
@@ -52,6 +393,10 @@ namespace onecloud {
     CloudStorage& CloudStorage::operator=(CloudStorage&&) noexcept = default;
 
     std::expected<CloudStorage, CloudError> CloudStorage::create(const std::filesystem::path& path, const std::string& password) {
+        return create(path, password, CryptoProvider::preferred_suite());
+    }
+
+    std::expected<CloudStorage, CloudError> CloudStorage::create(const std::filesystem::path& path, const std::string& password, CipherSuite cipher) {
         if (std::filesystem::exists(path)) {
             return std::unexpected(CloudError::FileExists);
         }
@@ -67,13 +412,14 @@ namespace onecloud {
 
         CloudStorage storage;
         storage.pImpl->containerPath = path;
+        storage.pImpl->cipher = cipher;
 
         ContainerHeader header{};
         header.magic_number = OCV_MAGIC_NUMBER;
         header.format_version = OCV_FORMAT_VERSION;
         header.manifest_offset = 0;
         header.manifest_length = 0;
-        header.flags = 0;
+        header.flags = static_cast<uint64_t>(cipher);
 
         auto salt = CryptoProvider::random_bytes(CryptoProvider::salt_length());
         if (salt.size() != CryptoProvider::salt_length()) {
@@ -106,12 +452,18 @@ namespace onecloud {
 
         ContainerHeader header{};
         file.read(reinterpret_cast<char*>(&header), sizeof(header));
-        if (header.magic_number != OCV_MAGIC_NUMBER) {
+        if (!supportedFormat(header)) {
+            return std::unexpected(CloudError::InvalidContainerFormat);
+        }
+        // Containers written before the suite was recorded have zero flags, which is ChaCha20-Poly1305.
+        const uint64_t suite = header.flags & HEADER_FLAG_CIPHER_MASK;
+        if (suite > static_cast<uint64_t>(CipherSuite::Aes256Gcm)) {
             return std::unexpected(CloudError::InvalidContainerFormat);
         }
 
         CloudStorage storage;
         storage.pImpl->containerPath = path;
+        storage.pImpl->cipher = static_cast<CipherSuite>(suite);
 
         std::vector<std::byte> salt(reinterpret_cast<const std::byte*>(header.pwhash_salt), reinterpret_cast<const std::byte*>(header.pwhash_salt) + sizeof(header.pwhash_salt));
         auto keyResult = CryptoProvider::derive_key_from_password(password, salt);
@@ -134,18 +486,33 @@ namespace onecloud {
 
         ContainerHeader header{};
         file.read(reinterpret_cast<char*>(&header), sizeof(header));
-        if (header.magic_number != OCV_MAGIC_NUMBER) return std::unexpected(CloudError::InvalidContainerFormat);
+        if (!supportedFormat(header)) return std::unexpected(CloudError::InvalidContainerFormat);
+
+        pendingEntries.clear();
+        deletedPaths.clear();
+        dictionaries.clear();
+        compressionLevel = 0;
 
         if (header.manifest_offset == 0 || header.manifest_length == 0) {
-            manifestCache.clear();
+            manifestBuffer.clear();
+            manifestView = ManifestView();
             return {};
         }
 
+        // A truncated container must fail cleanly rather than allocate whatever the header claims.
+        std::error_code size_error;
+        const uint64_t container_size = std::filesystem::file_size(containerPath, size_error);
+        if (size_error || header.manifest_offset > container_size || header.manifest_length > container_size - header.manifest_offset) {
+            return std::unexpected(CloudError::InvalidContainerFormat);
+        }
+
         file.seekg(header.manifest_offset);
         std::vector<std::byte> encrypted_buffer(header.manifest_length);
-        file.read(reinterpret_cast<char*>(encrypted_buffer.data()), encrypted_buffer.size());
+        if (!file.read(reinterpret_cast<char*>(encrypted_buffer.data()), encrypted_buffer.size())) {
+            return std::unexpected(CloudError::IOError);
+        }
 
-        auto decryptResult = CryptoProvider::decrypt(encrypted_buffer, masterKey);
+        auto decryptResult = CryptoProvider::decrypt(encrypted_buffer, masterKey, cipher);
         if (!decryptResult) return std::unexpected(decryptResult.error());
 
         auto& compressed_buffer = *decryptResult;
@@ -155,29 +522,48 @@ namespace onecloud {
         }
 
         std::vector<std::byte> manifest_buffer(decompressed_size);
-        ZSTD_decompress(manifest_buffer.data(), manifest_buffer.size(), compressed_buffer.data(), compressed_buffer.size());
-
-        onecloud::Manifest manifest_data;
-        if (!ManifestSerializer::deserialize(manifest_buffer, manifest_data)) {
+        size_t decompressed = ZSTD_decompress(manifest_buffer.data(), manifest_buffer.size(), compressed_buffer.data(), compressed_buffer.size());
+        if (ZSTD_isError(decompressed) || decompressed != manifest_buffer.size()) {
             return std::unexpected(CloudError::InvalidContainerFormat);
         }
 
-        manifestCache.clear();
-        for (auto& file_entry : manifest_data.files) {
-            manifestCache[file_entry.path] = std::move(file_entry);
+        if (ManifestSerializer::peekVersion(manifest_buffer) != ManifestSerializer::current_version()) {
+            // Older manifests are upgraded in memory; the next save writes the current version.
+            onecloud::Manifest manifest_data;
+            if (!ManifestSerializer::deserialize(manifest_buffer, manifest_data)) {
+                return std::unexpected(CloudError::InvalidContainerFormat);
+            }
+            manifest_data.version = ManifestSerializer::current_version();
+            ManifestSerializer::serialize(manifest_data, manifest_buffer);
         }
 
+        auto view = ManifestView::open(manifest_buffer);
+        if (!view) return std::unexpected(CloudError::InvalidContainerFormat);
+        manifestBuffer = std::move(manifest_buffer); // Moving a vector keeps its storage, so the view stays valid.
+        manifestView = *view;
+
+        compressionLevel = manifestView.compressionLevel();
+        compression.setLevel(compressionLevel);
+        for (const auto& dictionary : manifestView.dictionaries()) {
+            // Dictionaries are stored as raw encrypted blobs; load them in order so the newest ends up active.
+            std::vector<std::byte> scratch;
+            std::vector<std::byte> bytes(dictionary.location.original_size);
+            auto decodeResult = decodeChunk(file, dictionary.location, scratch, bytes);
+            if (!decodeResult) return std::unexpected(decodeResult.error());
+            auto added = compression.addDictionary(bytes);
+            if (!added) return std::unexpected(added.error());
+            dictionaries.push_back(dictionary);
+        }
         return {};
     }
 
-    std::expected<void, CloudError> CloudStorage::Impl::saveManifest() {
-        onecloud::Manifest manifest_to_save;
-        for (const auto& pair : manifestCache) {
-            manifest_to_save.files.push_back(pair.second);
-        }
-
-        std::vector<std::byte> manifest_buffer;
-        ManifestSerializer::serialize(manifest_to_save, manifest_buffer);
+    std::expected<std::vector<std::byte>, CloudError> CloudStorage::Impl::sealManifest(std::span<const ManifestRecord> records,
+        std::span<const CompressionDictionary> dictionary_table, std::vector<std::byte>& manifest_buffer) const
+    {
+        ManifestSettings settings;
+        settings.compression_level = compressionLevel;
+        settings.dictionaries = dictionary_table;
+        ManifestSerializer::serializeRecords(records, settings, manifest_buffer);
 
         size_t compressed_bound = ZSTD_compressBound(manifest_buffer.size());
         std::vector<std::byte> compressed_buffer(compressed_bound);
@@ -185,7 +571,16 @@ namespace onecloud {
         if (ZSTD_isError(compressed_size)) return std::unexpected(CloudError::IOError);
         compressed_buffer.resize(compressed_size);
 
-        auto encryptResult = CryptoProvider::encrypt(compressed_buffer, masterKey);
+        return CryptoProvider::encrypt(compressed_buffer, masterKey, cipher);
+    }
+
+    std::expected<void, CloudError> CloudStorage::Impl::saveManifest() {
+        std::vector<ManifestRecord> records;
+        records.reserve(manifestView.size() + pendingEntries.size());
+        forEachRecord([&](const ManifestRecord& rec) { records.push_back(rec); });
+
+        std::vector<std::byte> manifest_buffer;
+        auto encryptResult = sealManifest(records, dictionaries, manifest_buffer);
         if (!encryptResult) return std::unexpected(encryptResult.error());
         auto& encrypted_buffer = *encryptResult;
 
@@ -198,42 +593,197 @@ namespace onecloud {
 
         file.write(reinterpret_cast<const char*>(encrypted_buffer.data()), encrypted_buffer.size());
 
-        file.seekp(offsetof(ContainerHeader, manifest_offset));
+        // The chunks written since the last save and the new manifest must be on disk before the header
+        // points at them; otherwise a crash could leave a header referring to bytes that never landed.
+        file.flush();
+        if (!file || !syncFile(containerPath)) return std::unexpected(CloudError::IOError);
+
+        // The manifest is always written in the current layout, so the header now claims the current version.
+        const uint32_t format_version = OCV_FORMAT_VERSION;
+        file.seekp(offsetof(ContainerHeader, format_version));
+        file.write(reinterpret_cast<const char*>(&format_version), sizeof(format_version));
         file.write(reinterpret_cast<const char*>(&new_manifest_offset), sizeof(new_manifest_offset));
         file.write(reinterpret_cast<const char*>(&new_manifest_length), sizeof(new_manifest_length));
-
+        file.flush();
+        if (!file || !syncFile(containerPath)) return std::unexpected(CloudError::IOError);
+
+        // The records above borrowed from the old buffer; only swap once they are no longer needed.
+        auto view = ManifestView::open(manifest_buffer);
+        if (!view) return std::unexpected(CloudError::InvalidContainerFormat);
+        manifestBuffer = std::move(manifest_buffer);
+        manifestView = *view;
+        pendingEntries.clear();
+        deletedPaths.clear();
         return {};
     }
 
     // --- Public Method Implementations ---
 
+    std::expected<void, CloudError> CloudStorage::Impl::encodeChunk(std::fstream& file, std::span<const std::byte> data, onecloud::FileEntry& entry) {
+        OMNI_TRACE_SCOPE_ARG("cloud", "encode_chunk", data.size());
+        auto encoded = compression.encode(data, encodeScratch);
+        if (!encoded) return std::unexpected(encoded.error());
+        std::span<const std::byte> payload = (encoded->codec == ChunkCodec::Raw) ? data : std::span<const std::byte>(encodeScratch);
+
+        sealScratch.resize(payload.size() + CryptoProvider::overhead());
+        auto sealed = CryptoProvider::encrypt_into(payload, masterKey, cipher, sealScratch);
+        if (!sealed) return std::unexpected(sealed.error());
+        std::span<const std::byte> encrypted_chunk(sealScratch.data(), *sealed);
+
+        file.seekp(0, std::ios::end);
+        uint64_t chunk_offset = static_cast<uint64_t>(file.tellp());
+        if (!file.write(reinterpret_cast<const char*>(encrypted_chunk.data()), encrypted_chunk.size())) {
+            return std::unexpected(CloudError::IOError);
+        }
+
+        // FIXED: Use value-initialization to prevent potential uninitialized members
+        onecloud::DataChunk chunk_metadata{};
+        chunk_metadata.offset_in_container = chunk_offset;
+        chunk_metadata.compressed_size = static_cast<uint32_t>(encrypted_chunk.size());
+        chunk_metadata.original_size = static_cast<uint32_t>(data.size());
+        chunk_metadata.codec = encoded->codec;
+        chunk_metadata.dictionary_id = encoded->dictionary_id;
+        entry.chunks.push_back(chunk_metadata);
+        entry.original_size += data.size();
+        return {};
+    }
+
+    std::expected<ChunkPtr, CloudError> CloudStorage::Impl::cachedChunk(std::ifstream& file, const onecloud::DataChunk& chunk, std::vector<std::byte>& scratch) {
+        if (auto hit = chunkCache.find(chunk.offset_in_container)) {
+            return hit;
+        }
+
+        auto pending = inflight.find(chunk.offset_in_container);
+        if (pending != inflight.end()) {
+            JobManager::Wait(pending->second.task);
+            ChunkPtr prefetched = std::move(*pending->second.result);
+            inflight.erase(pending);
+            if (prefetched) return prefetched;
+            // A failed or cancelled read-ahead is retried synchronously so the caller sees the real error.
+        }
+
+        auto decoded = std::make_shared<std::vector<std::byte>>(chunk.original_size);
+        auto decodeResult = decodeChunk(file, chunk, scratch, *decoded);
+        if (!decodeResult) return std::unexpected(decodeResult.error());
+
+        chunkCache.insert(chunk.offset_in_container, decoded);
+        return ChunkPtr(std::move(decoded));
+    }
+
+    void CloudStorage::Impl::prefetch(const ManifestRecord& entry, size_t first) {
+        std::erase_if(inflight, [](const auto& pending) { return pending.second.task.finished(); });
+
+        for (size_t i = first; i < entry.chunks.size() && i < first + READAHEAD_CHUNKS; ++i) {
+            const onecloud::DataChunk chunk = entry.chunks[i];
+            if (chunkCache.contains(chunk.offset_in_container) || inflight.count(chunk.offset_in_container)) continue;
+
+            // Tasks copy everything they need; ~Impl waits for them, so the cache and policy pointers stay valid.
+            // Low priority, so read-ahead never holds up interactive jobs on the pool.
+            auto result = std::make_shared<ChunkPtr>();
+            TaskOptions options;
+            options.priority = JobPriority::Low;
+            options.cancel = prefetchCancel;
+            TaskHandle task = JobManager::SubmitJob([path = containerPath, key = masterKey, suite = cipher, chunk, cache = &chunkCache, policy = &compression, result]() {
+                std::ifstream file(path, std::ios::binary);
+                if (!file) return;
+                std::vector<std::byte> scratch;
+                auto decoded = std::make_shared<std::vector<std::byte>>(chunk.original_size);
+                if (!decodeChunkFrom(file, chunk, key, suite, *policy, scratch, *decoded)) return;
+                cache->insert(chunk.offset_in_container, decoded);
+                *result = std::move(decoded);
+                }, std::move(options));
+            inflight.emplace(chunk.offset_in_container, Prefetch{ std::move(task), std::move(result) });
+            ++prefetchIssued;
+        }
+    }
+
     std::expected<std::vector<std::byte>, CloudError> CloudStorage::readFile(const std::string& virtual_path) {
-        auto it = pImpl->manifestCache.find(virtual_path);
-        if (it == pImpl->manifestCache.end()) {
+        auto sizeResult = fileSize(virtual_path);
+        if (!sizeResult) return std::unexpected(sizeResult.error());
+
+        std::vector<std::byte> full_data(*sizeResult);
+        auto readResult = readFileInto(virtual_path, full_data);
+        if (!readResult) return std::unexpected(readResult.error());
+        return full_data;
+    }
+
+    std::expected<uint64_t, CloudError> CloudStorage::fileSize(const std::string& virtual_path) const {
+        auto record = pImpl->lookup(virtual_path);
+        if (!record) {
+            return std::unexpected(CloudError::FileNotFound);
+        }
+        return record->original_size;
+    }
+
+    std::expected<size_t, CloudError> CloudStorage::readFileInto(const std::string& virtual_path, std::span<std::byte> dest) {
+        auto record = pImpl->lookup(virtual_path);
+        if (!record) {
             return std::unexpected(CloudError::FileNotFound);
         }
 
-        const auto& file_entry = it->second;
-        std::vector<std::byte> full_data(file_entry.original_size);
-        std::byte* current_pos = full_data.data();
+        const auto& file_entry = *record;
+        if (dest.size() < file_entry.original_size) {
+            return std::unexpected(CloudError::BufferTooSmall);
+        }
 
         std::ifstream file(pImpl->containerPath, std::ios::binary);
         if (!file) return std::unexpected(CloudError::IOError);
 
+        // Files that fit comfortably in the cache are kept there; larger ones stream through without evicting
+        // it, and without looking it up, so they do not count as misses.
+        const bool cacheable = file_entry.original_size <= pImpl->chunkCache.budget() / 2;
+
+        std::vector<std::byte> scratch;
+        size_t written = 0;
         for (const auto& chunk : file_entry.chunks) {
-            file.seekg(chunk.offset_in_container);
-            std::vector<std::byte> encrypted_chunk(chunk.compressed_size);
-            file.read(reinterpret_cast<char*>(encrypted_chunk.data()), encrypted_chunk.size());
+            if (written + chunk.original_size > file_entry.original_size) {
+                return std::unexpected(CloudError::InvalidContainerFormat);
+            }
+            auto chunk_dest = dest.subspan(written, chunk.original_size);
+            if (auto hit = cacheable ? pImpl->chunkCache.find(chunk.offset_in_container) : nullptr) {
+                std::memcpy(chunk_dest.data(), hit->data(), chunk.original_size);
+            }
+            else {
+                auto chunkResult = pImpl->decodeChunk(file, chunk, scratch, chunk_dest);
+                if (!chunkResult) return std::unexpected(chunkResult.error());
+                if (cacheable) {
+                    pImpl->chunkCache.insert(chunk.offset_in_container, std::make_shared<std::vector<std::byte>>(chunk_dest.begin(), chunk_dest.end()));
+                }
+            }
+            written += chunk.original_size;
+        }
 
-            auto decryptResult = CryptoProvider::decrypt(encrypted_chunk, pImpl->masterKey);
-            if (!decryptResult) return std::unexpected(decryptResult.error());
+        return written;
+    }
 
-            auto& compressed_chunk = *decryptResult;
-            ZSTD_decompress(current_pos, chunk.original_size, compressed_chunk.data(), compressed_chunk.size());
-            current_pos += chunk.original_size;
+    std::expected<void, CloudError> CloudStorage::readFileChunked(const std::string& virtual_path, const ChunkSink& sink) {
+        auto record = pImpl->lookup(virtual_path);
+        if (!record) {
+            return std::unexpected(CloudError::FileNotFound);
         }
 
-        return full_data;
+        std::ifstream file(pImpl->containerPath, std::ios::binary);
+        if (!file) return std::unexpected(CloudError::IOError);
+
+        const bool cacheable = record->original_size <= pImpl->chunkCache.budget() / 2;
+
+        std::vector<std::byte> scratch;
+        std::vector<std::byte> plain;
+        for (const auto& chunk : record->chunks) {
+            if (auto hit = cacheable ? pImpl->chunkCache.find(chunk.offset_in_container) : nullptr) {
+                if (!sink(*hit)) return std::unexpected(CloudError::IOError);
+                continue;
+            }
+            plain.resize(chunk.original_size);
+            auto chunkResult = pImpl->decodeChunk(file, chunk, scratch, plain);
+            if (!chunkResult) return std::unexpected(chunkResult.error());
+            if (cacheable) {
+                pImpl->chunkCache.insert(chunk.offset_in_container, std::make_shared<std::vector<std::byte>>(plain));
+            }
+            if (!sink(plain)) return std::unexpected(CloudError::IOError);
+        }
+
+        return {};
     }
 
     std::expected<void, CloudError> CloudStorage::writeFile(const std::string& virtual_path, std::span<const std::byte> data) {
@@ -243,58 +793,441 @@ namespace onecloud {
         // FIXED: Use value-initialization to prevent potential uninitialized members
         onecloud::FileEntry new_entry{};
         new_entry.path = virtual_path;
-        new_entry.original_size = data.size();
         new_entry.creation_time = std::chrono::system_clock::now().time_since_epoch().count();
         new_entry.last_write_time = new_entry.creation_time;
 
         size_t bytes_processed = 0;
         while (bytes_processed < data.size()) {
-            size_t current_chunk_size = std::min(CHUNK_SIZE, data.size() - bytes_processed);
-            std::span<const std::byte> chunk_span = data.subspan(bytes_processed, current_chunk_size);
+            size_t current_chunk_size = std::min(pImpl->chunkSize, data.size() - bytes_processed);
+            auto encodeResult = pImpl->encodeChunk(file, data.subspan(bytes_processed, current_chunk_size), new_entry);
+            if (!encodeResult) return std::unexpected(encodeResult.error());
+            bytes_processed += current_chunk_size;
+        }
 
-            size_t compressed_bound = ZSTD_compressBound(current_chunk_size);
-            std::vector<std::byte> compressed_chunk(compressed_bound);
-            size_t compressed_size = ZSTD_compress(compressed_chunk.data(), compressed_bound, chunk_span.data(), chunk_span.size(), 3);
-            if (ZSTD_isError(compressed_size)) return std::unexpected(CloudError::IOError);
-            compressed_chunk.resize(compressed_size);
+        // saveManifest appends through its own stream, so the chunk data must reach the file first.
+        file.close();
+        if (file.fail()) return std::unexpected(CloudError::IOError);
+
+        pImpl->stageEntry(std::move(new_entry));
+        return pImpl->commitChanges();
+    }
 
-            auto encryptResult = CryptoProvider::encrypt(compressed_chunk, pImpl->masterKey);
-            if (!encryptResult) return std::unexpected(encryptResult.error());
-            auto& encrypted_chunk = *encryptResult;
+    std::expected<void, CloudError> CloudStorage::deleteFile(const std::string& virtual_path) {
+        if (!pImpl->lookup(virtual_path)) {
+            return std::unexpected(CloudError::FileNotFound);
+        }
+        pImpl->pendingEntries.erase(virtual_path);
+        pImpl->deletedPaths.insert(virtual_path);
+        return pImpl->commitChanges();
+    }
 
-            uint64_t chunk_offset = static_cast<uint64_t>(file.tellp());
-            file.write(reinterpret_cast<const char*>(encrypted_chunk.data()), encrypted_chunk.size());
+    std::expected<std::vector<std::string>, CloudError> CloudStorage::listFiles() {
+        std::vector<std::string> file_list;
+        file_list.reserve(pImpl->manifestView.size() + pImpl->pendingEntries.size());
+        pImpl->forEachRecord([&](const ManifestRecord& rec) { file_list.emplace_back(rec.path); });
+        return file_list;
+    }
 
-            // FIXED: Use value-initialization to prevent potential uninitialized members
-            onecloud::DataChunk chunk_metadata{};
-            chunk_metadata.offset_in_container = chunk_offset;
-            chunk_metadata.compressed_size = static_cast<uint32_t>(encrypted_chunk.size());
-            chunk_metadata.original_size = static_cast<uint32_t>(current_chunk_size);
-            new_entry.chunks.push_back(chunk_metadata);
+    std::expected<void, CloudError> CloudStorage::forEachFile(const ListOptions& options, const FileVisitor& visitor) const {
+        // Narrow the scanned range to the literal part of the glob when it is more specific than the prefix.
+        std::string_view scan_prefix = options.prefix;
+        std::string_view literal = std::string_view(options.glob).substr(0, options.glob.find_first_of("*?["));
+        if (!options.glob.empty()) {
+            if (literal.starts_with(scan_prefix)) scan_prefix = literal;
+            else if (!scan_prefix.starts_with(literal)) return {};
+        }
 
-            bytes_processed += current_chunk_size;
+        std::string from(scan_prefix);
+        if (!options.start_after.empty() && std::string_view(options.start_after) >= from) {
+            from = options.start_after;
+            from.push_back('\0'); // Smallest key strictly after start_after.
         }
 
-        pImpl->manifestCache[virtual_path] = std::move(new_entry);
-        return pImpl->saveManifest();
+        size_t produced = 0;
+        pImpl->forEachRecordFrom(from, [&](const ManifestRecord& rec) {
+            if (!rec.path.starts_with(scan_prefix)) return false;
+            if (!options.glob.empty() && !globMatch(options.glob, rec.path)) return true;
+            FileInfo info;
+            info.size = rec.original_size;
+            info.creation_time = rec.creation_time;
+            info.last_write_time = rec.last_write_time;
+            if (!visitor(rec.path, info)) return false;
+            return options.limit == 0 || ++produced < options.limit;
+            });
+        return {};
     }
 
-    std::expected<void, CloudError> CloudStorage::deleteFile(const std::string& virtual_path) {
-        auto it = pImpl->manifestCache.find(virtual_path);
-        if (it == pImpl->manifestCache.end()) {
+    std::expected<std::vector<std::string>, CloudError> CloudStorage::listFiles(const ListOptions& options) const {
+        std::vector<std::string> file_list;
+        auto result = forEachFile(options, [&](std::string_view path, const FileInfo&) {
+            file_list.emplace_back(path);
+            return true;
+            });
+        if (!result) return std::unexpected(result.error());
+        return file_list;
+    }
+
+    std::expected<std::vector<DirEntry>, CloudError> CloudStorage::listDirectory(std::string_view directory, std::string_view start_after, size_t limit) const {
+        while (!directory.empty() && directory.front() == '/') directory.remove_prefix(1);
+        while (!directory.empty() && directory.back() == '/') directory.remove_suffix(1);
+        if (!directory.empty() && !isDirectory(directory)) {
+            return std::unexpected(CloudError::FileNotFound);
+        }
+
+        const std::string prefix = directory.empty() ? std::string() : std::string(directory) + "/";
+        std::string cursor = prefix;
+        if (!start_after.empty()) {
+            cursor = prefix + std::string(start_after);
+            cursor += isDirectory(cursor) ? AFTER_SEPARATOR : '\0';
+        }
+
+        std::vector<DirEntry> entries;
+        while (limit == 0 || entries.size() < limit) {
+            auto rec = pImpl->firstRecordFrom(cursor);
+            if (!rec || !rec->path.starts_with(prefix)) break;
+
+            std::string_view rest = rec->path.substr(prefix.size());
+            size_t slash = rest.find('/');
+            DirEntry entry;
+            if (slash == std::string_view::npos) {
+                entry.name.assign(rest);
+                entry.size = rec->original_size;
+                cursor.assign(rec->path);
+                cursor.push_back('\0');
+            }
+            else {
+                // Report the subdirectory once and jump past everything beneath it.
+                entry.name.assign(rest.substr(0, slash));
+                entry.is_directory = true;
+                cursor = prefix + entry.name + AFTER_SEPARATOR;
+            }
+            entries.push_back(std::move(entry));
+        }
+        return entries;
+    }
+
+    bool CloudStorage::isDirectory(std::string_view path) const {
+        while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+        if (path.empty()) return true;
+        const std::string prefix = std::string(path) + "/";
+        auto rec = pImpl->firstRecordFrom(prefix);
+        return rec && rec->path.starts_with(prefix);
+    }
+
+    std::expected<FileInfo, CloudError> CloudStorage::fileInfo(const std::string& virtual_path) const {
+        auto record = pImpl->lookup(virtual_path);
+        if (!record) {
+            return std::unexpected(CloudError::FileNotFound);
+        }
+        FileInfo info;
+        info.size = record->original_size;
+        info.creation_time = record->creation_time;
+        info.last_write_time = record->last_write_time;
+        return info;
+    }
+
+    std::expected<size_t, CloudError> CloudStorage::readFileRange(const std::string& virtual_path, uint64_t offset, std::span<std::byte> dest) {
+        auto record = pImpl->lookup(virtual_path);
+        if (!record) {
             return std::unexpected(CloudError::FileNotFound);
         }
-        pImpl->manifestCache.erase(it);
+
+        const auto& file_entry = *record;
+        if (offset >= file_entry.original_size || dest.empty()) {
+            return size_t{ 0 };
+        }
+
+        std::ifstream file(pImpl->containerPath, std::ios::binary);
+        if (!file) return std::unexpected(CloudError::IOError);
+
+        const bool sequential = (virtual_path == pImpl->lastReadPath && offset == pImpl->lastReadEnd);
+
+        std::vector<std::byte> scratch;
+        size_t written = 0;
+        size_t last_chunk = 0;
+        uint64_t chunk_start = 0;
+        for (size_t i = 0; i < file_entry.chunks.size(); ++i) {
+            const auto& chunk = file_entry.chunks[i];
+            uint64_t chunk_end = chunk_start + chunk.original_size;
+            if (chunk_end <= offset) {
+                chunk_start = chunk_end;
+                continue;
+            }
+            if (written == dest.size()) break;
+
+            auto chunkResult = pImpl->cachedChunk(file, chunk, scratch);
+            if (!chunkResult) return std::unexpected(chunkResult.error());
+
+            size_t from = static_cast<size_t>(offset + written - chunk_start);
+            size_t count = std::min<size_t>(chunk.original_size - from, dest.size() - written);
+            std::memcpy(dest.data() + written, (*chunkResult)->data() + from, count);
+            written += count;
+            last_chunk = i;
+            chunk_start = chunk_end;
+        }
+
+        pImpl->lastReadPath = virtual_path;
+        pImpl->lastReadEnd = offset + written;
+        if (sequential && written > 0) {
+            pImpl->prefetch(file_entry, last_chunk + 1);
+        }
+
+        return written;
+    }
+
+    void CloudStorage::setChunkCacheBudget(size_t bytes) {
+        pImpl->chunkCache.setBudget(bytes);
+    }
+
+    ChunkCacheStats CloudStorage::chunkCacheStats() const {
+        ChunkCacheStats stats;
+        pImpl->chunkCache.fillStats(stats);
+        stats.prefetched = pImpl->prefetchIssued;
+        return stats;
+    }
+
+    std::expected<void, CloudError> CloudStorage::setCompressionLevel(int level) {
+        pImpl->compression.setLevel(level);
+        pImpl->compressionLevel = (level == 0) ? 0 : pImpl->compression.level();
+        return pImpl->commitChanges();
+    }
+
+    std::expected<uint32_t, CloudError> CloudStorage::trainDictionary(size_t max_dictionary_bytes) {
+        // Sample the small files, which are what the dictionary is used for.
+        std::vector<std::string> sample_paths;
+        size_t sample_bytes = 0;
+        pImpl->forEachRecordFrom({}, [&](const ManifestRecord& rec) {
+            if (rec.original_size == 0 || rec.original_size > DICTIONARY_SAMPLE_MAX_FILE) return true;
+            sample_paths.emplace_back(rec.path);
+            sample_bytes += rec.original_size;
+            return sample_bytes < DICTIONARY_TRAINING_BYTES;
+            });
+
+        std::vector<std::vector<std::byte>> samples;
+        samples.reserve(sample_paths.size());
+        for (const auto& path : sample_paths) {
+            auto data = readFile(path);
+            if (!data) return std::unexpected(data.error());
+            samples.push_back(std::move(*data));
+        }
+
+        auto trained = CompressionPolicy::trainDictionary(samples, max_dictionary_bytes);
+        if (!trained) return std::unexpected(trained.error());
+
+        // Store the dictionary as an encrypted raw blob; the manifest records where it lives.
+        auto encryptResult = CryptoProvider::encrypt(*trained, pImpl->masterKey, pImpl->cipher);
+        if (!encryptResult) return std::unexpected(encryptResult.error());
+
+        CompressionDictionary record{};
+        {
+            std::fstream file(pImpl->containerPath, std::ios::in | std::ios::out | std::ios::binary);
+            if (!file) return std::unexpected(CloudError::IOError);
+            file.seekp(0, std::ios::end);
+            record.location.offset_in_container = static_cast<uint64_t>(file.tellp());
+            if (!file.write(reinterpret_cast<const char*>(encryptResult->data()), encryptResult->size())) {
+                return std::unexpected(CloudError::IOError);
+            }
+        }
+        record.location.compressed_size = static_cast<uint32_t>(encryptResult->size());
+        record.location.original_size = static_cast<uint32_t>(trained->size());
+        record.location.codec = ChunkCodec::Raw;
+
+        auto id = pImpl->compression.addDictionary(*trained);
+        if (!id) return std::unexpected(id.error());
+        record.id = *id;
+        std::erase_if(pImpl->dictionaries, [&](const CompressionDictionary& existing) { return existing.id == record.id; });
+        pImpl->dictionaries.push_back(record);
+
+        auto saveResult = pImpl->commitChanges();
+        if (!saveResult) return std::unexpected(saveResult.error());
+        return *id;
+    }
+
+    CompressionStats CloudStorage::compressionStats() const {
+        CompressionStats stats;
+        stats.level = pImpl->compression.level();
+        stats.dictionaries = pImpl->dictionaries.size();
+        pImpl->forEachRecord([&](const ManifestRecord& rec) {
+            for (const auto& chunk : rec.chunks) {
+                switch (chunk.codec) {
+                case ChunkCodec::Raw: ++stats.raw_chunks; break;
+                case ChunkCodec::ZstdDictionary: ++stats.dictionary_chunks; break;
+                default: ++stats.zstd_chunks; break;
+                }
+                stats.original_bytes += chunk.original_size;
+                stats.stored_bytes += chunk.compressed_size;
+            }
+            });
+        return stats;
+    }
+
+    CipherSuite CloudStorage::cipherSuite() const {
+        return pImpl->cipher;
+    }
+
+    std::expected<CompactionStats, CloudError> CloudStorage::compact() {
+        // Read-ahead tasks hold the old offsets; cancel or finish them before the file moves.
+        pImpl->dropPrefetches();
+
+        CompactionStats stats;
+        std::error_code size_error;
+        stats.bytes_before = std::filesystem::file_size(pImpl->containerPath, size_error);
+        if (size_error) return std::unexpected(CloudError::IOError);
+
+        std::ifstream in(pImpl->containerPath, std::ios::binary);
+        if (!in) return std::unexpected(CloudError::IOError);
+        ContainerHeader header{};
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return std::unexpected(CloudError::IOError);
+
+        // A leftover from an interrupted compaction is never referenced; start over.
+        std::filesystem::path compacted_path = pImpl->containerPath;
+        compacted_path += ".compact";
+        std::filesystem::remove(compacted_path, size_error);
+
+        std::ofstream out(compacted_path, std::ios::binary | std::ios::trunc);
+        if (!out) return std::unexpected(CloudError::IOError);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<std::byte> scratch;
+        auto copyChunk = [&](onecloud::DataChunk& chunk) -> bool {
+            scratch.resize(chunk.compressed_size);
+            in.seekg(chunk.offset_in_container);
+            if (!in.read(reinterpret_cast<char*>(scratch.data()), scratch.size())) return false;
+            chunk.offset_in_container = static_cast<uint64_t>(out.tellp());
+            ++stats.chunks_copied;
+            return static_cast<bool>(out.write(reinterpret_cast<const char*>(scratch.data()), scratch.size()));
+            };
+
+        // Chunks are already encrypted and encoded, so they are copied byte for byte.
+        std::vector<onecloud::FileEntry> entries;
+        bool copied = true;
+        pImpl->forEachRecordFrom({}, [&](const ManifestRecord& rec) {
+            onecloud::FileEntry entry{};
+            entry.path.assign(rec.path);
+            entry.original_size = rec.original_size;
+            entry.creation_time = rec.creation_time;
+            entry.last_write_time = rec.last_write_time;
+            entry.chunks.assign(rec.chunks.begin(), rec.chunks.end());
+            for (auto& chunk : entry.chunks) {
+                if (!copyChunk(chunk)) {
+                    copied = false;
+                    return false;
+                }
+            }
+            entries.push_back(std::move(entry));
+            return true;
+            });
+        std::vector<CompressionDictionary> dictionaries = pImpl->dictionaries;
+        for (auto& dictionary : dictionaries) {
+            if (copied && !copyChunk(dictionary.location)) copied = false;
+        }
+        if (!copied) return std::unexpected(CloudError::IOError);
+
+        std::vector<ManifestRecord> records;
+        records.reserve(entries.size());
+        for (const auto& entry : entries) records.push_back(Impl::toRecord(entry));
+
+        std::vector<std::byte> manifest_buffer;
+        auto sealed = pImpl->sealManifest(records, dictionaries, manifest_buffer);
+        if (!sealed) return std::unexpected(sealed.error());
+
+        header.format_version = OCV_FORMAT_VERSION;
+        header.manifest_offset = static_cast<uint64_t>(out.tellp());
+        header.manifest_length = sealed->size();
+        out.write(reinterpret_cast<const char*>(sealed->data()), sealed->size());
+        // Data and manifest reach the disk before the header that points at them, and the whole file
+        // before the rename that makes it the container; the directory sync then makes the rename stick.
+        out.flush();
+        if (!out || !syncFile(compacted_path)) return std::unexpected(CloudError::IOError);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        in.close();
+        if (out.fail() || !syncFile(compacted_path)) return std::unexpected(CloudError::IOError);
+
+        std::filesystem::rename(compacted_path, pImpl->containerPath, size_error);
+        if (size_error) return std::unexpected(CloudError::IOError);
+        // The rename has happened, so the state below must follow it even if the directory sync fails.
+        const bool durable = syncDirectory(pImpl->containerPath.parent_path());
+
+        auto view = ManifestView::open(manifest_buffer);
+        if (!view) return std::unexpected(CloudError::InvalidContainerFormat);
+        pImpl->manifestBuffer = std::move(manifest_buffer);
+        pImpl->manifestView = *view;
+        pImpl->pendingEntries.clear();
+        pImpl->deletedPaths.clear();
+        pImpl->dictionaries = std::move(dictionaries);
+        pImpl->chunkCache.clear();
+        pImpl->lastReadPath.clear();
+        pImpl->lastReadEnd = 0;
+
+        if (!durable) return std::unexpected(CloudError::IOError);
+        stats.bytes_after = std::filesystem::file_size(pImpl->containerPath, size_error);
+        return stats;
+    }
+
+    void CloudStorage::beginBatch() {
+        pImpl->batching = true;
+    }
+
+    std::expected<void, CloudError> CloudStorage::endBatch() {
+        pImpl->batching = false;
         return pImpl->saveManifest();
     }
 
-    std::expected<std::vector<std::string>, CloudError> CloudStorage::listFiles() {
-        std::vector<std::string> file_list;
-        file_list.reserve(pImpl->manifestCache.size());
-        for (const auto& pair : pImpl->manifestCache) {
-            file_list.push_back(pair.first);
+    void CloudStorage::setChunkSize(size_t bytes) {
+        pImpl->chunkSize = std::clamp(bytes, MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+    }
+
+    size_t CloudStorage::chunkSize() const {
+        return pImpl->chunkSize;
+    }
+
+    CloudStorage::StreamWriter CloudStorage::beginWrite(const std::string& virtual_path) {
+        return StreamWriter(*this, virtual_path);
+    }
+
+    // --- StreamWriter Implementation ---
+
+    CloudStorage::StreamWriter::StreamWriter(CloudStorage& storage, const std::string& virtual_path) : storage_(&storage) {
+        entry_.path = virtual_path;
+        entry_.creation_time = std::chrono::system_clock::now().time_since_epoch().count();
+        entry_.last_write_time = entry_.creation_time;
+    }
+
+    std::expected<void, CloudError> CloudStorage::StreamWriter::write(std::span<const std::byte> data) {
+        if (committed_) return std::unexpected(CloudError::IOError);
+        while (!data.empty()) {
+            const size_t chunk_size = storage_->pImpl->chunkSize;
+            size_t take = std::min(chunk_size - std::min(pending_.size(), chunk_size), data.size());
+            pending_.insert(pending_.end(), data.begin(), data.begin() + take);
+            data = data.subspan(take);
+            if (pending_.size() >= chunk_size) {
+                auto flushResult = flushPending();
+                if (!flushResult) return flushResult;
+            }
         }
-        return file_list;
+        return {};
+    }
+
+    std::expected<void, CloudError> CloudStorage::StreamWriter::flushPending() {
+        if (pending_.empty()) return {};
+        std::fstream file(storage_->pImpl->containerPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+        if (!file) return std::unexpected(CloudError::IOError);
+        auto encodeResult = storage_->pImpl->encodeChunk(file, pending_, entry_);
+        if (!encodeResult) return encodeResult;
+        pending_.clear();
+        return {};
+    }
+
+    std::expected<void, CloudError> CloudStorage::StreamWriter::commit() {
+        if (committed_) return std::unexpected(CloudError::IOError);
+        auto flushResult = flushPending();
+        if (!flushResult) return flushResult;
+        committed_ = true;
+        entry_.last_write_time = std::chrono::system_clock::now().time_since_epoch().count();
+        storage_->pImpl->stageEntry(std::move(entry_));
+        return storage_->pImpl->commitChanges();
     }
 
 } // namespace onecloud
@@ -5,6 +5,7 @@ Copyright © 2025 Cadell Richard Anderson
 #pragma once
 
 #include "CloudError.h" // CORRECTED: Include the new, centralized error header
+#include "types.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -12,16 +13,63 @@ Copyright © 2025 Cadell Richard Anderson
 #include <span>
 #include <expected>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
 
 // NOTE: The local 'enum class CloudError' has been removed from this file.
 
 namespace onecloud {
 
+    // Lightweight per-file metadata, without the chunk list.
+    struct FileInfo {
+        uint64_t size = 0;
+        int64_t creation_time = 0;
+        int64_t last_write_time = 0;
+    };
+
+    // Counters for the decoded chunk cache.
+    struct ChunkCacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t prefetched = 0;   // chunks decoded ahead of time by sequential read-ahead
+        size_t cached_chunks = 0;
+        size_t cached_bytes = 0;
+        size_t budget_bytes = 0;
+    };
+
+    // How the container's chunks are stored, summed from the manifest.
+    struct CompressionStats {
+        int level = 0;                 // ZSTD level used for new chunks
+        size_t dictionaries = 0;       // trained dictionaries stored in the container
+        uint64_t zstd_chunks = 0;
+        uint64_t dictionary_chunks = 0;
+        uint64_t raw_chunks = 0;       // chunks stored uncompressed because they would not shrink
+        uint64_t original_bytes = 0;
+        uint64_t stored_bytes = 0;     // encrypted bytes on disk, excluding manifests
+    };
+
+    // What compact() reclaimed.
+    struct CompactionStats {
+        uint64_t bytes_before = 0;
+        uint64_t bytes_after = 0;
+        uint64_t chunks_copied = 0;
+    };
+
     // This is the real C++ class that performs all the work.
     class CloudStorage {
     public:
+        class StreamWriter;
+
+        // Receives each decompressed chunk of a file in order. Return false to abort the read.
+        using ChunkSink = std::function<bool(std::span<const std::byte>)>;
+        // Receives matching files in path order. Return false to stop the listing.
+        using FileVisitor = std::function<bool(std::string_view path, const FileInfo& info)>;
+
         // --- Static factory functions ---
+        // New containers use CryptoProvider::preferred_suite(); the choice is stored in the header.
         static std::expected<CloudStorage, onecloud::CloudError> create(const std::filesystem::path& path, const std::string& password);
+        static std::expected<CloudStorage, onecloud::CloudError> create(const std::filesystem::path& path, const std::string& password, onecloud::CipherSuite cipher);
         static std::expected<CloudStorage, onecloud::CloudError> open(const std::filesystem::path& path, const std::string& password);
 
         // --- Rule of 5 for PIMPL ---
@@ -31,17 +79,95 @@ namespace onecloud {
 
         // --- Public methods that will be called by the C API ---
         std::expected<std::vector<std::byte>, onecloud::CloudError> readFile(const std::string& virtual_path);
+        std::expected<uint64_t, onecloud::CloudError> fileSize(const std::string& virtual_path) const;
+        // Decompresses straight into 'dest', which must be at least fileSize() bytes. Returns bytes written.
+        std::expected<size_t, onecloud::CloudError> readFileInto(const std::string& virtual_path, std::span<std::byte> dest);
+        // Streams the file chunk by chunk; peak memory is one chunk regardless of file size.
+        std::expected<void, onecloud::CloudError> readFileChunked(const std::string& virtual_path, const ChunkSink& sink);
         std::expected<void, onecloud::CloudError> writeFile(const std::string& virtual_path, std::span<const std::byte> data);
         std::expected<void, onecloud::CloudError> deleteFile(const std::string& virtual_path);
         std::expected<std::vector<std::string>, onecloud::CloudError> listFiles();
 
+        // --- Listing ---
+        // The manifest is kept sorted by path, so these only touch the entries they return
+        // (plus one binary search), rather than the whole container.
+        std::expected<void, onecloud::CloudError> forEachFile(const ListOptions& options, const FileVisitor& visitor) const;
+        std::expected<std::vector<std::string>, onecloud::CloudError> listFiles(const ListOptions& options) const;
+        // Immediate children of 'directory' ("" for the root); subdirectories are skipped in one step each.
+        std::expected<std::vector<DirEntry>, onecloud::CloudError> listDirectory(std::string_view directory, std::string_view start_after = {}, size_t limit = 0) const;
+        bool isDirectory(std::string_view path) const;
+
+        std::expected<FileInfo, onecloud::CloudError> fileInfo(const std::string& virtual_path) const;
+        // Reads up to dest.size() bytes starting at 'offset', decoding only the chunks that overlap the range.
+        // Returns the number of bytes read (0 at or past end of file).
+        std::expected<size_t, onecloud::CloudError> readFileRange(const std::string& virtual_path, uint64_t offset, std::span<std::byte> dest);
+        // Starts an incremental write. Data is encoded one chunk at a time as it arrives and the file only
+        // becomes visible (replacing any previous version) when the writer is committed.
+        StreamWriter beginWrite(const std::string& virtual_path);
+
+        // Decompressed chunks are kept in a byte-bounded LRU (64 MB by default). Sequential ranged
+        // reads additionally decode the next chunks in the background.
+        void setChunkCacheBudget(size_t bytes);
+        ChunkCacheStats chunkCacheStats() const;
+
+        // --- Compression ---
+        // Each chunk is sampled first: high-entropy data is stored raw, small chunks use the trained
+        // dictionary if there is one, everything else is ZSTD at the container's level.
+        // The level is saved with the container and applies to chunks written afterwards; 0 restores the default.
+        std::expected<void, onecloud::CloudError> setCompressionLevel(int level);
+        // Trains a dictionary from the container's small files and uses it for later small writes.
+        // Returns the dictionary ID. Existing chunks keep the encoding they were written with.
+        std::expected<uint32_t, onecloud::CloudError> trainDictionary(size_t max_dictionary_bytes = 112 * 1024);
+        CompressionStats compressionStats() const;
+        // The AEAD suite every chunk and manifest in this container is sealed with.
+        onecloud::CipherSuite cipherSuite() const;
+
+        // --- Maintenance ---
+        // The container is append-only: replaced and deleted files, and every superseded manifest, stay
+        // on disk. compact() copies the live chunks (still encrypted) into a fresh file next to the
+        // container and renames it over the original, so a crash at any point leaves one intact container.
+        std::expected<CompactionStats, onecloud::CloudError> compact();
+        // Chunk size for files written from now on (4 MB by default, clamped to 64 KB..64 MB). Not stored
+        // in the container; every chunk records its own size.
+        void setChunkSize(size_t bytes);
+        // Between beginBatch() and endBatch() writes and deletes are visible to this instance but the manifest
+        // is only saved once, at the end. Importing many small files then costs one manifest write instead
+        // of one per file; a crash before endBatch() loses the whole batch and nothing else.
+        void beginBatch();
+        std::expected<void, onecloud::CloudError> endBatch();
+        size_t chunkSize() const;
+
     private:
         // --- Private constructor ---
         CloudStorage();
 
+        friend class StreamWriter;
+
         // --- Pointer to implementation (PIMPL) ---
         class Impl;
         std::unique_ptr<Impl> pImpl;
     };
 
+    // Buffers appended data into container-sized chunks and writes each full chunk immediately,
+    // so memory use stays at one chunk no matter how large the file grows.
+    class CloudStorage::StreamWriter {
+    public:
+        std::expected<void, onecloud::CloudError> write(std::span<const std::byte> data);
+        // Flushes the final partial chunk and publishes the file in the manifest.
+        std::expected<void, onecloud::CloudError> commit();
+        uint64_t size() const { return entry_.original_size + pending_.size(); }
+        const std::string& path() const { return entry_.path; }
+
+    private:
+        friend class CloudStorage;
+        StreamWriter(CloudStorage& storage, const std::string& virtual_path);
+
+        std::expected<void, onecloud::CloudError> flushPending();
+
+        CloudStorage* storage_;
+        onecloud::FileEntry entry_;
+        std::vector<std::byte> pending_;
+        bool committed_ = false;
+    };
+
 } // namespace onecloud
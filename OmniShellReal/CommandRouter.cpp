@@ -44,8 +44,10 @@ Copyright © 2025 Cadell Richard Anderson
 // =================================================================
 // 3. Project Headers
 // =================================================================
+#include "BinaryDiff.h"
 #include "BinaryManip.h"
 #include "CommandRouter.h"
+#include "ControlFlowGraph.h"
 #include "DaemonMonitor.h"
 #include "DiagnosticsModule.h"
 #include "JobManager.h"
@@ -53,6 +55,10 @@ Copyright © 2025 Cadell Richard Anderson
 #include "OmniConfig.h"
 #include "OmniEditorIDE.h"
 #include "PMU.h"
+#include "ScanCache.h"
+#include "Trace.h"
+#include "Profiler.h"
+#include "TimeSeriesStore.h"
 #include "ScriptRunner.h"
 #include "SensorManager.h"
 #include "ShellExecutor.h"
@@ -67,6 +73,8 @@ Copyright © 2025 Cadell Richard Anderson
 #include "source_network_pcap.h"
 #include "web_fetcher.h"
 #include "CloudAPI.h"
+#include "CloudMount.h"
+#include "CloudBenchmark.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -97,6 +105,7 @@ std::map<std::string, CommandMeta> g_command_metadata = {
     { "<command> &", { "Job Control", "<command> &", "Runs a command in the background", true, true, true } },
     { "jobs",        { "Job Control", "jobs", "Lists all background jobs", true, true, true } },
     { "fg",          { "Job Control", "fg <job_id>", "Brings a background job to the foreground", true, true, true } },
+    { "cancel",      { "Job Control", "cancel <job_id>", "Cancels a background job that has not started yet", true, true, true } },
 
     // Shell Integration
 #if defined(_WIN32)
@@ -119,7 +128,8 @@ std::map<std::string, CommandMeta> g_command_metadata = {
     { "omni:sensor_list",{ "Diagnostics & Repair", "omni:sensor_list", "Displays a list of available hardware sensors", true, true, true } },
     { "omni:diagnose",   { "Diagnostics & Repair", "omni:diagnose...", "Runs diagnostic tools", true, true, true } },
     { "registry",        { "Diagnostics & Repair", "registry <key> <term>", "(Windows) Scans the registry", true, true, true } },
-    { "entropy",         { "Diagnostics & Repair", "entropy <path> [quarantine_dir][report_dir]", "Scans file/dir entropy and quarantines high-entropy files", true, true, true } },
+    { "entropy",         { "Diagnostics & Repair", "entropy <path> [quarantine_dir][report_dir] [--min-size N] [--max-size N] [--ext .exe,.dll] [--sample N] [--no-cache]", "Scans file/dir entropy and quarantines high-entropy files", true, true, true } },
+    { "omni:scancache",  { "Diagnostics & Repair", "omni:scancache [stats | save | clear]", "Shows or resets the cache that lets repeated entropy scans and binary probes skip unchanged files", true, true, true } },
     { "processes",       { "Diagnostics & Repair", "processes", "Lists running processes", true, true, true } },
     { "omni:kill",       { "Diagnostics & Repair", "omni:kill <pid>", "Terminates a process by its PID", true, true, true } },
     { "omni:sensor_dump",     { "Diagnostics & Repair", "omni:sensor_dump", "Outputs detailed sensor readings for all sensors", true, false, false } },
@@ -133,8 +143,9 @@ std::map<std::string, CommandMeta> g_command_metadata = {
     { "omni:binary sections",   { "Binary Analysis", "omni:binary sections <file>", "List all sections in a PE or ELF binary.", true, true, true } },
     { "omni:binary symbols",    { "Binary Analysis", "omni:binary symbols <file>", "List all exported symbols in a binary.", true, true, true } },
     { "omni:binary attach",     { "Binary Analysis", "omni:binary attach <pid>", "Attach to a running process for instrumentation.", true, true, true } },
-    { "omni:binary diff",       { "Binary Analysis", "omni:binary diff <file1> <file2>", "Find the first difference between two binary files.", true, true, true } },
+    { "omni:binary diff",       { "Binary Analysis", "omni:binary diff <file1> <file2> [--first] [--sections] [--functions] [--gap N]", "List every differing byte range; optionally compare sections and functions.", true, true, true } },
     { "omni:binary ai-analyze", { "Binary Analysis", "omni:binary ai-analyze <file>", "Run AI-powered analysis on a binary for threats.", true, true, true } },
+    { "omni:binary cfg",        { "Binary Analysis", "omni:binary cfg <file> [--dot|--json] [--out <file>]", "Recover functions, basic blocks and edges; export as DOT or JSON.", true, true, true } },
 
     // AI Daemon Control
     { "omni:task_daemon",{ "AI Daemon Control", "omni:task_daemon...", "Controls the AI maintenance daemon", true, true, true } },
@@ -160,6 +171,11 @@ std::map<std::string, CommandMeta> g_command_metadata = {
     { "omni:pmu_summary",{ "PMU", "omni:pmu_summary <csv>", "Summarize PMU CSV by thread CPU", true, true, true } },
     { "omni:pmu_analyze", { "PMU", "omni:pmu_analyze <data>", "Analyze PMU data for performance metrics", true, false, false } },
     { "omni:pmu_monitor", { "PMU", "omni:pmu_monitor", "Continuously monitor PMU counters", true, false, false } },
+    { "omni:pmu_bench",   { "PMU", "omni:pmu_bench [threads] [samples]", "Measures the cost of one PMU sample with N idle threads", true, true, true } },
+    { "omni:trace",       { "PMU", "omni:trace <start [events_per_thread]|stop|dump <out.json>|status>", "Scoped hot-path tracing; dump writes Chrome trace JSON (chrome://tracing, Perfetto)", true, true, true } },
+    { "omni:metrics",     { "PMU", "omni:metrics [list | show <metric> [seconds] | stats [seconds] [prefix] | spill <dir> [max_mb] [max_hours]]", "Query the compressed metric history kept by the daemon and PMU monitor; spilled history is kept up to max_mb (default 256) and max_hours (default 168), 0 = no limit", true, true, true } },
+    { "omni:profile",     { "PMU", "omni:profile <start [hz]|stop|dump <out.folded>|top [n]|status>", "In-process sampling profiler; dump writes folded stacks for flamegraphs", false, true, false } },
+    { "omni:pmu_counters", { "PMU", "omni:pmu_counters [on|off]", "Enable per-thread cycles/instructions/cache/branch counters (perf_event_open)", false, true, false } },
 
     // AI (Local LLM)
     { "omni:llm:load",   { "AI (Local LLM)", "omni:llm:load <model_path>", "Load a local.cllf model", true, true, true } },
@@ -208,13 +224,17 @@ std::map<std::string, CommandMeta> g_command_metadata = {
     // BEGIN ADDITION: Cloud Storage Command Metadata
     // =================================================================
     { "omni:cloud:create",   { "Cloud Storage", "omni:cloud:create <path> <pass>", "Creates a new, empty cloud container", true, false, false } },
-    { "omni:cloud:list",     { "Cloud Storage", "omni:cloud:list <path> <pass>", "Lists files within a container", true, false, false } },
+    { "omni:cloud:list",     { "Cloud Storage", "omni:cloud:list <path> <pass> [dir|glob]", "Lists a container directory or files matching a glob", true, false, false } },
     { "omni:cloud:upload",   { "Cloud Storage", "omni:cloud:upload <path> <pass> <local> [virtual]", "Uploads a local file to a container", true, false, false } },
     { "omni:cloud:download", { "Cloud Storage", "omni:cloud:download <path> <pass> <virtual> <local>", "Downloads a virtual file from a container", true, false, false } },
     { "omni:cloud:delete",   { "Cloud Storage", "omni:cloud:delete <path> <pass> <virtual>", "Deletes a virtual file from a container", true, false, false } },
-    { "omni:cloud:mount",    { "Cloud Storage", "omni:cloud:mount <path> <mount_point>", "Mounts a container as a virtual drive (Windows)", true, false, false } },
-    { "omni:cloud:unmount",  { "Cloud Storage", "omni:cloud:unmount <mount_point>", "Unmounts a virtual drive (Windows)", true, false, false } },
-    { "omni:cloud:status",   { "Cloud Storage", "omni:cloud:status", "Shows status of mounted containers", true, false, false } }
+    { "omni:cloud:mount",    { "Cloud Storage", "omni:cloud:mount <path> <pass> <mount_point>", "Mounts a container as a directory tree (Linux, FUSE)", false, true, false } },
+    { "omni:cloud:unmount",  { "Cloud Storage", "omni:cloud:unmount <mount_point>", "Unmounts a mounted container (Linux, FUSE)", false, true, false } },
+    { "omni:cloud:status",   { "Cloud Storage", "omni:cloud:status", "Shows status of mounted containers", true, true, false } },
+    { "omni:cloud:compression", { "Cloud Storage", "omni:cloud:compression <path> <pass> [level <n>] [train]", "Shows or tunes a container's compression (level, trained dictionary)", true, true, false } },
+    { "omni:cloud:compact",  { "Cloud Storage", "omni:cloud:compact <path> <pass>", "Rewrites a container without deleted files and superseded versions", true, true, false } },
+    { "omni:cloud:bench",    { "Cloud Storage", "omni:cloud:bench <work_dir> [quick] [mb <n>] [threads <n,..>] [chunks <kb,..>]", "Measures container write/read/compaction throughput, open latency and KDF cost", true, true, false } },
+    { "omni:cloud:faultcheck", { "Cloud Storage", "omni:cloud:faultcheck <work_dir> [iterations] [seed]", "Truncates container writes at random points and verifies the container still opens intact", true, true, false } }
     // =================================================================
     // END ADDITION
     // =================================================================
@@ -241,6 +261,8 @@ namespace {
     // UPDATED: This now uses the correct type for the IPC shared-memory writer.
     static std::map<std::string, std::unique_ptr<ironrouter::ipc::PacketWriter>> g_ring_writers;
     static std::unique_ptr<ironrouter::LiveCapture> g_live_capture;
+    // Active container mounts keyed by mount point
+    static std::map<std::string, std::unique_ptr<onecloud::CloudMount>> g_cloud_mounts;
 
     // Helper to parse script arguments and options
     static void parseScriptOptions(const Args& args, size_t startIndex, std::string& pathOrCode, bool& isFile, std::vector<std::string>& scriptArgs, ScriptOptions& opt) {
@@ -508,6 +530,8 @@ namespace {
         case onecloud::CloudError::IOError: return "A disk input/output error occurred.";
         case onecloud::CloudError::OutOfMemory: return "Out of memory.";
         case onecloud::CloudError::EncryptionFailed: return "An encryption or decryption error occurred."; // Was EncryptionError
+        case onecloud::CloudError::BufferTooSmall: return "The destination buffer is too small.";
+        case onecloud::CloudError::CompressionFailed: return "Compression failed.";
         case onecloud::CloudError::Unknown: return "An unknown error occurred.";
         default: return "An unrecognized error code was returned.";
         }
@@ -527,7 +551,7 @@ namespace {
 
     std::string Cmd_CloudList(const Args& args) {
         if (args.size() < 3) {
-            return "Usage: omni:cloud:list <container_path> <password>";
+            return "Usage: omni:cloud:list <container_path> <password> [directory | glob]";
         }
         auto open_result = onecloud::CloudAPI::open(args[1], args[2]);
         if (!open_result) {
@@ -535,8 +559,27 @@ namespace {
         }
 
         auto& storage = *open_result;
- 
-        auto list_result = storage.list_files();
+
+        // A pattern argument searches the whole tree; a plain path lists one directory level.
+        const std::string target = args.size() > 3 ? args[3] : "";
+        if (target.find_first_of("*?[") != std::string::npos) {
+            onecloud::ListOptions options;
+            options.glob = target;
+            auto find_result = storage.find_files(options);
+            if (!find_result) {
+                return "Error: " + errorToString(find_result.error());
+            }
+            if (find_result->empty()) {
+                return "No files match '" + target + "'.";
+            }
+            std::string output = "Files matching '" + target + "':\n";
+            for (const auto& file : *find_result) {
+                output += "- " + file + "\n";
+            }
+            return output;
+        }
+
+        auto list_result = storage.list_directory(target);
         if (!list_result) {
             return "Error: " + errorToString(list_result.error());
         }
@@ -545,9 +588,14 @@ namespace {
             return "Container is empty.";
         }
 
-        std::string output = "Files in container '" + args[1] + "':\n";
-        for (const auto& file : *list_result) {
-            output += "- " + file + "\n";
+        std::string output = "Files in container '" + args[1] + "'" + (target.empty() ? "" : " under '" + target + "'") + ":\n";
+        for (const auto& entry : *list_result) {
+            if (entry.is_directory) {
+                output += "- " + entry.name + "/\n";
+            }
+            else {
+                output += "- " + entry.name + " (" + std::to_string(entry.size) + " bytes)\n";
+            }
         }
         return output;
     }
@@ -601,16 +649,43 @@ namespace {
         }
 
         auto& storage = *open_result;
-        auto read_result = storage.read_file(virtual_path);
-        if (!read_result) {
-            return "Error: " + errorToString(read_result.error());
+        auto size_result = storage.file_size(virtual_path);
+        if (!size_result) {
+            return "Error: " + errorToString(size_result.error());
+        }
+
+        // Streamed into a side file that replaces 'local_path' only once complete, so a failure part way
+        // (bad chunk, wrong password, full disk) never leaves a truncated file in place of the old one.
+        const std::filesystem::path part_path = local_path + ".part";
+        std::ofstream local_file(part_path, std::ios::binary | std::ios::trunc);
+        if (!local_file) {
+            return "Error: Cannot open destination file '" + part_path.string() + "' for writing.";
         }
+        auto discard = [&](const std::string& message) {
+            local_file.close();
+            std::error_code ec;
+            std::filesystem::remove(part_path, ec);
+            return message;
+        };
 
-        std::ofstream local_file(local_path, std::ios::binary | std::ios::trunc);
+        // Stream chunks straight to disk so the whole file is never buffered in memory.
+        auto read_result = storage.read_file_chunked(virtual_path, [&](std::span<const std::byte> chunk) {
+            local_file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+            return static_cast<bool>(local_file);
+            });
+        if (!read_result) {
+            return discard("Error: " + errorToString(read_result.error()));
+        }
+        local_file.flush();
+        local_file.close();
         if (!local_file) {
-            return "Error: Cannot open destination file '" + local_path + "' for writing.";
+            return discard("Error: Failed writing '" + part_path.string() + "'.");
+        }
+        std::error_code rename_error;
+        std::filesystem::rename(part_path, local_path, rename_error);
+        if (rename_error) {
+            return discard("Error: Cannot move '" + part_path.string() + "' to '" + local_path + "': " + rename_error.message());
         }
-        local_file.write(reinterpret_cast<const char*>(read_result->data()), read_result->size());
         return "Successfully downloaded '" + virtual_path + "' to '" + local_path + "'.";
     }
 
@@ -638,22 +713,195 @@ namespace {
     }
 
     std::string Cmd_CloudMount(const Args& args) {
-        if (args.size() < 3) {
-            return "Usage: omni:cloud:mount <container_path> <mount_point_path>";
+        if (args.size() < 4) {
+            return "Usage: omni:cloud:mount <container_path> <password> <mount_point_path>";
+        }
+        if (!onecloud::CloudMount::supported()) {
+            return "[INFO] This build has no FUSE support; rebuild on Linux with the libfuse3 headers installed and link with `pkg-config --libs fuse3`.";
         }
-        return "[INFO] Filesystem mounting via the Windows Cloud Filter API is a complex, platform-specific operation.\n"
-            "[INFO] This command is a placeholder for the logic detailed in the architecture report.";
+        const std::string mount_point = std::filesystem::absolute(args[3]).string();
+        if (g_cloud_mounts.count(mount_point)) {
+            return "Error: '" + mount_point + "' is already mounted.";
+        }
+
+        auto mount_result = onecloud::CloudMount::mount(args[1], args[2], mount_point);
+        if (!mount_result) {
+            return "Error: " + errorToString(mount_result.error());
+        }
+        g_cloud_mounts[mount_point] = std::move(*mount_result);
+        return "Mounted '" + args[1] + "' at '" + mount_point + "'.";
     }
 
     std::string Cmd_CloudUnmount(const Args& args) {
         if (args.size() < 2) {
             return "Usage: omni:cloud:unmount <mount_point_path>";
         }
-        return "[INFO] Filesystem unmounting is not yet implemented.";
+        const std::string mount_point = std::filesystem::absolute(args[1]).string();
+        auto it = g_cloud_mounts.find(mount_point);
+        if (it == g_cloud_mounts.end()) {
+            return "Error: Nothing is mounted at '" + mount_point + "'.";
+        }
+        it->second->unmount();
+        g_cloud_mounts.erase(it);
+        return "Unmounted '" + mount_point + "'.";
+    }
+
+    std::string Cmd_CloudCompression(const Args& args) {
+        if (args.size() < 3) {
+            return "Usage: omni:cloud:compression <container_path> <password> [level <n>] [train]";
+        }
+        auto open_result = onecloud::CloudAPI::open(args[1], args[2]);
+        if (!open_result) {
+            return "Error: " + errorToString(open_result.error());
+        }
+
+        auto& storage = *open_result;
+        std::string output;
+        for (size_t i = 3; i < args.size(); ++i) {
+            if (args[i] == "level" && i + 1 < args.size()) {
+                int level = 0;
+                try {
+                    level = std::stoi(args[++i]);
+                }
+                catch (const std::exception&) {
+                    return "Error: Invalid compression level '" + args[i] + "'.";
+                }
+                auto result = storage.set_compression_level(level);
+                if (!result) {
+                    return "Error: " + errorToString(result.error());
+                }
+                output += "Compression level set.\n";
+            }
+            else if (args[i] == "train") {
+                auto result = storage.train_dictionary();
+                if (!result) {
+                    return "Error: " + errorToString(result.error());
+                }
+                output += "Trained dictionary " + std::to_string(*result) + " from the container's small files.\n";
+            }
+            else {
+                return "Error: Unknown option '" + args[i] + "'.";
+            }
+        }
+
+        auto stats = storage.compression_stats();
+        if (!stats) {
+            return "Error: " + errorToString(stats.error());
+        }
+        const double ratio = stats->stored_bytes ? static_cast<double>(stats->original_bytes) / stats->stored_bytes : 0.0;
+        std::ostringstream os;
+        os << "Level: " << stats->level << ", dictionaries: " << stats->dictionaries << "\n"
+            << "Chunks: " << stats->zstd_chunks << " zstd, " << stats->dictionary_chunks << " zstd+dictionary, "
+            << stats->raw_chunks << " raw (incompressible)\n"
+            << "Bytes: " << stats->original_bytes << " original, " << stats->stored_bytes << " stored"
+            << " (ratio " << std::fixed << std::setprecision(2) << ratio << ")\n";
+        return output + os.str();
+    }
+
+    std::string Cmd_CloudCompact(const Args& args) {
+        if (args.size() < 3) {
+            return "Usage: omni:cloud:compact <container_path> <password>";
+        }
+        auto open_result = onecloud::CloudAPI::open(args[1], args[2]);
+        if (!open_result) {
+            return "Error: " + errorToString(open_result.error());
+        }
+        auto result = open_result->compact();
+        if (!result) {
+            return "Error: " + errorToString(result.error());
+        }
+        return "Compacted: " + std::to_string(result->bytes_before) + " -> " + std::to_string(result->bytes_after)
+            + " bytes (" + std::to_string(result->chunks_copied) + " chunks kept).";
+    }
+
+    // Parses "a,b,c" into numbers, each multiplied by 'scale'. Returns false on a malformed list.
+    template<typename T>
+    bool parseNumberList(const std::string& text, T scale, std::vector<T>& out) {
+        out.clear();
+        std::stringstream ss(text);
+        std::string item;
+        try {
+            while (std::getline(ss, item, ',')) {
+                out.push_back(static_cast<T>(std::stoull(item)) * scale);
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        return !out.empty();
+    }
+
+    std::string Cmd_CloudBench(const Args& args) {
+        if (args.size() < 2) {
+            return "Usage: omni:cloud:bench <work_dir> [quick] [mb <per-thread MB>] [threads <n,..>] [chunks <KB,..>]";
+        }
+        onecloud::BenchmarkOptions options;
+        options.work_dir = args[1];
+        for (size_t i = 2; i < args.size(); ++i) {
+            if (args[i] == "quick") {
+                options.chunk_sizes = { 1024 * 1024, 4 * 1024 * 1024 };
+                options.thread_counts = { 1, 2 };
+                options.bytes_per_thread = 8ull * 1024 * 1024;
+                options.file_counts = { 100, 1000 };
+            }
+            else if (args[i] == "mb" && i + 1 < args.size()) {
+                std::vector<uint64_t> mb;
+                if (!parseNumberList<uint64_t>(args[++i], 1024 * 1024, mb)) return "Error: Invalid size '" + args[i] + "'.";
+                options.bytes_per_thread = mb.front();
+            }
+            else if (args[i] == "threads" && i + 1 < args.size()) {
+                if (!parseNumberList<unsigned>(args[++i], 1, options.thread_counts)) return "Error: Invalid thread list '" + args[i] + "'.";
+            }
+            else if (args[i] == "chunks" && i + 1 < args.size()) {
+                if (!parseNumberList<size_t>(args[++i], 1024, options.chunk_sizes)) return "Error: Invalid chunk list '" + args[i] + "'.";
+            }
+            else {
+                return "Error: Unknown option '" + args[i] + "'.";
+            }
+        }
+
+        auto samples = onecloud::CloudBenchmark::run(options);
+        if (!samples) {
+            return "Error: " + errorToString(samples.error());
+        }
+        return onecloud::CloudBenchmark::format(*samples);
+    }
+
+    std::string Cmd_CloudFaultCheck(const Args& args) {
+        if (args.size() < 2) {
+            return "Usage: omni:cloud:faultcheck <work_dir> [iterations] [seed]";
+        }
+        onecloud::FaultInjectionOptions options;
+        options.work_dir = args[1];
+        try {
+            if (args.size() > 2) options.iterations = static_cast<unsigned>(std::stoul(args[2]));
+            if (args.size() > 3) options.seed = static_cast<uint32_t>(std::stoul(args[3]));
+        }
+        catch (const std::exception&) {
+            return "Error: Invalid iteration count or seed.";
+        }
+
+        auto report = onecloud::CloudBenchmark::faultInjection(options);
+        if (!report) {
+            return "Error: " + errorToString(report.error());
+        }
+        std::string output = std::to_string(report->iterations) + " crash images: " + std::to_string(report->recovered)
+            + " opened intact, " + std::to_string(report->failures.size()) + " failures.\n";
+        for (const auto& failure : report->failures) {
+            output += "- " + failure + "\n";
+        }
+        return output;
     }
 
     std::string Cmd_CloudStatus(const Args& args) {
-        return "[INFO] Sync status reporting is not yet implemented.";
+        if (g_cloud_mounts.empty()) {
+            return "No containers are mounted.";
+        }
+        std::string output = "Mounted containers:\n";
+        for (const auto& [mount_point, mount] : g_cloud_mounts) {
+            output += "- " + mount->status() + "\n";
+        }
+        return output;
     }
     // =================================================================
     // END ADDITION
@@ -922,7 +1170,17 @@ namespace {
     }
 
     std::string Cmd_Jobs(const Args&) {
-        return JobManager::listJobs();
+        return JobManager::listJobs() + "[pool] " + JobManager::PoolStats();
+    }
+
+    std::string Cmd_Cancel(const Args& args) {
+        if (args.size() < 2) return "Usage: cancel <job_id>";
+        try {
+            return JobManager::cancelJob(std::stoi(args[1]));
+        }
+        catch (...) {
+            return "Error: Invalid Job ID.";
+        }
     }
 
     std::string Cmd_Fg(const Args& args) {
@@ -1014,6 +1272,30 @@ namespace {
     }
 #endif
 
+    // Opens the configured scan cache on first use; a blank <ScanCacheFile> leaves it closed.
+    static void ensureScanCache() {
+        if (appConfig.scanCacheFile.empty()) return;
+        std::string error;
+        if (!ScanCache::instance().open(appConfig.scanCacheFile, &error)) {
+            std::cerr << "[ScanCache] " << error << "\n";
+        }
+    }
+
+    std::string Cmd_ScanCache(const Args& args) {
+        ensureScanCache();
+        ScanCache& cache = ScanCache::instance();
+        const std::string sub = (args.size() > 1) ? args[1] : "stats";
+        if (sub == "stats") return cache.stats();
+        if (!cache.isOpen()) return "Scan cache is disabled (set <ScanCacheFile> in OmniConfig.xml).";
+        std::string error;
+        if (sub == "save") return cache.save(&error) ? "Scan cache saved." : "Error: " + error;
+        if (sub == "clear") {
+            cache.clear();
+            return cache.save(&error) ? "Scan cache cleared." : "Error: " + error;
+        }
+        return "Usage: omni:scancache [stats | save | clear]";
+    }
+
     std::string Cmd_Diagnose(const Args& args) {
         if (args.size() < 2) {
             try {
@@ -1031,7 +1313,7 @@ namespace {
                 return ss.str();
             }
             catch (...) {
-                return "Usage: omni:diagnose <registry|entropy|processes|analyze> ...";
+                return "Usage: omni:diagnose <registry|entropy|signatures|processes|analyze> ...";
             }
         }
         std::string subcommand = args[1];
@@ -1040,10 +1322,43 @@ namespace {
             return DiagnosticsModule::ScanRegistry(args[2], { args[3] });
         }
         if (subcommand == "entropy") {
-            if (args.size() < 3) return "Usage: omni:diagnose entropy <path> [quarantine_dir] [report_dir]";
-            std::string quarantineDir = (args.size() > 3) ? args[3] : appConfig.defaultQuarantineDir;
-            std::string reportDir = (args.size() > 4) ? args[4] : appConfig.defaultReportDir;
-            return DiagnosticsModule::ScanFileEntropy(args[2], quarantineDir, reportDir, appConfig.entropyThreshold);
+            const std::string usage = "Usage: omni:diagnose entropy <path> [quarantine_dir] [report_dir] "
+                "[--min-size N] [--max-size N] [--ext .exe,.dll] [--sample N] [--no-cache]";
+            if (args.size() < 3) return usage;
+            FileScanOptions options;
+            std::vector<std::string> positional;
+            try {
+                for (size_t i = 2; i < args.size(); ++i) {
+                    const std::string& a = args[i];
+                    bool hasValue = i + 1 < args.size();
+                    if (a == "--no-cache") options.use_cache = false;
+                    else if (a == "--min-size" && hasValue) options.min_size = std::stoull(args[++i]);
+                    else if (a == "--max-size" && hasValue) options.max_size = std::stoull(args[++i]);
+                    else if (a == "--sample" && hasValue) options.sample_bytes = std::stoull(args[++i]);
+                    else if (a == "--ext" && hasValue) {
+                        std::stringstream list(args[++i]);
+                        for (std::string ext; std::getline(list, ext, ',');) {
+                            if (ext.empty()) continue;
+                            options.extensions.push_back(ext[0] == '.' ? ext : "." + ext);
+                        }
+                    }
+                    else if (a.rfind("--", 0) == 0) return usage;
+                    else positional.push_back(a);
+                }
+            }
+            catch (const std::exception&) {
+                return usage;
+            }
+            if (positional.empty()) return usage;
+            std::string quarantineDir = (positional.size() > 1) ? positional[1] : appConfig.defaultQuarantineDir;
+            std::string reportDir = (positional.size() > 2) ? positional[2] : appConfig.defaultReportDir;
+            DiagnosticsModule::LoadSignatures(appConfig.signaturePatterns);
+            if (options.use_cache) ensureScanCache();
+            return DiagnosticsModule::ScanFileEntropy(positional[0], quarantineDir, reportDir, appConfig.entropyThreshold, options);
+        }
+        if (subcommand == "signatures") {
+            DiagnosticsModule::LoadSignatures(appConfig.signaturePatterns);
+            return DiagnosticsModule::SignatureStats();
         }
         if (subcommand == "processes") {
             return DiagnosticsModule::MonitorProcesses();
@@ -1906,11 +2221,165 @@ namespace {
         auto s = PMU::SampleSelf();
         std::ostringstream out;
         out << "PID: " << s.pid << "\nUser ms: " << s.user_ms << "\nKernel ms: " << s.kernel_ms << "\n";
+        if (s.hw) {
+            out << "Cycles: " << s.hw->cycles << "\nInstructions: " << s.hw->instructions
+                << "\nIPC: " << std::fixed << std::setprecision(2) << s.hw->ipc() << std::defaultfloat
+                << "\nCache misses: " << s.hw->cache_misses << "/" << s.hw->cache_references
+                << "\nBranch misses: " << s.hw->branch_misses
+                << "\nContext switches: " << s.hw->context_switches << "\n";
+        }
         for (const auto& t : s.thread_samples) {
             out << "  TID: " << t.tid
                 << " user_ms=" << t.user_ms
-                << " kernel_ms=" << t.kernel_ms << "\n";
+                << " kernel_ms=" << t.kernel_ms;
+            if (t.hw) {
+                if (t.hw->hardware) {
+                    out << " cycles=" << t.hw->cycles << " instructions=" << t.hw->instructions
+                        << " cache_misses=" << t.hw->cache_misses << " branch_misses=" << t.hw->branch_misses;
+                }
+                out << " csw=" << t.hw->context_switches;
+            }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+    std::string Cmd_Trace(const Args& args) {
+        const std::string usage = "Usage: omni:trace <start [events_per_thread]|stop|dump <out.json>|status>";
+        const std::string action = args.size() >= 2 ? args[1] : "status";
+        if (action == "start") {
+            size_t events = 0;
+            try {
+                if (args.size() >= 3) events = static_cast<size_t>(std::stoul(args[2]));
+            }
+            catch (const std::exception&) {
+                return usage;
+            }
+            if (events > Trace::MAX_EVENTS_PER_THREAD) {
+                return "Error: at most " + std::to_string(Trace::MAX_EVENTS_PER_THREAD) + " events per thread.";
+            }
+            Trace::Start(events);
+            return "[Trace] started: " + Trace::Status();
+        }
+        if (action == "stop") {
+            Trace::Stop();
+            return "[Trace] stopped: " + Trace::Status();
+        }
+        if (action == "dump") {
+            if (args.size() < 3) return usage;
+            long long written = Trace::DumpChromeJson(args[2]);
+            if (written < 0) return "Error: cannot write " + args[2];
+            return "[Trace] " + std::to_string(written) + " events written to " + args[2];
+        }
+        if (action == "status") return "[Trace] " + Trace::Status();
+        return usage;
+    }
+
+    std::string Cmd_Profile(const Args& args) {
+        const std::string usage = "Usage: omni:profile <start [hz]|stop|dump <out.folded>|top [n]|status>";
+        const std::string action = args.size() >= 2 ? args[1] : "status";
+        try {
+            if (action == "start") {
+                Profiler::Options options;
+                if (args.size() >= 3) options.hz = static_cast<unsigned>(std::stoul(args[2]));
+                if (!Profiler::Start(options)) return "[Profile] not started: " + Profiler::Status();
+                return "[Profile] started: " + Profiler::Status();
+            }
+            if (action == "stop") {
+                Profiler::Stop();
+                return "[Profile] stopped: " + Profiler::Status();
+            }
+            if (action == "dump") {
+                if (args.size() < 3) return usage;
+                long long lines = Profiler::DumpFolded(args[2]);
+                if (lines < 0) return "Error: cannot write " + args[2];
+                return "[Profile] " + std::to_string(lines) + " folded stacks written to " + args[2];
+            }
+            if (action == "top") {
+                size_t n = (args.size() >= 3) ? static_cast<size_t>(std::stoul(args[2])) : 20;
+                return "[Profile] " + Profiler::Status() + "\n" + Profiler::TopFrames(n);
+            }
+        }
+        catch (const std::exception&) {
+            return usage;
+        }
+        if (action == "status") return "[Profile] " + Profiler::Status();
+        return usage;
+    }
+
+    std::string Cmd_Metrics(const Args& args) {
+        const std::string usage = "Usage: omni:metrics [list | show <metric> [seconds] | stats [seconds] [prefix] | spill <dir> [max_mb] [max_hours]]";
+        auto& store = TimeSeriesStore::instance();
+        const std::string action = args.size() >= 2 ? args[1] : "list";
+        try {
+            if (action == "list") {
+                std::ostringstream out;
+                out << "[Metrics] " << store.pointCount() << " points in " << store.compressedBytes() << " bytes, " << store.spillStatus() << "\n";
+                for (const auto& name : store.metrics()) out << "  " << name << "\n";
+                return out.str();
+            }
+            if (action == "show") {
+                if (args.size() < 3) return usage;
+                std::chrono::seconds window(args.size() >= 4 ? std::stoll(args[3]) : 300);
+                auto pts = store.points(args[2], window);
+                if (pts.empty()) return "[Metrics] no points for " + args[2];
+                std::ostringstream out;
+                out << std::fixed << std::setprecision(3);
+                for (const auto& p : pts) {
+                    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(p.at.time_since_epoch()).count();
+                    out << ms << "," << p.value << "\n";
+                }
+                return out.str();
+            }
+            if (action == "stats") {
+                std::chrono::seconds window(args.size() >= 3 ? std::stoll(args[2]) : 300);
+                std::string text = store.describe(window, args.size() >= 4 ? args[3] : std::string());
+                return text.empty() ? "[Metrics] no points in window" : text;
+            }
+            if (action == "spill") {
+                if (args.size() < 3) return usage;
+                SpillRetention retention;
+                if (args.size() >= 4) retention.max_bytes = std::stoull(args[3]) << 20;
+                if (args.size() >= 5) retention.max_age = std::chrono::hours(std::stoll(args[4]));
+                if (!store.enableSpill(args[2], retention)) return "Error: cannot spill to " + args[2];
+                return "[Metrics] evicted blocks now " + store.spillStatus();
+            }
+        }
+        catch (const std::exception&) {
+            return usage;
         }
+        return usage;
+    }
+
+    std::string Cmd_PmuCounters(const Args& args) {
+        if (args.size() >= 2) {
+            if (args[1] != "on" && args[1] != "off") return "Usage: omni:pmu_counters [on|off]";
+            PMU::EnableHardwareCounters(args[1] == "on");
+        }
+        return "[PMU] counters: " + PMU::HardwareCounterStatus();
+    }
+
+    std::string Cmd_PmuBench(const Args& args) {
+        size_t threads = 100;
+        size_t samples = 1000;
+        try {
+            if (args.size() >= 2) threads = static_cast<size_t>(std::stoul(args[1]));
+            if (args.size() >= 3) samples = static_cast<size_t>(std::stoul(args[2]));
+        }
+        catch (const std::exception&) {
+            return "Usage: omni:pmu_bench [threads] [samples]";
+        }
+        threads = (std::min)(threads, PMU::MAX_BENCHMARK_THREADS);
+        double us = 0.0;
+        try {
+            us = PMU::BenchmarkSampling(threads, samples);
+        }
+        catch (const std::exception& e) {
+            return std::string("[PMU] Could not start ") + std::to_string(threads) + " idle threads: " + e.what();
+        }
+        std::ostringstream out;
+        out << "[PMU] " << std::fixed << std::setprecision(2) << us << " us per sample ("
+            << threads << " idle threads, " << samples << " samples)";
         return out.str();
     }
 
@@ -1927,11 +2396,19 @@ namespace {
         auto b = loadCSV(args[2]);
         auto d = PMU::Diff(a, b);
         std::ostringstream out;
-        out << "Proc Delta: user=" << d.proc_user_ms << " kernel=" << d.proc_kernel_ms << "\n";
+        out << "Proc Delta: user=" << d.proc_user_ms << " kernel=" << d.proc_kernel_ms;
+        if (d.proc_hw && d.proc_hw->hardware) {
+            out << " ipc=" << d.proc_hw->ipc() << " cache_miss%=" << d.proc_hw->cacheMissRate() * 100.0;
+        }
+        out << "\n";
         for (const auto& td : d.thread_deltas) {
             out << "TID " << td.tid
                 << ": user_delta=" << td.user_ms
-                << " kernel_delta=" << td.kernel_ms << "\n";
+                << " kernel_delta=" << td.kernel_ms;
+            if (td.hw && td.hw->hardware) {
+                out << " ipc=" << td.hw->ipc() << " cache_miss%=" << td.hw->cacheMissRate() * 100.0;
+            }
+            out << "\n";
         }
         return out.str();
     }
@@ -1985,7 +2462,7 @@ namespace {
     // =================================================================
     std::string Cmd_Binary(const Args& args) {
         if (args.size() < 2) { // Changed to 2, as some commands need more args
-            return "Usage: omni:binary <probe|sections|symbols|attach|diff|ai-analyze> ...";
+            return "Usage: omni:binary <probe|sections|symbols|cfg|attach|diff|ai-analyze> ...";
         }
 
         std::string subcommand = args[1];
@@ -1995,7 +2472,9 @@ namespace {
         if (subcommand == "probe") {
             if (args.size() < 3) return "Usage: omni:binary probe <filepath>";
             std::string target = args[2];
+            ensureScanCache();
             auto info = BinaryManip::Probe(target);
+            if (ScanCache::instance().isOpen()) ScanCache::instance().save();
             if (!info) {
                 return "Error: Failed to probe binary '" + target + "'.";
             }
@@ -2042,6 +2521,33 @@ namespace {
                 ss << sym << "\n";
             }
         }
+        // --- Handler for "cfg" subcommand ---
+        else if (subcommand == "cfg") {
+            if (args.size() < 3) return "Usage: omni:binary cfg <filepath> [--dot|--json] [--out <file>]";
+            std::string format, outPath;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (args[i] == "--dot" || args[i] == "--json") format = args[i].substr(2);
+                else if (args[i] == "--out" && i + 1 < args.size()) outPath = args[++i];
+            }
+            std::string error;
+            auto table = BinaryTranslator::Disassemble(args[2], &error);
+            if (!table) return "Error: " + error;
+            auto cfg = ControlFlowGraph::Build(table);
+            std::string text;
+            if (format == "dot") text = cfg->toDot();
+            else if (format == "json") text = cfg->toJson();
+            else {
+                ss << "--- Control Flow Graph: " << cfg->functions().size() << " functions, " << cfg->blockCount()
+                    << " blocks, " << cfg->edgeCount() << " edges ---\n";
+                for (const auto& line : cfg->describe()) ss << line << "\n";
+                text = ss.str();
+                ss.str("");
+            }
+            if (outPath.empty()) return text;
+            std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+            if (!out || !out.write(text.data(), static_cast<std::streamsize>(text.size()))) return "Error: cannot write " + outPath;
+            ss << "Wrote " << outPath << " (" << cfg->functions().size() << " functions, " << cfg->blockCount() << " blocks).";
+        }
         // --- Handler for "attach" subcommand ---
         else if (subcommand == "attach") {
             if (args.size() < 3) return "Usage: omni:binary attach <pid>";
@@ -2058,13 +2564,29 @@ namespace {
         }
         // --- Handler for "diff" subcommand ---
         else if (subcommand == "diff") {
-            if (args.size() < 4) return "Usage: omni:binary diff <file1> <file2>";
-            auto diff_offset = BinaryManip::FindFirstDifference(args[2], args[3]);
-            if (diff_offset) {
-                ss << "Files differ at offset: 0x" << std::hex << *diff_offset;
+            if (args.size() < 4) return "Usage: omni:binary diff <file1> <file2> [--first] [--sections] [--functions] [--gap N]";
+            BinaryDiff::DiffOptions options;
+            bool firstOnly = false;
+            for (size_t i = 4; i < args.size(); ++i) {
+                if (args[i] == "--first") firstOnly = true;
+                else if (args[i] == "--sections") options.sections = true;
+                else if (args[i] == "--functions") options.functions = true;
+                else if (args[i] == "--gap" && i + 1 < args.size()) {
+                    try { options.mergeGap = std::stoull(args[++i]); }
+                    catch (...) { return "Error: --gap expects a byte count."; }
+                }
+            }
+            std::string error;
+            if (firstOnly) {
+                auto diff_offset = BinaryDiff::FirstDifference(args[2], args[3], &error);
+                if (!error.empty()) return "Error: " + error;
+                if (diff_offset) ss << "Files differ at offset: 0x" << std::hex << *diff_offset;
+                else ss << "Files are identical.";
             }
             else {
-                ss << "Files are identical.";
+                auto report = BinaryDiff::Compare(args[2], args[3], options, &error);
+                if (!report) return "Error: " + error;
+                ss << BinaryDiff::FormatReport(*report);
             }
         }
         // --- Handler for "ai-analyze" subcommand ---
@@ -2082,7 +2604,7 @@ namespace {
         }
         // --- Fallback for unknown subcommand ---
         else {
-            return "Unknown omni:binary subcommand. Use 'probe', 'sections', 'symbols', 'attach', 'diff', or 'ai-analyze'.";
+            return "Unknown omni:binary subcommand. Use 'probe', 'sections', 'symbols', 'cfg', 'attach', 'diff', or 'ai-analyze'.";
         }
 
         return ss.str();
@@ -2580,9 +3102,20 @@ namespace {
         }
         f << "Process PID,user_ms,kernel_ms\n";
         f << s.pid << "," << s.user_ms << "," << s.kernel_ms << "\n";
-        f << "Thread TID,user_ms,kernel_ms\n";
-        for (const auto& t : s.thread_samples)
-            f << t.tid << "," << t.user_ms << "," << t.kernel_ms << "\n";
+        // Counter columns are appended only when counters were on, so older readers that take the
+        // first three fields keep working.
+        f << "Thread TID,user_ms,kernel_ms";
+        if (s.hw) f << ",cycles,instructions,cache_references,cache_misses,branch_misses,context_switches";
+        f << "\n";
+        for (const auto& t : s.thread_samples) {
+            f << t.tid << "," << t.user_ms << "," << t.kernel_ms;
+            if (s.hw) {
+                const PMU::HwCounters hw = t.hw.value_or(PMU::HwCounters{});
+                f << "," << hw.cycles << "," << hw.instructions << "," << hw.cache_references
+                    << "," << hw.cache_misses << "," << hw.branch_misses << "," << hw.context_switches;
+            }
+            f << "\n";
+        }
     }
 
     PMU::ProcessSample loadCSV(const std::string& path) {
@@ -2615,6 +3148,31 @@ namespace {
             ts.tid = static_cast<uint32_t>(std::stoul(tid));
             ts.user_ms = std::stod(u);
             ts.kernel_ms = std::stod(k);
+
+            uint64_t counters[6] = {};
+            size_t n = 0;
+            for (std::string field; n < 6 && std::getline(ss, field, ','); ++n) {
+                counters[n] = std::stoull(field);
+            }
+            if (n == 6) {
+                PMU::HwCounters hw{};
+                hw.cycles = counters[0];
+                hw.instructions = counters[1];
+                hw.cache_references = counters[2];
+                hw.cache_misses = counters[3];
+                hw.branch_misses = counters[4];
+                hw.context_switches = counters[5];
+                hw.hardware = hw.cycles || hw.instructions || hw.cache_references;
+                ts.hw = hw;
+                if (!out.hw) out.hw.emplace();
+                out.hw->hardware = out.hw->hardware || hw.hardware;
+                out.hw->cycles += hw.cycles;
+                out.hw->instructions += hw.instructions;
+                out.hw->cache_references += hw.cache_references;
+                out.hw->cache_misses += hw.cache_misses;
+                out.hw->branch_misses += hw.branch_misses;
+                out.hw->context_switches += hw.context_switches;
+            }
             out.thread_samples.push_back(ts);
         }
         out.threads = out.thread_samples.size();
@@ -2649,6 +3207,7 @@ CommandRouter::CommandRouter() {
     add_cmd(*this, "exit", &Cmd_Exit);
     add_cmd(*this, "jobs", &Cmd_Jobs);
     add_cmd(*this, "fg", &Cmd_Fg);
+    add_cmd(*this, "cancel", &Cmd_Cancel);
 
     // Navigation
     add_cmd(*this, "cd", &Cmd_Cd);
@@ -2680,6 +3239,7 @@ CommandRouter::CommandRouter() {
     // Diagnostics/process
     add_cmd(*this, "omni:diagnose", &Cmd_Diagnose);
     add_cmd(*this, "omni:kill", &Cmd_Kill);
+    add_cmd(*this, "omni:scancache", &Cmd_ScanCache);
     add_cmd(*this, "omni:task_daemon", &Cmd_TaskDaemon);
 
     // AI shell
@@ -2708,6 +3268,11 @@ CommandRouter::CommandRouter() {
     add_cmd(*this, "omni:pmu_analyze", &Cmd_PmuAnalyze);
     add_cmd(*this, "omni:pmu_monitor", &Cmd_PmuMonitor);
     add_cmd(*this, "omni:pmu_sample", &Cmd_PmuSample);
+    add_cmd(*this, "omni:pmu_bench", &Cmd_PmuBench);
+    add_cmd(*this, "omni:pmu_counters", &Cmd_PmuCounters);
+    add_cmd(*this, "omni:trace", &Cmd_Trace);
+    add_cmd(*this, "omni:profile", &Cmd_Profile);
+    add_cmd(*this, "omni:metrics", &Cmd_Metrics);
     add_cmd(*this, "omni:pmu_save", &Cmd_PmuSave);
     add_cmd(*this, "omni:pmu_diff", &Cmd_PmuDiff);
     add_cmd(*this, "omni:pmu_summary", &Cmd_PmuSummary);
@@ -2758,6 +3323,10 @@ CommandRouter::CommandRouter() {
     add_cmd(*this, "omni:cloud:mount", &Cmd_CloudMount);
     add_cmd(*this, "omni:cloud:unmount", &Cmd_CloudUnmount);
     add_cmd(*this, "omni:cloud:status", &Cmd_CloudStatus);
+    add_cmd(*this, "omni:cloud:compression", &Cmd_CloudCompression);
+    add_cmd(*this, "omni:cloud:compact", &Cmd_CloudCompact);
+    add_cmd(*this, "omni:cloud:bench", &Cmd_CloudBench);
+    add_cmd(*this, "omni:cloud:faultcheck", &Cmd_CloudFaultCheck);
     // =================================================================
     // END ADDITION
     // =================================================================
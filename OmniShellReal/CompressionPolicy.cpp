@@ -0,0 +1,215 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// CompressionPolicy.cpp
+
+#include "CompressionPolicy.h"
+#include "DiagnosticsModule.h"
+#include <zstd.h>
+#include <zdict.h>
+#include <algorithm>
+#include <cstring>
+
+namespace onecloud {
+
+    namespace {
+        constexpr int DEFAULT_LEVEL = 3;
+        constexpr size_t ENTROPY_WINDOWS = 4;
+
+        // One compression and one decompression context per thread, created on first use.
+        class ThreadContexts {
+        public:
+            ~ThreadContexts() {
+                ZSTD_freeCCtx(cctx_);
+                ZSTD_freeDCtx(dctx_);
+            }
+
+            ZSTD_CCtx* compressor() {
+                if (!cctx_) cctx_ = ZSTD_createCCtx();
+                return cctx_;
+            }
+
+            ZSTD_DCtx* decompressor() {
+                if (!dctx_) dctx_ = ZSTD_createDCtx();
+                return dctx_;
+            }
+
+        private:
+            ZSTD_CCtx* cctx_ = nullptr;
+            ZSTD_DCtx* dctx_ = nullptr;
+        };
+
+        ThreadContexts& threadContexts() {
+            thread_local ThreadContexts contexts;
+            return contexts;
+        }
+    }
+
+    // Digested forms of one dictionary. The decoder half never changes; the encoder half is rebuilt
+    // when the level changes because a ZSTD_CDict is bound to its level.
+    struct CompressionPolicy::Dictionary {
+        std::vector<std::byte> bytes;
+        std::shared_ptr<ZSTD_DDict> ddict;
+        std::shared_ptr<ZSTD_CDict> cdict;
+        int cdict_level = 0;
+    };
+
+    CompressionPolicy::CompressionPolicy() = default;
+    CompressionPolicy::~CompressionPolicy() = default;
+
+    void CompressionPolicy::setLevel(int level) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        settings_.level = (level == 0) ? DEFAULT_LEVEL : std::clamp(level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+    }
+
+    int CompressionPolicy::level() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return settings_.level;
+    }
+
+    std::expected<uint32_t, CloudError> CompressionPolicy::addDictionary(std::span<const std::byte> dictionary) {
+        const uint32_t id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+        if (id == 0) return std::unexpected(CloudError::InvalidContainerFormat);
+
+        auto entry = std::make_shared<Dictionary>();
+        entry->bytes.assign(dictionary.begin(), dictionary.end());
+        entry->ddict.reset(ZSTD_createDDict(entry->bytes.data(), entry->bytes.size()), ZSTD_freeDDict);
+        if (!entry->ddict) return std::unexpected(CloudError::OutOfMemory);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        dictionaries_[id] = std::move(entry);
+        active_dictionary_ = id;
+        return id;
+    }
+
+    std::optional<uint32_t> CompressionPolicy::activeDictionary() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (active_dictionary_ == 0) return std::nullopt;
+        return active_dictionary_;
+    }
+
+    std::shared_ptr<CompressionPolicy::Dictionary> CompressionPolicy::findDictionary(uint32_t id) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = dictionaries_.find(id);
+        return it == dictionaries_.end() ? nullptr : it->second;
+    }
+
+    double CompressionPolicy::sampleEntropy(std::span<const std::byte> data, size_t sample_bytes) {
+        auto bytes = std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+        if (bytes.size() <= sample_bytes) {
+            return DiagnosticsModule::calculateEntropy(bytes);
+        }
+
+        // Head, two interior windows and the tail: enough to catch a compressed payload behind a text header.
+        const size_t window = std::max<size_t>(sample_bytes / ENTROPY_WINDOWS, 1);
+        const size_t stride = (bytes.size() - window) / (ENTROPY_WINDOWS - 1);
+        double total = 0.0;
+        for (size_t i = 0; i < ENTROPY_WINDOWS; ++i) {
+            total += DiagnosticsModule::calculateEntropy(bytes.subspan(i * stride, window));
+        }
+        return total / ENTROPY_WINDOWS;
+    }
+
+    std::expected<EncodedChunk, CloudError> CompressionPolicy::encode(std::span<const std::byte> data, std::vector<std::byte>& out) const {
+        EncodedChunk result;
+        // The sampling settings never change after construction, so this runs outside the lock.
+        if (sampleEntropy(data, settings_.entropy_sample_bytes) >= settings_.raw_entropy_threshold) {
+            result.codec = ChunkCodec::Raw;
+        }
+
+        int level = DEFAULT_LEVEL;
+        std::shared_ptr<ZSTD_CDict> cdict;
+        if (result.codec != ChunkCodec::Raw) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            level = settings_.level;
+            if (active_dictionary_ != 0 && data.size() <= settings_.dictionary_max_chunk) {
+                auto& dictionary = *dictionaries_.at(active_dictionary_);
+                if (!dictionary.cdict || dictionary.cdict_level != level) {
+                    dictionary.cdict.reset(ZSTD_createCDict(dictionary.bytes.data(), dictionary.bytes.size(), level), ZSTD_freeCDict);
+                    dictionary.cdict_level = level;
+                }
+                cdict = dictionary.cdict;
+                if (cdict) {
+                    result.codec = ChunkCodec::ZstdDictionary;
+                    result.dictionary_id = active_dictionary_;
+                }
+            }
+        }
+
+        if (result.codec != ChunkCodec::Raw) {
+            ZSTD_CCtx* cctx = threadContexts().compressor();
+            if (!cctx) return std::unexpected(CloudError::OutOfMemory);
+
+            out.resize(ZSTD_compressBound(data.size()));
+            size_t compressed_size = (result.codec == ChunkCodec::ZstdDictionary)
+                ? ZSTD_compress_usingCDict(cctx, out.data(), out.size(), data.data(), data.size(), cdict.get())
+                : ZSTD_compressCCtx(cctx, out.data(), out.size(), data.data(), data.size(), level);
+            if (ZSTD_isError(compressed_size)) return std::unexpected(CloudError::CompressionFailed);
+
+            if (compressed_size < data.size()) {
+                out.resize(compressed_size);
+                return result;
+            }
+            // The estimate missed; a frame that does not shrink the data is not worth decoding later.
+            result = EncodedChunk{ ChunkCodec::Raw, 0 };
+        }
+
+        out.clear(); // Raw: the caller stores 'data' itself.
+        return result;
+    }
+
+    std::expected<void, CloudError> CompressionPolicy::decode(const DataChunk& chunk, std::span<const std::byte> encoded, std::span<std::byte> dest) const {
+        if (dest.size() < chunk.original_size) return std::unexpected(CloudError::BufferTooSmall);
+
+        size_t written = 0;
+        switch (chunk.codec) {
+        case ChunkCodec::Raw:
+            if (encoded.size() != chunk.original_size) return std::unexpected(CloudError::InvalidContainerFormat);
+            std::memcpy(dest.data(), encoded.data(), encoded.size());
+            return {};
+
+        case ChunkCodec::Zstd: {
+            ZSTD_DCtx* dctx = threadContexts().decompressor();
+            if (!dctx) return std::unexpected(CloudError::OutOfMemory);
+            written = ZSTD_decompressDCtx(dctx, dest.data(), chunk.original_size, encoded.data(), encoded.size());
+            break;
+        }
+
+        case ChunkCodec::ZstdDictionary: {
+            auto dictionary = findDictionary(chunk.dictionary_id);
+            if (!dictionary) return std::unexpected(CloudError::InvalidContainerFormat);
+            ZSTD_DCtx* dctx = threadContexts().decompressor();
+            if (!dctx) return std::unexpected(CloudError::OutOfMemory);
+            written = ZSTD_decompress_usingDDict(dctx, dest.data(), chunk.original_size, encoded.data(), encoded.size(), dictionary->ddict.get());
+            break;
+        }
+
+        default:
+            return std::unexpected(CloudError::InvalidContainerFormat);
+        }
+
+        if (ZSTD_isError(written) || written != chunk.original_size) {
+            return std::unexpected(CloudError::InvalidContainerFormat);
+        }
+        return {};
+    }
+
+    std::expected<std::vector<std::byte>, CloudError> CompressionPolicy::trainDictionary(std::span<const std::vector<std::byte>> samples, size_t max_bytes) {
+        std::vector<std::byte> concatenated;
+        std::vector<size_t> sizes;
+        sizes.reserve(samples.size());
+        for (const auto& sample : samples) {
+            if (sample.empty()) continue;
+            concatenated.insert(concatenated.end(), sample.begin(), sample.end());
+            sizes.push_back(sample.size());
+        }
+        if (sizes.empty()) return std::unexpected(CloudError::CompressionFailed);
+
+        std::vector<std::byte> dictionary(max_bytes);
+        size_t dictionary_size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(),
+            concatenated.data(), sizes.data(), static_cast<unsigned>(sizes.size()));
+        if (ZDICT_isError(dictionary_size)) return std::unexpected(CloudError::CompressionFailed);
+        dictionary.resize(dictionary_size);
+        return dictionary;
+    }
+
+} // namespace onecloud
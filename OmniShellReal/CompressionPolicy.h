@@ -0,0 +1,95 @@
+Copyright © 2025 Cadell Richard Anderson
+
+//CompressionPolicy.h
+
+#pragma once
+
+#include "types.h"
+#include "CloudError.h"
+#include <span>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <expected>
+#include <optional>
+
+namespace onecloud {
+
+    // Tuning knobs for CompressionPolicy.
+    struct CompressionSettings {
+        int level = 3;                              // ZSTD level for new chunks.
+        double raw_entropy_threshold = 7.5;         // Bits per byte at or above which a chunk is stored raw.
+        size_t entropy_sample_bytes = 64 * 1024;    // Bytes sampled per chunk for the entropy estimate.
+        size_t dictionary_max_chunk = 64 * 1024;    // Chunks up to this size use the active dictionary.
+    };
+
+    // How encode() stored one chunk; copied into its DataChunk record.
+    struct EncodedChunk {
+        ChunkCodec codec = ChunkCodec::Zstd;
+        uint32_t dictionary_id = 0;
+    };
+
+    /**
+     * @class CompressionPolicy
+     * @brief Picks a codec per chunk and owns the ZSTD state needed to apply it.
+     *
+     * Chunks whose sampled entropy says they are already compressed (encrypted captures, media,
+     * archives) skip ZSTD entirely and are stored raw. Small chunks use the container's trained
+     * dictionary when one exists. Compression and decompression contexts are kept per thread and
+     * reused, so read-ahead workers and the writer never allocate one per chunk.
+     */
+    class CompressionPolicy {
+    public:
+        CompressionPolicy();
+        ~CompressionPolicy();
+        CompressionPolicy(const CompressionPolicy&) = delete;
+        CompressionPolicy& operator=(const CompressionPolicy&) = delete;
+
+        // Sets the ZSTD level for new chunks; 0 restores the default. Clamped to the library's range.
+        void setLevel(int level);
+        int level() const;
+
+        /**
+         * @brief Registers a trained dictionary. The most recently added one is used for new small chunks;
+         *        older ones stay available for decoding.
+         * @return The dictionary ID, or InvalidContainerFormat if the buffer is not a ZSTD dictionary.
+         */
+        std::expected<uint32_t, CloudError> addDictionary(std::span<const std::byte> dictionary);
+        std::optional<uint32_t> activeDictionary() const;
+
+        /**
+         * @brief Chooses a codec for 'data' and writes the encoded bytes to 'out'. For ChunkCodec::Raw
+         *        'out' is left empty and 'data' itself is what gets stored, saving a copy.
+         * @return The codec and dictionary used, or CompressionFailed if ZSTD reports an error.
+         */
+        std::expected<EncodedChunk, CloudError> encode(std::span<const std::byte> data, std::vector<std::byte>& out) const;
+
+        /**
+         * @brief Decodes a chunk's plaintext into 'dest' (at least chunk.original_size bytes). Safe to call
+         *        from several threads at once.
+         */
+        std::expected<void, CloudError> decode(const DataChunk& chunk, std::span<const std::byte> encoded, std::span<std::byte> dest) const;
+
+        /**
+         * @brief Trains a ZSTD dictionary from sample files.
+         * @param samples Sample contents, ideally many small files of the kind the dictionary is for.
+         * @param max_bytes The largest dictionary to produce.
+         * @return The dictionary, or CompressionFailed if the samples were too few or too small.
+         */
+        static std::expected<std::vector<std::byte>, CloudError> trainDictionary(std::span<const std::vector<std::byte>> samples, size_t max_bytes);
+
+        // Entropy estimate in bits per byte, averaged over up to 'sample_bytes' taken from four places in 'data'.
+        static double sampleEntropy(std::span<const std::byte> data, size_t sample_bytes);
+
+    private:
+        struct Dictionary;
+        std::shared_ptr<Dictionary> findDictionary(uint32_t id) const;
+
+        CompressionSettings settings_;
+        mutable std::mutex mutex_;
+        std::map<uint32_t, std::shared_ptr<Dictionary>> dictionaries_;
+        uint32_t active_dictionary_ = 0;
+    };
+
+} // namespace onecloud
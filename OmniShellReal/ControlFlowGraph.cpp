@@ -0,0 +1,387 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// ControlFlowGraph.cpp
+#include "ControlFlowGraph.h"
+#include "BinaryImage.h"
+#include "JobManager.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+using BinaryTranslator::Instruction;
+using BinaryTranslator::InstructionTable;
+
+namespace {
+    constexpr size_t FUNCTIONS_PER_TASK = 64;
+    constexpr size_t MAX_BLOCKS = 1 << 16;      // per function; stops a descent that has wandered into data
+    constexpr size_t NO_INDEX = static_cast<size_t>(-1);
+    constexpr size_t CALLEES_SHOWN = 8;
+
+    // Imports that never return; code after a call to one belongs to something else.
+    constexpr std::string_view NO_RETURN[] = {
+        "exit", "_exit", "_Exit", "abort", "__assert_fail", "__stack_chk_fail", "__fortify_fail",
+        "__cxa_throw", "__cxa_rethrow", "_Unwind_Resume", "longjmp", "__longjmp_chk", "err", "errx",
+        "ExitProcess", "ExitThread", "FreeLibraryAndExitThread", "RtlExitUserProcess",
+    };
+
+    std::string Hex(uint64_t value) {
+        char buf[16];
+        const auto end = std::to_chars(buf, buf + sizeof buf, value, 16).ptr;
+        return "0x" + std::string(buf, end);
+    }
+
+    size_t IndexOf(const InstructionTable& t, uint64_t address) {
+        auto it = std::lower_bound(t.instructions.begin(), t.instructions.end(), address,
+            [](const Instruction& insn, uint64_t a) { return insn.address < a; });
+        return (it != t.instructions.end() && it->address == address) ? static_cast<size_t>(it - t.instructions.begin()) : NO_INDEX;
+    }
+
+    bool CallsNoReturn(const InstructionTable& t, const Instruction& insn) {
+        const ImageImport* imp = (insn.flags & Instruction::Call) ? t.importOf(insn) : nullptr;
+        return imp && std::find(std::begin(NO_RETURN), std::end(NO_RETURN), imp->name) != std::end(NO_RETURN);
+    }
+
+    // Execution never continues with the next instruction.
+    bool StopsFlow(const InstructionTable& t, const Instruction& insn) {
+        if (insn.flags & Instruction::Return) return true;
+        if ((insn.flags & Instruction::Jump) && !(insn.flags & Instruction::Conditional)) return true;
+        return CallsNoReturn(t, insn);
+    }
+
+    FlowFunction BuildFunction(const InstructionTable& t, uint64_t entry, const std::unordered_set<uint64_t>& entries) {
+        FlowFunction fn;
+        fn.entry = entry;
+        const auto& ins = t.instructions;
+
+        struct Taken {
+            uint64_t from;          // address of the jump
+            uint64_t to;
+            FlowEdge::Kind kind;
+        };
+        std::map<uint64_t, uint64_t> blocks;    // start -> end
+        std::vector<Taken> taken;
+        std::vector<uint64_t> work{ entry };
+
+        while (!work.empty() && blocks.size() < MAX_BLOCKS) {
+            const uint64_t start = work.back();
+            work.pop_back();
+            auto next = blocks.upper_bound(start);
+            if (next != blocks.begin()) {
+                auto prev = std::prev(next);
+                if (prev->first == start) continue;
+                if (start < prev->second) {
+                    // Lands inside a block already walked: split it there.
+                    if (IndexOf(t, start) == NO_INDEX) {
+                        ++fn.unresolved;
+                        continue;
+                    }
+                    blocks.emplace(start, prev->second);
+                    prev->second = start;
+                    continue;
+                }
+            }
+            size_t i = IndexOf(t, start);
+            if (i == NO_INDEX) {
+                ++fn.unresolved;
+                continue;
+            }
+            const uint64_t limit = (next == blocks.end()) ? UINT64_MAX : next->first;
+            for (;; ++i) {
+                const Instruction& insn = ins[i];
+                if (insn.flags & Instruction::Call) {
+                    if (const ImageImport* imp = t.importOf(insn)) fn.imports.push_back(imp->name);
+                    else if (insn.target) fn.callees.push_back(insn.target);
+                    if (CallsNoReturn(t, insn)) break;
+                }
+                else if (insn.flags & Instruction::Jump) {
+                    const bool conditional = (insn.flags & Instruction::Conditional) != 0;
+                    if (const ImageImport* imp = t.importOf(insn)) {
+                        fn.imports.push_back(imp->name);
+                    }
+                    else if (!insn.target) {
+                        ++fn.indirectJumps;
+                    }
+                    else if (!conditional && insn.target != entry && entries.count(insn.target)) {
+                        fn.callees.push_back(insn.target);     // tail call
+                    }
+                    else {
+                        taken.push_back({ insn.address, insn.target, conditional ? FlowEdge::Branch : FlowEdge::Jump });
+                        work.push_back(insn.target);
+                    }
+                    if (conditional) work.push_back(insn.address + insn.size);
+                    break;
+                }
+                if (insn.flags & Instruction::Return) break;
+                const uint64_t after = insn.address + insn.size;
+                if (i + 1 >= ins.size() || ins[i + 1].address != after || after >= limit) break;
+            }
+            blocks.emplace(start, ins[i].address + ins[i].size);
+        }
+
+        fn.blocks.reserve(blocks.size());
+        for (const auto& [start, end] : blocks) {
+            FlowBlock b;
+            b.start = start;
+            b.end = end;
+            const size_t first = IndexOf(t, start);
+            const size_t last = static_cast<size_t>(std::lower_bound(ins.begin() + first, ins.end(), end,
+                [](const Instruction& insn, uint64_t a) { return insn.address < a; }) - ins.begin());
+            b.first = static_cast<uint32_t>(first);
+            b.count = static_cast<uint32_t>(last - first);
+            fn.blocks.push_back(b);
+        }
+        auto blockStarting = [&](uint64_t a) -> size_t {
+            auto it = std::lower_bound(fn.blocks.begin(), fn.blocks.end(), a, [](const FlowBlock& b, uint64_t x) { return b.start < x; });
+            return (it != fn.blocks.end() && it->start == a) ? static_cast<size_t>(it - fn.blocks.begin()) : NO_INDEX;
+        };
+        auto blockContaining = [&](uint64_t a) -> size_t {
+            auto it = std::upper_bound(fn.blocks.begin(), fn.blocks.end(), a, [](uint64_t x, const FlowBlock& b) { return x < b.start; });
+            return static_cast<size_t>(it - fn.blocks.begin()) - 1;
+        };
+
+        for (size_t b = 0; b < fn.blocks.size(); ++b) {
+            const FlowBlock& block = fn.blocks[b];
+            if (StopsFlow(t, ins[block.first + block.count - 1])) continue;
+            const size_t to = blockStarting(block.end);
+            if (to != NO_INDEX) fn.edges.push_back({ static_cast<uint32_t>(b), static_cast<uint32_t>(to), FlowEdge::Fallthrough });
+        }
+        for (const auto& e : taken) {
+            const size_t to = blockStarting(e.to);
+            if (to == NO_INDEX) continue;   // counted as unresolved when it was walked
+            fn.edges.push_back({ static_cast<uint32_t>(blockContaining(e.from)), static_cast<uint32_t>(to), e.kind });
+        }
+        auto edgeKey = [](const FlowEdge& e) { return std::tuple(e.from, e.to, e.kind); };
+        std::sort(fn.edges.begin(), fn.edges.end(), [&](const FlowEdge& a, const FlowEdge& b) { return edgeKey(a) < edgeKey(b); });
+        fn.edges.erase(std::unique(fn.edges.begin(), fn.edges.end(), [&](const FlowEdge& a, const FlowEdge& b) { return edgeKey(a) == edgeKey(b); }), fn.edges.end());
+        std::sort(fn.callees.begin(), fn.callees.end());
+        fn.callees.erase(std::unique(fn.callees.begin(), fn.callees.end()), fn.callees.end());
+        std::sort(fn.imports.begin(), fn.imports.end());
+        fn.imports.erase(std::unique(fn.imports.begin(), fn.imports.end()), fn.imports.end());
+        return fn;
+    }
+
+    void AppendJsonString(std::string& out, std::string_view s) {
+        out += '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof buf, "\\u%04x", c);
+                out += buf;
+            }
+            else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    // DOT quoted string. Graphviz drops the backslash from escapes it does not
+    // recognise, so <, >, {, } and | are escaped for record labels without
+    // changing how plain labels render.
+    void AppendDotString(std::string& out, std::string_view s) {
+        out += '"';
+        for (char c : s) {
+            switch (c) {
+            case '"': case '\\': case '<': case '>': case '{': case '}': case '|':
+                out += '\\';
+                out += c;
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20 && c != 0x7f)
+                    out += c;
+                break;
+            }
+        }
+        out += '"';
+    }
+
+    const char* KindName(FlowEdge::Kind kind) {
+        switch (kind) {
+        case FlowEdge::Jump:   return "jump";
+        case FlowEdge::Branch: return "branch";
+        default:               return "fallthrough";
+        }
+    }
+}
+
+std::shared_ptr<const ControlFlowGraph> ControlFlowGraph::Build(std::shared_ptr<const InstructionTable> instructions) {
+    auto graph = std::make_shared<ControlFlowGraph>();
+    graph->table = std::move(instructions);
+    const InstructionTable* t = graph->table.get();
+    if (!t || t->instructions.empty()) return graph;
+
+    std::unordered_map<uint64_t, std::string_view> names;
+    std::vector<uint64_t> pending;
+    if (t->image) {
+        for (const auto& fn : t->image->functions()) {
+            if (IndexOf(*t, fn.address) == NO_INDEX) continue;
+            pending.push_back(fn.address);
+            if (!fn.name.empty()) names.emplace(fn.address, fn.name);
+        }
+    }
+    if (pending.empty()) pending.push_back(t->instructions.front().address);
+    std::unordered_set<uint64_t> entries(pending.begin(), pending.end());
+
+    // Each wave builds the functions found so far; their direct call targets seed the next wave.
+    // 'entries' is only written between waves, so the tasks can read it freely.
+    while (!pending.empty()) {
+        std::vector<FlowFunction> wave(pending.size());
+        auto run = [&](size_t task) {
+            const size_t end = std::min(pending.size(), (task + 1) * FUNCTIONS_PER_TASK);
+            for (size_t k = task * FUNCTIONS_PER_TASK; k < end; ++k) wave[k] = BuildFunction(*t, pending[k], entries);
+        };
+        const size_t tasks = (pending.size() + FUNCTIONS_PER_TASK - 1) / FUNCTIONS_PER_TASK;
+        if (tasks == 1) {
+            run(0);
+        }
+        else {
+            std::vector<TaskHandle> handles;
+            handles.reserve(tasks);
+            for (size_t task = 0; task < tasks; ++task) handles.push_back(JobManager::SubmitJob([&run, task]() { run(task); }));
+            for (const auto& h : handles) JobManager::Wait(h);
+        }
+
+        std::vector<uint64_t> next;
+        for (auto& fn : wave) {
+            for (uint64_t callee : fn.callees) {
+                if (IndexOf(*t, callee) != NO_INDEX && entries.insert(callee).second) next.push_back(callee);
+            }
+            graph->funcs.push_back(std::move(fn));
+        }
+        pending = std::move(next);
+    }
+
+    std::sort(graph->funcs.begin(), graph->funcs.end(), [](const FlowFunction& a, const FlowFunction& b) { return a.entry < b.entry; });
+    for (auto& fn : graph->funcs) {
+        auto it = names.find(fn.entry);
+        fn.name = (it != names.end()) ? std::string(it->second) : "sub_" + Hex(fn.entry).substr(2);
+    }
+    return graph;
+}
+
+const FlowFunction* ControlFlowGraph::functionAt(uint64_t entry) const {
+    auto it = std::lower_bound(funcs.begin(), funcs.end(), entry, [](const FlowFunction& f, uint64_t a) { return f.entry < a; });
+    return (it != funcs.end() && it->entry == entry) ? &*it : nullptr;
+}
+
+size_t ControlFlowGraph::blockCount() const {
+    size_t n = 0;
+    for (const auto& fn : funcs) n += fn.blocks.size();
+    return n;
+}
+
+size_t ControlFlowGraph::edgeCount() const {
+    size_t n = 0;
+    for (const auto& fn : funcs) n += fn.edges.size();
+    return n;
+}
+
+std::vector<std::string> ControlFlowGraph::describe() const {
+    std::vector<std::string> lines;
+    lines.reserve(funcs.size());
+    for (const auto& fn : funcs) {
+        std::string line = fn.name + " @ " + Hex(fn.entry) + ": " + std::to_string(fn.blocks.size()) + " blocks, "
+            + std::to_string(fn.edges.size()) + " edges";
+        if (fn.indirectJumps) line += ", " + std::to_string(fn.indirectJumps) + " indirect jumps";
+        if (fn.unresolved) line += ", " + std::to_string(fn.unresolved) + " unresolved targets";
+        std::vector<std::string> called;
+        for (uint64_t c : fn.callees) {
+            const FlowFunction* callee = functionAt(c);
+            called.push_back(callee ? callee->name : Hex(c));
+        }
+        for (auto name : fn.imports) called.emplace_back(name);
+        if (!called.empty()) {
+            line += " -> ";
+            for (size_t k = 0; k < called.size() && k < CALLEES_SHOWN; ++k) line += (k ? ", " : "") + called[k];
+            if (called.size() > CALLEES_SHOWN) line += " (+" + std::to_string(called.size() - CALLEES_SHOWN) + " more)";
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+std::string ControlFlowGraph::toDot() const {
+    // Node ids are per function, since overlapping functions can share an address.
+    auto node = [](size_t f, size_t b) { return "b" + std::to_string(f) + "_" + std::to_string(b); };
+    auto entryBlock = [](const FlowFunction& fn) -> size_t {
+        for (size_t b = 0; b < fn.blocks.size(); ++b) {
+            if (fn.blocks[b].start == fn.entry) return b;
+        }
+        return NO_INDEX;
+    };
+
+    std::string out = "digraph cfg {\n  node [shape=box, fontname=\"monospace\"];\n";
+    for (size_t f = 0; f < funcs.size(); ++f) {
+        const FlowFunction& fn = funcs[f];
+        out += "  subgraph \"cluster_" + std::to_string(f) + "\" {\n    label=";
+        AppendDotString(out, fn.name);
+        out += ";\n";
+        for (size_t b = 0; b < fn.blocks.size(); ++b) {
+            out += "    " + node(f, b) + " [label=\"" + Hex(fn.blocks[b].start) + "\\n" + std::to_string(fn.blocks[b].count) + " insns\"];\n";
+        }
+        for (const auto& e : fn.edges) {
+            out += "    " + node(f, e.from) + " -> " + node(f, e.to);
+            if (e.kind == FlowEdge::Branch) out += " [color=\"darkgreen\"]";
+            else if (e.kind == FlowEdge::Fallthrough) out += " [color=\"gray40\"]";
+            out += ";\n";
+        }
+        out += "  }\n";
+    }
+    for (size_t f = 0; f < funcs.size(); ++f) {
+        const size_t from = entryBlock(funcs[f]);
+        if (from == NO_INDEX) continue;
+        for (uint64_t c : funcs[f].callees) {
+            const FlowFunction* callee = functionAt(c);
+            if (!callee) continue;
+            const size_t to = entryBlock(*callee);
+            if (to != NO_INDEX) out += "  " + node(f, from) + " -> " + node(static_cast<size_t>(callee - funcs.data()), to) + " [style=dashed];\n";
+        }
+    }
+    out += "}\n";
+    return out;
+}
+
+std::string ControlFlowGraph::toJson() const {
+    std::string out = "{\"functions\":[";
+    for (size_t f = 0; f < funcs.size(); ++f) {
+        const FlowFunction& fn = funcs[f];
+        out += f ? ",{" : "{";
+        out += "\"name\":";
+        AppendJsonString(out, fn.name);
+        out += ",\"entry\":\"" + Hex(fn.entry) + "\",\"blocks\":[";
+        for (size_t b = 0; b < fn.blocks.size(); ++b) {
+            out += b ? "," : "";
+            out += "{\"start\":\"" + Hex(fn.blocks[b].start) + "\",\"end\":\"" + Hex(fn.blocks[b].end)
+                + "\",\"instructions\":" + std::to_string(fn.blocks[b].count) + "}";
+        }
+        out += "],\"edges\":[";
+        for (size_t k = 0; k < fn.edges.size(); ++k) {
+            out += k ? "," : "";
+            out += "{\"from\":" + std::to_string(fn.edges[k].from) + ",\"to\":" + std::to_string(fn.edges[k].to)
+                + ",\"kind\":\"" + KindName(fn.edges[k].kind) + "\"}";
+        }
+        out += "],\"calls\":[";
+        for (size_t k = 0; k < fn.callees.size(); ++k) out += (k ? ",\"" : "\"") + Hex(fn.callees[k]) + "\"";
+        out += "],\"imports\":[";
+        for (size_t k = 0; k < fn.imports.size(); ++k) {
+            out += k ? "," : "";
+            AppendJsonString(out, fn.imports[k]);
+        }
+        out += "],\"indirect_jumps\":" + std::to_string(fn.indirectJumps) + ",\"unresolved\":" + std::to_string(fn.unresolved) + "}";
+    }
+    out += "]}\n";
+    return out;
+}
@@ -0,0 +1,72 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// ControlFlowGraph.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BinaryTranslator.h"
+
+// A straight run of instructions entered only at its first one.
+struct FlowBlock {
+    uint64_t start = 0;
+    uint64_t end = 0;           // one past the last instruction
+    uint32_t first = 0;         // index of its first instruction in the InstructionTable
+    uint32_t count = 0;
+};
+
+struct FlowEdge {
+    enum Kind : uint8_t { Fallthrough, Jump, Branch };   // Branch: a conditional jump taken
+
+    uint32_t from = 0;          // block indices within the function
+    uint32_t to = 0;
+    Kind kind = Fallthrough;
+};
+
+struct FlowFunction {
+    uint64_t entry = 0;
+    std::string name;                       // symbol name, or sub_<address>
+    std::vector<FlowBlock> blocks;          // by address
+    std::vector<FlowEdge> edges;
+    std::vector<uint64_t> callees;          // direct calls and tail jumps to other functions, sorted
+    std::vector<std::string_view> imports;  // imports called or tail-jumped to, sorted
+    uint32_t indirectJumps = 0;             // jumps through a register or memory, not followed
+    uint32_t unresolved = 0;                // direct targets that are not instruction boundaries
+};
+
+/**
+ * @class ControlFlowGraph
+ * @brief Functions, basic blocks and edges recovered from a disassembled binary.
+ *
+ * Recursive descent from the entry point and the function symbols, over the instruction table the
+ * disassembler already produced: each function follows its jumps, keeps its blocks in an interval
+ * map keyed by start address, and splits a block when a later jump lands inside it. Direct call
+ * targets become new functions, found in waves; the functions of one wave are built in parallel on
+ * the JobManager pool. Calls do not end a block. Jumps to another function's entry are treated as
+ * tail calls.
+ */
+class ControlFlowGraph {
+public:
+    static std::shared_ptr<const ControlFlowGraph> Build(std::shared_ptr<const BinaryTranslator::InstructionTable> table);
+
+    const std::vector<FlowFunction>& functions() const { return funcs; }    // by entry
+    const FlowFunction* functionAt(uint64_t entry) const;
+    const BinaryTranslator::InstructionTable& instructions() const { return *table; }
+    size_t blockCount() const;
+    size_t edgeCount() const;
+
+    // One line per function: name, address, block and edge counts, and what it calls.
+    std::vector<std::string> describe() const;
+    // Graphviz: one cluster per function, with dashed edges for calls between functions.
+    std::string toDot() const;
+    std::string toJson() const;
+
+private:
+    std::shared_ptr<const BinaryTranslator::InstructionTable> table;
+    std::vector<FlowFunction> funcs;
+};
@@ -8,15 +8,104 @@ Copyright © 2025 Cadell Richard Anderson
 #include <botan/exceptn.h>
 #include <botan/pwdhash.h>
 
+#include <cstring>
+#include <memory>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#elif defined(_M_ARM64)
+#include <windows.h>
+#elif (defined(__aarch64__) || defined(__arm__)) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
 namespace onecloud {
 
+    namespace {
+        const char* botanName(CipherSuite suite) {
+            return suite == CipherSuite::Aes256Gcm ? "AES-256/GCM" : "ChaCha20Poly1305";
+        }
+
+        // Seeding an AutoSeeded_RNG is far more expensive than drawing a nonce from it.
+        Botan::RandomNumberGenerator& threadRng() {
+            thread_local Botan::AutoSeeded_RNG rng;
+            return rng;
+        }
+
+        // One cipher object per (suite, direction) per thread. The key is only rescheduled when it changes,
+        // which in practice is once per container.
+        class CipherContext {
+        public:
+            Botan::AEAD_Mode& get(CipherSuite suite, Botan::Cipher_Dir dir, std::span<const std::byte> key) {
+                if (!mode_) {
+                    mode_ = Botan::AEAD_Mode::create_or_throw(botanName(suite), dir);
+                }
+                if (key.size() != key_.size() || std::memcmp(key.data(), key_.data(), key.size()) != 0) {
+                    mode_->set_key(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+                    key_.assign(reinterpret_cast<const uint8_t*>(key.data()), reinterpret_cast<const uint8_t*>(key.data()) + key.size());
+                }
+                return *mode_;
+            }
+
+            // Reused for the tag so finish() does not allocate per message.
+            Botan::secure_vector<uint8_t> tail;
+
+        private:
+            std::unique_ptr<Botan::AEAD_Mode> mode_;
+            Botan::secure_vector<uint8_t> key_;
+        };
+
+        CipherContext& threadContext(CipherSuite suite, Botan::Cipher_Dir dir) {
+            thread_local CipherContext contexts[2][2];
+            return contexts[suite == CipherSuite::Aes256Gcm ? 1 : 0][dir == Botan::Cipher_Dir::Encryption ? 0 : 1];
+        }
+
+        // AES and carry-less multiply instructions, which make AES-GCM faster than ChaCha20-Poly1305.
+        // Detected here rather than through Botan, whose CPUID interface is internal in Botan 3.
+        bool detectAesAndClmul() {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(_M_X64) || defined(_M_IX86)
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 25)) && (info[2] & (1 << 1));     // ECX.AES, ECX.PCLMULQDQ
+#elif defined(_M_ARM64)
+            return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__aarch64__) && defined(__APPLE__)
+            return true;    // every Apple ARM64 core has the crypto extensions
+#elif defined(__aarch64__) && defined(__linux__)
+            const unsigned long hwcap = getauxval(AT_HWCAP);
+            return (hwcap & HWCAP_AES) && (hwcap & HWCAP_PMULL);
+#elif defined(__arm__) && defined(__linux__)
+            const unsigned long hwcap2 = getauxval(AT_HWCAP2);
+            return (hwcap2 & HWCAP2_AES) && (hwcap2 & HWCAP2_PMULL);
+#else
+            return false;
+#endif
+        }
+
+        bool knownSuite(CipherSuite suite) {
+            return suite == CipherSuite::ChaCha20Poly1305 || suite == CipherSuite::Aes256Gcm;
+        }
+    }
+
     std::vector<std::byte> CryptoProvider::random_bytes(size_t size) {
-        Botan::AutoSeeded_RNG rng;
         std::vector<std::byte> buffer(size);
-        rng.randomize(reinterpret_cast<uint8_t*>(buffer.data()), size);
+        threadRng().randomize(reinterpret_cast<uint8_t*>(buffer.data()), size);
         return buffer;
     }
 
+    CipherSuite CryptoProvider::preferred_suite() {
+        static const bool accelerated = detectAesAndClmul();
+        return accelerated ? CipherSuite::Aes256Gcm : CipherSuite::ChaCha20Poly1305;
+    }
+
+    std::string_view CryptoProvider::suite_name(CipherSuite suite) {
+        return botanName(suite);
+    }
+
     std::expected<std::vector<std::byte>, CloudError> CryptoProvider::derive_key_from_password(
         const std::string& password,
         std::span<const std::byte> salt)
@@ -50,69 +139,121 @@ namespace onecloud {
         return derived_key;
     }
 
-    std::expected<std::vector<std::byte>, CloudError> CryptoProvider::encrypt(
+    std::expected<size_t, CloudError> CryptoProvider::encrypt_into(
         std::span<const std::byte> plaintext,
-        std::span<const std::byte> key)
+        std::span<const std::byte> key,
+        CipherSuite suite,
+        std::span<std::byte> out)
     {
-        if (key.size() != key_length()) {
+        if (key.size() != key_length() || !knownSuite(suite)) {
             return std::unexpected(onecloud::CloudError::EncryptionFailed);
         }
+        if (out.size() < plaintext.size() + overhead()) {
+            return std::unexpected(onecloud::CloudError::BufferTooSmall);
+        }
 
         try {
-            auto aead = Botan::AEAD_Mode::create_or_throw("ChaCha20Poly1305", Botan::Cipher_Dir::Encryption);
-            aead->set_key(reinterpret_cast<const uint8_t*>(key.data()), key.size());
-
-            auto nonce = random_bytes(nonce_length());
-            aead->start(reinterpret_cast<const uint8_t*>(nonce.data()), nonce.size());
+            auto& context = threadContext(suite, Botan::Cipher_Dir::Encryption);
+            auto& aead = context.get(suite, Botan::Cipher_Dir::Encryption, key);
 
-            Botan::secure_vector<uint8_t> buffer(
-                reinterpret_cast<const uint8_t*>(plaintext.data()),
-                reinterpret_cast<const uint8_t*>(plaintext.data()) + plaintext.size()
-            );
-            aead->finish(buffer);
+            auto* nonce = reinterpret_cast<uint8_t*>(out.data());
+            threadRng().randomize(nonce, nonce_length());
+            aead.start(nonce, nonce_length());
 
-            std::vector<std::byte> result;
-            result.reserve(nonce.size() + buffer.size());
-            result.insert(result.end(), nonce.begin(), nonce.end());
-            result.insert(result.end(), reinterpret_cast<const std::byte*>(buffer.data()), reinterpret_cast<const std::byte*>(buffer.data()) + buffer.size());
+            // Encrypt in place in the caller's buffer; finish() only has to append the tag.
+            auto* body = nonce + nonce_length();
+            if (!plaintext.empty() && reinterpret_cast<const std::byte*>(body) != plaintext.data()) {
+                std::memmove(body, plaintext.data(), plaintext.size());
+            }
+            // process() only takes whole multiples of the mode's granularity; finish() handles the rest.
+            const size_t bulk = plaintext.size() - plaintext.size() % aead.update_granularity();
+            size_t processed = aead.process(body, bulk);
 
-            return result;
+            context.tail.assign(body + processed, body + plaintext.size());
+            aead.finish(context.tail);
+            std::memcpy(body + processed, context.tail.data(), context.tail.size());
+            return nonce_length() + processed + context.tail.size();
         }
         catch (const std::exception&) {
             return std::unexpected(onecloud::CloudError::EncryptionFailed);
         }
     }
 
-    std::expected<std::vector<std::byte>, CloudError> CryptoProvider::decrypt(
+    std::expected<size_t, CloudError> CryptoProvider::decrypt_into(
         std::span<const std::byte> encrypted_data,
-        std::span<const std::byte> key)
+        std::span<const std::byte> key,
+        CipherSuite suite,
+        std::span<std::byte> out)
     {
-        if (key.size() != key_length() || encrypted_data.size() < nonce_length() + tag_length()) {
+        if (key.size() != key_length() || !knownSuite(suite) || encrypted_data.size() < overhead()) {
             return std::unexpected(onecloud::CloudError::EncryptionFailed);
         }
+        const size_t plaintext_size = encrypted_data.size() - overhead();
+        if (out.size() < plaintext_size) {
+            return std::unexpected(onecloud::CloudError::BufferTooSmall);
+        }
 
         try {
-            auto aead = Botan::AEAD_Mode::create_or_throw("ChaCha20Poly1305", Botan::Cipher_Dir::Decryption);
-            aead->set_key(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+            auto& context = threadContext(suite, Botan::Cipher_Dir::Decryption);
+            auto& aead = context.get(suite, Botan::Cipher_Dir::Decryption, key);
+
+            const auto* nonce = reinterpret_cast<const uint8_t*>(encrypted_data.data());
+            aead.start(nonce, nonce_length());
 
-            auto nonce = encrypted_data.subspan(0, nonce_length());
-            aead->start(reinterpret_cast<const uint8_t*>(nonce.data()), nonce.size());
+            // Hold the tag aside first: moving the ciphertext into 'out' may overwrite it.
+            const auto* tag = nonce + nonce_length() + plaintext_size;
+            context.tail.assign(tag, tag + tag_length());
 
-            auto ciphertext_and_tag = encrypted_data.subspan(nonce_length());
-            Botan::secure_vector<uint8_t> buffer(
-                reinterpret_cast<const uint8_t*>(ciphertext_and_tag.data()),
-                reinterpret_cast<const uint8_t*>(ciphertext_and_tag.data()) + ciphertext_and_tag.size()
-            );
-            aead->finish(buffer);
+            auto* body = reinterpret_cast<uint8_t*>(out.data());
+            if (plaintext_size > 0) {
+                std::memmove(body, nonce + nonce_length(), plaintext_size);
+            }
+            const size_t bulk = plaintext_size - plaintext_size % aead.update_granularity();
+            size_t processed = aead.process(body, bulk);
 
-            return std::vector<std::byte>(reinterpret_cast<const std::byte*>(buffer.data()), reinterpret_cast<const std::byte*>(buffer.data()) + buffer.size());
+            // Anything the mode did not consume (a partial block) is finished together with the tag.
+            context.tail.insert(context.tail.begin(), body + processed, body + plaintext_size);
+            aead.finish(context.tail);
+            std::memcpy(body + processed, context.tail.data(), context.tail.size());
+            return processed + context.tail.size();
         }
+        // process() has already decrypted into 'out' before the tag was checked: never leave
+        // unauthenticated plaintext in the caller's buffer.
         catch (const Botan::Invalid_Authentication_Tag&) {
+            std::memset(out.data(), 0, plaintext_size);
             return std::unexpected(onecloud::CloudError::InvalidPassword);
         }
         catch (const std::exception&) {
+            std::memset(out.data(), 0, plaintext_size);
+            return std::unexpected(onecloud::CloudError::EncryptionFailed);
+        }
+    }
+
+    std::expected<std::vector<std::byte>, CloudError> CryptoProvider::encrypt(
+        std::span<const std::byte> plaintext,
+        std::span<const std::byte> key,
+        CipherSuite suite)
+    {
+        std::vector<std::byte> result(plaintext.size() + overhead());
+        auto written = encrypt_into(plaintext, key, suite, result);
+        if (!written) return std::unexpected(written.error());
+        result.resize(*written);
+        return result;
+    }
+
+    std::expected<std::vector<std::byte>, CloudError> CryptoProvider::decrypt(
+        std::span<const std::byte> encrypted_data,
+        std::span<const std::byte> key,
+        CipherSuite suite)
+    {
+        if (encrypted_data.size() < overhead()) {
             return std::unexpected(onecloud::CloudError::EncryptionFailed);
         }
+        std::vector<std::byte> result(encrypted_data.size() - overhead());
+        auto written = decrypt_into(encrypted_data, key, suite, result);
+        if (!written) return std::unexpected(written.error());
+        result.resize(*written);
+        return result;
     }
 
 } // namespace onecloud
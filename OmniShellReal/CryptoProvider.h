@@ -8,7 +8,9 @@ Copyright © 2025 Cadell Richard Anderson
 #include <string>
 #include <expected>
 #include <span>
+#include <string_view>
 #include "CloudAPI.h" 
+#include "types.h"
 
 namespace onecloud {
 
@@ -19,6 +21,10 @@ namespace onecloud {
      * This class abstracts the underlying crypto library (Botan), offering a stable
      * and easy-to-use set of functions for key derivation, authenticated encryption,
      * and random data generation.
+     *
+     * Cipher objects are cached per thread and per suite, so repeated calls with the same key
+     * skip both the object construction and the key schedule. Every suite uses the same
+     * [nonce][ciphertext][tag] layout and sizes.
      */
     class CryptoProvider {
     public:
@@ -33,24 +39,60 @@ namespace onecloud {
             std::span<const std::byte> salt);
 
         /**
-         * @brief Encrypts and authenticates a block of data using ChaCha20-Poly1305.
+         * @brief Encrypts and authenticates a block of data.
          * @param plaintext The data to encrypt.
          * @param key The 32-byte encryption key.
+         * @param suite The AEAD to use (ChaCha20-Poly1305 unless the container says otherwise).
          * @return A single buffer containing [nonce][ciphertext][authentication_tag], or a CloudError.
          */
         static std::expected<std::vector<std::byte>, CloudError> encrypt(
             std::span<const std::byte> plaintext,
-            std::span<const std::byte> key);
+            std::span<const std::byte> key,
+            CipherSuite suite = CipherSuite::ChaCha20Poly1305);
 
         /**
-         * @brief Decrypts and verifies a block of data encrypted with ChaCha20-Poly1305.
+         * @brief Decrypts and verifies a block of data.
          * @param encrypted_data The buffer containing [nonce][ciphertext][authentication_tag].
          * @param key The 32-byte decryption key.
+         * @param suite The AEAD the data was encrypted with.
          * @return The original plaintext on success, or a CloudError if decryption or verification fails.
          */
         static std::expected<std::vector<std::byte>, CloudError> decrypt(
             std::span<const std::byte> encrypted_data,
-            std::span<const std::byte> key);
+            std::span<const std::byte> key,
+            CipherSuite suite = CipherSuite::ChaCha20Poly1305);
+
+        /**
+         * @brief Encrypts into a caller-provided buffer without any intermediate allocation.
+         * @param out Receives [nonce][ciphertext][tag]; must hold at least plaintext.size() + overhead() bytes.
+         *        To encrypt in place, put the plaintext at out.data() + nonce_length(); any other overlap is undefined.
+         * @return The number of bytes written, or BufferTooSmall / EncryptionFailed.
+         */
+        static std::expected<size_t, CloudError> encrypt_into(
+            std::span<const std::byte> plaintext,
+            std::span<const std::byte> key,
+            CipherSuite suite,
+            std::span<std::byte> out);
+
+        /**
+         * @brief Decrypts and verifies into a caller-provided buffer.
+         * @param out Receives the plaintext; must hold encrypted_data.size() - overhead() bytes. It may point
+         *        anywhere inside 'encrypted_data' (e.g. its first byte) to decrypt in place.
+         * @return The plaintext size, or InvalidPassword if the tag does not verify. On any failure after
+         *         decryption started, the plaintext-sized prefix of 'out' is zeroed.
+         */
+        static std::expected<size_t, CloudError> decrypt_into(
+            std::span<const std::byte> encrypted_data,
+            std::span<const std::byte> key,
+            CipherSuite suite,
+            std::span<std::byte> out);
+
+        /**
+         * @brief The fastest suite on this machine: AES-256-GCM when the CPU accelerates both AES and
+         *        GHASH (AES-NI + CLMUL, or the ARMv8 AES + PMULL extensions), otherwise ChaCha20-Poly1305.
+         */
+        static CipherSuite preferred_suite();
+        static std::string_view suite_name(CipherSuite suite);
 
         /**
          * @brief Generates a buffer of cryptographically secure random bytes.
@@ -63,8 +105,9 @@ namespace onecloud {
         // These define the required sizes for keys, salts, etc., for the container format.
         static constexpr size_t key_length() { return 32; } // 256-bit key
         static constexpr size_t salt_length() { return 16; } // 128-bit salt
-        static constexpr size_t nonce_length() { return 12; } // 96-bit nonce for ChaCha20
-        static constexpr size_t tag_length() { return 16; } // 128-bit Poly1305 tag
+        static constexpr size_t nonce_length() { return 12; } // 96-bit nonce for ChaCha20 and GCM
+        static constexpr size_t tag_length() { return 16; } // 128-bit Poly1305 / GCM tag
+        static constexpr size_t overhead() { return nonce_length() + tag_length(); }
     };
 
 } // namespace onecloud
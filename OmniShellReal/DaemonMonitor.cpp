@@ -9,9 +9,110 @@ Copyright © 2025 Cadell Richard Anderson
 #include "ShellExecutor.h"
 #include "CommandRouter.h"
 #include "TileAnalytics.h"
+#include "TimeSeriesStore.h"
+#include "TimerWheel.h"
+#include "PMU.h"
 #include <iostream>
 #include <chrono>
 #include <iomanip>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Millis = std::chrono::milliseconds;
+
+    constexpr size_t WORKER_COUNT = 2;     // a slow repair run must not hold up the sensor poll
+    constexpr double HOT_PRESSURE = 0.85;  // at or above: every task runs at its minimum period
+    constexpr double CALM_PRESSURE = 0.5;  // below: idle tasks stretch toward their maximum period
+    constexpr unsigned MAX_BACKOFF_SHIFT = 6;
+
+    // What a run reports back; together with the system pressure it picks the next period.
+    enum class TaskOutcome { Idle, Normal, Urgent, Failed };
+
+    struct DaemonTask {
+        std::string name;
+        Millis base, min, max;
+        double jitter = 0.1;                    // +/- fraction of the period, so tasks drift apart
+        std::function<TaskOutcome()> run;
+
+        Millis period{ 0 };
+        unsigned failures = 0;
+        bool running = false;
+        uint64_t runs = 0;
+        uint64_t coalesced = 0;                 // firings dropped because the previous run was still going
+        double lastMs = 0.0;
+        TaskOutcome lastOutcome = TaskOutcome::Idle;
+    };
+
+    const char* outcomeName(TaskOutcome o) {
+        switch (o) {
+        case TaskOutcome::Idle: return "idle";
+        case TaskOutcome::Normal: return "normal";
+        case TaskOutcome::Urgent: return "urgent";
+        default: return "failed";
+        }
+    }
+
+    Millis periodOf(int s) { return std::chrono::duration_cast<Millis>(std::chrono::seconds(std::max(s, 1))); }
+
+    // How close the machine is to a limit, as a fraction of it (1.0 = at the threshold): the CPU
+    // temperature against cpuThreshold (degrees C, as decideProfile uses it) and the CPU load against
+    // 100%. Other thermal sensors (GPU, NVMe) have their own limits and do not count.
+    double computePressure(const std::vector<SensorData>& sensors, const ConfigState& cfg) {
+        double p = 0.0;
+        const double tempLimit = std::max(cfg.cpuThreshold, 1);
+        for (const auto& s : sensors) {
+            if (s.id == "thermal_cpu") p = std::max(p, s.value / tempLimit);
+            else if (s.id == "cpu_load") p = std::max(p, s.value / 100.0);
+        }
+        return p;
+    }
+}
+
+struct DaemonMonitor::Scheduler {
+    std::mutex mutex;
+    std::condition_variable wakeCv;     // monitor thread: the wheel changed or we are stopping
+    std::condition_variable workCv;     // workers: a task was queued or we are stopping
+    TimerWheel wheel;
+    std::vector<DaemonTask> tasks;
+    std::deque<size_t> ready;
+    ConfigState config;                 // shared copy; the sensor task applies sampling profiles to it
+    std::minstd_rand rng{ std::random_device{}() };
+    std::atomic<double> pressure{ 0.0 };
+    std::optional<PMU::ProcessSample> lastPmuSample;
+
+    explicit Scheduler(const ConfigState& cfg) : config(cfg) {}
+
+    ConfigState configCopy() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return config;
+    }
+
+    // Called with 'mutex' held after a run.
+    Millis nextPeriod(DaemonTask& t, TaskOutcome outcome) {
+        const double p = pressure.load(std::memory_order_relaxed);
+        if (outcome == TaskOutcome::Failed) {
+            ++t.failures;
+            t.period = std::min(t.base * (1u << std::min(t.failures, MAX_BACKOFF_SHIFT)), t.max);
+        }
+        else {
+            t.failures = 0;
+            if (outcome == TaskOutcome::Urgent || p >= HOT_PRESSURE) t.period = t.min;
+            else if (outcome == TaskOutcome::Idle && p < CALM_PRESSURE) t.period = std::min(t.period * 3 / 2, t.max);
+            else t.period = t.base;
+            t.period = std::clamp(t.period, t.min, t.max);
+        }
+        std::uniform_real_distribution<double> spread(1.0 - t.jitter, 1.0 + t.jitter);
+        return Millis(static_cast<long long>(t.period.count() * spread(rng)));
+    }
+};
 
 DaemonMonitor::DaemonMonitor() : isRunning(false) {}
 
@@ -24,28 +125,223 @@ void DaemonMonitor::start(const ConfigState& config) {
         std::cout << "[Daemon] Monitor is already running." << std::endl;
         return;
     }
+    if (!config.metricsSpillDir.empty()) {
+        SpillRetention retention;
+        retention.max_bytes = static_cast<uint64_t>(std::max(config.metricsSpillMaxMB, 0)) << 20;
+        retention.max_age = std::chrono::hours(std::max(config.metricsSpillMaxHours, 0));
+        if (!TimeSeriesStore::instance().enableSpill(config.metricsSpillDir, retention)) {
+            std::cout << "[Daemon] Metric spill disabled: cannot use " << config.metricsSpillDir << std::endl;
+        }
+    }
+
+    scheduler = std::make_unique<Scheduler>(config);
+    Scheduler& sched = *scheduler;
+    const Millis interval = periodOf(config.daemonIntervalSeconds);
+
+    // Sensor poll: feeds the metric history, sets the system pressure every other task adapts to,
+    // and applies the sampling profile as soon as a threshold is approached.
+    sched.tasks.push_back({ "sensors", periodOf(config.sensorPollSeconds), Millis(1000),
+        std::max(periodOf(config.sensorPollSeconds), interval), 0.1, [this, &sched]() {
+            auto sensors = SensorManager::snapshot(Millis(0));
+            auto& store = TimeSeriesStore::instance();
+            for (const auto& s : sensors) {
+                store.append("sensor." + s.id, s.value, s.unit, s.timestamp);
+            }
+            double p;
+            {
+                std::lock_guard<std::mutex> lock(sched.mutex);
+                p = computePressure(sensors, sched.config);
+                OmniAIManager::applySamplingProfile(decideProfile(sensors, sched.config), sched.config);
+            }
+            sched.pressure.store(p, std::memory_order_relaxed);
+            store.append("daemon.pressure", p);
+            if (p >= HOT_PRESSURE) return TaskOutcome::Urgent;
+            return p < CALM_PRESSURE ? TaskOutcome::Idle : TaskOutcome::Normal;
+        } });
+
+    // PMU self-sample: the first run only takes the baseline.
+    sched.tasks.push_back({ "pmu", periodOf(config.pmuSampleSeconds), Millis(2000),
+        std::max(periodOf(config.pmuSampleSeconds) * 6, interval), 0.1, [&sched]() {
+            PMU::ProcessSample curr = PMU::SampleSelf();
+            if (sched.lastPmuSample) PMU::PublishDelta(*sched.lastPmuSample, curr, 5);
+            sched.lastPmuSample = std::move(curr);
+            return TaskOutcome::Idle;
+        } });
+
+    // Tile probe: only while the CPU is over its threshold.
+    sched.tasks.push_back({ "tile", interval, Millis(10000), std::max(interval * 20, Millis(10000)), 0.1, [&sched]() {
+            ConfigState cfg = sched.configCopy();
+            auto sensors = SensorManager::snapshot(periodOf(cfg.sensorPollSeconds));
+            bool hot_cpu = std::any_of(sensors.begin(), sensors.end(), [&](const SensorData& s) {
+                return s.id == "thermal_cpu" && s.value > cfg.cpuThreshold;
+            });
+            if (!hot_cpu) return TaskOutcome::Idle;
+
+            std::cout << "[Daemon] CPU hot, running tile probe with PMU...\n";
+            // Minimal buffer seeded by chunks
+            std::vector<uint16_t> chunks = { 0xDEF0,0x9ABC,0x5678,0x1234,0xDEF0,0x9ABC,0x5678,0x1234 };
+            TileRunConfig tcfg;
+            tcfg.rows = 128; tcfg.cols = 128;
+            tcfg.target_time_ms = cfg.tileTargetTimeMs;
+            tcfg.high_prio_fraction = cfg.tileHighPrioFraction;
+            tcfg.overlap_h = cfg.tileOverlapH;
+            tcfg.overlap_w = cfg.tileOverlapW;
+            tcfg.out_dir = cfg.tileOutDir;
+            tcfg.run_tag = "daemon";
+            auto summary = TileAnalytics::RunFromChunks(chunks, tcfg);
+            std::cout << "[Daemon] Tile probe done: wall=" << std::fixed << std::setprecision(3)
+                << summary.wall_ms << " ms, csv=" << summary.csv_path << "\n";
+            return TaskOutcome::Normal;
+        } });
+
+    // Repair analysis: asks the AI for a plan and executes it.
+    sched.tasks.push_back({ "repair", interval, Millis(10000), std::max(interval * 20, Millis(10000)), 0.1, [&sched]() {
+            ConfigState cfg = sched.configCopy();
+            auto sensors = SensorManager::snapshot(periodOf(cfg.sensorPollSeconds));
+            auto plan = OmniAIManager::analyzeAndRecommend(sensors, cfg);
+            if (plan.empty() || (plan.size() == 1 && plan[0].description == "System appears nominal.")) {
+                std::cout << "[Daemon] AI Analysis: System nominal." << std::endl;
+                return TaskOutcome::Idle;
+            }
+
+            std::cout << "[Daemon] AI has recommended a repair plan. Executing..." << std::endl;
+            for (const auto& step : plan) {
+                std::cout << "  - Executing Step: " << step.description << std::endl;
+                std::string result;
+                switch (step.shell) {
+                case ShellType::CMD:
+                    result = ShellExecutor::run(step.command);
+                    break;
+                case ShellType::POWERSHELL:
+                    result = ShellExecutor::runPowerShell(step.command);
+                    break;
+                case ShellType::OMNI:
+                {
+                    CommandRouter router; // Create a temporary router instance
+                    result = router.dispatch(step.command);
+                }
+                break;
+                case ShellType::BASH:
+                    result = ShellExecutor::run(step.command);
+                    break;
+                }
+                std::cout << "    Result:\n" << result << std::endl;
+            }
+            return TaskOutcome::Normal;
+        } });
+
+    // Sensors and PMU start right away; analysis follows once the first readings are in.
+    const auto now = Clock::now();
+    const Millis firstDue[] = { Millis(0), Millis(0), interval, Millis(500) };
+    for (size_t i = 0; i < sched.tasks.size(); ++i) {
+        sched.tasks[i].period = sched.tasks[i].base;
+        sched.wheel.schedule(i, now + firstDue[i]);
+    }
+
     isRunning = true;
-    monitorThread = std::thread(&DaemonMonitor::monitorLoop, this, config);
+    for (size_t i = 0; i < WORKER_COUNT; ++i) workers.emplace_back(&DaemonMonitor::workerLoop, this);
+    monitorThread = std::thread(&DaemonMonitor::monitorLoop, this);
     std::cout << "[Daemon] AI maintenance monitor started." << std::endl;
 }
 
 void DaemonMonitor::stop() {
     if (isRunning) {
-        isRunning = false;
+        {
+            std::lock_guard<std::mutex> lock(scheduler->mutex);
+            isRunning = false;
+        }
+        scheduler->wakeCv.notify_all();
+        scheduler->workCv.notify_all();
         if (monitorThread.joinable()) {
             monitorThread.join();
         }
+        for (auto& w : workers) {
+            if (w.joinable()) w.join();
+        }
+        workers.clear();
         std::cout << "[Daemon] AI maintenance monitor stopped." << std::endl;
     }
 }
 
 std::string DaemonMonitor::getStatus() const {
     if (isRunning) {
-        return "[Daemon] Status: Active.";
+        std::ostringstream out;
+        out << "[Daemon] Status: Active.";
+        std::lock_guard<std::mutex> lock(scheduler->mutex);
+        out << " pressure=" << std::fixed << std::setprecision(2) << scheduler->pressure.load();
+        for (const auto& t : scheduler->tasks) {
+            out << "\n  " << std::left << std::setw(8) << t.name << std::right
+                << " every " << std::setprecision(1) << t.period.count() / 1000.0 << "s"
+                << "  runs=" << t.runs << "  last=" << outcomeName(t.lastOutcome)
+                << " (" << std::setprecision(2) << t.lastMs << " ms)";
+            if (t.failures) out << "  failures=" << t.failures;
+            if (t.coalesced) out << "  coalesced=" << t.coalesced;
+            if (t.running) out << "  [running]";
+        }
+        return out.str();
     }
     return "[Daemon] Status: Inactive.";
 }
 
+void DaemonMonitor::monitorLoop() {
+    Scheduler& sched = *scheduler;
+    std::vector<uint64_t> due;
+    std::unique_lock<std::mutex> lock(sched.mutex);
+    while (isRunning) {
+        const auto now = Clock::now();
+        due.clear();
+        sched.wheel.advance(now, due);
+        for (uint64_t id : due) {
+            DaemonTask& t = sched.tasks[id];
+            if (t.running) {
+                // Still busy from the last firing: skip this one rather than queue a backlog.
+                ++t.coalesced;
+                sched.wheel.schedule(id, now + t.period);
+                continue;
+            }
+            t.running = true;
+            sched.ready.push_back(id);
+        }
+        if (!sched.ready.empty()) sched.workCv.notify_all();
+
+        // Sleep until the next deadline; a worker re-arming a task or stop() wakes us early.
+        auto wake = sched.wheel.nextWake().value_or(now + std::chrono::seconds(1));
+        sched.wakeCv.wait_until(lock, wake);
+    }
+}
+
+void DaemonMonitor::workerLoop() {
+    Scheduler& sched = *scheduler;
+    std::unique_lock<std::mutex> lock(sched.mutex);
+    while (true) {
+        sched.workCv.wait(lock, [&] { return !isRunning || !sched.ready.empty(); });
+        if (!isRunning) break;
+        const size_t id = sched.ready.front();
+        sched.ready.pop_front();
+        DaemonTask& t = sched.tasks[id];
+
+        lock.unlock();
+        const auto t0 = Clock::now();
+        TaskOutcome outcome;
+        try {
+            outcome = t.run();
+        }
+        catch (const std::exception& e) {
+            std::cout << "[Daemon] Task " << t.name << " failed: " << e.what() << std::endl;
+            outcome = TaskOutcome::Failed;
+        }
+        const auto t1 = Clock::now();
+        lock.lock();
+
+        t.running = false;
+        ++t.runs;
+        t.lastOutcome = outcome;
+        t.lastMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        sched.wheel.schedule(id, t1 + sched.nextPeriod(t, outcome));
+        sched.wakeCv.notify_one();
+    }
+}
+
 // NEW: properly defined as a class member, outside monitorLoop
 void DaemonMonitor::captureTileTelemetry() {
     std::vector<uint16_t> chunks = { 0xDEF0,0x9ABC,0x5678,0x1234,0xDEF0,0x9ABC,0x5678,0x1234 };
@@ -85,72 +381,3 @@ SamplingProfile DaemonMonitor::decideProfile(
     if (low_battery) return SamplingProfile::FastPreview;
     return SamplingProfile::Balanced;
 }
-
-void DaemonMonitor::monitorLoop(ConfigState config) {
-    while (isRunning) {
-        std::cout << "\n[Daemon] Running periodic check..." << std::endl;
-        auto sensors = SensorManager::listSensors();
-
-        // Apply adaptive sampling profile
-        auto chosen = decideProfile(sensors, config);
-        OmniAIManager::applySamplingProfile(chosen, config);
-        std::cout << "[Daemon] Applied profile: " << static_cast<int>(chosen) << std::endl;
-
-        auto plan = OmniAIManager::analyzeAndRecommend(sensors, config);
-
-        bool hot_cpu = false;
-        for (const auto& s : sensors) {
-            if (s.id == "thermal_cpu" && s.value > config.cpuThreshold) {
-                hot_cpu = true;
-                break;
-            }
-        }
-        if (hot_cpu) {
-            std::cout << "[Daemon] CPU hot, running tile probe with PMU...\n";
-            // Minimal buffer seeded by chunks
-            std::vector<uint16_t> chunks = { 0xDEF0,0x9ABC,0x5678,0x1234,0xDEF0,0x9ABC,0x5678,0x1234 };
-            TileRunConfig tcfg;
-            tcfg.rows = 128; tcfg.cols = 128;
-            tcfg.target_time_ms = config.tileTargetTimeMs;
-            tcfg.high_prio_fraction = config.tileHighPrioFraction;
-            tcfg.overlap_h = config.tileOverlapH;
-            tcfg.overlap_w = config.tileOverlapW;
-            tcfg.out_dir = config.tileOutDir;
-            tcfg.run_tag = "daemon";
-            auto summary = TileAnalytics::RunFromChunks(chunks, tcfg);
-            std::cout << "[Daemon] Tile probe done: wall=" << std::fixed << std::setprecision(3)
-                << summary.wall_ms << " ms, csv=" << summary.csv_path << "\n";
-        }
-
-        if (!plan.empty() && !(plan.size() == 1 && plan[0].description == "System appears nominal.")) {
-            std::cout << "[Daemon] AI has recommended a repair plan. Executing..." << std::endl;
-            for (const auto& step : plan) {
-                std::cout << "  - Executing Step: " << step.description << std::endl;
-                std::string result;
-                switch (step.shell) {
-                case ShellType::CMD:
-                    result = ShellExecutor::run(step.command);
-                    break;
-                case ShellType::POWERSHELL:
-                    result = ShellExecutor::runPowerShell(step.command);
-                    break;
-                case ShellType::OMNI:
-                {
-                    CommandRouter router; // Create a temporary router instance
-                    result = router.dispatch(step.command);
-                }
-                break;
-                case ShellType::BASH:
-                    result = ShellExecutor::run(step.command);
-                    break;
-                }
-                std::cout << "    Result:\n" << result << std::endl;
-            }
-        }
-        else {
-            std::cout << "[Daemon] AI Analysis: System nominal." << std::endl;
-        }
-
-        std::this_thread::sleep_for(std::chrono::seconds(config.daemonIntervalSeconds));
-    }
-}
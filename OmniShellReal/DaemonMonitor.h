@@ -6,6 +6,7 @@ Copyright © 2025 Cadell Richard Anderson
 #include "SensorManager.h"  
 #include <thread>
 #include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -28,8 +29,16 @@ public:
     );
 
 private:
-    void monitorLoop(ConfigState config);
+    // Timer-wheel scheduler state and the periodic tasks; defined in DaemonMonitor.cpp.
+    struct Scheduler;
+
+    // Fires due tasks from the timer wheel onto the workers.
+    void monitorLoop();
+    // Runs queued tasks and re-arms each with its adapted period.
+    void workerLoop();
 
     std::atomic<bool> isRunning;
     std::thread monitorThread;
+    std::vector<std::thread> workers;
+    std::unique_ptr<Scheduler> scheduler;
 };
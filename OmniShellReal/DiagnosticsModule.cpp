@@ -5,9 +5,12 @@ Copyright © 2025 Cadell Richard Anderson
 #include "DiagnosticsModule.h"
 #include "ShellExecutor.h"
 #include "BinaryTranslator.h"
+#include "BinaryFeatures.h"
 #include "JobManager.h"
 #include "OmniEditorIDE.h"
 #include "OmniAIManager.h" // Include for AI summarization
+#include "SignatureMatcher.h"
+#include "ScanCache.h"
 
 #include <iostream>
 #include <sstream>
@@ -17,6 +20,9 @@ Copyright © 2025 Cadell Richard Anderson
 #include <filesystem>
 #include <fstream>
 #include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #ifdef _WIN32
 #include <tlhelp32.h>
@@ -104,57 +110,145 @@ std::string DiagnosticsModule::ScanRegistry(const std::string&, const std::vecto
 #endif
 
 double DiagnosticsModule::calculateEntropy(const std::vector<unsigned char>& data) {
-    if (data.empty()) return 0.0;
-    std::unordered_map<unsigned char, size_t> freq;
-    for (unsigned char byte : data) freq[byte]++;
-
-    double entropy = 0.0;
-    for (const auto& pair : freq) {
-        double p = static_cast<double>(pair.second) / data.size();
-        entropy -= p * std::log2(p);
-    }
-    return entropy;
+    return calculateEntropy(std::span<const unsigned char>(data));
 }
 
 // ======================= NEW: Signature Matching =======================
-bool DiagnosticsModule::matchSignatures(const std::vector<unsigned char>& data, std::string& matchedSigName) {
-    static const std::vector<std::pair<std::string, std::vector<unsigned char>>> signatures = {
-        { "MZ_Header", { 'M', 'Z' } },
-        { "UPX_Packer", { 'U', 'P', 'X', '!' } },
-        { "ELF_Header", { 0x7F, 'E', 'L', 'F' } },
-        { "Malicious_DLL_Load", { 'L','o','a','d','L','i','b','r','a','r','y','A' } },
-        { "Suspicious_PowerShell", { 'P','o','w','e','r','S','h','e','l','l' } }
-    };
+namespace {
+    using SignatureList = std::vector<std::pair<std::string, std::vector<unsigned char>>>;
+
+    const SignatureList& builtinSignatures() {
+        static const SignatureList signatures = {
+            { "MZ_Header", { 'M', 'Z' } },
+            { "UPX_Packer", { 'U', 'P', 'X', '!' } },
+            { "ELF_Header", { 0x7F, 'E', 'L', 'F' } },
+            { "Malicious_DLL_Load", { 'L','o','a','d','L','i','b','r','a','r','y','A' } },
+            { "Suspicious_PowerShell", { 'P','o','w','e','r','S','h','e','l','l' } }
+        };
+        return signatures;
+    }
 
-    for (const auto& sig : signatures) {
-        auto it = std::search(data.begin(), data.end(), sig.second.begin(), sig.second.end());
-        if (it != data.end()) {
-            matchedSigName = sig.first;
-            return true;
-        }
+    // Scans hold their own reference, so a reload never pulls the matcher out from under them.
+    std::mutex g_signatureMutex;
+    std::shared_ptr<const SignatureMatcher> g_signatureMatcher;
+    SignatureList g_configSignatures;
+
+    std::shared_ptr<const SignatureMatcher> compileSignatures(const SignatureList& configPatterns) {
+        auto matcher = std::make_shared<SignatureMatcher>();
+        for (const auto& [name, bytes] : builtinSignatures()) matcher->add(name, bytes);
+        for (const auto& [name, bytes] : configPatterns) matcher->add(name, bytes);
+        matcher->compile();
+        return matcher;
+    }
+
+    std::shared_ptr<const SignatureMatcher> currentSignatures() {
+        std::lock_guard<std::mutex> lock(g_signatureMutex);
+        if (!g_signatureMatcher) g_signatureMatcher = compileSignatures(g_configSignatures);
+        return g_signatureMatcher;
     }
-    return false;
+
+    // The signatures found in one file, which may be fed block by block.
+    struct SignatureHits {
+        SignatureMatcher::Stream stream;
+        std::map<uint32_t, std::pair<uint64_t, uint64_t>> found; // pattern -> first offset, hits
+
+        void feed(const SignatureMatcher& matcher, std::span<const unsigned char> block) {
+            matcher.feed(stream, block, [&](const SignatureMatch& m) {
+                auto [it, added] = found.try_emplace(m.pattern, m.offset, 0);
+                it->second.second++;
+                return true;
+                });
+        }
+
+        // Every signature found, each with its first offset and hit count; empty if none.
+        std::string describe(const SignatureMatcher& matcher) const {
+            std::stringstream ss;
+            for (const auto& [pattern, hit] : found) {
+                if (ss.tellp() > 0) ss << ", ";
+                ss << matcher.name(pattern) << "@0x" << std::hex << hit.first << std::dec;
+                if (hit.second > 1) ss << " x" << hit.second;
+            }
+            return ss.str();
+        }
+    };
 }
-// =======================================================================
 
-std::string DiagnosticsModule::analyzeAndReport(const std::string& filePath, const std::string& reportDir) {
-    JobManager::SubmitJob([filePath, reportDir]() {
-        std::string filename = std::filesystem::path(filePath).filename().string();
+void DiagnosticsModule::LoadSignatures(const std::vector<std::pair<std::string, std::vector<unsigned char>>>& configPatterns) {
+    std::lock_guard<std::mutex> lock(g_signatureMutex);
+    if (g_signatureMatcher && configPatterns == g_configSignatures) return;
+    g_signatureMatcher = compileSignatures(configPatterns);
+    g_configSignatures = configPatterns;
+}
 
-        std::string decompiledCode = BinaryTranslator::Decompile(filePath);
+std::string DiagnosticsModule::SignatureStats() {
+    auto matcher = currentSignatures();
+    size_t configCount;
+    {
+        std::lock_guard<std::mutex> lock(g_signatureMutex);
+        configCount = g_configSignatures.size();
+    }
+    std::stringstream ss;
+    ss << "Signatures: " << matcher->patternCount() << " (" << builtinSignatures().size() << " built-in, "
+        << configCount << " from config)\n";
+    ss << "Automaton:  " << matcher->stateCount() << " states, " << matcher->denseStateCount()
+        << " with dense rows, " << std::fixed << std::setprecision(1) << matcher->memoryBytes() / 1024.0 << " KiB";
+    return ss.str();
+}
 
-        std::string summary = OmniAIManager::summarize(decompiledCode);
+bool DiagnosticsModule::matchSignatures(const SignatureMatcher& matcher, std::span<const unsigned char> data, std::string& matchedSigName) {
+    SignatureHits hits;
+    hits.feed(matcher, data);
+    if (hits.found.empty()) return false;
+    matchedSigName = hits.describe(matcher);
+    return true;
+}
+// =======================================================================
 
+// Runs as a small job graph on the background pool: the decompiler, followed by the AI summary, in
+// parallel with the heuristic scan, then the report once both are in. Low priority, so a scan that flags
+// many files does not crowd out interactive jobs.
+std::string DiagnosticsModule::analyzeAndReport(const std::string& filePath, const std::string& reportDir) {
+    struct Analysis {
+        std::string filename;
+        std::string decompiledCode;
+        std::string summary;
+        std::string heuristics;
+    };
+    auto analysis = std::make_shared<Analysis>();
+    analysis->filename = std::filesystem::path(filePath).filename().string();
+
+    TaskOptions low;
+    low.priority = JobPriority::Low;
+
+    TaskHandle decompile = JobManager::SubmitJob([analysis, filePath]() {
+        analysis->decompiledCode = BinaryTranslator::Decompile(filePath);
+        }, low);
+
+    TaskOptions afterDecompile = low;
+    afterDecompile.after = { decompile };
+    TaskHandle summarize = JobManager::SubmitJob([analysis]() {
+        analysis->summary = OmniAIManager::summarize(analysis->decompiledCode);
+        }, afterDecompile);
+
+    // Works from the cached import/string features, so it runs alongside the decompiler instead of
+    // searching its output.
+    TaskHandle heuristics = JobManager::SubmitJob([analysis, filePath]() {
+        std::string error;
+        auto features = BinaryFeatures::Extract(filePath, &error);
+        analysis->heuristics = features ? BinaryFeatures::FormatBehaviors(BinaryFeatures::DetectBehaviors(*features))
+            : "[Error: " + error + "]\n";
+        }, low);
+
+    TaskOptions afterBoth = low;
+    afterBoth.after = { summarize, heuristics };
+    JobManager::SubmitJob([analysis, reportDir]() {
+        const std::string& filename = analysis->filename;
         std::ostringstream reportContent;
         reportContent << "AI Analysis for: " << filename << "\n";
         reportContent << "======================================\n\n";
-        reportContent << "--- AI Summary ---\n" << summary << "\n\n";
+        reportContent << "--- AI Summary ---\n" << analysis->summary << "\n\n";
         reportContent << "--- Heuristic Detections ---\n";
-        if (decompiledCode.find("CreateRemoteThread") != std::string::npos) reportContent << "[!] Code Injection Detected\n";
-        if (decompiledCode.find("GetProcAddress") != std::string::npos) reportContent << "[!] Dynamic API Resolution Detected\n";
-        if (decompiledCode.find("WriteProcessMemory") != std::string::npos) reportContent << "[!] Memory Tampering Detected\n";
-        if (decompiledCode.find("socket") != std::string::npos || decompiledCode.find("WSASocket") != std::string::npos) reportContent << "[!] Network Activity Detected\n";
-        if (decompiledCode.find("RegCreateKey") != std::string::npos || decompiledCode.find("RegSetValue") != std::string::npos) reportContent << "[!] Registry Manipulation Detected\n";
+        reportContent << analysis->heuristics;
 
         try {
             std::filesystem::create_directories(reportDir);
@@ -167,68 +261,106 @@ std::string DiagnosticsModule::analyzeAndReport(const std::string& filePath, con
         catch (const std::exception& e) {
             std::cerr << "Error writing report: " << e.what() << "\n";
         }
-        });
-    return "Analysis job for " + std::filesystem::path(filePath).filename().string() + " submitted to background queue.";
+        }, afterBoth);
+    return "Analysis job for " + analysis->filename + " submitted to background queue.";
 }
 
-std::string DiagnosticsModule::ScanFileEntropy(const std::string& path, const std::string& quarantineDir, const std::string& reportDir, double entropyThreshold) {
+std::string DiagnosticsModule::ScanFileEntropy(const std::string& path, const std::string& quarantineDir, const std::string& reportDir, double entropyThreshold,
+    const FileScanOptions& options) {
     std::stringstream ss;
     if (!std::filesystem::exists(path)) {
         return "Error: Path does not exist.";
     }
 
-    try {
-        auto scan_file = [&](const std::filesystem::path& filePath) {
-            std::ifstream file(filePath, std::ios::binary);
-            if (!file) return;
-            std::vector<unsigned char> buffer(std::istreambuf_iterator<char>(file), {});
+    // The line for each file is printed as its result comes in, so a big tree shows progress and its
+    // listing is never held in memory; the returned string is the summary.
+    auto emit = [](const std::string& text) { std::cout << text << std::flush; };
 
-            // ===== Signature detection before entropy check =====
-            std::string matchedSig;
-            if (matchSignatures(buffer, matchedSig)) {
-                ss << "  - " << filePath.string() << ": [SIGNATURE MATCH: " << matchedSig << "]";
-                try {
-                    std::filesystem::create_directories(quarantineDir);
-                    std::filesystem::copy(filePath, std::filesystem::path(quarantineDir) / filePath.filename(), std::filesystem::copy_options::overwrite_existing);
-                    ss << " -> Quarantined due to signature.\n";
-                    ss << "    " << analyzeAndReport(filePath.string(), reportDir) << "\n";
-                }
-                catch (const std::exception& e) {
-                    ss << " -> Failed to quarantine: " << e.what() << "\n";
-                }
-                return; // Skip entropy check if signature found
-            }
-            // =====================================================
+    // Flagged files are quarantined once the scan is done, not from onResult, which runs under the
+    // scanner's result lock and would hold up every worker while a file is copied.
+    struct Flagged {
+        FileScanResult result;
+        const char* reason;
+    };
+    std::vector<Flagged> flagged;
 
-            double entropy = calculateEntropy(buffer);
-            ss << "  - " << filePath.string() << ": " << std::fixed << std::setprecision(4) << entropy;
-            if (entropy > entropyThreshold) {
-                ss << " [HIGH ENTROPY DETECTED]";
-                try {
-                    std::filesystem::create_directories(quarantineDir);
-                    std::filesystem::copy(filePath, std::filesystem::path(quarantineDir) / filePath.filename(), std::filesystem::copy_options::overwrite_existing);
-                    ss << " -> Quarantined.\n";
-                    ss << "    " << analyzeAndReport(filePath.string(), reportDir) << "\n";
-                }
-                catch (const std::exception& e) {
-                    ss << " -> Failed to quarantine: " << e.what() << "\n";
-                }
+    auto quarantine = [&](const FileScanResult& r, const char* reason) {
+        const std::filesystem::path& filePath = r.path;
+        std::ostringstream out;
+        out << "  - " << filePath.string();
+        try {
+            // A cached verdict is for content an earlier scan already quarantined and reported on.
+            if (r.cached && std::filesystem::exists(std::filesystem::path(quarantineDir) / filePath.filename())) {
+                out << " -> Already quarantined" << reason << " (unchanged since last scan).\n";
             }
             else {
-                ss << "\n";
+                std::filesystem::create_directories(quarantineDir);
+                std::filesystem::copy(filePath, std::filesystem::path(quarantineDir) / filePath.filename(), std::filesystem::copy_options::overwrite_existing);
+                out << " -> Quarantined" << reason << ".\n";
+                out << "    " << analyzeAndReport(filePath.string(), reportDir) << "\n";
             }
-            };
+        }
+        catch (const std::exception& e) {
+            out << " -> Failed to quarantine: " << e.what() << "\n";
+        }
+        emit(out.str());
+        };
 
-        if (std::filesystem::is_regular_file(path)) {
-            scan_file(path);
+    try {
+        if (std::filesystem::is_directory(path)) {
+            emit("Scanning directory: " + path + "\n");
         }
-        else if (std::filesystem::is_directory(path)) {
-            ss << "Scanning directory: " << path << "\n";
-            for (const auto& entry : std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied)) {
-                if (entry.is_regular_file()) {
-                    scan_file(entry.path());
+
+        // Runs on the scan workers, block by block over the same bytes the entropy is computed over.
+        std::shared_ptr<const SignatureMatcher> matcher = currentSignatures();
+        auto classify = [matcher]() -> FileScanner::ClassifierPass {
+            return [matcher, hits = std::make_shared<SignatureHits>()](std::span<const unsigned char> block) {
+                if (block.empty()) return hits->describe(*matcher);
+                hits->feed(*matcher, block);
+                return std::string();
+                };
+            };
+        FileScanOptions scanOptions = options;
+        scanOptions.classifier_tag = matcher->fingerprint();
+
+        FileScanSummary summary = FileScanner::Scan(path, scanOptions, classify, [&](const FileScanResult& r) {
+            std::ostringstream line;
+            line << "  - " << r.path.string() << ": ";
+            if (!r.error.empty()) {
+                line << "[ERROR: " << r.error << "]\n";
+            }
+            // ===== Signature detection before entropy check =====
+            else if (!r.signature.empty()) {
+                line << "[SIGNATURE MATCH: " << r.signature << "]\n";
+                flagged.push_back({ r, " due to signature" }); // Skip entropy check if signature found
+            }
+            // =====================================================
+            else {
+                line << std::fixed << std::setprecision(4) << r.entropy;
+                if (r.sampled) line << " (sampled " << r.bytes_scanned << " of " << r.size << " bytes)";
+                if (r.entropy > entropyThreshold) {
+                    line << " [HIGH ENTROPY DETECTED]";
+                    flagged.push_back({ r, "" });
                 }
+                line << "\n";
             }
+            emit(line.str());
+            });
+
+        for (const auto& f : flagged) quarantine(f.result, f.reason);
+
+        ss << "Scanned " << summary.files << " files";
+        if (summary.cached) ss << " (" << summary.cached << " unchanged, from cache)";
+        ss << ", " << std::fixed << std::setprecision(1) << summary.bytes / (1024.0 * 1024.0) << " MiB read in "
+            << std::setprecision(2) << summary.seconds << " s";
+        if (summary.filtered) ss << ", " << summary.filtered << " filtered out";
+        if (summary.errors) ss << ", " << summary.errors << " unreadable";
+        if (!flagged.empty()) ss << ", " << flagged.size() << " flagged";
+        ss << "\n";
+
+        std::string cacheError;
+        if (ScanCache::instance().isOpen() && !ScanCache::instance().save(&cacheError)) {
+            ss << "Warning: scan cache not saved: " << cacheError << "\n";
         }
     }
     catch (const std::exception& e) {
@@ -6,6 +6,13 @@ Copyright © 2025 Cadell Richard Anderson
 #pragma once
 #include <string>
 #include <vector>
+#include <span>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include "FileScanner.h"
+
+class SignatureMatcher;
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -14,11 +21,36 @@ Copyright © 2025 Cadell Richard Anderson
 class DiagnosticsModule {
 public:
     static std::string ScanRegistry(const std::string& rootKey, const std::vector<std::string>& searchTerms);
-    static std::string ScanFileEntropy(const std::string& path, const std::string& quarantineDir, const std::string& reportDir, double entropyThreshold);
+    // Scans a file or directory tree in parallel (see FileScanner). The line for each file is printed
+    // as it completes, flagged files are quarantined and analysed after the scan, and the summary is
+    // returned.
+    static std::string ScanFileEntropy(const std::string& path, const std::string& quarantineDir, const std::string& reportDir, double entropyThreshold,
+        const FileScanOptions& options = {});
     static std::string MonitorProcesses();
     static std::string TerminateProcessByPID(unsigned long pid);
     static void AnalyzeBinary(const std::string& filepath);
 
+    // Compiles the built-in signatures plus 'configPatterns' (ConfigState::signaturePatterns) into the
+    // matcher used by ScanFileEntropy. Cheap when the patterns have not changed since the last call.
+    static void LoadSignatures(const std::vector<std::pair<std::string, std::vector<unsigned char>>>& configPatterns);
+    static std::string SignatureStats();
+
+    // Shannon entropy in bits per byte (0.0 - 8.0). Defined inline so other modules (e.g. the
+    // OneCloud compression policy) can share it without linking the scanners.
+    static double calculateEntropy(std::span<const unsigned char> data) {
+        if (data.empty()) return 0.0;
+        std::array<size_t, 256> freq{};
+        for (unsigned char byte : data) freq[byte]++;
+
+        double entropy = 0.0;
+        for (size_t count : freq) {
+            if (count == 0) continue;
+            double p = static_cast<double>(count) / data.size();
+            entropy -= p * std::log2(p);
+        }
+        return entropy;
+    }
+
 private:
 #ifdef _WIN32
     static void SearchRegistryRecursive(HKEY hKey, const std::wstring& searchTerm, std::vector<std::wstring>& foundItems);
@@ -28,6 +60,7 @@ private:
     static double calculateEntropy(const std::vector<unsigned char>& data);
     static std::string analyzeAndReport(const std::string& filePath, const std::string& reportDir);
 
-    // NEW: Lightweight signature matcher for detecting known malicious patterns
-    static bool matchSignatures(const std::vector<unsigned char>& data, std::string& matchedSigName);
+    // NEW: Lightweight signature matcher for detecting known malicious patterns.
+    // Lists every signature found, each with its first offset and hit count.
+    static bool matchSignatures(const SignatureMatcher& matcher, std::span<const unsigned char> data, std::string& matchedSigName);
 };
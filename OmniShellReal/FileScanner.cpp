@@ -0,0 +1,380 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// FileScanner.cpp
+#include "FileScanner.h"
+#include "JobManager.h"
+#include "ScanCache.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace FileScanner {
+
+    namespace {
+        constexpr size_t READ_BLOCK = size_t(1) << 20;  // whole files are read in blocks of this size
+        constexpr uint64_t SAMPLE_CHUNKS = 16;
+        constexpr size_t BATCH_FILES = 64;              // files per pool task
+        constexpr uint64_t BATCH_BYTES = 64ull << 20;   // or fewer if they add up to this much
+        constexpr size_t MAX_BLOCK = size_t(1) << 30;   // keeps each 32-bit table count below 2^28
+        constexpr uint64_t K1 = 0x9E3779B97F4A7C15ull;
+        constexpr uint64_t K2 = 0xFF51AFD7ED558CCDull;
+
+        struct Item {
+            std::filesystem::path path;
+            uint64_t size;
+        };
+
+        std::string lowerCase(std::string s) {
+            std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return s;
+        }
+
+        // HashBytes over a file read block by block. The total length is part of the hash, so it is given
+        // up front; every block but the last must be a multiple of 8 bytes long.
+        class Hasher {
+        public:
+            explicit Hasher(uint64_t total) : h(total * K1) {}
+
+            void update(std::span<const unsigned char> data) {
+                const unsigned char* p = data.data();
+                const size_t n = data.size();
+                size_t i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    uint64_t v;
+                    std::memcpy(&v, p + i, 8);
+                    h = std::rotl(h ^ (v * K1), 27) * K2;
+                }
+                if (i < n) std::memcpy(&tail, p + i, n - i);
+            }
+
+            uint64_t finish() const {
+                uint64_t f = h ^ (tail * K1);
+                f ^= f >> 33;
+                f *= K2;
+                f ^= f >> 33;
+                return f;
+            }
+
+        private:
+            uint64_t h;
+            uint64_t tail = 0;
+        };
+
+        // A file opened for positioned reads. Unlike a mapping, a file truncated or replaced while it is
+        // being scanned shows up as a short read rather than a SIGBUS.
+        class InputFile {
+        public:
+            explicit InputFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+                handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+#else
+                fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#if defined(__linux__)
+                if (fd >= 0) ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+            }
+            ~InputFile() {
+#ifdef _WIN32
+                if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+                if (fd >= 0) ::close(fd);
+#endif
+            }
+            InputFile(const InputFile&) = delete;
+            InputFile& operator=(const InputFile&) = delete;
+
+#ifdef _WIN32
+            bool isOpen() const { return handle != INVALID_HANDLE_VALUE; }
+#else
+            bool isOpen() const { return fd >= 0; }
+#endif
+
+            // Appends up to 'count' bytes from 'offset' to 'out'; fewer only at the end of the file.
+            bool readAt(uint64_t offset, size_t count, std::vector<unsigned char>& out) {
+                const size_t at = out.size();
+                out.resize(at + count);
+                size_t done = 0;
+                while (done < count) {
+#ifdef _WIN32
+                    OVERLAPPED where{};
+                    where.Offset = static_cast<DWORD>(offset + done);
+                    where.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+                    DWORD got = 0;
+                    const DWORD want = static_cast<DWORD>(std::min<size_t>(count - done, 1u << 30));
+                    if (!ReadFile(handle, out.data() + at + done, want, &got, &where) && GetLastError() != ERROR_HANDLE_EOF) {
+                        out.resize(at + done);
+                        return false;
+                    }
+#else
+                    const ssize_t got = ::pread(fd, out.data() + at + done, count - done, static_cast<off_t>(offset + done));
+                    if (got < 0) {
+                        if (errno == EINTR) continue;
+                        out.resize(at + done);
+                        return false;
+                    }
+#endif
+                    if (got == 0) break;
+                    done += static_cast<size_t>(got);
+                }
+                out.resize(at + done);
+                return true;
+            }
+
+        private:
+#ifdef _WIN32
+            HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+            int fd = -1;
+#endif
+        };
+
+        FileScanResult scanOne(const Item& item, const FileScanOptions& options, const Classifier& classify, uint64_t cacheKey) {
+            OMNI_TRACE_SCOPE("scan", "file");
+            thread_local std::vector<unsigned char> buffer;
+            FileScanResult r;
+            r.path = item.path;
+            r.size = item.size;
+
+            // Identify before reading: if the file changes under the scan, the stored identity is already
+            // stale and the next scan redoes it.
+            ScanCache& cache = ScanCache::instance();
+            FileIdentity id;
+            const bool cacheable = options.use_cache && cache.isOpen() && ScanCache::Identify(item.path, id);
+            if (cacheable) {
+                if (auto hit = cache.findScan(id, cacheKey)) {
+                    r.size = id.size;
+                    r.bytes_scanned = hit->bytes_scanned;
+                    r.sampled = hit->sampled;
+                    r.entropy = hit->entropy;
+                    r.signature = std::move(hit->signature);
+                    r.content_hash = hit->content_hash;
+                    r.cached = true;
+                    return r;
+                }
+            }
+
+            InputFile in(item.path);
+            if (!in.isOpen()) {
+                r.error = "cannot open";
+                return r;
+            }
+            Histogram hist{};
+            ClassifierPass pass = classify ? classify() : nullptr;
+            if (options.sample_bytes && item.size > options.sample_bytes) {
+                // Evenly spaced chunks, the first at the start and the last at the end of the file.
+                const uint64_t chunk = std::max<uint64_t>(options.sample_bytes / SAMPLE_CHUNKS, 1);
+                const uint64_t chunks = std::min<uint64_t>(SAMPLE_CHUNKS, options.sample_bytes);
+                buffer.clear();
+                for (uint64_t k = 0; k < chunks; ++k) {
+                    uint64_t offset = (chunks > 1) ? k * (item.size - chunk) / (chunks - 1) : 0;
+                    if (!in.readAt(offset, static_cast<size_t>(chunk), buffer)) break;
+                }
+                AccumulateHistogram(buffer, hist);
+                if (pass) pass(buffer);
+                r.bytes_scanned = buffer.size();
+                r.content_hash = HashBytes(buffer);
+                r.sampled = true;
+            }
+            else {
+                // Block by block through the one buffer, so memory stays at READ_BLOCK however large the file.
+                Hasher hash(item.size);
+                uint64_t offset = 0;
+                while (offset < item.size) {
+                    buffer.clear();
+                    const size_t want = static_cast<size_t>(std::min<uint64_t>(READ_BLOCK, item.size - offset));
+                    if (!in.readAt(offset, want, buffer)) {
+                        r.error = "read error";
+                        return r;
+                    }
+                    AccumulateHistogram(buffer, hist);
+                    hash.update(buffer);
+                    if (pass) pass(buffer);
+                    offset += buffer.size();
+                    if (buffer.size() < want) break;
+                }
+                if (offset != item.size) {
+                    r.error = "file shrank while being scanned";
+                    return r;
+                }
+                r.bytes_scanned = offset;
+                r.content_hash = hash.finish();
+            }
+
+            r.entropy = EntropyFromHistogram(hist, r.bytes_scanned);
+            if (pass) r.signature = pass({});
+            if (cacheable) cache.storeScan(id, cacheKey, { r.entropy, r.bytes_scanned, r.sampled, r.signature, r.content_hash });
+            return r;
+        }
+    }
+
+    void AccumulateHistogram(std::span<const unsigned char> data, Histogram& hist) {
+        alignas(64) uint32_t t[4][256];
+        const unsigned char* p = data.data();
+        size_t n = data.size();
+        while (n > 0) {
+            const size_t block = std::min(n, MAX_BLOCK);
+            std::memset(t, 0, sizeof(t));
+            size_t i = 0;
+            for (; i + 16 <= block; i += 16) {
+                uint64_t a, b;
+                std::memcpy(&a, p + i, 8);
+                std::memcpy(&b, p + i + 8, 8);
+                t[0][a & 0xFF]++;         t[1][(a >> 8) & 0xFF]++;
+                t[2][(a >> 16) & 0xFF]++; t[3][(a >> 24) & 0xFF]++;
+                t[0][(a >> 32) & 0xFF]++; t[1][(a >> 40) & 0xFF]++;
+                t[2][(a >> 48) & 0xFF]++; t[3][a >> 56]++;
+                t[0][b & 0xFF]++;         t[1][(b >> 8) & 0xFF]++;
+                t[2][(b >> 16) & 0xFF]++; t[3][(b >> 24) & 0xFF]++;
+                t[0][(b >> 32) & 0xFF]++; t[1][(b >> 40) & 0xFF]++;
+                t[2][(b >> 48) & 0xFF]++; t[3][b >> 56]++;
+            }
+            for (; i < block; ++i) t[0][p[i]]++;
+            for (size_t c = 0; c < 256; ++c) {
+                hist[c] += uint64_t(t[0][c]) + t[1][c] + t[2][c] + t[3][c];
+            }
+            p += block;
+            n -= block;
+        }
+    }
+
+    double EntropyFromHistogram(const Histogram& hist, uint64_t total) {
+        if (total == 0) return 0.0;
+        double entropy = 0.0;
+        for (uint64_t count : hist) {
+            if (count == 0) continue;
+            double p = static_cast<double>(count) / total;
+            entropy -= p * std::log2(p);
+        }
+        return entropy;
+    }
+
+    uint64_t HashBytes(std::span<const unsigned char> data) {
+        Hasher hash(data.size());
+        hash.update(data);
+        return hash.finish();
+    }
+
+    FileScanSummary Scan(const std::filesystem::path& root,
+        const FileScanOptions& options,
+        const Classifier& classify,
+        const std::function<void(const FileScanResult&)>& onResult)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::mutex resultMutex;
+        FileScanSummary summary;
+        std::exception_ptr failure;     // first exception a task caught; guarded by resultMutex
+
+        std::vector<std::string> extensions;
+        for (const auto& e : options.extensions) extensions.push_back(lowerCase(e));
+
+        // Whatever besides the file itself changes a result.
+        const uint64_t keyParts[3] = { options.sample_bytes, options.classifier_tag, classify ? 1u : 0u };
+        const uint64_t cacheKey = HashBytes({ reinterpret_cast<const unsigned char*>(keyParts), sizeof keyParts });
+
+        // Bounded so that a huge tree is walked no faster than it is scanned.
+        const size_t maxInflight = 4 * std::max(1u, std::thread::hardware_concurrency());
+        std::deque<TaskHandle> inflight;
+        std::vector<Item> batch;
+        uint64_t batchBytes = 0;
+
+        // The tasks refer to this frame, so however Scan is left, none of them may still be running.
+        struct WaitAll {
+            std::deque<TaskHandle>& tasks;
+            ~WaitAll() {
+                for (const auto& h : tasks) JobManager::Wait(h);
+            }
+        } waitAll{ inflight };
+
+        auto flush = [&]() {
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                if (failure) std::rethrow_exception(failure);
+            }
+            if (batch.empty()) return;
+            auto items = std::make_shared<std::vector<Item>>(std::move(batch));
+            batch.clear();
+            batchBytes = 0;
+            inflight.emplace_back();    // allocated first, so a submitted task is always waited for
+            inflight.back() = JobManager::SubmitJob([items, cacheKey, &options, &classify, &onResult, &resultMutex, &summary, &failure]() {
+                try {
+                    for (const Item& item : *items) {
+                        FileScanResult r = scanOne(item, options, classify, cacheKey);
+                        std::lock_guard<std::mutex> lock(resultMutex);
+                        if (failure) return;
+                        ++summary.files;
+                        if (r.cached) ++summary.cached;
+                        else summary.bytes += r.bytes_scanned;
+                        if (!r.error.empty()) ++summary.errors;
+                        if (onResult) onResult(r);
+                    }
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(resultMutex);
+                    if (!failure) failure = std::current_exception();
+                }
+                });
+            while (inflight.size() > maxInflight) {
+                JobManager::Wait(inflight.front());
+                inflight.pop_front();
+            }
+        };
+
+        auto consider = [&](const std::filesystem::path& p, uint64_t size) {
+            bool wanted = size >= options.min_size && size <= options.max_size;
+            if (wanted && !extensions.empty()) {
+                std::string ext = lowerCase(p.extension().string());
+                wanted = std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+            }
+            if (!wanted) {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                ++summary.filtered;
+                return;
+            }
+            batch.push_back({ p, size });
+            batchBytes += size;
+            if (batch.size() >= BATCH_FILES || batchBytes >= BATCH_BYTES) flush();
+        };
+
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(root, ec)) {
+            consider(root, std::filesystem::file_size(root, ec));
+        }
+        else if (std::filesystem::is_directory(root, ec)) {
+            std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, ec), end;
+            for (; !ec && it != end; it.increment(ec)) {
+                std::error_code fec;
+                if (!it->is_regular_file(fec)) continue;
+                uint64_t size = it->file_size(fec);
+                if (fec) continue;
+                consider(it->path(), size);
+            }
+        }
+        flush();
+        for (const auto& h : inflight) JobManager::Wait(h);
+        inflight.clear();
+        if (failure) std::rethrow_exception(failure);
+
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return summary;
+    }
+}
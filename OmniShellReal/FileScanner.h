@@ -0,0 +1,79 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// FileScanner.h
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+// Which files a scan visits and how much of each it reads.
+struct FileScanOptions {
+    uint64_t min_size = 0;
+    uint64_t max_size = std::numeric_limits<uint64_t>::max();   // larger files are skipped
+    std::vector<std::string> extensions;    // e.g. ".exe"; matched case-insensitively; empty = every file
+    uint64_t sample_bytes = 0;              // 0 = whole file; otherwise read at most this many bytes,
+                                            // as 16 evenly spaced chunks, from larger files
+    bool use_cache = true;                  // reuse ScanCache results for unchanged files, if it is open
+    uint64_t classifier_tag = 0;            // identifies the classifier; results cached under another are redone
+};
+
+struct FileScanResult {
+    std::filesystem::path path;
+    uint64_t size = 0;
+    uint64_t bytes_scanned = 0;
+    bool sampled = false;
+    double entropy = 0.0;       // bits per byte over the bytes scanned
+    std::string signature;      // what the classifier reported; empty if nothing matched
+    uint64_t content_hash = 0;  // HashBytes of the bytes scanned
+    bool cached = false;        // taken from ScanCache without reading the file
+    std::string error;          // set when the file could not be read; the other fields are then empty
+};
+
+struct FileScanSummary {
+    uint64_t files = 0;         // files visited (including cached ones and those with errors)
+    uint64_t cached = 0;        // answered from ScanCache
+    uint64_t filtered = 0;      // files skipped by the size/extension filters
+    uint64_t errors = 0;
+    uint64_t bytes = 0;         // bytes actually read
+    double seconds = 0.0;
+};
+
+namespace FileScanner {
+    using Histogram = std::array<uint64_t, 256>;
+
+    // Adds the byte counts of 'data' to 'hist'. Counts into four interleaved 32-bit tables from 8-byte
+    // loads, so runs of one byte value do not serialise on a single counter.
+    void AccumulateHistogram(std::span<const unsigned char> data, Histogram& hist);
+
+    // Shannon entropy in bits per byte of a histogram over 'total' bytes.
+    double EntropyFromHistogram(const Histogram& hist, uint64_t total);
+
+    // Fast non-cryptographic 64-bit hash, to tell whether a rescanned file's content actually changed.
+    uint64_t HashBytes(std::span<const unsigned char> data);
+
+    // One file's classification, run on the worker: called with each block of the bytes that were
+    // scanned, in file order, then once with an empty span, when it returns a signature name or an
+    // empty string (what it returns for the blocks is ignored).
+    using ClassifierPass = std::function<std::string(std::span<const unsigned char>)>;
+
+    // Optional hook that starts a ClassifierPass for each file scanned.
+    using Classifier = std::function<ClassifierPass()>;
+
+    // Scans 'root' (a file, or a directory walked recursively) on the JobManager pool. Files are read
+    // with positioned reads in 1 MiB blocks (never mapped, so truncating a file mid-scan is an error
+    // rather than a crash), and unchanged files are answered from ScanCache when it is open. 'onResult' is called once per file in completion order,
+    // never concurrently, while the scan is still running. If it throws, the scan stops and Scan
+    // rethrows once every task has finished. Results are stored in the cache but not saved; that is
+    // the caller's call.
+    FileScanSummary Scan(const std::filesystem::path& root,
+        const FileScanOptions& options,
+        const Classifier& classify,
+        const std::function<void(const FileScanResult&)>& onResult);
+}
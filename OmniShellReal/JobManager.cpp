@@ -4,97 +4,275 @@ Copyright © 2025 Cadell Richard Anderson
 // JobManager.cpp
 // =================================================================
 #include "JobManager.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <queue>
-#include <condition_variable>
+#include <sstream>
 
-std::vector<Job> JobManager::jobs;
-int JobManager::nextJobId = 1;
-std::mutex JobManager::jobMutex;
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 namespace {
-    std::queue<std::function<void()>> void_jobs;
-    std::mutex void_jobMutex;
-    std::condition_variable void_jobCV;
-    bool void_running = true;
-    std::thread void_worker;
-
-    void ProcessVoidJobs() {
-        while (void_running) {
-            std::function<void()> job;
-            {
-                std::unique_lock<std::mutex> lock(void_jobMutex);
-                void_jobCV.wait(lock, [] { return !void_jobs.empty() || !void_running; });
-                if (!void_running && void_jobs.empty()) break;
-                job = std::move(void_jobs.front());
-                void_jobs.pop();
+    std::mutex poolMutex;
+    std::condition_variable poolReleased;  // signalled when the last counted PoolRef drops
+    std::unique_ptr<ThreadPool> pool;
+    ThreadPool* draining = nullptr;         // the pool Shutdown() is tearing down
+    size_t poolUsers = 0;
+    bool shutDown = false;                  // once set, no pool is ever created again
+
+    // The pool for the duration of one call, or null once Shutdown() has begun. Shutdown() waits for
+    // every counted reference to drop before it destroys the pool. The draining pool's own workers
+    // still get it, uncounted: its destructor joins them, so it outlives anything they do with it.
+    class PoolRef {
+    public:
+        PoolRef() {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (draining && draining->onWorkerThread()) {
+                p = draining;
+                return;
             }
-            job();
+            if (shutDown) return;
+            if (!pool) pool = std::make_unique<ThreadPool>();
+            p = pool.get();
+            counted = true;
+            ++poolUsers;
+        }
+        ~PoolRef() {
+            if (!counted) return;
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (--poolUsers == 0) poolReleased.notify_all();
+        }
+        PoolRef(const PoolRef&) = delete;
+        PoolRef& operator=(const PoolRef&) = delete;
+
+        ThreadPool* get() const { return p; }
+
+    private:
+        ThreadPool* p = nullptr;
+        bool counted = false;
+    };
+
+    struct JobSlot {
+        uint32_t generation = 0;
+        bool used = false;
+        Job job;
+    };
+
+    std::mutex jobMutex;
+    std::vector<JobSlot> slots;     // job id N lives in slots[N - 1]
+    std::priority_queue<int, std::vector<int>, std::greater<int>> freeIds;
+
+    struct Completion {
+        int id;
+        uint32_t generation;
+    };
+
+    // Separate from jobMutex so finishing workers never wait behind a listing or a checkJobs().
+    std::mutex completionMutex;
+    std::vector<Completion> completed;
+    int completionEventFd = -1;
+
+    // Called with jobMutex held.
+    JobSlot* findSlot(int jobId) {
+        if (jobId < 1 || static_cast<size_t>(jobId) > slots.size()) return nullptr;
+        JobSlot& slot = slots[jobId - 1];
+        return slot.used ? &slot : nullptr;
+    }
+
+    // Called with jobMutex held.
+    void releaseSlot(int jobId) {
+        JobSlot& slot = slots[jobId - 1];
+        slot.used = false;
+        slot.job = Job{};
+        freeIds.push(jobId);
+    }
+
+    void postCompletion(int id, uint32_t generation) {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        completed.push_back({ id, generation });
+#if defined(__linux__)
+        if (completionEventFd >= 0) {
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t n = ::write(completionEventFd, &one, sizeof(one));
+        }
+#endif
+    }
+
+    std::string collectResult(Job& job) {
+        try {
+            return job.future.get();
+        }
+        catch (const std::exception& e) {
+            return std::string("Error: ") + e.what();
         }
     }
 }
 
 int JobManager::addJob(const std::string& command, std::function<std::string()> task) {
+    PoolRef pool;
+    if (!pool.get()) return 0;
+    auto promise = std::make_shared<std::promise<std::string>>();
+    CancelToken cancel;
+
     std::lock_guard<std::mutex> lock(jobMutex);
-    int id = nextJobId++;
-    jobs.emplace_back(Job{ id, command, std::async(std::launch::async, task), false, "" });
+    int id;
+    if (!freeIds.empty()) {
+        id = freeIds.top();
+        freeIds.pop();
+    }
+    else {
+        slots.emplace_back();
+        id = static_cast<int>(slots.size());
+    }
+    JobSlot& slot = slots[id - 1];
+    slot.used = true;
+    const uint32_t generation = ++slot.generation;
+
+    // The wrapper always runs, even for a cancelled job, so that every job posts exactly one completion.
+    TaskHandle handle = pool.get()->submit([promise, cancel, id, generation, task = std::move(task)]() {
+        if (cancel.isCancelled()) {
+            promise->set_value("[Job " + std::to_string(id) + " cancelled]");
+        }
+        else {
+            try {
+                promise->set_value(task());
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        }
+        postCompletion(id, generation);
+        });
+    slot.job = Job{ id, command, promise->get_future(), false, "", cancel, handle };
     return id;
 }
 
 std::string JobManager::listJobs() {
     std::lock_guard<std::mutex> lock(jobMutex);
     std::stringstream ss;
-    for (const auto& job : jobs) {
-        ss << "[" << job.id << "]" << (job.isDone ? "  Done" : "+ Running") << "    " << job.command << "\n";
+    for (const auto& slot : slots) {
+        if (!slot.used) continue;
+        const Job& job = slot.job;
+        const char* state = "+ Running";
+        if (job.task.finished()) state = "  Done";
+        else if (job.cancel.isCancelled()) state = "  Cancelled";
+        else if (job.task.status() == TaskStatus::Queued) state = "+ Queued";
+        ss << "[" << job.id << "]" << state << "    " << job.command << "\n";
     }
     return ss.str();
 }
 
 std::string JobManager::waitForJob(int jobId) {
     std::unique_lock<std::mutex> lock(jobMutex);
-    auto it = std::find_if(jobs.begin(), jobs.end(), [jobId](const Job& j) { return j.id == jobId; });
-    if (it != jobs.end()) {
-        lock.unlock(); // Unlock before waiting
-        std::string result = it->future.get();
-        lock.lock(); // Re-lock to modify the vector
-        jobs.erase(it);
-        return result;
-    }
-    return "Error: Job not found.";
+    JobSlot* slot = findSlot(jobId);
+    if (!slot) return "Error: Job not found.";
+    const uint32_t generation = slot->generation;
+    TaskHandle handle = slot->job.task;
+    lock.unlock(); // Unlock before waiting
+
+    Wait(handle);
+
+    lock.lock(); // A concurrent wait may have collected the job and its id been reused meanwhile
+    slot = findSlot(jobId);
+    if (!slot || slot->generation != generation) return "Error: Job not found.";
+    std::string result = collectResult(slot->job);
+    releaseSlot(jobId); // its queued completion is now stale and will be skipped
+    return result;
 }
 
-void JobManager::checkJobs() {
+std::string JobManager::cancelJob(int jobId) {
     std::lock_guard<std::mutex> lock(jobMutex);
-    for (auto& job : jobs) {
-        if (!job.isDone && job.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-            job.isDone = true;
-            job.result = job.future.get();
-            std::cout << "\n[Job " << job.id << "+ Done] " << job.command << "\n" << job.result << std::endl;
-        }
+    JobSlot* slot = findSlot(jobId);
+    if (!slot) return "Error: Job not found.";
+    TaskStatus st = slot->job.task.status();
+    if (st != TaskStatus::Queued && st != TaskStatus::Waiting) {
+        return "[" + std::to_string(jobId) + "] already started; it will run to completion.";
     }
-    // Clean up completed jobs
-    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const Job& j) { return j.isDone; }), jobs.end());
+    slot->job.cancel.cancel();
+    return "[" + std::to_string(jobId) + "] cancelled.";
 }
 
-void JobManager::SubmitJob(std::function<void()> job) {
+void JobManager::checkJobs() {
+    std::vector<Completion> batch;
     {
-        std::lock_guard<std::mutex> lock(void_jobMutex);
-        void_jobs.push(std::move(job));
+        std::lock_guard<std::mutex> lock(completionMutex);
+#if defined(__linux__)
+        if (completionEventFd >= 0) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t n = ::read(completionEventFd, &count, sizeof(count)); // resets the counter
+        }
+#endif
+        batch.swap(completed);
     }
-    void_jobCV.notify_one();
+    if (batch.empty()) return;
+
+    std::lock_guard<std::mutex> lock(jobMutex);
+    for (const Completion& c : batch) {
+        JobSlot* slot = findSlot(c.id);
+        if (!slot || slot->generation != c.generation) continue; // already collected by waitForJob
+        Job& job = slot->job;
+        job.isDone = true;
+        job.result = collectResult(job);
+        std::cout << "\n[Job " << job.id << "+ Done] " << job.command << "\n" << job.result << std::endl;
+        releaseSlot(c.id);
+    }
+}
+
+int JobManager::completionFd() {
+    std::lock_guard<std::mutex> lock(completionMutex);
+    return completionEventFd;
+}
+
+TaskHandle JobManager::SubmitJob(std::function<void()> job, TaskOptions options) {
+    PoolRef pool;
+    if (!pool.get()) return ThreadPool::runHere(std::move(job), std::move(options));
+    return pool.get()->submit(std::move(job), std::move(options));
+}
+
+void JobManager::Wait(const TaskHandle& task) {
+    PoolRef pool;
+    if (pool.get()) pool.get()->wait(task);
+    else task.wait();   // anything still unfinished is being drained by Shutdown()
+}
+
+std::string JobManager::PoolStats() {
+    PoolRef pool;
+    return pool.get() ? pool.get()->stats() : "shut down";
 }
 
 void JobManager::Initialize() {
-    void_running = true;
-    void_worker = std::thread(ProcessVoidJobs);
+    PoolRef{};
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(completionMutex);
+    if (completionEventFd < 0) completionEventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
 }
 
 void JobManager::Shutdown() {
+    // Waits for calls from outside the pool to let go of it, then destroys it here, which runs what
+    // is already queued and joins the workers. Jobs running meanwhile keep submitting to it; any other
+    // caller from now on runs its work inline.
+    std::unique_ptr<ThreadPool> drained;
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        shutDown = true;
+        draining = pool.get();
+        poolReleased.wait(lock, [] { return poolUsers == 0; });
+        drained = std::move(pool);
+    }
+    drained.reset();
     {
-        std::lock_guard<std::mutex> lock(void_jobMutex);
-        void_running = false;
+        std::lock_guard<std::mutex> lock(poolMutex);
+        draining = nullptr;
     }
-    void_jobCV.notify_all();
-    if (void_worker.joinable()) void_worker.join();
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(completionMutex);
+    if (completionEventFd >= 0) ::close(completionEventFd);
+    completionEventFd = -1;
+#endif
 }
@@ -9,6 +9,7 @@ Copyright © 2025 Cadell Richard Anderson
 #include <future>
 #include <mutex>
 #include <functional>
+#include "ThreadPool.h"
 
 struct Job {
     int id;
@@ -16,18 +17,35 @@ struct Job {
     std::future<std::string> future;
     bool isDone = false;
     std::string result;
+    CancelToken cancel;
+    TaskHandle task;
 };
 
+// Background work for the shell and the scanners. Both addJob() and SubmitJob() run on one shared
+// work-stealing pool sized to the hardware, created by Initialize() or on first use. After
+// Shutdown() there is no pool: addJob() refuses new jobs and SubmitJob() runs its task inline.
+//
+// Shell jobs live in a slot map indexed by job id; ids are reused lowest-first like shell job
+// numbers, and a generation per slot keeps a late completion from touching a reused id. Finished
+// jobs are pushed onto a completion queue, so checkJobs() costs nothing while jobs are pending.
 class JobManager {
 public:
-    static std::vector<Job> jobs;
-    static int nextJobId;
-    static std::mutex jobMutex;
+    // Returns the job id, or 0 once Shutdown() has run.
     static int addJob(const std::string& command, std::function<std::string()> task);
     static std::string listJobs();
     static std::string waitForJob(int jobId);
+    // Cancels a job that has not started yet; a running job is left to finish.
+    static std::string cancelJob(int jobId);
+    // Prints the jobs that finished since the last call and frees their ids.
     static void checkJobs();
-    static void SubmitJob(std::function<void()> job);
+    // Becomes readable when a job finishes and stays so until checkJobs() runs, so a REPL can poll
+    // it alongside stdin. An eventfd on Linux; -1 elsewhere, where checkJobs() is called per prompt.
+    static int completionFd();
+    static TaskHandle SubmitJob(std::function<void()> job, TaskOptions options = {});
+    // Waits for a task from SubmitJob(). From inside a job it meanwhile runs only that job's own
+    // subtasks and the awaited task itself, never unrelated jobs.
+    static void Wait(const TaskHandle& task);
+    static std::string PoolStats();
     static void Initialize();
     static void Shutdown();
 };
@@ -5,6 +5,8 @@ Copyright © 2025 Cadell Richard Anderson
 #include "ManifestSerializer.h"
 #include <cstring> // For memcpy
 #include <type_traits> // For std::is_trivial_v
+#include <algorithm>
+#include <numeric>
 
 namespace onecloud {
 
@@ -57,9 +59,301 @@ namespace onecloud {
             std::span<const std::byte> view_;
             size_t offset_ = 0;
         };
+
+        // --- Version 2/3 on-disk structures ---
+        struct ManifestHeaderV2 {
+            uint32_t version;
+            uint32_t file_count;
+            uint32_t chunk_count;
+            uint32_t bucket_count;
+            uint64_t string_table_offset;
+            uint64_t string_table_size;
+            uint64_t file_table_offset;
+            uint64_t chunk_table_offset;
+            uint64_t hash_table_offset;
+        };
+
+        // Version 3 appends the container settings to the version 2 header.
+        struct ManifestHeaderV3 {
+            ManifestHeaderV2 base;
+            int32_t compression_level;
+            uint32_t dictionary_count;
+            uint64_t dictionary_table_offset;
+        };
+
+        // Version 2 chunk records predate the codec fields; such chunks are all plain ZSTD.
+        struct DataChunkV2 {
+            uint64_t offset_in_container;
+            uint32_t compressed_size;
+            uint32_t original_size;
+        };
+
+        struct FileRecordV2 {
+            uint32_t path_offset;
+            uint32_t path_length;
+            uint64_t original_size;
+            int64_t creation_time;
+            int64_t last_write_time;
+            uint32_t first_chunk;
+            uint32_t chunk_count;
+        };
+
+        static_assert(sizeof(ManifestHeaderV2) == 56, "Manifest v2 header layout changed");
+        static_assert(sizeof(ManifestHeaderV3) == 72, "Manifest v3 header layout changed");
+        static_assert(sizeof(FileRecordV2) == 40, "Manifest v2 file record layout changed");
+        static_assert(sizeof(DataChunkV2) == 16, "Manifest v2 chunk layout changed");
+        static_assert(sizeof(DataChunk) == 24 && std::is_trivially_copyable_v<DataChunk>, "DataChunk is read in place");
+        static_assert(sizeof(CompressionDictionary) == 32 && std::is_trivially_copyable_v<CompressionDictionary>, "CompressionDictionary is read in place");
+
+        uint64_t fnv1a(std::string_view text) {
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char c : text) {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        uint32_t bucketCountFor(uint32_t file_count) {
+            uint32_t buckets = 2;
+            while (buckets < file_count * 2ull) buckets <<= 1; // Load factor <= 0.5 keeps probes short.
+            return buckets;
+        }
+
+        template<typename T>
+        T loadAt(std::span<const std::byte> buffer, uint64_t offset) {
+            T value;
+            std::memcpy(&value, buffer.data() + offset, sizeof(T));
+            return value;
+        }
+
+        bool fitsIn(std::span<const std::byte> buffer, uint64_t offset, uint64_t length) {
+            return offset <= buffer.size() && length <= buffer.size() - offset;
+        }
+
+        // Copies a version 2 manifest out into 'out', widening each chunk record.
+        bool readVersion2(std::span<const std::byte> buffer, Manifest& out) {
+            if (buffer.size() < sizeof(ManifestHeaderV2)) return false;
+            const auto header = loadAt<ManifestHeaderV2>(buffer, 0);
+            if (!fitsIn(buffer, header.file_table_offset, uint64_t{ header.file_count } * sizeof(FileRecordV2))) return false;
+            if (!fitsIn(buffer, header.chunk_table_offset, uint64_t{ header.chunk_count } * sizeof(DataChunkV2))) return false;
+            if (!fitsIn(buffer, header.string_table_offset, header.string_table_size)) return false;
+
+            out.version = 2;
+            out.files.resize(header.file_count);
+            for (uint32_t i = 0; i < header.file_count; ++i) {
+                const auto rec = loadAt<FileRecordV2>(buffer, header.file_table_offset + uint64_t{ i } * sizeof(FileRecordV2));
+                if (uint64_t{ rec.path_offset } + rec.path_length > header.string_table_size) return false;
+                if (uint64_t{ rec.first_chunk } + rec.chunk_count > header.chunk_count) return false;
+
+                auto& file = out.files[i];
+                file.path.assign(reinterpret_cast<const char*>(buffer.data() + header.string_table_offset + rec.path_offset), rec.path_length);
+                file.original_size = rec.original_size;
+                file.creation_time = rec.creation_time;
+                file.last_write_time = rec.last_write_time;
+                file.chunks.resize(rec.chunk_count);
+                for (uint32_t j = 0; j < rec.chunk_count; ++j) {
+                    const auto old = loadAt<DataChunkV2>(buffer, header.chunk_table_offset + uint64_t{ rec.first_chunk + j } * sizeof(DataChunkV2));
+                    auto& chunk = file.chunks[j];
+                    chunk = {};
+                    chunk.offset_in_container = old.offset_in_container;
+                    chunk.compressed_size = old.compressed_size;
+                    chunk.original_size = old.original_size;
+                    chunk.codec = ChunkCodec::Zstd;
+                }
+            }
+            return true;
+        }
+    }
+
+    // --- ManifestView ---
+
+    std::optional<ManifestView> ManifestView::open(std::span<const std::byte> buffer) {
+        if (buffer.size() < sizeof(ManifestHeaderV3)) return std::nullopt;
+        if (reinterpret_cast<uintptr_t>(buffer.data()) % alignof(DataChunk) != 0) return std::nullopt;
+
+        const auto full_header = loadAt<ManifestHeaderV3>(buffer, 0);
+        const auto& header = full_header.base;
+        if (header.version != ManifestSerializer::current_version()) return std::nullopt;
+
+        auto fits = [&](uint64_t offset, uint64_t length) { return fitsIn(buffer, offset, length); };
+        if (!fits(header.file_table_offset, uint64_t{ header.file_count } * sizeof(FileRecordV2))) return std::nullopt;
+        if (!fits(header.chunk_table_offset, uint64_t{ header.chunk_count } * sizeof(DataChunk))) return std::nullopt;
+        if (!fits(header.hash_table_offset, uint64_t{ header.bucket_count } * sizeof(uint32_t))) return std::nullopt;
+        if (!fits(header.string_table_offset, header.string_table_size)) return std::nullopt;
+        if (header.chunk_table_offset % alignof(DataChunk) != 0) return std::nullopt;
+        if (!fits(full_header.dictionary_table_offset, uint64_t{ full_header.dictionary_count } * sizeof(CompressionDictionary))) return std::nullopt;
+        if (full_header.dictionary_table_offset % alignof(CompressionDictionary) != 0) return std::nullopt;
+        if (header.bucket_count == 0 || (header.bucket_count & (header.bucket_count - 1)) != 0) return std::nullopt;
+        if (header.bucket_count <= header.file_count) return std::nullopt;
+
+        ManifestView view;
+        view.buffer_ = buffer;
+        view.file_count_ = header.file_count;
+        view.chunk_count_ = header.chunk_count;
+        view.bucket_count_ = header.bucket_count;
+        view.string_table_offset_ = header.string_table_offset;
+        view.file_table_offset_ = header.file_table_offset;
+        view.chunk_table_offset_ = header.chunk_table_offset;
+        view.hash_table_offset_ = header.hash_table_offset;
+        view.compression_level_ = full_header.compression_level;
+        view.dictionaries_ = std::span<const CompressionDictionary>(
+            reinterpret_cast<const CompressionDictionary*>(buffer.data() + full_header.dictionary_table_offset), full_header.dictionary_count);
+
+        // One linear pass so later accessors can trust every offset; also enforces the sort order
+        // that prefix queries rely on.
+        std::string_view previous;
+        for (uint32_t i = 0; i < header.file_count; ++i) {
+            const auto rec = loadAt<FileRecordV2>(buffer, header.file_table_offset + uint64_t{ i } * sizeof(FileRecordV2));
+            if (uint64_t{ rec.path_offset } + rec.path_length > header.string_table_size) return std::nullopt;
+            if (uint64_t{ rec.first_chunk } + rec.chunk_count > header.chunk_count) return std::nullopt;
+            std::string_view current = view.path(i);
+            if (i > 0 && !(previous < current)) return std::nullopt;
+            previous = current;
+        }
+        return view;
+    }
+
+    std::string_view ManifestView::path(uint32_t index) const {
+        const auto rec = loadAt<FileRecordV2>(buffer_, file_table_offset_ + uint64_t{ index } * sizeof(FileRecordV2));
+        return std::string_view(reinterpret_cast<const char*>(buffer_.data() + string_table_offset_ + rec.path_offset), rec.path_length);
+    }
+
+    ManifestRecord ManifestView::record(uint32_t index) const {
+        const auto rec = loadAt<FileRecordV2>(buffer_, file_table_offset_ + uint64_t{ index } * sizeof(FileRecordV2));
+        ManifestRecord out;
+        out.path = std::string_view(reinterpret_cast<const char*>(buffer_.data() + string_table_offset_ + rec.path_offset), rec.path_length);
+        out.original_size = rec.original_size;
+        out.creation_time = rec.creation_time;
+        out.last_write_time = rec.last_write_time;
+        const auto* chunks = reinterpret_cast<const DataChunk*>(buffer_.data() + chunk_table_offset_);
+        out.chunks = std::span<const DataChunk>(chunks + rec.first_chunk, rec.chunk_count);
+        return out;
+    }
+
+    std::optional<uint32_t> ManifestView::find(std::string_view wanted) const {
+        if (bucket_count_ == 0) return std::nullopt;
+        const uint32_t mask = bucket_count_ - 1;
+        uint32_t slot = static_cast<uint32_t>(fnv1a(wanted)) & mask;
+        for (uint32_t probes = 0; probes < bucket_count_; ++probes) {
+            const auto entry = loadAt<uint32_t>(buffer_, hash_table_offset_ + uint64_t{ slot } * sizeof(uint32_t));
+            if (entry == 0 || entry > file_count_) return std::nullopt;
+            if (path(entry - 1) == wanted) return entry - 1;
+            slot = (slot + 1) & mask;
+        }
+        return std::nullopt;
+    }
+
+    uint32_t ManifestView::lowerBound(std::string_view key) const {
+        uint32_t low = 0;
+        uint32_t high = file_count_;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (path(mid) < key) low = mid + 1;
+            else high = mid;
+        }
+        return low;
+    }
+
+    // --- ManifestSerializer ---
+
+    uint32_t ManifestSerializer::peekVersion(std::span<const std::byte> buffer) {
+        if (buffer.size() < sizeof(uint32_t)) return 0;
+        return loadAt<uint32_t>(buffer, 0);
+    }
+
+    void ManifestSerializer::serializeRecords(std::span<const ManifestRecord> records, const ManifestSettings& settings, std::vector<std::byte>& out_buffer) {
+        ManifestHeaderV3 full_header{};
+        auto& header = full_header.base;
+        header.version = current_version();
+        header.file_count = static_cast<uint32_t>(records.size());
+        header.bucket_count = bucketCountFor(header.file_count);
+
+        uint64_t total_chunks = 0;
+        uint64_t total_string_bytes = 0;
+        for (const auto& rec : records) {
+            total_chunks += rec.chunks.size();
+            total_string_bytes += rec.path.size();
+        }
+        header.chunk_count = static_cast<uint32_t>(total_chunks);
+        header.string_table_size = total_string_bytes;
+
+        full_header.compression_level = settings.compression_level;
+        full_header.dictionary_count = static_cast<uint32_t>(settings.dictionaries.size());
+
+        header.file_table_offset = sizeof(ManifestHeaderV3);
+        header.chunk_table_offset = header.file_table_offset + uint64_t{ header.file_count } * sizeof(FileRecordV2);
+        full_header.dictionary_table_offset = header.chunk_table_offset + total_chunks * sizeof(DataChunk);
+        header.hash_table_offset = full_header.dictionary_table_offset + settings.dictionaries.size_bytes();
+        header.string_table_offset = header.hash_table_offset + uint64_t{ header.bucket_count } * sizeof(uint32_t);
+
+        out_buffer.assign(header.string_table_offset + total_string_bytes, std::byte{ 0 });
+        std::byte* base = out_buffer.data();
+        std::memcpy(base, &full_header, sizeof(full_header));
+        if (!settings.dictionaries.empty()) {
+            std::memcpy(base + full_header.dictionary_table_offset, settings.dictionaries.data(), settings.dictionaries.size_bytes());
+        }
+
+        uint32_t chunk_cursor = 0;
+        uint32_t string_cursor = 0;
+        const uint32_t mask = header.bucket_count - 1;
+        for (uint32_t i = 0; i < header.file_count; ++i) {
+            const auto& rec = records[i];
+
+            FileRecordV2 file{};
+            file.path_offset = string_cursor;
+            file.path_length = static_cast<uint32_t>(rec.path.size());
+            file.original_size = rec.original_size;
+            file.creation_time = rec.creation_time;
+            file.last_write_time = rec.last_write_time;
+            file.first_chunk = chunk_cursor;
+            file.chunk_count = static_cast<uint32_t>(rec.chunks.size());
+            std::memcpy(base + header.file_table_offset + uint64_t{ i } * sizeof(FileRecordV2), &file, sizeof(file));
+
+            if (!rec.chunks.empty()) {
+                std::memcpy(base + header.chunk_table_offset + uint64_t{ chunk_cursor } * sizeof(DataChunk), rec.chunks.data(), rec.chunks.size_bytes());
+            }
+            std::memcpy(base + header.string_table_offset + string_cursor, rec.path.data(), rec.path.size());
+
+            uint32_t slot = static_cast<uint32_t>(fnv1a(rec.path)) & mask;
+            for (;;) {
+                std::byte* cell = base + header.hash_table_offset + uint64_t{ slot } * sizeof(uint32_t);
+                uint32_t occupied;
+                std::memcpy(&occupied, cell, sizeof(occupied));
+                if (occupied == 0) {
+                    const uint32_t entry = i + 1;
+                    std::memcpy(cell, &entry, sizeof(entry));
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+
+            chunk_cursor += file.chunk_count;
+            string_cursor += file.path_length;
+        }
     }
 
     void ManifestSerializer::serialize(const Manifest& manifest, std::vector<std::byte>& out_buffer) {
+        if (manifest.version >= 2) {
+            std::vector<uint32_t> order(manifest.files.size());
+            std::iota(order.begin(), order.end(), 0u);
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return manifest.files[a].path < manifest.files[b].path;
+                });
+
+            std::vector<ManifestRecord> records;
+            records.reserve(order.size());
+            for (uint32_t index : order) {
+                const auto& file = manifest.files[index];
+                records.push_back({ file.path, file.original_size, file.creation_time, file.last_write_time, file.chunks });
+            }
+            ManifestSettings settings;
+            settings.compression_level = manifest.compression_level;
+            settings.dictionaries = manifest.dictionaries;
+            serializeRecords(records, settings, out_buffer);
+            return;
+        }
+
         out_buffer.clear();
         BufferWriter writer(out_buffer);
 
@@ -88,9 +382,32 @@ namespace onecloud {
         out_manifest = {}; // Clear the output manifest
         BufferReader reader(buffer);
 
+        if (peekVersion(buffer) == 2) {
+            return readVersion2(buffer, out_manifest);
+        }
+
+        if (peekVersion(buffer) == current_version()) {
+            auto view = ManifestView::open(buffer);
+            if (!view) return false;
+            out_manifest.version = current_version();
+            out_manifest.compression_level = view->compressionLevel();
+            out_manifest.dictionaries.assign(view->dictionaries().begin(), view->dictionaries().end());
+            out_manifest.files.resize(view->size());
+            for (uint32_t i = 0; i < view->size(); ++i) {
+                const auto rec = view->record(i);
+                auto& file = out_manifest.files[i];
+                file.path.assign(rec.path);
+                file.original_size = rec.original_size;
+                file.creation_time = rec.creation_time;
+                file.last_write_time = rec.last_write_time;
+                file.chunks.assign(rec.chunks.begin(), rec.chunks.end());
+            }
+            return true;
+        }
+
         // --- Manifest Header ---
         if (!reader.read(out_manifest.version)) return false;
-        if (out_manifest.version != 1) return false; // Only support version 1 for now
+        if (out_manifest.version != 1) return false;
 
         uint32_t file_count;
         if (!reader.read(file_count)) return false;
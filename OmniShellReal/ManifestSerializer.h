@@ -7,9 +7,87 @@ Copyright © 2025 Cadell Richard Anderson
 #include <span>
 #include <vector>
 #include <cstddef>
+#include <optional>
+#include <string_view>
 
 namespace onecloud {
 
+    /**
+     * @brief A non-owning view of one file entry. The path and chunk list point into the
+     *        buffer (or FileEntry) they were taken from and share its lifetime.
+     */
+    struct ManifestRecord {
+        std::string_view path;
+        uint64_t original_size = 0;
+        int64_t creation_time = 0;
+        int64_t last_write_time = 0;
+        std::span<const DataChunk> chunks;
+    };
+
+    // Container-wide settings stored alongside the file table (version 3+).
+    struct ManifestSettings {
+        int32_t compression_level = 0;
+        std::span<const CompressionDictionary> dictionaries;
+    };
+
+    /**
+     * @class ManifestView
+     * @brief Reads a version 3 manifest in place, without allocating per entry.
+     *
+     * Version 3 layout (native endianness, offsets relative to the start of the buffer):
+     *   header      : version, file_count, chunk_count, bucket_count, 64-bit offsets/sizes of the tables,
+     *                 compression level, dictionary count and dictionary table offset
+     *   file table  : file_count fixed 40-byte records sorted by path (path offset/length into the string
+     *                 table, sizes, timestamps, first chunk index, chunk count)
+     *   chunk table : chunk_count 24-byte DataChunk records (with codec), 8-byte aligned
+     *   dictionaries: dictionary_count 32-byte CompressionDictionary records
+     *   hash index  : bucket_count (power of two) 32-bit slots holding file index + 1, linear probing on FNV-1a
+     *   string table: concatenated, unterminated UTF-8 paths
+     *
+     * Version 2 is the same minus the settings fields and dictionary table, with 16-byte chunks; it is
+     * only read through ManifestSerializer::deserialize and upgraded.
+     */
+    class ManifestView {
+    public:
+        ManifestView() = default;
+
+        /**
+         * @brief Validates a version 3 manifest and returns a view over it.
+         * @param buffer The decompressed manifest. Must stay alive and unmodified while the view is used,
+         *        and must be 8-byte aligned (any heap allocation is).
+         * @return The view, or std::nullopt if the buffer is not a well-formed version 3 manifest.
+         */
+        static std::optional<ManifestView> open(std::span<const std::byte> buffer);
+
+        uint32_t size() const { return file_count_; }
+        bool empty() const { return file_count_ == 0; }
+
+        // Record at 'index' (0 <= index < size()); records are sorted by path.
+        ManifestRecord record(uint32_t index) const;
+        std::string_view path(uint32_t index) const;
+
+        // O(1) lookup through the hash index.
+        std::optional<uint32_t> find(std::string_view path) const;
+
+        // Index of the first record whose path is not less than 'key' (binary search over the sorted table).
+        uint32_t lowerBound(std::string_view key) const;
+
+        int32_t compressionLevel() const { return compression_level_; }
+        std::span<const CompressionDictionary> dictionaries() const { return dictionaries_; }
+
+    private:
+        std::span<const std::byte> buffer_;
+        uint32_t file_count_ = 0;
+        uint32_t chunk_count_ = 0;
+        uint32_t bucket_count_ = 0;
+        uint64_t string_table_offset_ = 0;
+        uint64_t file_table_offset_ = 0;
+        uint64_t chunk_table_offset_ = 0;
+        uint64_t hash_table_offset_ = 0;
+        int32_t compression_level_ = 0;
+        std::span<const CompressionDictionary> dictionaries_;
+    };
+
     /**
      * @class ManifestSerializer
      * @brief Provides static methods to serialize and deserialize the manifest
@@ -20,15 +98,32 @@ namespace onecloud {
      */
     class ManifestSerializer {
     public:
+        // The version written by serializeRecords and by serialize() for any Manifest::version >= 2.
+        static constexpr uint32_t current_version() { return 3; }
+
         /**
          * @brief Serializes an in-memory Manifest object into a byte buffer.
-         * @param manifest The Manifest object to serialize.
+         * @param manifest The Manifest object to serialize. Version 1 selects the legacy stream format,
+         *        anything newer the current indexed format.
          * @param out_buffer The byte vector that will be cleared and filled with the serialized data.
          */
         static void serialize(const Manifest& manifest, std::vector<std::byte>& out_buffer);
 
         /**
-         * @brief Deserializes a byte buffer into an in-memory Manifest object.
+         * @brief Serializes file records directly into the current format.
+         * @param records The entries to write, sorted by path with no duplicates.
+         * @param settings Container-wide compression settings to store with them.
+         * @param out_buffer The byte vector that will be cleared and filled with the serialized data.
+         */
+        static void serializeRecords(std::span<const ManifestRecord> records, const ManifestSettings& settings, std::vector<std::byte>& out_buffer);
+
+        /**
+         * @brief Returns the format version stored at the start of a serialized manifest, or 0 if too short.
+         */
+        static uint32_t peekVersion(std::span<const std::byte> buffer);
+
+        /**
+         * @brief Deserializes a byte buffer (version 1, 2 or 3) into an in-memory Manifest object.
          * @param buffer A span representing the byte buffer to deserialize.
          * @param out_manifest The Manifest object that will be populated with the deserialized data.
          * @return True if deserialization is successful, false otherwise (e.g., due to corrupted
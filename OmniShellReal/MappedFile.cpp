@@ -0,0 +1,110 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// MappedFile.cpp
+#include "MappedFile.h"
+
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        base = std::exchange(other.base, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+#ifdef _WIN32
+        mapping = std::exchange(other.mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::filesystem::path& path, std::string* error) {
+    close();
+    auto fail = [&](const std::string& why) {
+        if (error) *error = why;
+        close();
+        return false;
+    };
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return fail("cannot open (error " + std::to_string(GetLastError()) + ")");
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return fail("cannot stat (error " + std::to_string(GetLastError()) + ")");
+    }
+    opened = true;
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return true;
+    }
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // the mapping keeps the file open
+    if (!mapping) return fail("cannot map (error " + std::to_string(GetLastError()) + ")");
+    base = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!base) return fail("cannot map view (error " + std::to_string(GetLastError()) + ")");
+    length = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return fail(std::string("cannot open: ") + std::strerror(errno));
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        return fail(std::string("cannot stat: ") + std::strerror(err));
+    }
+    if (!S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return fail("not a regular file");
+    }
+    opened = true;
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd); // the mapping keeps the file open
+    if (p == MAP_FAILED) return fail(std::string("cannot map: ") + std::strerror(err));
+    base = static_cast<const unsigned char*>(p);
+    length = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    if (base) munmap(const_cast<unsigned char*>(base), length);
+#endif
+    base = nullptr;
+    length = 0;
+    opened = false;
+}
+
+void MappedFile::adviseSequential() const {
+#if defined(__linux__) || defined(__APPLE__)
+    if (base) madvise(const_cast<unsigned char*>(base), length, MADV_SEQUENTIAL);
+#endif
+}
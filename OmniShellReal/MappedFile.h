@@ -0,0 +1,51 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// MappedFile.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+ * @class MappedFile
+ * @brief A whole file mapped read-only into memory (mmap, or a file mapping view on Windows).
+ *
+ * The mapping is private to the object and released on close() or destruction. Empty files open
+ * successfully with an empty span, since neither platform can map zero bytes.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps 'path'. On failure returns false and, if given, sets 'error' to a readable reason.
+    bool open(const std::filesystem::path& path, std::string* error = nullptr);
+    void close();
+
+    // Hints that the mapping will be read front to back once (read-ahead, early page drop).
+    void adviseSequential() const;
+
+    bool isOpen() const { return opened; }
+    std::span<const unsigned char> bytes() const { return { base, length }; }
+    const unsigned char* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+};
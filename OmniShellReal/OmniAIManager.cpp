@@ -6,6 +6,7 @@ Copyright © 2025 Cadell Richard Anderson
 #include "SensorManager.h"
 #include "OmniConfig.h"
 #include "TileAnalytics.h"
+#include "TimeSeriesStore.h"
 
 #include <sstream>
 #include <vector>
@@ -72,10 +73,12 @@ static std::string buildContextSnapshot(const ConfigState& cfg) {
     os << "batteryMinThreshold=" << cfg.batteryMinThreshold << "\n";
     os << "entropyThreshold=" << cfg.entropyThreshold << "\n";
     os << "\n[LiveSensors]\n";
-    auto sensors = SensorManager::listSensors();
+    auto sensors = SensorManager::snapshot();
     for (const auto& s : sensors) {
         os << s.id << "=" << s.value << " " << s.unit << "\n";
     }
+    std::string history = TimeSeriesStore::instance().describe(std::chrono::minutes(5));
+    if (!history.empty()) os << "\n[History5m]\n" << history;
     return os.str();
 }
 
@@ -87,10 +90,12 @@ static std::string buildContext(const ConfigState& cfg) {
     out << "  batteryMinThreshold=" << cfg.batteryMinThreshold << "\n";
     out << "  entropyThreshold=" << cfg.entropyThreshold << "\n";
     out << "\nLive Sensors:\n";
-    auto sensors = SensorManager::listSensors();
+    auto sensors = SensorManager::snapshot();
     for (const auto& s : sensors) {
         out << "  " << s.label << ": " << s.value << " " << s.unit << "\n";
     }
+    std::string history = TimeSeriesStore::instance().describe(std::chrono::minutes(5));
+    if (!history.empty()) out << "\nHistory (last 5 min):\n" << history;
     return out.str();
 }
 
@@ -52,6 +52,23 @@ namespace OmniConfigNS {
             }
         }
 
+        if (tinyxml2::XMLElement* daemon = root->FirstChildElement("Daemon")) {
+            daemon->QueryIntAttribute("IntervalSeconds", &config.daemonIntervalSeconds);
+            daemon->QueryIntAttribute("SensorPollSeconds", &config.sensorPollSeconds);
+            daemon->QueryIntAttribute("PmuSampleSeconds", &config.pmuSampleSeconds);
+        }
+
+        if (tinyxml2::XMLElement* elem = root->FirstChildElement("MetricsSpillDir")) {
+            if (const char* dir = elem->GetText()) config.metricsSpillDir = dir;
+            elem->QueryIntAttribute("MaxMB", &config.metricsSpillMaxMB);
+            elem->QueryIntAttribute("MaxHours", &config.metricsSpillMaxHours);
+        }
+
+        if (tinyxml2::XMLElement* elem = root->FirstChildElement("ScanCacheFile")) {
+            const char* file = elem->GetText();
+            config.scanCacheFile = file ? file : "";
+        }
+
         // Optional: override entropyThreshold if present
         if (tinyxml2::XMLElement* elem = root->FirstChildElement("EntropyThreshold")) {
             elem->QueryDoubleText(&config.entropyThreshold);
@@ -17,7 +17,9 @@ struct ConfigState {
     int  cpuThreshold = 90;
     int  batteryMinThreshold = 20;
     double entropyThreshold = 7.5;
-    int  daemonIntervalSeconds = 30;
+    int  daemonIntervalSeconds = 30;   // base period of the daemon's tile probe and repair analysis
+    int  sensorPollSeconds = 5;        // base period of the daemon's sensor poll
+    int  pmuSampleSeconds = 10;        // base period of the daemon's PMU self-sample
     double tileTargetTimeMs = 0.8;
     double tileHighPrioFraction = 0.25;
     int  tileOverlapH = 1;
@@ -26,6 +28,10 @@ struct ConfigState {
     std::string tileOutDir = "./telemetry";
     std::string defaultQuarantineDir = "./quarantine";
     std::string defaultReportDir = "./reports";
+    std::string metricsSpillDir;    // empty keeps metric history in memory only
+    int  metricsSpillMaxMB = 256;      // spilled history kept on disk; 0 = no limit
+    int  metricsSpillMaxHours = 168;   // spilled segments older than this are deleted; 0 = no limit
+    std::string scanCacheFile = "./scan_cache.bin";     // empty disables the scan cache
 
     // NEW: name + raw byte pattern for signature matching
     std::vector<std::pair<std::string, std::vector<unsigned char>>> signaturePatterns;
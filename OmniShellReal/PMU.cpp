@@ -5,6 +5,7 @@ Copyright © 2025 Cadell Richard Anderson
 //===================================
 #include "PMU.h"
 #include "OmniAIManager.h" 
+#include "TimeSeriesStore.h"
 
 #include <vector>
 #include <string>
@@ -23,6 +24,9 @@ Copyright © 2025 Cadell Richard Anderson
 #include <cstdint>
 #include <tuple>
 #include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -44,6 +48,12 @@ Copyright © 2025 Cadell Richard Anderson
 #include <sys/types.h>
 #include <sys/sysinfo.h>
 #include <sys/resource.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <cerrno>
+#include <cstring>
+#include <array>
 #endif
 
 namespace PMU {
@@ -52,11 +62,25 @@ namespace PMU {
     static std::mutex g_summaryMutex;
 
 
+    static void RecordMetrics(const ProcessSample& a, const ProcessSample& b);
+
     std::string getRecentPmuSummary() {
         std::lock_guard<std::mutex> lock(g_summaryMutex);
         return g_lastSummary;
     }
 
+    std::string PublishDelta(const ProcessSample& a, const ProcessSample& b, size_t topN) {
+        std::string summary = BuildTopThreadSummary(a, b, topN);
+        {
+            std::lock_guard<std::mutex> lock(g_summaryMutex);
+            g_lastSummary = summary;
+        }
+        // Always push to OmniAIManager for system‑wide availability
+        OmniAIManager::setRecentPmuSummary(summary);
+        RecordMetrics(a, b);
+        return summary;
+    }
+
     void MonitorSelf(const std::chrono::milliseconds interval,
         const size_t topN,
         std::function<void(const std::string&)> onSummary,
@@ -68,14 +92,7 @@ namespace PMU {
             if (stopFlag && stopFlag->load(std::memory_order_relaxed)) break;
 
             ProcessSample curr = SampleSelf();
-            std::string summary = BuildTopThreadSummary(prev, curr, topN);
-
-            {
-                std::lock_guard<std::mutex> lock(g_summaryMutex);
-                g_lastSummary = summary;
-            }
-            // Always push to OmniAIManager for system‑wide availability
-            OmniAIManager::setRecentPmuSummary(summary);
+            std::string summary = PublishDelta(prev, curr, topN);
 
             if (onSummary) onSummary(summary);
             else std::cout << summary << std::endl;
@@ -95,9 +112,10 @@ namespace PMU {
     }
 #endif
 
-    ProcessSample SampleSelf() {
-        ProcessSample out{};
 #ifdef _WIN32
+    // One-shot snapshot: Toolhelp enumeration plus GetThreadTimes per thread.
+    static ProcessSample SampleSelfWindows() {
+        ProcessSample out{};
         out.pid = GetCurrentProcessId();
         HANDLE hProc = GetCurrentProcess();
         FILETIME c, e, k, u;
@@ -129,58 +147,562 @@ namespace PMU {
             }
             CloseHandle(snap);
         }
-#elif __linux__
-        out.pid = static_cast<uint32_t>(getpid());
-        // Process times from /proc/self/stat (utime, stime are in clock ticks)
-        {
-            std::ifstream f("/proc/self/stat");
-            std::string tmp, comm; char state;
-            uint64_t ppid, pgrp, session, tty_nr, tpgid;
-            uint64_t flags, minflt, cminflt, majflt, cmajflt, utime, stime;
-            // skip many fields, read up to utime, stime
-            // format: pid (comm) state ... utime stime ...
-            if (f) {
-                f >> out.pid;
-                f >> comm >> state;
-                for (int i = 0; i < 10; i++) f >> tmp; // skip to minflt
-                f >> minflt >> cminflt >> majflt >> cmajflt >> utime >> stime;
-                long ticks = sysconf(_SC_CLK_TCK);
-                out.user_ms = 1000.0 * static_cast<double>(utime) / ticks;
-                out.kernel_ms = 1000.0 * static_cast<double>(stime) / ticks;
-            }
-        }
-        // Threads: iterate /proc/self/task
-        {
-            DIR* d = opendir("/proc/self/task");
-            if (d) {
-                dirent* ent;
-                while ((ent = readdir(d)) != nullptr) {
+        out.threads = out.thread_samples.size();
+        out.taken_at = std::chrono::steady_clock::now();
+        return out;
+    }
+#endif
+
+    static void addCounters(HwCounters& sum, const HwCounters& add) {
+        sum.hardware = sum.hardware || add.hardware;
+        sum.cycles += add.cycles;
+        sum.instructions += add.instructions;
+        sum.cache_references += add.cache_references;
+        sum.cache_misses += add.cache_misses;
+        sum.branch_misses += add.branch_misses;
+        sum.context_switches += add.context_switches;
+    }
+
+#ifdef __linux__
+    // The fields of a /proc/<pid>/stat line this module uses (numbered as in proc(5)).
+    struct StatFields {
+        uint64_t utime = 0;        // 14
+        uint64_t stime = 0;        // 15
+        uint64_t num_threads = 0;  // 20
+        int processor = -1;        // 39, the CPU the task last ran on
+    };
+
+    // A stat line is well under 512 bytes; comm is capped at 16.
+    static constexpr size_t STAT_BUFFER = 1024;
+
+    // Hand-rolled parser: no allocation, no locale, no stream state. comm (field 2) may itself
+    // contain spaces and parentheses, so numbering starts after the last ')'.
+    static bool parseStat(const char* buf, size_t len, StatFields& out) {
+        const char* end = buf + len;
+        const char* p = end;
+        while (p > buf && p[-1] != ')') --p;
+        if (p == buf) return false;
+
+        int field = 2;
+        while (p < end) {
+            while (p < end && *p == ' ') ++p;
+            if (p == end || *p == '\n') break;
+            ++field;
+            uint64_t value = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                value = value * 10 + static_cast<uint64_t>(*p - '0');
+                ++p;
+            }
+            while (p < end && *p != ' ' && *p != '\n') ++p;
+
+            switch (field) {
+            case 14: out.utime = value; break;
+            case 15: out.stime = value; break;
+            case 20: out.num_threads = value; break;
+            case 39: out.processor = static_cast<int>(value); return true;
+            default: break;
+            }
+        }
+        return field >= 15;
+    }
+
+    // Counters are opened as three independent groups so each one fits the PMU on its own: the
+    // fixed cycle/instruction counters plus one general counter, two general counters for the cache,
+    // and the software context-switch count. The first event of a group is its leader.
+    struct CounterSpec {
+        uint32_t type;
+        uint64_t config;
+        size_t group;
+        uint64_t HwCounters::* field;
+    };
+
+    static constexpr std::array<CounterSpec, 6> COUNTERS = { {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0, &HwCounters::cycles },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0, &HwCounters::instructions },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0, &HwCounters::branch_misses },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, 1, &HwCounters::cache_references },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1, &HwCounters::cache_misses },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 2, &HwCounters::context_switches },
+    } };
+    static constexpr size_t COUNTER_GROUPS = 3;
+    // Keeps a process with thousands of threads from exhausting its fd limit on counters alone.
+    static constexpr size_t MAX_COUNTED_THREADS = 256;
+
+    static int perfEventOpen(perf_event_attr& attr, uint32_t tid, int group_fd) {
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, static_cast<pid_t>(tid), -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    static int readPerfParanoid() {
+        int level = 2;
+        if (FILE* f = std::fopen("/proc/sys/kernel/perf_event_paranoid", "r")) {
+            if (std::fscanf(f, "%d", &level) != 1) level = 2;
+            std::fclose(f);
+        }
+        return level;
+    }
+
+    class SelfSampler::Impl {
+    public:
+        struct Task {
+            uint32_t tid = 0;
+            int fd = -1;   // -1 once the fd limit is reached; the stat file is then opened per sample
+            std::string name;
+            std::array<int, COUNTERS.size()> perf{ -1, -1, -1, -1, -1, -1 };
+        };
+
+        Impl() : msPerTick(1000.0 / static_cast<double>(sysconf(_SC_CLK_TCK))) {
+            openProcess();
+        }
+
+        ~Impl() {
+            closeAll();
+        }
+
+        ProcessSample sample() {
+            // A forked child inherits fds that still describe the parent.
+            if (pid != static_cast<uint32_t>(getpid())) {
+                closeAll();
+                openProcess();
+            }
+
+            ProcessSample out{};
+            out.pid = pid;
+            StatFields proc;
+            if (readStat(procFd, 0, proc)) {
+                out.user_ms = msPerTick * static_cast<double>(proc.utime);
+                out.kernel_ms = msPerTick * static_cast<double>(proc.stime);
+            }
+
+            // Fast path: the thread count is unchanged and every cached task is still alive.
+            bool stale = (proc.num_threads != tasks.size()) || tasks.empty();
+            if (!stale) {
+                out.thread_samples.reserve(tasks.size());
+                for (const auto& task : tasks) {
+                    StatFields fields;
+                    if (!readStat(task.fd, task.tid, fields)) {
+                        stale = true;
+                        break;
+                    }
+                    out.thread_samples.push_back(toThreadSample(task, fields));
+                }
+            }
+            if (stale) {
+                rescan();
+                out.thread_samples.clear();
+                out.thread_samples.reserve(tasks.size());
+                for (const auto& task : tasks) {
+                    StatFields fields;
+                    if (readStat(task.fd, task.tid, fields)) {
+                        out.thread_samples.push_back(toThreadSample(task, fields));
+                    }
+                }
+            }
+
+            if (counting) {
+                for (const auto& ts : out.thread_samples) {
+                    if (!ts.hw) continue;
+                    if (!out.hw) out.hw.emplace();
+                    addCounters(*out.hw, *ts.hw);
+                }
+            }
+
+            out.threads = out.thread_samples.size();
+            out.taken_at = std::chrono::steady_clock::now();
+            return out;
+        }
+
+        std::map<uint32_t, std::string> threadNames() {
+            if (tasks.empty()) rescan();
+            std::map<uint32_t, std::string> names;
+            for (const auto& task : tasks) {
+                if (!task.name.empty()) names.emplace(task.tid, task.name);
+            }
+            return names;
+        }
+
+        bool enableCounters(bool enable) {
+            if (!enable) {
+                for (auto& task : tasks) closeCounters(task);
+                counting = false;
+                status = "disabled";
+                return true;
+            }
+            if (counting) return true;
+
+            paranoid = readPerfParanoid();
+            userOnly = false;
+            lastErrno = 0;
+            if (tasks.empty()) rescan();
+            counting = true;
+            size_t opened = 0;
+            bool hardware = false;
+            for (size_t i = 0; i < tasks.size() && i < MAX_COUNTED_THREADS; ++i) {
+                openCounters(tasks[i]);
+                if (tasks[i].perf[0] >= 0 || tasks[i].perf[3] >= 0) hardware = true;
+                if (tasks[i].perf[0] >= 0 || tasks[i].perf[3] >= 0 || tasks[i].perf[5] >= 0) ++opened;
+            }
+
+            if (opened == 0) {
+                counting = false;
+                status = "unavailable: " + describeError(lastErrno);
+                return false;
+            }
+            status = std::string("enabled") + (hardware ? "" : " (software only: " + describeError(lastErrno) + ")")
+                + (userOnly ? ", user-space only (perf_event_paranoid=" + std::to_string(paranoid) + ")" : "");
+            return true;
+        }
+
+        bool countersEnabled() const {
+            return counting;
+        }
+
+        std::string countersStatus() const {
+            return status;
+        }
+
+    private:
+        ThreadSample toThreadSample(const Task& task, const StatFields& fields) const {
+            ThreadSample ts{};
+            ts.tid = task.tid;
+            ts.user_ms = msPerTick * static_cast<double>(fields.utime);
+            ts.kernel_ms = msPerTick * static_cast<double>(fields.stime);
+            if (fields.processor >= 0) ts.cpu_affinity = fields.processor;
+            if (counting) ts.hw = readCounters(task);
+            return ts;
+        }
+
+        std::string describeError(int err) const {
+            switch (err) {
+            case 0: return "no counters opened";
+            case EACCES:
+            case EPERM: return "not permitted (perf_event_paranoid=" + std::to_string(paranoid) + "; lower it or grant CAP_PERFMON)";
+            case ENOENT:
+            case EOPNOTSUPP: return "no hardware PMU exposed (common inside virtual machines)";
+            case ENOSYS: return "kernel built without perf events";
+            case EMFILE:
+            case ENFILE: return "out of file descriptors";
+            default: return std::strerror(err);
+            }
+        }
+
+        // Opens each group leader first, then its members. A group is all-or-nothing so the
+        // values returned by a group read always line up with COUNTERS. Counting kernel time is tried
+        // first; once perf_event_paranoid refuses it, hardware groups fall back to user-space only.
+        // The context-switch count is skipped then, as switches are never seen from user space.
+        void openCounters(Task& task) {
+            for (size_t group = 0; group < COUNTER_GROUPS; ++group) {
+                const bool software = COUNTERS[groupStart(group)].type == PERF_TYPE_SOFTWARE;
+                if (userOnly && software) continue;
+                int err = openGroup(task, group, userOnly);
+                if (!userOnly && (err == EACCES || err == EPERM)) {
+                    userOnly = true;
+                    if (software) continue;
+                    err = openGroup(task, group, true);
+                }
+                if (err != 0 && (lastErrno == 0 || !software)) lastErrno = err;
+            }
+        }
+
+        static size_t groupStart(size_t group) {
+            size_t i = 0;
+            while (i < COUNTERS.size() && COUNTERS[i].group != group) ++i;
+            return i;
+        }
+
+        // Returns 0 or the errno of the member that failed.
+        int openGroup(Task& task, size_t group, bool excludeKernel) {
+            int leader = -1;
+            for (size_t i = groupStart(group); i < COUNTERS.size() && COUNTERS[i].group == group; ++i) {
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = COUNTERS[i].type;
+                attr.config = COUNTERS[i].config;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.exclude_kernel = excludeKernel ? 1 : 0;
+                attr.exclude_hv = 1;
+
+                int fd = perfEventOpen(attr, task.tid, leader);
+                if (fd < 0) {
+                    const int err = errno;
+                    for (size_t j = groupStart(group); j < i; ++j) {
+                        ::close(task.perf[j]);
+                        task.perf[j] = -1;
+                    }
+                    return err;
+                }
+                task.perf[i] = fd;
+                if (leader < 0) leader = fd;
+            }
+            return 0;
+        }
+
+        void closeCounters(Task& task) {
+            for (auto& fd : task.perf) {
+                if (fd >= 0) ::close(fd);
+                fd = -1;
+            }
+        }
+
+        // One read() per group returns every member plus the enabled/running times used to scale
+        // for multiplexing.
+        std::optional<HwCounters> readCounters(const Task& task) const {
+            std::optional<HwCounters> out;
+            size_t first = 0;
+            for (size_t group = 0; group < COUNTER_GROUPS; ++group) {
+                size_t members = 0;
+                while (first + members < COUNTERS.size() && COUNTERS[first + members].group == group) ++members;
+                const int leader = task.perf[first];
+                if (leader >= 0) {
+                    uint64_t buf[3 + COUNTERS.size()] = {};
+                    ssize_t n = ::read(leader, buf, sizeof(buf));
+                    if (n >= static_cast<ssize_t>((3 + members) * sizeof(uint64_t)) && buf[0] == members) {
+                        const uint64_t enabled = buf[1];
+                        const uint64_t running = buf[2];
+                        const double scale = running ? static_cast<double>(enabled) / static_cast<double>(running) : 0.0;
+                        if (!out) out.emplace();
+                        for (size_t m = 0; m < members; ++m) {
+                            (*out).*(COUNTERS[first + m].field) = static_cast<uint64_t>(static_cast<double>(buf[3 + m]) * scale);
+                        }
+                        if (COUNTERS[first].type == PERF_TYPE_HARDWARE) out->hardware = true;
+                    }
+                }
+                first += members;
+            }
+            return out;
+        }
+
+        int openTaskFile(uint32_t tid, const char* file) const {
+            char rel[48];
+            std::snprintf(rel, sizeof(rel), "%u/%s", tid, file);
+            return openat(taskDirFd, rel, O_RDONLY | O_CLOEXEC);
+        }
+
+        // pread() from offset 0 makes procfs regenerate the line, so one fd serves every sample.
+        bool readStat(int fd, uint32_t tid, StatFields& fields) const {
+            char buf[STAT_BUFFER];
+            ssize_t n = -1;
+            if (fd >= 0) {
+                n = pread(fd, buf, sizeof(buf), 0);
+            }
+            else if (tid != 0) {
+                int transient = openTaskFile(tid, "stat");
+                if (transient < 0) return false;
+                n = pread(transient, buf, sizeof(buf), 0);
+                ::close(transient);
+            }
+            return n > 0 && parseStat(buf, static_cast<size_t>(n), fields);
+        }
+
+        std::string readComm(uint32_t tid) const {
+            int fd = openTaskFile(tid, "comm");
+            if (fd < 0) return {};
+            char buf[64];
+            ssize_t n = pread(fd, buf, sizeof(buf), 0);
+            ::close(fd);
+            if (n <= 0) return {};
+            std::string name(buf, static_cast<size_t>(n));
+            if (!name.empty() && name.back() == '\n') name.pop_back();
+            return name;
+        }
+
+        // Re-lists /proc/self/task, keeping the fds of threads that still exist. Names are re-read
+        // for every thread because threads usually name themselves after they start.
+        void rescan() {
+            std::map<uint32_t, Task> previous;
+            for (auto& task : tasks) previous.emplace(task.tid, std::move(task));
+            tasks.clear();
+
+            if (DIR* d = opendir("/proc/self/task")) {
+                while (dirent* ent = readdir(d)) {
                     if (ent->d_name[0] == '.') continue;
-                    ThreadSample ts{};
-                    ts.tid = static_cast<uint32_t>(std::stoul(ent->d_name));
-                    // per-thread times
-                    std::ifstream ft(std::string("/proc/self/task/") + ent->d_name + "/stat");
-                    if (ft) {
-                        std::string tcomm; char tstate;
-                        uint64_t utime, stime;
-                        std::string skip;
-                        ft >> ts.tid >> tcomm >> tstate;
-                        for (int i = 0; i < 10; i++) ft >> skip;
-                        uint64_t minflt, cminflt, majflt, cmajflt;
-                        ft >> minflt >> cminflt >> majflt >> cmajflt >> utime >> stime;
-                        long ticks = sysconf(_SC_CLK_TCK);
-                        ts.user_ms = 1000.0 * static_cast<double>(utime) / ticks;
-                        ts.kernel_ms = 1000.0 * static_cast<double>(stime) / ticks;
+                    const uint32_t tid = static_cast<uint32_t>(std::strtoul(ent->d_name, nullptr, 10));
+                    Task task;
+                    auto it = previous.find(tid);
+                    if (it != previous.end()) {
+                        task = std::move(it->second);
+                        previous.erase(it);
+                    }
+                    else {
+                        task.tid = tid;
+                        task.fd = openTaskFile(tid, "stat");
+                        if (counting && tasks.size() < MAX_COUNTED_THREADS) openCounters(task);
                     }
-                    out.thread_samples.push_back(ts);
+                    task.name = readComm(tid);
+                    tasks.push_back(std::move(task));
                 }
                 closedir(d);
             }
+            for (auto& [tid, task] : previous) {
+                if (task.fd >= 0) ::close(task.fd);
+                closeCounters(task);
+            }
+        }
+
+        void openProcess() {
+            pid = static_cast<uint32_t>(getpid());
+            procFd = ::open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+            taskDirFd = ::open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+
+        void closeAll() {
+            for (auto& task : tasks) {
+                if (task.fd >= 0) ::close(task.fd);
+                closeCounters(task);
+            }
+            tasks.clear();
+            if (procFd >= 0) ::close(procFd);
+            if (taskDirFd >= 0) ::close(taskDirFd);
+            procFd = -1;
+            taskDirFd = -1;
         }
+
+        const double msPerTick;
+        bool counting = false;
+        bool userOnly = false;
+        int paranoid = 2;
+        int lastErrno = 0;
+        std::string status = "disabled";
+        uint32_t pid = 0;
+        int procFd = -1;
+        int taskDirFd = -1;
+        std::vector<Task> tasks;
+    };
+#else
+    class SelfSampler::Impl {
+    public:
+        ProcessSample sample() {
+#ifdef _WIN32
+            return SampleSelfWindows();
+#else
+            ProcessSample out{};
+            out.taken_at = std::chrono::steady_clock::now();
+            return out;
 #endif
-        out.threads = out.thread_samples.size();
-        out.taken_at = std::chrono::steady_clock::now();
-        return out;
+        }
+
+        std::map<uint32_t, std::string> threadNames() {
+            return {};
+        }
+
+        bool enableCounters(bool enable) {
+            return !enable;
+        }
+
+        bool countersEnabled() const {
+            return false;
+        }
+
+        std::string countersStatus() const {
+            return "unavailable: hardware counters need perf_event_open (Linux)";
+        }
+    };
+#endif
+
+    SelfSampler::SelfSampler() : pImpl(std::make_unique<Impl>()) {}
+    SelfSampler::~SelfSampler() = default;
+
+    ProcessSample SelfSampler::sample() {
+        return pImpl->sample();
+    }
+
+    std::map<uint32_t, std::string> SelfSampler::threadNames() {
+        return pImpl->threadNames();
+    }
+
+    bool SelfSampler::enableCounters(bool enable) {
+        return pImpl->enableCounters(enable);
+    }
+
+    bool SelfSampler::countersEnabled() const {
+        return pImpl->countersEnabled();
+    }
+
+    std::string SelfSampler::countersStatus() const {
+        return pImpl->countersStatus();
+    }
+
+    static std::mutex g_samplerMutex;
+
+    static SelfSampler& sharedSampler() {
+        static SelfSampler sampler;
+        return sampler;
+    }
+
+    ProcessSample SampleSelf() {
+        std::lock_guard<std::mutex> lock(g_samplerMutex);
+        return sharedSampler().sample();
+    }
+
+    bool EnableHardwareCounters(bool enable) {
+        std::lock_guard<std::mutex> lock(g_samplerMutex);
+        return sharedSampler().enableCounters(enable);
+    }
+
+    std::string HardwareCounterStatus() {
+        std::lock_guard<std::mutex> lock(g_samplerMutex);
+        return sharedSampler().countersStatus();
+    }
+
+    double BenchmarkSampling(size_t threads, size_t samples) {
+        threads = (std::min)(threads, MAX_BENCHMARK_THREADS);
+        std::mutex m;
+        std::condition_variable cv;
+        bool done = false;
+        std::vector<std::thread> idle;
+        auto release = [&] {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                done = true;
+            }
+            cv.notify_all();
+            for (auto& t : idle) t.join();
+        };
+        idle.reserve(threads);
+        try {
+            for (size_t i = 0; i < threads; ++i) {
+                idle.emplace_back([&] {
+                    std::unique_lock<std::mutex> lock(m);
+                    cv.wait(lock, [&] { return done; });
+                    });
+            }
+        }
+        catch (...) {
+            release();  // the threads already started are joinable; destroying them would terminate
+            throw;
+        }
+
+        // Wait until every thread shows up so the timed loop measures the steady state, not rescans.
+        // Samplers that report no thread count (macOS) are not waited for, and none waits past a second.
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        for (size_t seen = SampleSelf().threads; seen != 0 && seen < threads + 1; seen = SampleSelf().threads) {
+            if (std::chrono::steady_clock::now() >= deadline) break;
+            std::this_thread::yield();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < samples; ++i) {
+            SampleSelf();
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        release();
+
+        if (samples == 0) return 0.0;
+        return std::chrono::duration<double, std::micro>(elapsed).count() / static_cast<double>(samples);
+    }
+
+    // Counters only grow while a thread lives, but a thread whose group was reopened after a rescan
+    // starts again from zero; clamp rather than wrap in that case.
+    static HwCounters diffCounters(const HwCounters& a, const HwCounters& b) {
+        auto sub = [](uint64_t x, uint64_t y) { return x > y ? x - y : 0; };
+        HwCounters d{};
+        d.hardware = b.hardware;
+        d.cycles = sub(b.cycles, a.cycles);
+        d.instructions = sub(b.instructions, a.instructions);
+        d.cache_references = sub(b.cache_references, a.cache_references);
+        d.cache_misses = sub(b.cache_misses, a.cache_misses);
+        d.branch_misses = sub(b.branch_misses, a.branch_misses);
+        d.context_switches = sub(b.context_switches, a.context_switches);
+        return d;
     }
 
     CpuDelta Diff(const ProcessSample& a, const ProcessSample& b) {
@@ -197,11 +719,17 @@ namespace PMU {
             if (it != a.thread_samples.end()) {
                 delta.user_ms = (std::max)(0.0, tb.user_ms - it->user_ms);
                 delta.kernel_ms = (std::max)(0.0, tb.kernel_ms - it->kernel_ms);
+                if (tb.hw) delta.hw = it->hw ? diffCounters(*it->hw, *tb.hw) : *tb.hw;
             }
             else {
                 // new thread
                 delta.user_ms = tb.user_ms;
                 delta.kernel_ms = tb.kernel_ms;
+                delta.hw = tb.hw;
+            }
+            if (delta.hw) {
+                if (!d.proc_hw) d.proc_hw.emplace();
+                addCounters(*d.proc_hw, *delta.hw);
             }
             d.thread_deltas.push_back(delta);
         }
@@ -341,6 +869,22 @@ namespace PMU {
         return out;
     }
 
+    // Feeds the shared time-series store so windowed queries replace re-sampling and CSV reparsing.
+    static void RecordMetrics(const ProcessSample& a, const ProcessSample& b) {
+        auto& store = TimeSeriesStore::instance();
+        const CpuPercentages pct = ComputeCpuPercentages(a, b);
+        store.append("pmu.proc_cpu_pct", pct.proc_pct, "%");
+        store.append("pmu.threads", static_cast<double>(b.threads));
+        CpuDelta d = Diff(a, b);
+        if (d.proc_hw) {
+            if (d.proc_hw->hardware) {
+                store.append("pmu.ipc", d.proc_hw->ipc());
+                store.append("pmu.cache_miss_pct", d.proc_hw->cacheMissRate() * 100.0, "%");
+            }
+            store.append("pmu.context_switches", static_cast<double>(d.proc_hw->context_switches));
+        }
+    }
+
     // Resolve thread names for current process (best-effort)
     static inline std::map<uint32_t, std::string> GetThreadNamesSelf() {
         std::map<uint32_t, std::string> names;
@@ -387,28 +931,15 @@ namespace PMU {
             CloseHandle(snap);
         }
 #elif __linux__
-        DIR* d = opendir("/proc/self/task");
-        if (d) {
-            dirent* ent;
-            while ((ent = readdir(d)) != nullptr) {
-                if (ent->d_name[0] == '.') continue;
-                uint32_t tid = static_cast<uint32_t>(std::stoul(ent->d_name));
-                std::ifstream comm(std::string("/proc/self/task/") + ent->d_name + "/comm");
-                if (comm) {
-                    std::string n;
-                    std::getline(comm, n);
-                    if (!n.empty() && n.back() == '\n') n.pop_back();
-                    if (!n.empty()) names.emplace(tid, std::move(n));
-                }
-            }
-            closedir(d);
-        }
+        // Cached by the shared sampler; refreshed whenever the thread list changes.
+        std::lock_guard<std::mutex> lock(g_samplerMutex);
+        names = sharedSampler().threadNames();
 #endif
         return names;
     }
 
     // Build a concise top-N summary over a delta
-    static inline std::string BuildTopThreadSummary(const ProcessSample& a,
+    std::string BuildTopThreadSummary(const ProcessSample& a,
         const ProcessSample& b,
         size_t topN) // default lives in PMU.h
     {
@@ -426,6 +957,13 @@ namespace PMU {
             pctByTid[p.first] = p.second;
         }
 
+        std::map<uint32_t, HwCounters> hwByTid;
+        if (b.hw) {
+            for (const auto& td : Diff(a, b).thread_deltas) {
+                if (td.hw) hwByTid[td.tid] = *td.hw;
+            }
+        }
+
         for (const auto& m : pct.thread_ms) {
             uint32_t tid = m.first;
             double ms = m.second;
@@ -462,7 +1000,16 @@ namespace PMU {
                 os << " name=\"" << nm << "\"";
             }
             os << " cpu_ms=" << std::fixed << std::setprecision(3) << ms
-                << " cpu%=" << std::fixed << std::setprecision(2) << p << "]";
+                << " cpu%=" << std::fixed << std::setprecision(2) << p;
+            auto hw = hwByTid.find(tid);
+            if (hw != hwByTid.end()) {
+                if (hw->second.hardware) {
+                    os << " ipc=" << std::fixed << std::setprecision(2) << hw->second.ipc()
+                        << " llc_miss%=" << std::fixed << std::setprecision(2) << hw->second.cacheMissRate() * 100.0;
+                }
+                os << " csw=" << hw->second.context_switches;
+            }
+            os << "]";
             if (i + 1 < topN) {
                 os << " ";
             }
@@ -12,15 +12,33 @@ Copyright © 2025 Cadell Richard Anderson
 #include <optional>
 #include <functional>
 #include <atomic>
+#include <map>
+#include <memory>
 
 namespace PMU {
 
+    // Hardware and scheduler counters from perf_event_open (Linux). Totals since the thread was first
+    // seen, scaled up when the kernel had to multiplex the counters.
+    struct HwCounters {
+        bool hardware{ false };          // false when only the software counter could be opened
+        uint64_t cycles{ 0 };
+        uint64_t instructions{ 0 };
+        uint64_t cache_references{ 0 };
+        uint64_t cache_misses{ 0 };
+        uint64_t branch_misses{ 0 };
+        uint64_t context_switches{ 0 };
+
+        double ipc() const { return cycles ? static_cast<double>(instructions) / static_cast<double>(cycles) : 0.0; }
+        double cacheMissRate() const { return cache_references ? static_cast<double>(cache_misses) / static_cast<double>(cache_references) : 0.0; }
+    };
+
     // Represents a single thread's CPU time sample
     struct ThreadSample {
         uint32_t tid{ 0 };
         double user_ms{ 0.0 };
         double kernel_ms{ 0.0 };
         std::optional<int> cpu_affinity; // logical CPU id if known
+        std::optional<HwCounters> hw;    // set while hardware counters are enabled
     };
 
     // Control flag for live monitor loop (namespace‑scope)
@@ -33,6 +51,7 @@ namespace PMU {
         double kernel_ms{ 0.0 };
         size_t threads{ 0 };
         std::vector<ThreadSample> thread_samples;
+        std::optional<HwCounters> hw;    // sum over the live threads that have counters
         std::chrono::steady_clock::time_point taken_at;
     };
 
@@ -41,11 +60,48 @@ namespace PMU {
         double proc_user_ms{ 0.0 };
         double proc_kernel_ms{ 0.0 };
         std::vector<ThreadSample> thread_deltas; // per-thread delta
+        std::optional<HwCounters> proc_hw;
     };
 
     // Take a single snapshot of current process and its threads
     ProcessSample SampleSelf();
 
+    // Samples the current process repeatedly at low cost. On Linux the /proc stat files of the process
+    // and of every thread are opened once and re-read with pread(); the thread list is only rescanned
+    // when the thread count changes or a thread exits. SampleSelf() shares one instance.
+    class SelfSampler {
+    public:
+        SelfSampler();
+        ~SelfSampler();
+        SelfSampler(const SelfSampler&) = delete;
+        SelfSampler& operator=(const SelfSampler&) = delete;
+
+        ProcessSample sample();
+        // Thread names as of the last rescan of the thread list.
+        std::map<uint32_t, std::string> threadNames();
+
+        // Opens or closes perf_event_open counters for every thread (two hardware groups plus a
+        // context-switch counter, six fds per thread). Returns false, leaving CPU-time sampling
+        // untouched, when perf events are unavailable; countersStatus() then says why.
+        bool enableCounters(bool enable);
+        bool countersEnabled() const;
+        std::string countersStatus() const;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pImpl;
+    };
+
+    // Hardware counters for SampleSelf() and the monitor; off by default.
+    bool EnableHardwareCounters(bool enable);
+    std::string HardwareCounterStatus();
+
+    constexpr size_t MAX_BENCHMARK_THREADS = 4096;
+
+    // Average cost of one SampleSelf() in microseconds while 'threads' extra idle threads (at most
+    // MAX_BENCHMARK_THREADS) are alive. Throws std::system_error if they cannot all be started.
+    double BenchmarkSampling(size_t threads, size_t samples);
+
     // Compute delta CPU times between two snapshots
     CpuDelta Diff(const ProcessSample& a, const ProcessSample& b);
 
@@ -72,6 +128,12 @@ namespace PMU {
         const ProcessSample& b,
         size_t topN = 5);
 
+    // Builds the top-N summary for a delta and publishes it the way MonitorSelf does: as the recent
+    // summary, to OmniAIManager and to the metric history. Returns the summary.
+    std::string PublishDelta(const ProcessSample& a,
+        const ProcessSample& b,
+        size_t topN = 5);
+
     // Retrieve last summary string (if stored globally)
     std::string getRecentPmuSummary();
 
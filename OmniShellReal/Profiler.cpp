@@ -0,0 +1,394 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// Profiler.cpp
+
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace Profiler {
+
+#ifdef __linux__
+    namespace {
+        constexpr size_t MAX_DEPTH_LIMIT = 128;
+        constexpr uintptr_t MAX_STACK_SPAN = uintptr_t(1) << 30;  // upper bound on a stack walk's reach
+        constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(100);
+
+        enum SlotState : uint32_t { Free = 0, Writing = 1, Ready = 2 };
+
+        // Filled by the signal handler. A slot is claimed by CAS so a handler never waits on the
+        // drainer; a slot still busy when its turn comes round means the sample is dropped.
+        struct Slot {
+            std::atomic<uint32_t> state{ Free };
+            uint32_t tid = 0;
+            uint32_t depth = 0;
+            void* pcs[MAX_DEPTH_LIMIT];
+        };
+
+        // Read by the signal handler, so only trivially accessible atomics and raw pointers.
+        std::atomic<bool> g_sampling{ false };
+        std::atomic<uint64_t> g_cursor{ 0 };
+        std::atomic<uint64_t> g_dropped{ 0 };
+        Slot* g_slots = nullptr;
+        size_t g_slotMask = 0;
+        size_t g_maxDepth = 64;
+        uintptr_t g_stackSpan = uintptr_t(8) << 20;     // how far above sp a frame may lie (RLIMIT_STACK)
+
+        // Everything below is owned by the control functions and the drainer.
+        std::mutex g_mutex;                 // guards the profile and the drainer lifecycle
+        std::condition_variable g_wake;
+        std::thread g_drainer;
+        bool g_stopDrainer = false;
+        bool g_handlerInstalled = false;
+        // A handler that read g_slots just before a restart may still be writing to the previous
+        // buffer, so replaced buffers are retired rather than freed.
+        std::vector<std::unique_ptr<Slot[]>> g_slotBuffers;
+        Options g_options;
+        uint64_t g_folded = 0;
+
+        // Stacks are kept as raw addresses, leaf first, per thread name; symbolization happens once
+        // per distinct address at dump time.
+        std::map<std::string, std::map<std::vector<uintptr_t>, uint64_t>> g_stacks;
+        std::unordered_map<uint32_t, std::string> g_threadNames;
+        std::unordered_map<uintptr_t, std::string> g_symbols;
+
+        uint64_t currentThreadId() {
+            return static_cast<uint64_t>(syscall(SYS_gettid));
+        }
+
+        struct Registers {
+            uintptr_t pc = 0;
+            uintptr_t fp = 0;
+            uintptr_t sp = 0;
+        };
+
+        Registers interruptedRegisters(void* context) {
+            auto* uc = static_cast<ucontext_t*>(context);
+            Registers r;
+#if defined(__x86_64__)
+            r.pc = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+            r.fp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RBP]);
+            r.sp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+            r.pc = static_cast<uintptr_t>(uc->uc_mcontext.pc);
+            r.fp = static_cast<uintptr_t>(uc->uc_mcontext.regs[29]);
+            r.sp = static_cast<uintptr_t>(uc->uc_mcontext.sp);
+#else
+            (void)uc;
+#endif
+            return r;
+        }
+
+        // Copies memory of this process without faulting: an unmapped address makes the kernel return
+        // EFAULT rather than raise SIGSEGV. A plain system call, so safe inside the handler.
+        bool readOwnMemory(uintptr_t address, void* out, size_t size) {
+            iovec local{ out, size };
+            iovec remote{ reinterpret_cast<void*>(address), size };
+            return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+        }
+
+        // Runs on the sampled thread, so it only touches the slot, atomics and system calls: glibc's
+        // backtrace() takes the unwinder's and the loader's locks and could deadlock here. Instead it
+        // walks the frame-pointer chain from the interrupted registers; each frame holds the caller's
+        // frame pointer and the return address. Frames must lie on the stack above sp, move strictly
+        // upward and be readable, so code built without frame pointers just ends the stack early.
+        void onProfSignal(int, siginfo_t*, void* context) {
+            if (!g_sampling.load(std::memory_order_relaxed)) return;
+            const int savedErrno = errno;
+
+            Slot& slot = g_slots[g_cursor.fetch_add(1, std::memory_order_relaxed) & g_slotMask];
+            uint32_t expected = Free;
+            if (!slot.state.compare_exchange_strong(expected, Writing, std::memory_order_acquire)) {
+                g_dropped.fetch_add(1, std::memory_order_relaxed);
+                errno = savedErrno;
+                return;
+            }
+
+            const Registers regs = interruptedRegisters(context);
+            uint32_t depth = 0;
+            if (regs.pc) slot.pcs[depth++] = reinterpret_cast<void*>(regs.pc);
+            uintptr_t fp = regs.fp;
+            while (depth < g_maxDepth && fp >= regs.sp && fp - regs.sp < g_stackSpan && fp % sizeof(uintptr_t) == 0) {
+                uintptr_t frame[2];     // saved frame pointer, return address
+                if (!readOwnMemory(fp, frame, sizeof frame) || frame[1] == 0) break;
+                slot.pcs[depth++] = reinterpret_cast<void*>(frame[1]);
+                if (frame[0] <= fp) break;
+                fp = frame[0];
+            }
+            slot.tid = static_cast<uint32_t>(currentThreadId());
+            slot.depth = depth;
+            slot.state.store(Ready, std::memory_order_release);
+            errno = savedErrno;
+        }
+
+        std::string threadName(uint32_t tid) {
+            auto it = g_threadNames.find(tid);
+            if (it != g_threadNames.end()) return it->second;
+            std::ifstream f("/proc/self/task/" + std::to_string(tid) + "/comm");
+            std::string name;
+            if (!f || !std::getline(f, name) || name.empty()) name = "tid-" + std::to_string(tid);
+            std::replace(name.begin(), name.end(), ';', ':');
+            g_threadNames.emplace(tid, name);
+            return name;
+        }
+
+        // Caller holds g_mutex.
+        void drainLocked() {
+            if (!g_slots) return;
+            for (size_t i = 0; i <= g_slotMask; ++i) {
+                Slot& slot = g_slots[i];
+                if (slot.state.load(std::memory_order_acquire) != Ready) continue;
+                std::vector<uintptr_t> stack(slot.depth);
+                for (uint32_t d = 0; d < slot.depth; ++d) stack[d] = reinterpret_cast<uintptr_t>(slot.pcs[d]);
+                const uint32_t tid = slot.tid;
+                slot.state.store(Free, std::memory_order_release);
+
+                if (!stack.empty()) {
+                    ++g_stacks[threadName(tid)][stack];
+                    ++g_folded;
+                }
+            }
+        }
+
+        void drainerLoop() {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            while (!g_stopDrainer) {
+                g_wake.wait_for(lock, DRAIN_INTERVAL);
+                drainLocked();
+            }
+        }
+
+        // Return addresses point after the call; step back one byte so the lookup lands in the caller's
+        // call instruction. The leaf is an interrupted instruction and is used as-is.
+        const std::string& symbolize(uintptr_t address, bool leaf) {
+            const uintptr_t lookup = leaf ? address : address - 1;
+            auto it = g_symbols.find(lookup);
+            if (it != g_symbols.end()) return it->second;
+
+            std::string name;
+            Dl_info info{};
+            if (dladdr(reinterpret_cast<void*>(lookup), &info) && info.dli_sname) {
+                int status = 0;
+                char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                name = (status == 0 && demangled) ? demangled : info.dli_sname;
+                std::free(demangled);
+            }
+            else if (info.dli_fname) {
+                std::ostringstream os;
+                const char* base = std::strrchr(info.dli_fname, '/');
+                os << (base ? base + 1 : info.dli_fname) << "+0x" << std::hex
+                    << (lookup - reinterpret_cast<uintptr_t>(info.dli_fbase));
+                name = os.str();
+            }
+            else {
+                std::ostringstream os;
+                os << "0x" << std::hex << lookup;
+                name = os.str();
+            }
+            std::replace(name.begin(), name.end(), ';', ':');
+            return g_symbols.emplace(lookup, std::move(name)).first->second;
+        }
+
+        bool installHandler() {
+            if (g_handlerInstalled) return true;
+            struct sigaction sa {};
+            sa.sa_sigaction = &onProfSignal;
+            sa.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            if (sigaction(SIGPROF, &sa, nullptr) != 0) return false;
+            // The handler stays installed after Stop(): a SIGPROF still in flight would otherwise
+            // hit the default action and terminate the process.
+            g_handlerInstalled = true;
+            return true;
+        }
+
+        bool armTimer(unsigned hz) {
+            itimerval timer{};
+            if (hz > 0) {
+                const long usec = std::max<long>(1000000L / static_cast<long>(hz), 1);
+                timer.it_interval.tv_sec = usec / 1000000L;
+                timer.it_interval.tv_usec = usec % 1000000L;
+                timer.it_value = timer.it_interval;
+            }
+            return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+        }
+    }
+
+    bool Start(const Options& options) {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        if (g_sampling.load()) return false;
+
+        // Thread stacks default to RLIMIT_STACK, and the main thread grows up to it.
+        rlimit stackLimit{};
+        if (getrlimit(RLIMIT_STACK, &stackLimit) == 0 && stackLimit.rlim_cur != RLIM_INFINITY) {
+            g_stackSpan = std::min<uintptr_t>(static_cast<uintptr_t>(stackLimit.rlim_cur), MAX_STACK_SPAN);
+        }
+        else {
+            g_stackSpan = MAX_STACK_SPAN;
+        }
+
+        g_options = options;
+        g_options.hz = std::clamp(options.hz, 1u, 10000u);
+        g_options.max_depth = std::clamp<size_t>(options.max_depth, 1, MAX_DEPTH_LIMIT);
+        size_t capacity = 1;
+        while (capacity < std::max<size_t>(options.buffer_samples, 64)) capacity <<= 1;
+
+        if (!g_slots || g_slotMask + 1 != capacity) {
+            g_slotBuffers.push_back(std::make_unique<Slot[]>(capacity));
+            g_slots = g_slotBuffers.back().get();
+            g_slotMask = capacity - 1;
+        }
+        for (size_t i = 0; i < capacity; ++i) g_slots[i].state.store(Free);
+        g_maxDepth = g_options.max_depth;
+        g_cursor.store(0);
+        g_dropped.store(0);
+        g_folded = 0;
+        g_stacks.clear();
+        g_threadNames.clear();
+
+        if (!installHandler()) return false;
+        g_stopDrainer = false;
+        g_drainer = std::thread(drainerLoop);
+        g_sampling.store(true);
+        if (!armTimer(g_options.hz)) {
+            g_sampling.store(false);
+            g_stopDrainer = true;
+            lock.unlock();
+            g_wake.notify_all();
+            g_drainer.join();
+            return false;
+        }
+        return true;
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            if (!g_sampling.load()) return;
+            armTimer(0);
+            g_sampling.store(false);
+            g_stopDrainer = true;
+        }
+        g_wake.notify_all();
+        if (g_drainer.joinable()) g_drainer.join();
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        drainLocked();
+    }
+
+    bool Running() {
+        return g_sampling.load();
+    }
+
+    long long DumpFolded(const std::string& path) {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) return -1;
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        drainLocked();
+
+        // Different addresses inside one function fold to the same line once symbolized.
+        std::map<std::string, uint64_t> folded;
+        for (const auto& [thread, stacks] : g_stacks) {
+            for (const auto& [stack, count] : stacks) {
+                std::string line = thread;
+                for (size_t i = stack.size(); i-- > 0;) {
+                    line += ';';
+                    line += symbolize(stack[i], i == 0);
+                }
+                folded[line] += count;
+            }
+        }
+        for (const auto& [line, count] : folded) out << line << ' ' << count << '\n';
+        return out ? static_cast<long long>(folded.size()) : -1;
+    }
+
+    std::string TopFrames(size_t n) {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        drainLocked();
+        std::map<std::string, uint64_t> self;
+        for (const auto& [thread, stacks] : g_stacks) {
+            for (const auto& [stack, count] : stacks) {
+                self[symbolize(stack.front(), true)] += count;
+            }
+        }
+        std::vector<std::pair<std::string, uint64_t>> ranked(self.begin(), self.end());
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+        if (ranked.size() > n) ranked.resize(n);
+
+        std::ostringstream os;
+        for (const auto& [name, count] : ranked) {
+            os << std::setw(8) << count << "  " << std::fixed << std::setprecision(1) << std::setw(5)
+                << (g_folded ? 100.0 * static_cast<double>(count) / static_cast<double>(g_folded) : 0.0) << "%  " << name << "\n";
+        }
+        return os.str();
+    }
+
+    std::string Status() {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        size_t distinct = 0;
+        for (const auto& [thread, stacks] : g_stacks) distinct += stacks.size();
+        std::ostringstream os;
+        os << (g_sampling.load() ? "running" : "stopped")
+            << " hz=" << g_options.hz
+            << " samples=" << g_folded
+            << " dropped=" << g_dropped.load()
+            << " stacks=" << distinct;
+        return os.str();
+    }
+
+#else
+
+    bool Start(const Options&) {
+        return false;
+    }
+
+    void Stop() {}
+
+    bool Running() {
+        return false;
+    }
+
+    long long DumpFolded(const std::string&) {
+        return -1;
+    }
+
+    std::string TopFrames(size_t) {
+        return {};
+    }
+
+    std::string Status() {
+        return "unavailable: the sampling profiler needs SIGPROF (Linux)";
+    }
+
+#endif
+
+} // namespace Profiler
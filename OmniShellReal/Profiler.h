@@ -0,0 +1,45 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// Profiler.h
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// In-process statistical profiler. While running, the CPU-time interval timer (ITIMER_PROF) fires
+// SIGPROF on whichever thread is consuming CPU; the handler walks that thread's frame-pointer
+// chain into a preallocated slot and returns (stacks are complete only for code built with
+// -fno-omit-frame-pointer). A background thread drains the slots, symbolizes the return
+// addresses and folds identical stacks, so the output can go straight into flamegraph.pl or
+// speedscope. Linux only; elsewhere Start() fails and Status() says so.
+namespace Profiler {
+
+    struct Options {
+        unsigned hz = 99;               // samples per CPU-second; off a round number to avoid lockstep with timers
+        size_t buffer_samples = 4096;   // slots between drains; samples beyond this are dropped and counted
+        size_t max_depth = 64;          // frames kept per sample, leaf first
+    };
+
+    // Starts sampling, discarding any previous profile. Returns false if already running or the
+    // timer or signal handler could not be installed.
+    bool Start(const Options& options = {});
+
+    // Stops the timer and folds the remaining samples. The profile stays available for dumps.
+    void Stop();
+
+    bool Running();
+
+    /**
+     * @brief Writes the profile in folded-stack format, one "thread;root;...;leaf count" line per
+     *        distinct stack. Stacks of threads with the same name are merged.
+     * @return The number of lines written, or -1 if the file could not be opened.
+     */
+    long long DumpFolded(const std::string& path);
+
+    // The 'n' functions with the most samples at the top of the stack (self time).
+    std::string TopFrames(size_t n);
+
+    // One-line state: running flag, rate, samples folded and dropped, distinct stacks.
+    std::string Status();
+
+} // namespace Profiler
@@ -0,0 +1,426 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// ScanCache.cpp
+#include "ScanCache.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+    constexpr char MAGIC[8] = { 'O', 'M', 'N', 'I', 'S', 'C', 'A', 'N' };
+    constexpr uint32_t VERSION = 2;             // 2: probe verdicts from BinaryImage
+    constexpr uint64_t BYTE_ORDER_MARK = 0x0102030405060708ull;
+    constexpr int64_t RACY_NS = 2'000'000'000;  // coarser than any filesystem timestamp we care about
+
+    struct DiskHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t byte_order;
+        uint64_t count;
+        uint64_t strings_bytes;
+    };
+
+    enum : uint8_t {
+        HAS_SCAN = 1, SAMPLED = 2, HAS_PROBE = 4, RECOGNIZED = 8,
+        IS_LIBRARY = 16, POSITION_INDEPENDENT = 32, STRIPPED = 64
+    };
+
+    // Fixed size and sorted by (device, inode), so the mapped index can be binary-searched in place.
+    struct DiskRecord {
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        int64_t mtime_ns;
+        int64_t change_ns;
+        int64_t recorded_ns;
+        uint64_t scan_key;
+        double entropy;
+        uint64_t bytes_scanned;
+        uint64_t content_hash;
+        uint64_t image_base;
+        uint64_t entry_rva;
+        uint32_t signature_offset;  // into the string pool
+        uint32_t signature_length;
+        uint8_t flags;
+        uint8_t arch;
+        uint8_t os;
+        uint8_t reserved[5];
+    };
+    static_assert(sizeof(DiskHeader) == 40 && sizeof(DiskRecord) == 112, "on-disk layout changed");
+
+    struct Entry {
+        FileIdentity id;
+        int64_t recorded_ns = 0;
+        bool hasScan = false;
+        uint64_t scanKey = 0;
+        CachedScan scan;
+        bool hasProbe = false;
+        CachedProbe probe;
+    };
+
+    struct Key {
+        uint64_t device;
+        uint64_t inode;
+        bool operator==(const Key&) const = default;
+        bool operator<(const Key& o) const { return device != o.device ? device < o.device : inode < o.inode; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return std::hash<uint64_t>()(k.inode * 0x9E3779B97F4A7C15ull ^ k.device); }
+    };
+
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // An entry recorded in the same timestamp tick as the file's last write may predate a second write.
+    bool trusted(const Entry& e, const FileIdentity& id) {
+        return e.id == id && e.recorded_ns - id.mtime_ns >= RACY_NS;
+    }
+}
+
+struct ScanCache::Impl {
+    mutable std::shared_mutex mutex;
+    std::filesystem::path file;
+    bool opened = false;
+    MappedFile mapped;
+    const DiskRecord* records = nullptr;
+    size_t recordCount = 0;
+    const char* strings = nullptr;
+    size_t stringsBytes = 0;
+    bool cleared = false;                           // mapped records no longer count
+    std::unordered_map<Key, Entry, KeyHash> updates;
+
+    mutable std::atomic<uint64_t> hits{ 0 };
+    mutable std::atomic<uint64_t> misses{ 0 };
+
+    void unmap() {
+        mapped.close();
+        records = nullptr;
+        recordCount = 0;
+        strings = nullptr;
+        stringsBytes = 0;
+    }
+
+    // Leaves the cache empty, rather than failing, when the index is missing or unusable.
+    bool mapIndex(std::string* error) {
+        unmap();
+        std::error_code ec;
+        if (!std::filesystem::exists(file, ec)) return true;
+        std::string why;
+        if (!mapped.open(file, &why)) {
+            if (error) *error = why;
+            return false;
+        }
+        const auto bytes = mapped.bytes();
+        DiskHeader h{};
+        if (bytes.size() < sizeof h) return true;
+        std::memcpy(&h, bytes.data(), sizeof h);
+        const bool valid = std::memcmp(h.magic, MAGIC, sizeof MAGIC) == 0 && h.version == VERSION
+            && h.record_size == sizeof(DiskRecord) && h.byte_order == BYTE_ORDER_MARK
+            && h.count <= (bytes.size() - sizeof h) / sizeof(DiskRecord)
+            && h.strings_bytes == bytes.size() - sizeof h - h.count * sizeof(DiskRecord);
+        if (!valid) {
+            mapped.close();
+            return true;
+        }
+        records = reinterpret_cast<const DiskRecord*>(bytes.data() + sizeof h);
+        recordCount = static_cast<size_t>(h.count);
+        strings = reinterpret_cast<const char*>(bytes.data() + sizeof h + recordCount * sizeof(DiskRecord));
+        stringsBytes = static_cast<size_t>(h.strings_bytes);
+        return true;
+    }
+
+    Entry fromDisk(const DiskRecord& r) const {
+        Entry e;
+        e.id = { r.device, r.inode, r.size, r.mtime_ns, r.change_ns };
+        e.recorded_ns = r.recorded_ns;
+        e.hasScan = (r.flags & HAS_SCAN) != 0;
+        e.scanKey = r.scan_key;
+        e.scan.entropy = r.entropy;
+        e.scan.bytes_scanned = r.bytes_scanned;
+        e.scan.sampled = (r.flags & SAMPLED) != 0;
+        e.scan.content_hash = r.content_hash;
+        if (uint64_t(r.signature_offset) + r.signature_length <= stringsBytes) {
+            e.scan.signature.assign(strings + r.signature_offset, r.signature_length);
+        }
+        e.hasProbe = (r.flags & HAS_PROBE) != 0;
+        e.probe.recognized = (r.flags & RECOGNIZED) != 0;
+        e.probe.arch = r.arch;
+        e.probe.os = r.os;
+        e.probe.isLibrary = (r.flags & IS_LIBRARY) != 0;
+        e.probe.positionIndependent = (r.flags & POSITION_INDEPENDENT) != 0;
+        e.probe.stripped = (r.flags & STRIPPED) != 0;
+        e.probe.imageBase = r.image_base;
+        e.probe.entryRVA = r.entry_rva;
+        return e;
+    }
+
+    static DiskRecord toDisk(const Entry& e, std::string& pool) {
+        DiskRecord r{};
+        r.device = e.id.device;
+        r.inode = e.id.inode;
+        r.size = e.id.size;
+        r.mtime_ns = e.id.mtime_ns;
+        r.change_ns = e.id.change_ns;
+        r.recorded_ns = e.recorded_ns;
+        if (e.hasScan) {
+            r.flags |= HAS_SCAN | (e.scan.sampled ? SAMPLED : 0);
+            r.scan_key = e.scanKey;
+            r.entropy = e.scan.entropy;
+            r.bytes_scanned = e.scan.bytes_scanned;
+            r.content_hash = e.scan.content_hash;
+            r.signature_offset = static_cast<uint32_t>(pool.size());
+            r.signature_length = static_cast<uint32_t>(e.scan.signature.size());
+            pool += e.scan.signature;
+        }
+        if (e.hasProbe) {
+            r.flags |= HAS_PROBE;
+            if (e.probe.recognized) r.flags |= RECOGNIZED;
+            if (e.probe.isLibrary) r.flags |= IS_LIBRARY;
+            if (e.probe.positionIndependent) r.flags |= POSITION_INDEPENDENT;
+            if (e.probe.stripped) r.flags |= STRIPPED;
+            r.arch = e.probe.arch;
+            r.os = e.probe.os;
+            r.image_base = e.probe.imageBase;
+            r.entry_rva = e.probe.entryRVA;
+        }
+        return r;
+    }
+
+    // Caller holds the mutex (either mode).
+    std::optional<Entry> find(const Key& k) const {
+        if (auto it = updates.find(k); it != updates.end()) return it->second;
+        if (cleared || !records) return std::nullopt;
+        const DiskRecord* end = records + recordCount;
+        const DiskRecord* r = std::lower_bound(records, end, k, [](const DiskRecord& d, const Key& key) {
+            return Key{ d.device, d.inode } < key;
+            });
+        if (r == end || r->device != k.device || r->inode != k.inode) return std::nullopt;
+        return fromDisk(*r);
+    }
+
+    // The entry to update for 'id': the existing one if it still describes this file, else a fresh one.
+    Entry& slot(const FileIdentity& id) {
+        const Key k{ id.device, id.inode };
+        std::optional<Entry> existing = find(k);
+        Entry& e = updates[k];
+        if (existing && trusted(*existing, id)) e = *existing;
+        else {
+            e = Entry();
+            e.id = id;
+        }
+        e.recorded_ns = nowNs();
+        return e;
+    }
+};
+
+ScanCache::ScanCache() : pImpl(std::make_unique<Impl>()) {}
+
+ScanCache::~ScanCache() = default;
+
+ScanCache& ScanCache::instance() {
+    static ScanCache cache;
+    return cache;
+}
+
+bool ScanCache::Identify(const std::filesystem::path& path, FileIdentity& out) {
+#ifdef _WIN32
+    HANDLE h = CreateFileW(path.wstring().c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    BY_HANDLE_FILE_INFORMATION info{};
+    const bool ok = GetFileInformationByHandle(h, &info) != 0;
+    CloseHandle(h);
+    if (!ok) return false;
+    auto ns = [](FILETIME t) {
+        return static_cast<int64_t>(((uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime) - 116444736000000000ull) * 100;
+    };
+    out.device = info.dwVolumeSerialNumber;
+    out.inode = (uint64_t(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    out.size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    out.mtime_ns = ns(info.ftLastWriteTime);
+    out.change_ns = 0;
+#else
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return false;
+#ifdef __APPLE__
+    const timespec& m = st.st_mtimespec;
+    const timespec& c = st.st_ctimespec;
+#else
+    const timespec& m = st.st_mtim;
+    const timespec& c = st.st_ctim;
+#endif
+    out.device = static_cast<uint64_t>(st.st_dev);
+    out.inode = static_cast<uint64_t>(st.st_ino);
+    out.size = static_cast<uint64_t>(st.st_size);
+    out.mtime_ns = int64_t(m.tv_sec) * 1'000'000'000 + m.tv_nsec;
+    out.change_ns = int64_t(c.tv_sec) * 1'000'000'000 + c.tv_nsec;
+#endif
+    return true;
+}
+
+bool ScanCache::open(const std::filesystem::path& file, std::string* error) {
+    {
+        std::shared_lock<std::shared_mutex> lock(pImpl->mutex);
+        if (pImpl->opened && pImpl->file == file) return true;
+    }
+    if (isOpen() && !save(error)) return false;
+    std::unique_lock<std::shared_mutex> lock(pImpl->mutex);
+    pImpl->file = file;
+    pImpl->updates.clear();
+    pImpl->cleared = false;
+    pImpl->opened = pImpl->mapIndex(error);
+    return pImpl->opened;
+}
+
+bool ScanCache::isOpen() const {
+    std::shared_lock<std::shared_mutex> lock(pImpl->mutex);
+    return pImpl->opened;
+}
+
+bool ScanCache::save(std::string* error) {
+    std::unique_lock<std::shared_mutex> lock(pImpl->mutex);
+    Impl& d = *pImpl;
+    if (!d.opened) {
+        if (error) *error = "scan cache is not open";
+        return false;
+    }
+    if (d.updates.empty() && !d.cleared) return true;
+
+    // Merge: mapped records not superseded, plus everything stored since, sorted by key.
+    std::vector<std::pair<Key, Entry>> merged;
+    merged.reserve((d.cleared ? 0 : d.recordCount) + d.updates.size());
+    if (!d.cleared) {
+        for (size_t i = 0; i < d.recordCount; ++i) {
+            const Key k{ d.records[i].device, d.records[i].inode };
+            if (!d.updates.count(k)) merged.emplace_back(k, d.fromDisk(d.records[i]));
+        }
+    }
+    for (const auto& [k, e] : d.updates) merged.emplace_back(k, e);
+    std::sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<DiskRecord> out;
+    out.reserve(merged.size());
+    std::string pool;
+    for (const auto& [k, e] : merged) out.push_back(Impl::toDisk(e, pool));
+    DiskHeader h{};
+    std::memcpy(h.magic, MAGIC, sizeof MAGIC);
+    h.version = VERSION;
+    h.record_size = sizeof(DiskRecord);
+    h.byte_order = BYTE_ORDER_MARK;
+    h.count = out.size();
+    h.strings_bytes = pool.size();
+
+    std::error_code ec;
+    if (d.file.has_parent_path()) std::filesystem::create_directories(d.file.parent_path(), ec);
+    std::filesystem::path tmp = d.file;
+    tmp += ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<const char*>(&h), sizeof h);
+        f.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size() * sizeof(DiskRecord)));
+        f.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+        if (!f.flush()) {
+            if (error) *error = "cannot write " + tmp.string();
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+    // Windows cannot replace a file that is still mapped.
+    d.unmap();
+    std::filesystem::rename(tmp, d.file, ec);
+    if (ec) {
+        if (error) *error = "cannot replace " + d.file.string() + ": " + ec.message();
+        std::filesystem::remove(tmp, ec);
+        d.mapIndex(nullptr);
+        return false;
+    }
+    d.updates.clear();
+    d.cleared = false;
+    return d.mapIndex(error);
+}
+
+std::optional<CachedScan> ScanCache::findScan(const FileIdentity& id, uint64_t scanKey) const {
+    std::shared_lock<std::shared_mutex> lock(pImpl->mutex);
+    if (pImpl->opened) {
+        std::optional<Entry> e = pImpl->find({ id.device, id.inode });
+        if (e && e->hasScan && e->scanKey == scanKey && trusted(*e, id)) {
+            pImpl->hits.fetch_add(1, std::memory_order_relaxed);
+            return e->scan;
+        }
+    }
+    pImpl->misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void ScanCache::storeScan(const FileIdentity& id, uint64_t scanKey, const CachedScan& scan) {
+    std::unique_lock<std::shared_mutex> lock(pImpl->mutex);
+    if (!pImpl->opened) return;
+    Entry& e = pImpl->slot(id);
+    e.hasScan = true;
+    e.scanKey = scanKey;
+    e.scan = scan;
+}
+
+std::optional<CachedProbe> ScanCache::findProbe(const FileIdentity& id) const {
+    std::shared_lock<std::shared_mutex> lock(pImpl->mutex);
+    if (pImpl->opened) {
+        std::optional<Entry> e = pImpl->find({ id.device, id.inode });
+        if (e && e->hasProbe && trusted(*e, id)) {
+            pImpl->hits.fetch_add(1, std::memory_order_relaxed);
+            return e->probe;
+        }
+    }
+    pImpl->misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void ScanCache::storeProbe(const FileIdentity& id, const CachedProbe& probe) {
+    std::unique_lock<std::shared_mutex> lock(pImpl->mutex);
+    if (!pImpl->opened) return;
+    Entry& e = pImpl->slot(id);
+    e.hasProbe = true;
+    e.probe = probe;
+}
+
+void ScanCache::clear() {
+    std::unique_lock<std::shared_mutex> lock(pImpl->mutex);
+    pImpl->updates.clear();
+    pImpl->cleared = true;
+}
+
+std::string ScanCache::stats() const {
+    std::shared_lock<std::shared_mutex> lock(pImpl->mutex);
+    const Impl& d = *pImpl;
+    if (!d.opened) return "Scan cache: not open";
+    std::ostringstream out;
+    out << "Scan cache: " << d.file.string() << "\n";
+    out << "  on disk: " << (d.cleared ? 0 : d.recordCount) << " entries, " << std::fixed << std::setprecision(1)
+        << (d.cleared ? 0.0 : d.mapped.size() / 1024.0) << " KiB\n";
+    out << "  unsaved: " << d.updates.size() << " entries\n";
+    out << "  lookups: " << d.hits.load(std::memory_order_relaxed) << " hits, "
+        << d.misses.load(std::memory_order_relaxed) << " misses";
+    return out.str();
+}
@@ -0,0 +1,101 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// ScanCache.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+// What identifies one version of a file without reading it. 'change_ns' is the inode change time on
+// POSIX, which utimes() cannot forge, and 0 on Windows.
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    int64_t change_ns = 0;
+
+    bool operator==(const FileIdentity&) const = default;
+};
+
+// Result of an entropy/signature scan of one file.
+struct CachedScan {
+    double entropy = 0.0;
+    uint64_t bytes_scanned = 0;
+    bool sampled = false;
+    std::string signature;
+    uint64_t content_hash = 0;  // FileScanner::HashBytes of the bytes scanned
+};
+
+// Result of BinaryManip::Probe, in plain integers so the cache does not depend on BinaryManip.
+struct CachedProbe {
+    bool recognized = false;    // false: not an ELF or PE image
+    uint8_t arch = 0;
+    uint8_t os = 0;
+    bool isLibrary = false;
+    bool positionIndependent = false;
+    bool stripped = false;
+    uint64_t imageBase = 0;
+    uint64_t entryRVA = 0;
+};
+
+/**
+ * @class ScanCache
+ * @brief Persistent per-file results, so repeated scans of a mostly unchanged tree only read what changed.
+ *
+ * Entries are keyed by device and inode and are only returned while the file's size, modification
+ * time and change time still match. An entry written less than two seconds after the file was
+ * modified is not trusted, since a second write in the same timestamp tick would go unnoticed.
+ *
+ * The index file is a header, fixed-size records sorted by key and a string pool. It is mapped
+ * read-only and searched in place, so opening costs nothing per entry; results stored since then are
+ * held in memory until save() writes a merged index to a temporary file and renames it over the old
+ * one. Thread-safe.
+ */
+class ScanCache {
+public:
+    ScanCache();
+    ~ScanCache();
+    ScanCache(const ScanCache&) = delete;
+    ScanCache& operator=(const ScanCache&) = delete;
+
+    // The cache ScanFileEntropy and BinaryManip::Probe share.
+    static ScanCache& instance();
+
+    // Reads the identity of 'path' with one stat call. Returns false if it cannot be stat'ed.
+    static bool Identify(const std::filesystem::path& path, FileIdentity& out);
+
+    /**
+     * @brief Maps the index at 'file'. A missing file is an empty cache; a corrupt or foreign one is
+     * ignored and replaced on the next save. Re-opening the current file is a no-op, and opening
+     * another one saves the current one first.
+     */
+    bool open(const std::filesystem::path& file, std::string* error = nullptr);
+    bool isOpen() const;
+
+    // Writes the merged index if anything was stored since the last save.
+    bool save(std::string* error = nullptr);
+
+    // Scan results are also keyed by 'scanKey', which the caller derives from whatever changes a result
+    // besides the file (sampling, signature set).
+    std::optional<CachedScan> findScan(const FileIdentity& id, uint64_t scanKey) const;
+    void storeScan(const FileIdentity& id, uint64_t scanKey, const CachedScan& scan);
+
+    std::optional<CachedProbe> findProbe(const FileIdentity& id) const;
+    void storeProbe(const FileIdentity& id, const CachedProbe& probe);
+
+    // Drops every entry, on disk at the next save.
+    void clear();
+
+    // Entries, hit/miss counts and the index file.
+    std::string stats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pImpl;
+};
@@ -17,6 +17,7 @@ Copyright © 2025 Cadell Richard Anderson
 #include <unordered_set>
 #include <functional>
 #include <sstream>
+#include <mutex>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -34,6 +35,15 @@ static std::string bstr_to_str(BSTR bstr) {
 #include <sys/statvfs.h>
 #endif
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#endif
+
 // Helper for Linux CPU calculation
 #if defined(__linux__)
 struct CpuTimes {
@@ -48,13 +58,6 @@ struct CpuTimes {
     }
 };
 
-static CpuTimes getCpuTimes() {
-    std::ifstream proc_stat("/proc/stat");
-    proc_stat.ignore(5, ' '); // Skip "cpu"
-    CpuTimes t;
-    proc_stat >> t.user >> t.nice >> t.system >> t.idle >> t.iowait >> t.irq >> t.softirq >> t.steal;
-    return t;
-}
 #endif
 
 // ---------------------
@@ -73,7 +76,7 @@ static std::string readSysfsValue(const std::filesystem::path& p) {
 }
 
 // Maintain a set of seen sensor IDs to avoid duplicates when adding additive scans
-static void addSensorIfNew(std::vector<SensorData>& sensors, const SensorData& sd, std::unordered_set<std::string>& seen) {
+[[maybe_unused]] static void addSensorIfNew(std::vector<SensorData>& sensors, const SensorData& sd, std::unordered_set<std::string>& seen) {
     if (sd.id.empty()) {
         // fallback compose id from type+name
         std::string fallback = sd.type + "_" + sd.name;
@@ -89,78 +92,135 @@ static void addSensorIfNew(std::vector<SensorData>& sensors, const SensorData& s
     }
 }
 
-// Linux: exhaustive hwmon parser - safe, additive (calls should be made after your existing hwmon scan)
+// Linux: sensor registry. sysfs and /proc are walked once; every sensor keeps an open fd that is
+// re-read with pread() from offset 0, which makes sysfs and seq_file regenerate the value.
 #if defined(__linux__)
-static void parseHwmonDevice(const std::filesystem::path& hwmonPath, std::vector<SensorData>& sensors, std::unordered_set<std::string>& seen) {
+enum class StatusRule { None, Thermal, Fan, Battery };
+
+static SensorStatus evalStatusRule(StatusRule rule, double v) {
+    switch (rule) {
+    case StatusRule::Thermal: return v > 85.0 ? SensorStatus::CRITICAL : SensorStatus::OK;
+    case StatusRule::Fan:     return v < 100 ? SensorStatus::WARN : SensorStatus::OK;
+    case StatusRule::Battery: return v < 20.0 ? SensorStatus::WARN : SensorStatus::OK;
+    default:                  return SensorStatus::OK;
+    }
+}
+
+// One sysfs attribute. Everything in 'data' except value, status and timestamp is fixed at discovery.
+struct FileSensor {
+    SensorData data;
+    int fd = -1;
+    double scale = 1.0;     // the raw reading is divided by this
+    StatusRule rule = StatusRule::None;
+    uint32_t failures = 0;  // consecutive failed reads; the sensor is left out while they last
+};
+
+// Reads a small attribute with a single pread; false on error, empty read or a non-numeric value.
+static bool preadNumber(int fd, double& out) {
+    char buf[64];
+    ssize_t n;
+    do {
+        n = pread(fd, buf, sizeof(buf) - 1, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return false;
+    buf[n] = '\0';
+    char* end = nullptr;
+    out = std::strtod(buf, &end);
+    return end != buf;
+}
+
+// Reads a whole pseudo-file (e.g. /proc/net/dev, whose size grows with the interface count).
+static bool preadAll(int fd, std::string& out) {
+    out.clear();
+    char buf[4096];
+    off_t off = 0;
+    for (;;) {
+        ssize_t n = pread(fd, buf, sizeof(buf), off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) break;
+        out.append(buf, static_cast<size_t>(n));
+        off += n;
+    }
+    return !out.empty();
+}
+
+static int openReadOnly(const std::filesystem::path& p) {
+    return ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+// Opens 'p' and keeps it only if it currently yields a number.
+static bool openFileSensor(const std::filesystem::path& p, FileSensor& fs) {
+    fs.fd = openReadOnly(p);
+    if (fs.fd < 0) return false;
+    double probe = 0.0;
+    if (!preadNumber(fs.fd, probe)) {
+        ::close(fs.fd);
+        fs.fd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Exhaustive hwmon parser - second pass that picks up labels, PWM, energy, etc. not found by the
+// first scan; ids already in 'seen' are skipped.
+static void parseHwmonDevice(const std::filesystem::path& hwmonPath, std::vector<FileSensor>& out, std::unordered_set<std::string>& seen) {
     // read chip name
     std::string chipName = readSysfsValue(hwmonPath / "name");
     if (chipName.empty()) chipName = hwmonPath.filename().string();
 
     auto pushFromAttr = [&](const std::string& attrPath, const std::string& idPrefix,
         const std::string& type, const std::string& labelHint,
-        const std::string& units,
-        std::function<double(long long)> transform = nullptr,
-        std::function<SensorStatus(double)> statusEval = nullptr) {
+        const std::string& units, double scale, StatusRule rule) {
+            std::error_code ec;
             std::filesystem::path p = hwmonPath / attrPath;
-            if (!std::filesystem::exists(p)) return;
-            std::string raw = readSysfsValue(p);
-            if (raw.empty()) return;
-            try {
-                long long vi = std::stoll(raw);
-                double v = transform ? transform(vi) : static_cast<double>(vi);
-                SensorStatus st = SensorStatus::OK;
-                if (statusEval) st = statusEval(v);
-                std::string label = labelHint;
-                // attempt to load label file e.g. temp1_label or in0_label
-                std::string labelFile = attrPath;
-                // attrPath often like "temp1_input" -> label name "temp1_label"
-                size_t pos = labelFile.rfind('_');
-                if (pos != std::string::npos) labelFile = labelFile.substr(0, pos) + "_label";
-                std::string lab = readSysfsValue(hwmonPath / labelFile);
+            if (!std::filesystem::exists(p, ec)) return;
+            std::string label = labelHint;
+            // attrPath often like "temp1_input" -> label name "temp1_label"; "pwm1" has no label file
+            size_t pos = attrPath.rfind('_');
+            if (pos != std::string::npos) {
+                std::string lab = readSysfsValue(hwmonPath / (attrPath.substr(0, pos) + "_label"));
                 if (!lab.empty()) label = lab;
-                // Compose a reasonably stable id
-                std::string id = idPrefix + "_" + chipName + "_" + label;
-                // normalize id: replace spaces / slashes
-                std::replace(id.begin(), id.end(), ' ', '_');
-                std::replace(id.begin(), id.end(), '/', '_');
-                // Map attrPath -> "name" field, label -> label
-                SensorData sd = { id, type, attrPath, label, v, units, st, hwmonPath.string(), std::chrono::system_clock::now() };
-                addSensorIfNew(sensors, sd, seen);
-            }
-            catch (...) {
-                return;
             }
+            // Compose a reasonably stable id
+            std::string id = idPrefix + "_" + chipName + "_" + label;
+            // normalize id: replace spaces / slashes
+            std::replace(id.begin(), id.end(), ' ', '_');
+            std::replace(id.begin(), id.end(), '/', '_');
+            if (seen.count(id)) return;
+
+            FileSensor fs;
+            if (!openFileSensor(p, fs)) return;
+            fs.data = { id, type, attrPath, label, 0.0, units, SensorStatus::OK, hwmonPath.string(), {} };
+            fs.scale = scale;
+            fs.rule = rule;
+            seen.insert(id);
+            out.push_back(std::move(fs));
         };
 
     // temperatures (millideg to degC)
     for (int i = 1; i <= 12; ++i) {
-        pushFromAttr("temp" + std::to_string(i) + "_input", "thermal", "thermal", "Temp" + std::to_string(i), "C",
-            [](long long vv) { return vv / 1000.0; },
-            [](double v) { return v > 85.0 ? SensorStatus::CRITICAL : SensorStatus::OK; });
+        pushFromAttr("temp" + std::to_string(i) + "_input", "thermal", "thermal", "Temp" + std::to_string(i), "C", 1000.0, StatusRule::Thermal);
     }
     // voltages (in0_input ... millivolt -> volts)
     for (int i = 0; i < 12; ++i) {
-        pushFromAttr("in" + std::to_string(i) + "_input", "voltage", "voltage", "V" + std::to_string(i), "V",
-            [](long long vv) { return vv / 1000.0; }, nullptr);
+        pushFromAttr("in" + std::to_string(i) + "_input", "voltage", "voltage", "V" + std::to_string(i), "V", 1000.0, StatusRule::None);
     }
     // fans
     for (int i = 1; i <= 8; ++i) {
-        pushFromAttr("fan" + std::to_string(i) + "_input", "fan", "fan", "Fan" + std::to_string(i), "RPM",
-            nullptr, [](double v) { return v < 100 ? SensorStatus::WARN : SensorStatus::OK; });
+        pushFromAttr("fan" + std::to_string(i) + "_input", "fan", "fan", "Fan" + std::to_string(i), "RPM", 1.0, StatusRule::Fan);
     }
     // pwm controls
     for (int i = 1; i <= 8; ++i) {
-        pushFromAttr("pwm" + std::to_string(i), "pwm", "pwm", "PWM" + std::to_string(i), "0-255",
-            nullptr, nullptr);
+        pushFromAttr("pwm" + std::to_string(i), "pwm", "pwm", "PWM" + std::to_string(i), "0-255", 1.0, StatusRule::None);
     }
     // power / energy / current
     for (int i = 1; i <= 4; ++i) {
-        pushFromAttr("power" + std::to_string(i) + "_average", "power", "power", "Power" + std::to_string(i), "W",
-            [](long long vv) { return vv / 1000000.0; }, nullptr);
-        pushFromAttr("energy" + std::to_string(i) + "_input", "energy", "energy", "Energy" + std::to_string(i), "J",
-            [](long long vv) { return vv / 1000000.0; }, nullptr);
-        pushFromAttr("curr" + std::to_string(i) + "_input", "current", "current", "Current" + std::to_string(i), "A",
-            [](long long vv) { return vv / 1000.0; }, nullptr);
+        pushFromAttr("power" + std::to_string(i) + "_average", "power", "power", "Power" + std::to_string(i), "W", 1000000.0, StatusRule::None);
+        pushFromAttr("energy" + std::to_string(i) + "_input", "energy", "energy", "Energy" + std::to_string(i), "J", 1000000.0, StatusRule::None);
+        pushFromAttr("curr" + std::to_string(i) + "_input", "current", "current", "Current" + std::to_string(i), "A", 1000.0, StatusRule::None);
     }
 }
 
@@ -174,6 +234,319 @@ static std::map<std::string, std::string> discoverHwmonByName() {
     }
     return m;
 }
+
+// Discovered sensor set plus the open fds behind it. refresh() re-reads values only; the sysfs walk
+// is repeated when the hwmon/power_supply listing changes (polled, since sysfs has no usable inotify)
+// or when an attribute has failed to read several times in a row. A single failed read only leaves
+// that sensor out of the result, since some drivers return EAGAIN/ENODATA now and then.
+struct SensorRegistry {
+    static constexpr auto HOTPLUG_POLL = std::chrono::seconds(5);
+    static constexpr auto MIN_CPU_WINDOW = std::chrono::milliseconds(100);
+    static constexpr uint32_t FIRST_FAILURE_LIMIT = 3;
+    static constexpr uint32_t MAX_FAILURE_LIMIT = 1024;
+
+    std::mutex mutex;
+    bool discovered = false;
+    std::vector<FileSensor> primary;    // first hwmon scan and battery, in walk order
+    std::vector<FileSensor> extra;      // second-pass hwmon attributes
+    int statFd = -1, meminfoFd = -1, netDevFd = -1;
+    std::string listing;
+    std::chrono::steady_clock::time_point lastHotplugCheck;
+    // Consecutive failures that trigger a rediscovery. Doubles each time one does, so an attribute
+    // that never reads does not cause a sysfs walk every few polls; a hotplug resets it.
+    uint32_t failureLimit = FIRST_FAILURE_LIMIT;
+
+    CpuTimes lastCpu;
+    std::chrono::steady_clock::time_point lastCpuAt;
+    bool haveCpu = false;
+    double cpuUsage = 0.0;
+
+    std::string netBuf;
+
+    ~SensorRegistry() { closeAll(); }
+
+    void closeAll() {
+        for (auto* list : { &primary, &extra }) {
+            for (auto& fs : *list) if (fs.fd >= 0) ::close(fs.fd);
+            list->clear();
+        }
+        for (int* fd : { &statFd, &meminfoFd, &netDevFd }) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+        }
+        discovered = false;
+    }
+
+    // Directory names under the hotplug-capable classes; a change means a device came or went.
+    static std::string currentListing() {
+        std::vector<std::string> names;
+        for (const char* dir : { "/sys/class/hwmon", "/sys/class/power_supply" }) {
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+                names.push_back(it->path().string());
+            }
+        }
+        std::sort(names.begin(), names.end());
+        std::string out;
+        for (const auto& n : names) out += n + "\n";
+        return out;
+    }
+
+    void discover() {
+        closeAll();
+        listing = currentListing();
+        lastHotplugCheck = std::chrono::steady_clock::now();
+        std::error_code ec;
+
+        // --- 1. Comprehensive HWMON Scan for Temp, Fan, Voltage, Power, Current, Energy ---
+        for (std::filesystem::directory_iterator hw("/sys/class/hwmon", ec), end; !ec && hw != end; hw.increment(ec)) {
+            if (!hw->is_directory(ec)) continue;
+            std::string deviceName = readSysfsValue(hw->path() / "name");
+
+            std::error_code fec;
+            for (std::filesystem::directory_iterator it(hw->path(), fec); !fec && it != end; it.increment(fec)) {
+                std::string filename = it->path().filename().string();
+                std::string type;
+                if (filename.rfind("temp", 0) == 0) type = "temp";
+                else if (filename.rfind("fan", 0) == 0) type = "fan";
+                else if (filename.rfind("in", 0) == 0) type = "in";
+                else if (filename.rfind("power", 0) == 0) type = "power";
+                else if (filename.rfind("curr", 0) == 0) type = "curr";
+                else if (filename.rfind("energy", 0) == 0) type = "energy";
+                else continue;
+
+                size_t underscore_pos = filename.find('_');
+                if (underscore_pos == std::string::npos) continue;
+                int number = 0;
+                std::string item;
+                try {
+                    number = std::stoi(filename.substr(type.length(), underscore_pos - type.length()));
+                    item = filename.substr(underscore_pos + 1);
+                }
+                catch (...) {
+                    continue;
+                }
+                if (item != "input" && item != "average") continue;
+
+                FileSensor fs;
+                if (!openFileSensor(it->path(), fs)) continue;
+
+                std::string label = deviceName + " " + type + std::to_string(number);
+                std::string tempLabel = readSysfsValue(hw->path() / (type + std::to_string(number) + "_label"));
+                if (!tempLabel.empty()) label = tempLabel;
+
+                const std::string source = it->path().string();
+                if (type == "temp")        { fs.data = { "thermal_" + label, "thermal", filename, label, 0.0, "C", SensorStatus::OK, source, {} }; fs.scale = 1000.0; fs.rule = StatusRule::Thermal; }
+                else if (type == "fan")    { fs.data = { "fan_" + label, "fan", filename, label, 0.0, "RPM", SensorStatus::OK, source, {} }; fs.rule = StatusRule::Fan; }
+                else if (type == "in")     { fs.data = { "voltage_" + label, "voltage", filename, label, 0.0, "V", SensorStatus::OK, source, {} }; fs.scale = 1000.0; }
+                else if (type == "power")  { fs.data = { "power_" + label, "power", filename, label, 0.0, "W", SensorStatus::OK, source, {} }; fs.scale = 1000000.0; }
+                else if (type == "curr")   { fs.data = { "current_" + label, "current", filename, label, 0.0, "A", SensorStatus::OK, source, {} }; fs.scale = 1000.0; }
+                else                       { fs.data = { "energy_" + label, "energy", filename, label, 0.0, "J", SensorStatus::OK, source, {} }; fs.scale = 1000000.0; }
+                primary.push_back(std::move(fs));
+            }
+        }
+
+        // --- 2. Battery ---
+        for (std::filesystem::directory_iterator ps("/sys/class/power_supply", ec), end; !ec && ps != end; ps.increment(ec)) {
+            if (!ps->is_directory(ec) || ps->path().filename().string().find("BAT") == std::string::npos) continue;
+            FileSensor fs;
+            if (!openFileSensor(ps->path() / "capacity", fs)) continue;
+            fs.data = { "battery_charge", "power", ps->path().filename().string(), "Battery", 0.0, "%", SensorStatus::OK, ps->path().string(), {} };
+            fs.rule = StatusRule::Battery;
+            primary.push_back(std::move(fs));
+        }
+
+        statFd = ::open("/proc/stat", O_RDONLY | O_CLOEXEC);
+        meminfoFd = ::open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+        netDevFd = ::open("/proc/net/dev", O_RDONLY | O_CLOEXEC);
+
+        // Second pass skips anything the first scan, the fixed sensors or the interfaces already claim.
+        std::unordered_set<std::string> seen = { "cpu_load", "mem_usage", "disk_free_root" };
+        for (const auto& fs : primary) seen.insert(fs.data.id);
+        std::vector<SensorData> net;
+        readNetDev(net, std::chrono::system_clock::now());
+        for (const auto& sd : net) seen.insert(sd.id);
+        for (std::filesystem::directory_iterator hw("/sys/class/hwmon", ec), end; !ec && hw != end; hw.increment(ec)) {
+            if (!hw->is_directory(ec)) continue;
+            parseHwmonDevice(hw->path(), extra, seen);
+        }
+        discovered = true;
+    }
+
+    // Re-walks sysfs when a device appeared or vanished since the last poll.
+    void pollHotplug() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastHotplugCheck < HOTPLUG_POLL) return;
+        lastHotplugCheck = now;
+        if (currentListing() != listing) {
+            discovered = false;
+            failureLimit = FIRST_FAILURE_LIMIT;
+        }
+    }
+
+    // Appends one reading per file sensor that reads; returns false once one of them has failed
+    // 'failureLimit' times in a row.
+    bool readFiles(std::vector<FileSensor>& list, std::vector<SensorData>& out,
+        std::chrono::system_clock::time_point stamp) const {
+        bool ok = true;
+        for (auto& fs : list) {
+            double raw = 0.0;
+            if (!preadNumber(fs.fd, raw)) {
+                if (++fs.failures >= failureLimit) ok = false;
+                continue;
+            }
+            fs.failures = 0;
+            SensorData sd = fs.data;
+            sd.value = raw / fs.scale;
+            sd.status = evalStatusRule(fs.rule, sd.value);
+            sd.timestamp = stamp;
+            out.push_back(std::move(sd));
+        }
+        return ok;
+    }
+
+    bool readCpuTimes(CpuTimes& t) const {
+        char buf[256];
+        ssize_t n;
+        do {
+            n = pread(statFd, buf, sizeof(buf) - 1, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 4) return false;
+        buf[n] = '\0';
+        long long* fields[] = { &t.user, &t.nice, &t.system, &t.idle, &t.iowait, &t.irq, &t.softirq, &t.steal };
+        char* p = buf + 3; // skip "cpu"
+        for (long long* f : fields) {
+            char* end = nullptr;
+            *f = std::strtoll(p, &end, 10);
+            if (end == p) return false;
+            p = end;
+        }
+        return true;
+    }
+
+    // --- 3. CPU Load ---
+    // Measured against the previous refresh instead of sleeping between two reads. Only the first call
+    // still waits MIN_CPU_WINDOW for a baseline; a call sooner than that after the last one reuses its value.
+    void readCpu(std::vector<SensorData>& out, std::chrono::system_clock::time_point stamp) {
+        if (statFd < 0) return;
+        CpuTimes now;
+        if (!haveCpu) {
+            if (!readCpuTimes(lastCpu)) return;
+            lastCpuAt = std::chrono::steady_clock::now();
+            haveCpu = true;
+            std::this_thread::sleep_for(MIN_CPU_WINDOW);
+        }
+        if (std::chrono::steady_clock::now() - lastCpuAt >= MIN_CPU_WINDOW && readCpuTimes(now)) {
+            double totalDelta = static_cast<double>(now.getTotal() - lastCpu.getTotal());
+            double idleDelta = static_cast<double>(now.getIdle() - lastCpu.getIdle());
+            cpuUsage = (totalDelta > 0) ? (1.0 - idleDelta / totalDelta) * 100.0 : 0.0;
+            lastCpu = now;
+            lastCpuAt = std::chrono::steady_clock::now();
+        }
+        out.push_back({ "cpu_load", "cpu", "Usage", "CPU Load", cpuUsage, "%", cpuUsage > 90.0 ? SensorStatus::WARN : SensorStatus::OK, "/proc/stat", stamp });
+    }
+
+    // --- 4. Memory Usage ---
+    void readMemory(std::vector<SensorData>& out, std::chrono::system_clock::time_point stamp) const {
+        char buf[512];
+        if (meminfoFd < 0) return;
+        ssize_t n = pread(meminfoFd, buf, sizeof(buf) - 1, 0);
+        if (n <= 0) return;
+        buf[n] = '\0';
+        auto field = [&](const char* key) -> long long {
+            const char* p = std::strstr(buf, key);
+            return p ? std::strtoll(p + std::strlen(key), nullptr, 10) : 0;
+        };
+        long long memTotal = field("MemTotal:");
+        long long memAvailable = field("MemAvailable:");
+        if (memTotal > 0) {
+            double memUsedPercent = 100.0 - ((double)memAvailable / memTotal * 100.0);
+            out.push_back({ "mem_usage", "memory", "UsedMemory", "Memory Usage", memUsedPercent, "%", memUsedPercent > 85.0 ? SensorStatus::WARN : SensorStatus::OK, "/proc/meminfo", stamp });
+        }
+    }
+
+    // --- 5. Disk Space ---
+    static void readDisk(std::vector<SensorData>& out, std::chrono::system_clock::time_point stamp) {
+        struct statvfs stat;
+        if (statvfs("/", &stat) == 0) {
+            unsigned long long totalSpace = stat.f_blocks * stat.f_frsize;
+            unsigned long long freeSpace = stat.f_bavail * stat.f_frsize;
+            if (totalSpace > 0) {
+                double freePercent = (double)freeSpace / totalSpace * 100.0;
+                out.push_back({ "disk_free_root", "disk", "FreeSpace", "Disk / Free", freePercent, "%", freePercent < 15.0 ? SensorStatus::WARN : SensorStatus::OK, "statvfs", stamp });
+            }
+        }
+    }
+
+    // --- 6. Network I/O ---
+    // Interfaces come from the file itself, so they appear and disappear without a rescan.
+    void readNetDev(std::vector<SensorData>& out, std::chrono::system_clock::time_point stamp) {
+        if (netDevFd < 0 || !preadAll(netDevFd, netBuf)) return;
+        size_t pos = 0;
+        for (int skip = 0; skip < 2 && pos != std::string::npos; ++skip) { // two header lines
+            pos = netBuf.find('\n', pos);
+            if (pos != std::string::npos) ++pos;
+        }
+        while (pos != std::string::npos && pos < netBuf.size()) {
+            size_t eol = netBuf.find('\n', pos);
+            std::string_view line(netBuf.data() + pos, (eol == std::string::npos ? netBuf.size() : eol) - pos);
+            pos = (eol == std::string::npos) ? eol : eol + 1;
+
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            std::string_view name = line.substr(0, colon);
+            while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+            std::string iface_name(name);
+
+            // recv: bytes packets errs drop fifo frame compressed multicast, then trans: bytes ...
+            long long values[9] = {};
+            std::string fields(line.substr(colon + 1));
+            const char* p = fields.c_str();
+            int got = 0;
+            for (; got < 9; ++got) {
+                char* end = nullptr;
+                values[got] = std::strtoll(p, &end, 10);
+                if (end == p) break;
+                p = end;
+            }
+            if (got < 9) continue;
+            out.push_back({ "net_recv_" + iface_name, "net", "ReceivedBytes", iface_name + " Received", (double)values[0], "Bytes", SensorStatus::OK, "/proc/net/dev", stamp });
+            out.push_back({ "net_sent_" + iface_name, "net", "SentBytes", iface_name + " Sent", (double)values[8], "Bytes", SensorStatus::OK, "/proc/net/dev", stamp });
+        }
+    }
+
+    std::vector<SensorData> refresh() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (discovered) pollHotplug();
+        if (!discovered) discover();
+
+        std::vector<SensorData> sensors;
+        sensors.reserve(primary.size() + extra.size() + 16);
+        auto stamp = std::chrono::system_clock::now();
+        bool ok = readFiles(primary, sensors, stamp);
+        readCpu(sensors, stamp);
+        readMemory(sensors, stamp);
+        readDisk(sensors, stamp);
+        readNetDev(sensors, stamp);
+        ok = readFiles(extra, sensors, stamp) && ok;
+        if (!ok) {
+            // Probably a device went away without the listing changing; walk sysfs again next time.
+            discovered = false;
+            failureLimit = std::min(failureLimit * 2, MAX_FAILURE_LIMIT);
+        }
+        return sensors;
+    }
+
+    void invalidate() {
+        std::lock_guard<std::mutex> lock(mutex);
+        discovered = false;
+    }
+};
+
+static SensorRegistry& sensorRegistry() {
+    static SensorRegistry registry;
+    return registry;
+}
 #endif // __linux__
 
 // ---------------------
@@ -546,171 +919,17 @@ std::vector<SensorData> SensorManager::listSensors() {
     // =================================================
     // Linux /sys/class and /proc Implementation
     // =================================================
-    // --- 1. Comprehensive HWMON Scan for Temp, Fan, Voltage, Power, Current, Energy ---
-    for (const auto& hwmon_entry : std::filesystem::directory_iterator("/sys/class/hwmon")) {
-        if (!hwmon_entry.is_directory()) continue;
-
-        std::string deviceName;
-        std::ifstream nameFile(hwmon_entry.path() / "name");
-        if (nameFile.is_open()) {
-            std::getline(nameFile, deviceName);
-        }
-
-        for (const auto& sensor_entry : std::filesystem::directory_iterator(hwmon_entry.path())) {
-            std::string filename = sensor_entry.path().filename().string();
-            std::string type;
-            std::string item;
-            int number = 0;
-
-            if (filename.rfind("temp", 0) == 0) type = "temp";
-            else if (filename.rfind("fan", 0) == 0) type = "fan";
-            else if (filename.rfind("in", 0) == 0) type = "in";
-            else if (filename.rfind("power", 0) == 0) type = "power";
-            else if (filename.rfind("curr", 0) == 0) type = "curr";
-            else if (filename.rfind("energy", 0) == 0) type = "energy";
-            else continue;
-
-            size_t underscore_pos = filename.find('_');
-            if (underscore_pos == std::string::npos) continue;
-
-            try {
-                number = std::stoi(filename.substr(type.length(), underscore_pos - type.length()));
-                item = filename.substr(underscore_pos + 1);
-            }
-            catch (...) {
-                continue;
-            }
-
-            if (item == "input" || item == "average") {
-                std::ifstream valueFile(sensor_entry.path());
-                if (!valueFile.is_open()) continue;
-                double value;
-                valueFile >> value;
-
-                std::string label = deviceName + " " + type + std::to_string(number);
-                std::ifstream labelFile(hwmon_entry.path() / (type + std::to_string(number) + "_label"));
-                if (labelFile.is_open()) {
-                    std::string tempLabel;
-                    std::getline(labelFile, tempLabel);
-                    if (!tempLabel.empty()) label = tempLabel;
-                }
+    // Discovery runs once (and again on hotplug); each call only re-reads the cached fds.
+    sensors = sensorRegistry().refresh();
 
-                if (type == "temp") {
-                    sensors.push_back({ "thermal_" + label, "thermal", filename, label, value / 1000.0, "C", (value / 1000.0) > 85.0 ? SensorStatus::CRITICAL : SensorStatus::OK, sensor_entry.path().string(), std::chrono::system_clock::now() });
-                }
-                else if (type == "fan") {
-                    sensors.push_back({ "fan_" + label, "fan", filename, label, value, "RPM", value < 100 ? SensorStatus::WARN : SensorStatus::OK, sensor_entry.path().string(), std::chrono::system_clock::now() });
-                }
-                else if (type == "in") {
-                    sensors.push_back({ "voltage_" + label, "voltage", filename, label, value / 1000.0, "V", SensorStatus::OK, sensor_entry.path().string(), std::chrono::system_clock::now() });
-                }
-                else if (type == "power") {
-                    sensors.push_back({ "power_" + label, "power", filename, label, value / 1000000.0, "W", SensorStatus::OK, sensor_entry.path().string(), std::chrono::system_clock::now() });
-                }
-                else if (type == "curr") {
-                    sensors.push_back({ "current_" + label, "current", filename, label, value / 1000.0, "A", SensorStatus::OK, sensor_entry.path().string(), std::chrono::system_clock::now() });
-                }
-                else if (type == "energy") {
-                    sensors.push_back({ "energy_" + label, "energy", filename, label, value / 1000000.0, "J", SensorStatus::OK, sensor_entry.path().string(), std::chrono::system_clock::now() });
-                }
-            }
-        }
-    }
-
-    // --- 2. Battery ---
-    for (const auto& entry : std::filesystem::directory_iterator("/sys/class/power_supply")) {
-        if (entry.is_directory() && entry.path().filename().string().find("BAT") != std::string::npos) {
-            std::ifstream capFile(entry.path() / "capacity");
-            if (capFile.is_open()) {
-                double capacity;
-                capFile >> capacity;
-                sensors.push_back({ "battery_charge", "power", entry.path().filename().string(), "Battery", capacity, "%", capacity < 20.0 ? SensorStatus::WARN : SensorStatus::OK, entry.path().string(), std::chrono::system_clock::now() });
-            }
-        }
-    }
-
-    // --- 3. CPU Load ---
-    CpuTimes t1 = getCpuTimes();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    CpuTimes t2 = getCpuTimes();
-    double totalDelta = t2.getTotal() - t1.getTotal();
-    double idleDelta = t2.getIdle() - t1.getIdle();
-    double cpuUsage = (totalDelta > 0) ? (1.0 - idleDelta / totalDelta) * 100.0 : 0.0;
-    sensors.push_back({ "cpu_load", "cpu", "Usage", "CPU Load", cpuUsage, "%", cpuUsage > 90.0 ? SensorStatus::WARN : SensorStatus::OK, "/proc/stat", std::chrono::system_clock::now() });
-
-    // --- 4. Memory Usage ---
-    std::ifstream meminfo("/proc/meminfo");
-    std::string line;
-    long long memTotal = 0, memAvailable = 0;
-    while (std::getline(meminfo, line)) {
-        if (line.rfind("MemTotal:", 0) == 0) {
-            // parse number after label
-            std::istringstream iss(line.substr(9));
-            iss >> memTotal;
-        }
-        if (line.rfind("MemAvailable:", 0) == 0) {
-            std::istringstream iss(line.substr(13));
-            iss >> memAvailable;
-        }
-    }
-    if (memTotal > 0) {
-        double memUsedPercent = 100.0 - ((double)memAvailable / memTotal * 100.0);
-        sensors.push_back({ "mem_usage", "memory", "UsedMemory", "Memory Usage", memUsedPercent, "%", memUsedPercent > 85.0 ? SensorStatus::WARN : SensorStatus::OK, "/proc/meminfo", std::chrono::system_clock::now() });
-    }
-
-    // --- 5. Disk Space ---
-    struct statvfs stat;
-    if (statvfs("/", &stat) == 0) {
-        unsigned long long totalSpace = stat.f_blocks * stat.f_frsize;
-        unsigned long long freeSpace = stat.f_bavail * stat.f_frsize;
-        if (totalSpace > 0) {
-            double freePercent = (double)freeSpace / totalSpace * 100.0;
-            sensors.push_back({ "disk_free_root", "disk", "FreeSpace", "Disk / Free", freePercent, "%", freePercent < 15.0 ? SensorStatus::WARN : SensorStatus::OK, "statvfs", std::chrono::system_clock::now() });
-        }
-    }
-
-    // --- 6. Network I/O ---
-    std::ifstream net_dev("/proc/net/dev");
-    std::string net_line;
-    std::getline(net_dev, net_line); // Skip header
-    std::getline(net_dev, net_line); // Skip header
-    while (std::getline(net_dev, net_line)) {
-        std::stringstream ss(net_line);
-        std::string iface_name;
-        long long recv_bytes, recv_packets, recv_errs, recv_drop;
-        long long trans_bytes, trans_packets, trans_errs, trans_drop;
-        ss >> iface_name;
-        if (iface_name.back() == ':') {
-            iface_name.pop_back();
-        }
-        ss >> recv_bytes >> recv_packets >> recv_errs >> recv_drop;
-        ss >> trans_bytes >> trans_packets >> trans_errs >> trans_drop;
-        sensors.push_back({ "net_recv_" + iface_name, "net", "ReceivedBytes", iface_name + " Received", (double)recv_bytes, "Bytes", SensorStatus::OK, "/proc/net/dev", std::chrono::system_clock::now() });
-        sensors.push_back({ "net_sent_" + iface_name, "net", "SentBytes", iface_name + " Sent", (double)trans_bytes, "Bytes", SensorStatus::OK, "/proc/net/dev", std::chrono::system_clock::now() });
-    }
-
-    // --------------------------
-    // ADDITIVE: After core sysfs and /proc scans, run a second pass hwmon parser and optional GPU hooks.
-    // This pass uses the unified hwmon parser to capture labels, thresholds, PWM, energy, etc., and avoids duplicates.
-    // --------------------------
+    // Optional NVML (if compiled with HAS_NVML)
+#ifdef HAS_NVML
     {
         std::unordered_set<std::string> seen;
-        for (const auto& sd : sensors) {
-            if (!sd.id.empty()) seen.insert(sd.id);
-            else seen.insert(sd.type + "_" + sd.name);
-        }
-
-        // run exhaustive hwmon parsing for each hwmon device
-        for (const auto& hw : std::filesystem::directory_iterator("/sys/class/hwmon")) {
-            if (!hw.is_directory()) continue;
-            parseHwmonDevice(hw.path(), sensors, seen);
-        }
-
-        // Optional NVML (if compiled with HAS_NVML)
-#ifdef HAS_NVML
+        for (const auto& sd : sensors) seen.insert(sd.id);
         scanNvml(sensors, seen);
-#endif
     }
+#endif
 
 #else
     std::cerr << "SensorManager: Unsupported platform." << std::endl;
@@ -718,3 +937,29 @@ std::vector<SensorData> SensorManager::listSensors() {
 
     return sensors;
 }
+
+// Shared by snapshot() and rediscover().
+static std::mutex g_snapshotMutex;
+static std::vector<SensorData> g_snapshot;
+static std::chrono::steady_clock::time_point g_snapshotAt;
+static bool g_snapshotValid = false;
+
+std::vector<SensorData> SensorManager::snapshot(std::chrono::milliseconds maxAge) {
+    // Held across the refresh so concurrent callers wait for one read instead of each doing their own.
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    auto now = std::chrono::steady_clock::now();
+    if (!g_snapshotValid || now - g_snapshotAt > maxAge) {
+        g_snapshot = listSensors();
+        g_snapshotAt = std::chrono::steady_clock::now();
+        g_snapshotValid = true;
+    }
+    return g_snapshot;
+}
+
+void SensorManager::rediscover() {
+#if defined(__linux__)
+    sensorRegistry().invalidate();
+#endif
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    g_snapshotValid = false;
+}
@@ -30,6 +30,14 @@ struct SensorData {
 
 class SensorManager {
 public:
-    // Returns a list of discovered sensors (platform-specific)
+    // Returns a list of discovered sensors (platform-specific). On Linux the sensor set is discovered
+    // once and re-read through cached file descriptors; hotplug triggers a new walk of sysfs.
     static std::vector<SensorData> listSensors();
+
+    // Last readings if they are no older than 'maxAge', otherwise a fresh listSensors(). Meant for
+    // callers that run per query (AI context building) and can tolerate slightly stale values.
+    static std::vector<SensorData> snapshot(std::chrono::milliseconds maxAge = std::chrono::seconds(2));
+
+    // Forces the next listSensors() to rediscover sensors and drops the cached snapshot.
+    static void rediscover();
 };
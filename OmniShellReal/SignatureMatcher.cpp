@@ -0,0 +1,199 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// SignatureMatcher.cpp
+#include "SignatureMatcher.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void SignatureMatcher::add(std::string name, std::vector<unsigned char> bytes) {
+    if (isCompiled) throw std::logic_error("SignatureMatcher::add after compile");
+    if (bytes.empty()) return;
+    auto mix = [this](unsigned char c) { print = (print ^ c) * 0x100000001B3ull; };
+    for (char c : name) mix(static_cast<unsigned char>(c));
+    mix(0);
+    for (unsigned char c : bytes) mix(c);
+    mix(0xFF);
+    Pattern p;
+    p.name = std::move(name);
+    p.length = bytes.size();
+    p.bytes = std::move(bytes);
+    patterns.push_back(std::move(p));
+}
+
+void SignatureMatcher::compile() {
+    if (isCompiled) return;
+
+    // Input classes: one per byte value that appears in some pattern, plus a shared class for the rest.
+    bool used[256] = {};
+    for (const auto& p : patterns) {
+        for (unsigned char b : p.bytes) used[b] = true;
+    }
+    const bool allUsed = std::all_of(std::begin(used), std::end(used), [](bool u) { return u; });
+    classes = allUsed ? 0 : 1;
+    for (int b = 0; b < 256; ++b) byteClass[b] = used[b] ? static_cast<uint8_t>(classes++) : 0;
+
+    // Trie, in insertion order.
+    struct Node {
+        std::vector<std::pair<uint8_t, uint32_t>> edges;
+        std::vector<uint32_t> out;
+    };
+    std::vector<Node> trie(1);
+    for (uint32_t id = 0; id < patterns.size(); ++id) {
+        uint32_t s = 0;
+        for (unsigned char b : patterns[id].bytes) {
+            const uint8_t c = byteClass[b];
+            auto it = std::find_if(trie[s].edges.begin(), trie[s].edges.end(), [&](const auto& e) { return e.first == c; });
+            if (it != trie[s].edges.end()) {
+                s = it->second;
+                continue;
+            }
+            trie[s].edges.emplace_back(c, static_cast<uint32_t>(trie.size()));
+            s = static_cast<uint32_t>(trie.size());
+            trie.emplace_back();
+        }
+        trie[s].out.push_back(id);
+        std::vector<unsigned char>().swap(patterns[id].bytes);
+    }
+
+    // Renumber breadth-first, so every failure link points to a lower-numbered state.
+    const size_t n = trie.size();
+    std::vector<uint32_t> order{ 0 }, index(n);
+    order.reserve(n);
+    for (size_t k = 0; k < order.size(); ++k) {
+        auto& edges = trie[order[k]].edges;
+        std::sort(edges.begin(), edges.end());
+        for (const auto& e : edges) order.push_back(e.second);
+    }
+    for (uint32_t k = 0; k < n; ++k) index[order[k]] = k;
+
+    fail.assign(n, 0);
+    dictLink.assign(n, NO_STATE);
+    outputStart.assign(n + 1, 0);
+    outputPatterns.clear();
+    for (uint32_t k = 0; k < n; ++k) {
+        outputStart[k] = static_cast<uint32_t>(outputPatterns.size());
+        for (uint32_t id : trie[order[k]].out) outputPatterns.push_back(id);
+    }
+    outputStart[n] = static_cast<uint32_t>(outputPatterns.size());
+    auto hasOwnOutput = [&](uint32_t s) { return outputStart[s + 1] > outputStart[s]; };
+    auto hasOutput = [&](uint32_t s) { return hasOwnOutput(s) || dictLink[s] != NO_STATE; };
+
+    // Sparse edges in the new numbering.
+    edgeStart.assign(n + 1, 0);
+    edgeClass.clear();
+    edgeTarget.clear();
+    for (uint32_t k = 0; k < n; ++k) {
+        edgeStart[k] = static_cast<uint32_t>(edgeClass.size());
+        for (const auto& e : trie[order[k]].edges) {
+            edgeClass.push_back(e.first);
+            edgeTarget.push_back(index[e.second]);
+        }
+    }
+    edgeStart[n] = static_cast<uint32_t>(edgeClass.size());
+    trie.clear();
+    trie.shrink_to_fit();
+
+    auto childOf = [&](uint32_t s, uint8_t c) -> uint32_t {
+        for (uint32_t e = edgeStart[s]; e < edgeStart[s + 1]; ++e) {
+            if (edgeClass[e] == c) return edgeTarget[e];
+        }
+        return NO_STATE;
+    };
+
+    // Failure and dictionary links, breadth-first.
+    for (uint32_t s = 0; s < n; ++s) {
+        for (uint32_t e = edgeStart[s]; e < edgeStart[s + 1]; ++e) {
+            const uint32_t child = edgeTarget[e];
+            uint32_t f = 0;
+            if (s != 0) {
+                for (uint32_t t = fail[s];; t = fail[t]) {
+                    const uint32_t next = childOf(t, edgeClass[e]);
+                    if (next != NO_STATE) { f = next; break; }
+                    if (t == 0) break;
+                }
+            }
+            fail[child] = f;
+            dictLink[child] = hasOwnOutput(f) ? f : dictLink[f];
+        }
+    }
+
+    // Dense rows for the shallow states. Each row copies its failure state's row and overrides its own
+    // edges; the failure state is shallower, so its row is already complete.
+    denseStates = std::min<size_t>(n, std::max<size_t>(1, DENSE_BUDGET / classes));
+    dense.assign(denseStates * classes, 0);
+    for (uint32_t s = 0; s < denseStates; ++s) {
+        uint32_t* row = &dense[size_t(s) * classes];
+        if (s != 0) std::copy_n(&dense[size_t(fail[s]) * classes], classes, row);
+        for (uint32_t e = edgeStart[s]; e < edgeStart[s + 1]; ++e) {
+            row[edgeClass[e]] = edgeTarget[e] | (hasOutput(edgeTarget[e]) ? OUTPUT_BIT : 0);
+        }
+    }
+    for (auto& t : edgeTarget) t |= hasOutput(t) ? OUTPUT_BIT : 0;
+
+    isCompiled = true;
+}
+
+size_t SignatureMatcher::memoryBytes() const {
+    return dense.size() * sizeof(uint32_t) + edgeStart.size() * sizeof(uint32_t) + edgeClass.size()
+        + edgeTarget.size() * sizeof(uint32_t) + fail.size() * sizeof(uint32_t)
+        + outputStart.size() * sizeof(uint32_t) + outputPatterns.size() * sizeof(uint32_t)
+        + dictLink.size() * sizeof(uint32_t);
+}
+
+// Deep states have no dense row: follow the trie edge if there is one, otherwise the failure link,
+// until a state with a dense row is reached.
+uint32_t SignatureMatcher::step(uint32_t state, uint32_t cls) const {
+    while (state >= denseStates) {
+        const uint8_t* first = &edgeClass[edgeStart[state]];
+        const uint8_t* last = &edgeClass[0] + edgeStart[state + 1];
+        const uint8_t* it = std::lower_bound(first, last, static_cast<uint8_t>(cls));
+        if (it != last && *it == cls) return edgeTarget[it - &edgeClass[0]];
+        state = fail[state];
+    }
+    return dense[size_t(state) * classes + cls];
+}
+
+bool SignatureMatcher::report(uint32_t state, uint64_t end, const MatchCallback& onMatch) const {
+    for (uint32_t s = state; s != NO_STATE; s = dictLink[s]) {
+        for (uint32_t k = outputStart[s]; k < outputStart[s + 1]; ++k) {
+            const uint32_t id = outputPatterns[k];
+            if (!onMatch({ id, end + 1 - patterns[id].length })) return false;
+        }
+    }
+    return true;
+}
+
+bool SignatureMatcher::feed(Stream& stream, std::span<const unsigned char> data, const MatchCallback& onMatch) const {
+    if (!isCompiled) throw std::logic_error("SignatureMatcher::feed before compile");
+    if (patterns.empty()) {
+        stream.consumed += data.size();
+        return true;
+    }
+    uint32_t state = stream.state;
+    const unsigned char* p = data.data();
+    const size_t size = data.size();
+    for (size_t i = 0; i < size; ++i) {
+        const uint32_t cls = byteClass[p[i]];
+        const uint32_t next = (state < denseStates) ? dense[size_t(state) * classes + cls] : step(state, cls);
+        state = next & ~OUTPUT_BIT;
+        if ((next & OUTPUT_BIT) && !report(state, stream.consumed + i, onMatch)) {
+            stream.state = state;
+            stream.consumed += i + 1;
+            return false;
+        }
+    }
+    stream.state = state;
+    stream.consumed += size;
+    return true;
+}
+
+std::vector<SignatureMatch> SignatureMatcher::findAll(std::span<const unsigned char> data) const {
+    std::vector<SignatureMatch> matches;
+    Stream stream;
+    feed(stream, data, [&](const SignatureMatch& m) {
+        matches.push_back(m);
+        return true;
+        });
+    return matches;
+}
@@ -0,0 +1,91 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// SignatureMatcher.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct SignatureMatch {
+    uint32_t pattern;       // index in the order add() was called
+    uint64_t offset;        // of the first byte, counted from the start of the stream
+};
+
+/**
+ * @class SignatureMatcher
+ * @brief Aho-Corasick automaton that finds every occurrence of a set of byte patterns in one pass.
+ *
+ * Bytes that occur in no pattern share one input class. States are numbered breadth-first, and
+ * the shallow states, where a scan over unrelated data spends nearly all of its time, get dense
+ * transition rows (a full DFA) up to a fixed memory budget. Deeper states keep only their trie
+ * edges and fall back along failure links to a dense state, so thousands of long signatures do
+ * not blow the table up. Scanning costs one table lookup per byte, independent of the number of
+ * patterns. Immutable once compiled, so one instance can be shared by any number of threads.
+ */
+class SignatureMatcher {
+public:
+    // Scan position across calls to feed(), so a file can be matched block by block.
+    struct Stream {
+        uint32_t state = 0;
+        uint64_t consumed = 0;
+    };
+
+    // Return false to stop the scan.
+    using MatchCallback = std::function<bool(const SignatureMatch&)>;
+
+    // Adds a pattern; empty patterns are ignored. Only valid before compile().
+    void add(std::string name, std::vector<unsigned char> bytes);
+    void compile();
+
+    bool compiled() const { return isCompiled; }
+    size_t patternCount() const { return patterns.size(); }
+    const std::string& name(uint32_t pattern) const { return patterns[pattern].name; }
+    size_t patternLength(uint32_t pattern) const { return patterns[pattern].length; }
+    size_t stateCount() const { return fail.size(); }
+    size_t denseStateCount() const { return denseStates; }
+    size_t memoryBytes() const;
+
+    // Changes whenever a pattern or its name does, so cached results can tell which set produced them.
+    uint64_t fingerprint() const { return print; }
+
+    // Scans the next block of a stream, reporting matches that end inside it (including those that
+    // started in earlier blocks). Returns false if the callback stopped the scan.
+    bool feed(Stream& stream, std::span<const unsigned char> data, const MatchCallback& onMatch) const;
+
+    // Every match in 'data', in order of where each match ends.
+    std::vector<SignatureMatch> findAll(std::span<const unsigned char> data) const;
+
+private:
+    static constexpr uint32_t OUTPUT_BIT = 0x80000000u;   // set on transitions into a matching state
+    static constexpr uint32_t NO_STATE = 0xFFFFFFFFu;
+    static constexpr size_t DENSE_BUDGET = size_t(4) << 20;   // transition entries, 16 MiB
+
+    struct Pattern {
+        std::string name;
+        std::vector<unsigned char> bytes;   // released by compile()
+        size_t length = 0;
+    };
+
+    uint32_t step(uint32_t state, uint32_t cls) const;
+    bool report(uint32_t state, uint64_t end, const MatchCallback& onMatch) const;
+
+    std::vector<Pattern> patterns;
+    bool isCompiled = false;
+    uint64_t print = 0xCBF29CE484222325ull;  // FNV-1a over names and bytes
+
+    uint32_t classes = 1;
+    uint8_t byteClass[256] = {};
+    size_t denseStates = 0;
+    std::vector<uint32_t> dense;            // denseStates x classes; target | OUTPUT_BIT
+    std::vector<uint32_t> edgeStart;        // sparse trie edges of the deeper states, sorted by class
+    std::vector<uint8_t> edgeClass;
+    std::vector<uint32_t> edgeTarget;       // target | OUTPUT_BIT
+    std::vector<uint32_t> fail;
+    std::vector<uint32_t> outputStart;      // patterns ending exactly at each state
+    std::vector<uint32_t> outputPatterns;
+    std::vector<uint32_t> dictLink;         // nearest state on the failure chain with outputs
+};
@@ -0,0 +1,330 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// ThreadPool.cpp
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+static constexpr size_t PRIORITIES = 3;
+
+struct PoolTask {
+    uint64_t id = 0;
+    uint64_t parent = 0;        // id of the task that submitted this one, 0 if submitted from outside
+    std::function<void()> fn;
+    JobPriority priority = JobPriority::Normal;
+    std::optional<CancelToken> cancel;
+
+    // Unfinished dependencies, plus one held by submit() until every dependency is registered.
+    std::atomic<int> pending{ 1 };
+    std::atomic<bool> upstreamCancelled{ false };
+    std::atomic<TaskStatus> status{ TaskStatus::Waiting };
+
+    std::mutex mutex;
+    std::condition_variable doneCv;
+    bool finished = false;                              // guarded by mutex
+    std::vector<std::shared_ptr<PoolTask>> dependents;  // guarded by mutex
+};
+
+TaskStatus TaskHandle::status() const {
+    return task ? task->status.load(std::memory_order_acquire) : TaskStatus::Done;
+}
+
+bool TaskHandle::finished() const {
+    if (!task) return true;
+    std::lock_guard<std::mutex> lock(task->mutex);
+    return task->finished;
+}
+
+void TaskHandle::wait() const {
+    if (!task) return;
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->doneCv.wait(lock, [&] { return task->finished; });
+}
+
+namespace {
+    using TaskPtr = std::shared_ptr<PoolTask>;
+
+    struct TaskQueues {
+        std::mutex mutex;
+        std::array<std::deque<TaskPtr>, PRIORITIES> byPriority;
+    };
+
+    struct Worker {
+        TaskQueues queues;
+        std::atomic<uint64_t> executed{ 0 };
+        std::atomic<uint64_t> stolen{ 0 };
+        std::thread thread;
+    };
+
+    // Exceptions are logged rather than propagated; the task still counts as finished.
+    void Invoke(const std::function<void()>& fn) {
+        try {
+            fn();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[ThreadPool] task threw: " << e.what() << "\n";
+        }
+        catch (...) {
+            std::cerr << "[ThreadPool] task threw a non-standard exception\n";
+        }
+    }
+}
+
+struct ThreadPool::Impl {
+    std::vector<std::unique_ptr<Worker>> workers;
+    TaskQueues injected;                    // tasks submitted from outside the pool
+
+    std::atomic<size_t> queued{ 0 };
+    std::atomic<uint64_t> nextId{ 1 };
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool stopping = false;                  // guarded by sleepMutex
+
+    // The worker the calling thread is, if it belongs to this pool.
+    static thread_local Impl* currentPool;
+    static thread_local size_t currentIndex;
+    static thread_local PoolTask* currentTask;  // the task this worker is running, innermost first
+
+    Worker* self() { return currentPool == this ? workers[currentIndex].get() : nullptr; }
+
+    void enqueue(const TaskPtr& t) {
+        t->status.store(TaskStatus::Queued, std::memory_order_release);
+        TaskQueues& q = self() ? self()->queues : injected;
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.byPriority[static_cast<size_t>(t->priority)].push_back(t);
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        // Taking the lock orders this with a worker that is between its last check and its wait.
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        sleepCv.notify_one();
+    }
+
+    TaskPtr popFront(TaskQueues& q, size_t prio) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        auto& dq = q.byPriority[prio];
+        if (dq.empty()) return nullptr;
+        TaskPtr t = std::move(dq.front());
+        dq.pop_front();
+        return t;
+    }
+
+    TaskPtr popBack(TaskQueues& q, size_t prio) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        auto& dq = q.byPriority[prio];
+        if (dq.empty()) return nullptr;
+        TaskPtr t = std::move(dq.back());
+        dq.pop_back();
+        return t;
+    }
+
+    // Highest priority first; at each level: own newest, shared oldest, then the oldest of a victim,
+    // scanning victims from the next worker on so that thieves spread out.
+    TaskPtr find(size_t index) {
+        if (queued.load(std::memory_order_acquire) == 0) return nullptr;
+        Worker& me = *workers[index];
+        for (size_t prio = 0; prio < PRIORITIES; ++prio) {
+            if (TaskPtr t = popBack(me.queues, prio)) return t;
+            if (TaskPtr t = popFront(injected, prio)) return t;
+            for (size_t k = 1; k < workers.size(); ++k) {
+                if (TaskPtr t = popFront(workers[(index + k) % workers.size()]->queues, prio)) {
+                    me.stolen.fetch_add(1, std::memory_order_relaxed);
+                    return t;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // Removes the first task 'wanted' accepts, scanning from the newest or the oldest end.
+    template <typename Pred>
+    TaskPtr take(TaskQueues& q, size_t prio, bool newest, Pred wanted) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        auto& dq = q.byPriority[prio];
+        for (size_t k = 0; k < dq.size(); ++k) {
+            const size_t i = newest ? dq.size() - 1 - k : k;
+            if (!wanted(*dq[i])) continue;
+            TaskPtr t = std::move(dq[i]);
+            dq.erase(dq.begin() + static_cast<std::ptrdiff_t>(i));
+            return t;
+        }
+        return nullptr;
+    }
+
+    // What a worker waiting inside task 'group' may run meanwhile: the tasks that group submitted
+    // (work it is waiting for anyway) and the awaited task itself. Anything else, a shell job from
+    // addJob() in particular, could keep the waiter busy long after its own task finished.
+    TaskPtr findHelp(size_t index, uint64_t group, const PoolTask* awaited) {
+        if (queued.load(std::memory_order_acquire) == 0) return nullptr;
+        auto wanted = [&](const PoolTask& t) { return &t == awaited || (group && t.parent == group); };
+        for (size_t prio = 0; prio < PRIORITIES; ++prio) {
+            if (TaskPtr t = take(workers[index]->queues, prio, true, wanted)) return t;
+            if (TaskPtr t = take(injected, prio, false, wanted)) return t;
+            for (size_t k = 1; k < workers.size(); ++k) {
+                if (TaskPtr t = take(workers[(index + k) % workers.size()]->queues, prio, false, wanted)) {
+                    workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+                    return t;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void finish(const TaskPtr& t, TaskStatus final) {
+        std::vector<TaskPtr> released;
+        {
+            std::lock_guard<std::mutex> lock(t->mutex);
+            t->status.store(final, std::memory_order_release);
+            t->finished = true;
+            released.swap(t->dependents);
+        }
+        t->doneCv.notify_all();
+        for (const auto& d : released) {
+            if (final == TaskStatus::Cancelled) d->upstreamCancelled.store(true, std::memory_order_relaxed);
+            if (d->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) enqueue(d);
+        }
+    }
+
+    void run(const TaskPtr& t, Worker& w) {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        if (t->upstreamCancelled.load(std::memory_order_relaxed) || (t->cancel && t->cancel->isCancelled())) {
+            t->fn = nullptr;
+            finish(t, TaskStatus::Cancelled);
+            return;
+        }
+        t->status.store(TaskStatus::Running, std::memory_order_release);
+        PoolTask* outer = currentTask;
+        currentTask = t.get();
+        Invoke(t->fn);
+        currentTask = outer;
+        t->fn = nullptr; // release captures now rather than when the last handle goes away
+        w.executed.fetch_add(1, std::memory_order_relaxed);
+        finish(t, TaskStatus::Done);
+    }
+
+    void workerLoop(size_t index) {
+        currentPool = this;
+        currentIndex = index;
+        Worker& me = *workers[index];
+        while (true) {
+            if (TaskPtr t = find(index)) {
+                run(t, me);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCv.wait(lock, [&] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) break;
+        }
+        currentPool = nullptr;
+    }
+};
+
+thread_local ThreadPool::Impl* ThreadPool::Impl::currentPool = nullptr;
+thread_local size_t ThreadPool::Impl::currentIndex = 0;
+thread_local PoolTask* ThreadPool::Impl::currentTask = nullptr;
+
+ThreadPool::ThreadPool(size_t threads) : pImpl(std::make_unique<Impl>()) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; ++i) pImpl->workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < threads; ++i) {
+        pImpl->workers[i]->thread = std::thread([impl = pImpl.get(), i] { impl->workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(pImpl->sleepMutex);
+        pImpl->stopping = true;
+    }
+    pImpl->sleepCv.notify_all();
+    for (auto& w : pImpl->workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+TaskHandle ThreadPool::submit(std::function<void()> fn, TaskOptions options) {
+    auto t = std::make_shared<PoolTask>();
+    t->id = pImpl->nextId.fetch_add(1, std::memory_order_relaxed);
+    if (pImpl->self() && Impl::currentTask) t->parent = Impl::currentTask->id;
+    t->fn = std::move(fn);
+    t->priority = options.priority;
+    t->cancel = std::move(options.cancel);
+
+    for (const auto& dep : options.after) {
+        if (!dep.task) continue;
+        std::lock_guard<std::mutex> lock(dep.task->mutex);
+        if (!dep.task->finished) {
+            t->pending.fetch_add(1, std::memory_order_relaxed);
+            dep.task->dependents.push_back(t);
+        }
+        else if (dep.task->status.load(std::memory_order_relaxed) == TaskStatus::Cancelled) {
+            t->upstreamCancelled.store(true, std::memory_order_relaxed);
+        }
+    }
+    if (t->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) pImpl->enqueue(t);
+    return TaskHandle(t);
+}
+
+void ThreadPool::wait(const TaskHandle& h) {
+    if (!h.task) return;
+    PoolTask& t = *h.task;
+    if (Worker* me = pImpl->self()) {
+        const uint64_t group = Impl::currentTask ? Impl::currentTask->id : 0;
+        while (!h.finished()) {
+            if (TaskPtr other = pImpl->findHelp(Impl::currentIndex, group, &t)) {
+                pImpl->run(other, *me);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(t.mutex);
+            t.doneCv.wait_for(lock, std::chrono::milliseconds(1), [&] { return t.finished; });
+        }
+        return;
+    }
+    h.wait();
+}
+
+TaskHandle ThreadPool::runHere(std::function<void()> fn, TaskOptions options) {
+    auto t = std::make_shared<PoolTask>();
+    bool cancelled = false;
+    for (const auto& dep : options.after) {
+        dep.wait();
+        if (dep.status() == TaskStatus::Cancelled) cancelled = true;
+    }
+    if (options.cancel && options.cancel->isCancelled()) cancelled = true;
+    if (!cancelled) {
+        t->status.store(TaskStatus::Running, std::memory_order_release);
+        Invoke(fn);
+    }
+    std::lock_guard<std::mutex> lock(t->mutex);
+    t->status.store(cancelled ? TaskStatus::Cancelled : TaskStatus::Done, std::memory_order_release);
+    t->finished = true;
+    return TaskHandle(t);
+}
+
+bool ThreadPool::onWorkerThread() const {
+    return pImpl->self() != nullptr;
+}
+
+size_t ThreadPool::threadCount() const {
+    return pImpl->workers.size();
+}
+
+std::string ThreadPool::stats() const {
+    uint64_t executed = 0, stolen = 0;
+    for (const auto& w : pImpl->workers) {
+        executed += w->executed.load(std::memory_order_relaxed);
+        stolen += w->stolen.load(std::memory_order_relaxed);
+    }
+    std::ostringstream out;
+    out << pImpl->workers.size() << " workers, " << pImpl->queued.load(std::memory_order_relaxed)
+        << " queued, " << executed << " run, " << stolen << " stolen";
+    return out.str();
+}
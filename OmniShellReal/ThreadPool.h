@@ -0,0 +1,98 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// ThreadPool.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Scheduling class of a task. Workers always take the highest priority they can find, own queue
+// first, then the shared queue, then other workers.
+enum class JobPriority { High = 0, Normal = 1, Low = 2 };
+
+// Shared cancellation flag; copies observe the same flag. A task whose token is cancelled before it
+// starts is skipped. A running task that wants to stop early polls isCancelled() itself.
+class CancelToken {
+public:
+    CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+    void cancel() const { flag->store(true, std::memory_order_release); }
+    bool isCancelled() const { return flag->load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+enum class TaskStatus { Waiting, Queued, Running, Done, Cancelled };
+
+struct PoolTask;
+
+// Refers to a submitted task; used to wait for it or to make later tasks depend on it.
+class TaskHandle {
+public:
+    TaskHandle() = default;
+    bool valid() const { return task != nullptr; }
+    TaskStatus status() const;
+    // True once the task ran to completion (even if it threw) or was cancelled.
+    bool finished() const;
+    // Blocks until finished() without running anything meanwhile.
+    void wait() const;
+
+private:
+    friend class ThreadPool;
+    explicit TaskHandle(std::shared_ptr<PoolTask> t) : task(std::move(t)) {}
+    std::shared_ptr<PoolTask> task;
+};
+
+struct TaskOptions {
+    JobPriority priority = JobPriority::Normal;
+    std::optional<CancelToken> cancel;
+    // The task is queued only after all of these have finished. If one of them was cancelled, this
+    // task is cancelled too.
+    std::vector<TaskHandle> after;
+};
+
+/**
+ * @class ThreadPool
+ * @brief Work-stealing pool: each worker owns a deque per priority and pops its newest task (LIFO,
+ * cache-warm), while idle workers steal the oldest task from others (FIFO). Tasks submitted from
+ * outside the pool go through a shared FIFO queue per priority.
+ *
+ * Exceptions thrown by a task are caught and logged; the task still counts as finished.
+ */
+class ThreadPool {
+public:
+    // 'threads' == 0 sizes the pool to std::thread::hardware_concurrency().
+    explicit ThreadPool(size_t threads = 0);
+    // Runs every task already submitted (including dependents released on the way), then joins.
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    TaskHandle submit(std::function<void()> fn, TaskOptions options = {});
+
+    // Blocks until 'h' has finished. Called from inside a task, it meanwhile runs the tasks that task
+    // submitted (and 'h' itself), so that waiting on its own subtasks can never starve the pool;
+    // other work is left to the other workers.
+    void wait(const TaskHandle& h);
+
+    // Runs 'fn' on the calling thread, for when no pool is available: waits for its dependencies,
+    // honours cancellation like a pool task and returns the finished handle.
+    static TaskHandle runHere(std::function<void()> fn, TaskOptions options = {});
+
+    // True when called from one of this pool's workers.
+    bool onWorkerThread() const;
+
+    size_t threadCount() const;
+
+    // One line: workers, queued tasks, tasks run and tasks stolen.
+    std::string stats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pImpl;
+};
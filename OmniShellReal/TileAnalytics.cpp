@@ -4,6 +4,7 @@ Copyright © 2025 Cadell Richard Anderson
 // TileAnalytics.cpp
 #include "TileAnalytics.h"
 #include "OmniAIManager.h" 
+#include "Trace.h"
 
 
 #include <algorithm>
@@ -414,6 +415,7 @@ namespace TileAnalytics {
         // Process each tile
         size_t idx = 0;
         for (const auto& r : rects) {
+            OMNI_TRACE_SCOPE_ARG("tiles", "tile", idx);
             const auto tile_start = Clock::now();
 
             // Per-tile thresholds if requested
@@ -443,6 +445,7 @@ namespace TileAnalytics {
 
             // Unigram histogram
             if (cfg.use_unigrams) {
+                OMNI_TRACE_SCOPE("tiles", "unigram");
                 std::vector<uint32_t> counts(n_bins, 0);
                 for (size_t yy = 0; yy < r.h; ++yy) {
                     for (size_t xx = 0; xx < r.w; ++xx) {
@@ -456,6 +459,7 @@ namespace TileAnalytics {
 
             // Bigram histogram (adjacent pairs)
             if (cfg.use_bigrams && ((cfg.bigram_vertical && r.h >= 2) || (!cfg.bigram_vertical && r.w >= 2))) {
+                OMNI_TRACE_SCOPE("tiles", "bigram");
                 const size_t pairs = cfg.bigram_vertical ? (r.w * (r.h - 1)) : (r.h * (r.w - 1));
                 std::vector<uint32_t> counts(static_cast<size_t>(n_bins) * static_cast<size_t>(n_bins), 0);
                 if (cfg.bigram_vertical) {
@@ -482,6 +486,7 @@ namespace TileAnalytics {
 
             // Trigram histogram (adjacent triplets) using sparse map (distinct <= samples)
             if (cfg.use_trigrams && ((cfg.trigram_vertical && r.h >= 3) || (!cfg.trigram_vertical && r.w >= 3))) {
+                OMNI_TRACE_SCOPE("tiles", "trigram");
                 std::unordered_map<uint32_t, uint32_t> counts;
                 counts.reserve(512);
                 uint64_t triplets = 0;
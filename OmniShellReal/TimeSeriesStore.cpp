@@ -0,0 +1,633 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// TimeSeriesStore.cpp
+
+#include "TimeSeriesStore.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    using Clock = std::chrono::system_clock;
+
+    int64_t toMs(Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+    }
+
+    Clock::time_point fromMs(int64_t ms) {
+        return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds(ms)));
+    }
+
+    // Appends bit fields most-significant first into 64-bit words.
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint64_t>& words, size_t& bits) : words_(words), bits_(bits) {}
+
+        void write(uint64_t value, unsigned count) {
+            while (count > 0) {
+                const size_t used = bits_ & 63;
+                if (used == 0) words_.push_back(0);
+                const unsigned room = static_cast<unsigned>(64 - used);
+                const unsigned take = std::min(room, count);
+                const uint64_t chunk = (take == 64) ? value : (value >> (count - take)) & ((uint64_t{ 1 } << take) - 1);
+                words_.back() |= chunk << (room - take);
+                bits_ += take;
+                count -= take;
+            }
+        }
+
+    private:
+        std::vector<uint64_t>& words_;
+        size_t& bits_;
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint64_t* words, size_t word_count) : words_(words), limit_(word_count * 64) {}
+
+        bool read(unsigned count, uint64_t& out) {
+            if (pos_ + count > limit_) return false;
+            out = 0;
+            while (count > 0) {
+                const size_t used = pos_ & 63;
+                const unsigned room = static_cast<unsigned>(64 - used);
+                const unsigned take = std::min(room, count);
+                const uint64_t word = words_[pos_ >> 6];
+                const uint64_t chunk = (take == 64) ? word : (word >> (room - take)) & ((uint64_t{ 1 } << take) - 1);
+                out = (take == 64) ? chunk : (out << take) | chunk;
+                pos_ += take;
+                count -= take;
+            }
+            return true;
+        }
+
+        bool bit(bool& out) {
+            uint64_t v = 0;
+            if (!read(1, v)) return false;
+            out = v != 0;
+            return true;
+        }
+
+    private:
+        const uint64_t* words_;
+        size_t limit_;
+        size_t pos_ = 0;
+    };
+
+    // Delta-of-delta buckets for timestamps, as in Facebook's Gorilla: a fixed sampling interval
+    // costs one bit per point.
+    struct DodBucket {
+        uint64_t prefix;
+        unsigned prefix_bits;
+        unsigned value_bits;
+    };
+    constexpr DodBucket DOD_BUCKETS[] = { { 0b10, 2, 7 }, { 0b110, 3, 9 }, { 0b1110, 4, 12 } };
+
+    // One compressed block. Encoder state is kept alongside so appends never re-read the stream.
+    struct Block {
+        std::vector<uint64_t> words;
+        size_t bits = 0;
+        uint32_t count = 0;
+        int64_t first_ms = 0;
+        int64_t last_ms = 0;
+        int64_t prev_delta = 0;
+        uint64_t prev_value = 0;
+        unsigned leading = 64;      // 64 = no previous window
+        unsigned trailing = 0;
+
+        void append(int64_t ms, double value) {
+            BitWriter w(words, bits);
+            const uint64_t raw = std::bit_cast<uint64_t>(value);
+            if (count == 0) {
+                w.write(static_cast<uint64_t>(ms), 64);
+                w.write(raw, 64);
+                first_ms = last_ms = ms;
+                prev_value = raw;
+                ++count;
+                return;
+            }
+
+            const int64_t delta = ms - last_ms;
+            const int64_t dod = delta - prev_delta;
+            if (dod == 0) {
+                w.write(0, 1);
+            }
+            else {
+                bool written = false;
+                for (const auto& bucket : DOD_BUCKETS) {
+                    const int64_t half = int64_t{ 1 } << (bucket.value_bits - 1);
+                    if (dod >= -(half - 1) && dod <= half) {
+                        w.write(bucket.prefix, bucket.prefix_bits);
+                        w.write(static_cast<uint64_t>(dod + half - 1), bucket.value_bits);
+                        written = true;
+                        break;
+                    }
+                }
+                if (!written) {
+                    w.write(0b1111, 4);
+                    w.write(static_cast<uint64_t>(dod), 64);
+                }
+            }
+
+            const uint64_t x = raw ^ prev_value;
+            if (x == 0) {
+                w.write(0, 1);
+            }
+            else {
+                const unsigned lead = std::min<unsigned>(static_cast<unsigned>(std::countl_zero(x)), 31);
+                const unsigned trail = static_cast<unsigned>(std::countr_zero(x));
+                if (leading != 64 && lead >= leading && trail >= trailing) {
+                    w.write(0b10, 2);
+                    w.write(x >> trailing, 64 - leading - trailing);
+                }
+                else {
+                    const unsigned significant = 64 - lead - trail;
+                    w.write(0b11, 2);
+                    w.write(lead, 5);
+                    w.write(significant - 1, 6);
+                    w.write(x >> trail, significant);
+                    leading = lead;
+                    trailing = trail;
+                }
+            }
+
+            prev_delta = delta;
+            prev_value = raw;
+            last_ms = ms;
+            ++count;
+        }
+    };
+
+    // Calls visit(ms, value) for every point in an encoded block; stops early on a truncated stream.
+    template <typename Visit>
+    void decodeBlock(const uint64_t* words, size_t word_count, uint32_t count, Visit&& visit) {
+        if (count == 0) return;
+        BitReader r(words, word_count);
+        uint64_t ts = 0;
+        uint64_t raw = 0;
+        if (!r.read(64, ts) || !r.read(64, raw)) return;
+        int64_t ms = static_cast<int64_t>(ts);
+        int64_t delta = 0;
+        unsigned leading = 0;
+        unsigned trailing = 0;
+        visit(ms, std::bit_cast<double>(raw));
+
+        for (uint32_t i = 1; i < count; ++i) {
+            bool b = false;
+            int64_t dod = 0;
+            if (!r.bit(b)) return;
+            if (b) {
+                unsigned ones = 1;
+                while (ones < 4) {
+                    if (!r.bit(b)) return;
+                    if (!b) break;
+                    ++ones;
+                }
+                uint64_t v = 0;
+                if (ones == 4) {
+                    if (!r.read(64, v)) return;
+                    dod = static_cast<int64_t>(v);
+                }
+                else {
+                    const DodBucket& bucket = DOD_BUCKETS[ones - 1];
+                    if (!r.read(bucket.value_bits, v)) return;
+                    dod = static_cast<int64_t>(v) - ((int64_t{ 1 } << (bucket.value_bits - 1)) - 1);
+                }
+            }
+            delta += dod;
+            ms += delta;
+
+            if (!r.bit(b)) return;
+            if (b) {
+                bool fresh = false;
+                if (!r.bit(fresh)) return;
+                if (fresh) {
+                    uint64_t lead = 0;
+                    uint64_t significant = 0;
+                    if (!r.read(5, lead) || !r.read(6, significant)) return;
+                    leading = static_cast<unsigned>(lead);
+                    trailing = 64 - leading - static_cast<unsigned>(significant + 1);
+                }
+                uint64_t x = 0;
+                if (!r.read(64 - leading - trailing, x)) return;
+                raw ^= x << trailing;
+            }
+            visit(ms, std::bit_cast<double>(raw));
+        }
+    }
+
+    // A fixed-size file mapped read/write. Spilled blocks are appended as records:
+    // SpillHeader, the metric name padded to 8 bytes, then the block's words.
+    class MappedSegment {
+    public:
+        ~MappedSegment() {
+#ifdef _WIN32
+            if (base_) UnmapViewOfFile(base_);
+            if (mapping_) CloseHandle(mapping_);
+            if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+            if (base_) munmap(base_, size_);
+            if (fd_ >= 0) ::close(fd_);
+#endif
+        }
+
+        bool open(const std::filesystem::path& path, size_t size) {
+            size_ = size;
+#ifdef _WIN32
+            file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE) return false;
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE,
+                static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xFFFFFFFFu), nullptr);
+            if (!mapping_) return false;
+            base_ = static_cast<std::byte*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd_ < 0) return false;
+            struct stat st {};
+            if (fstat(fd_, &st) != 0) return false;
+            if (static_cast<size_t>(st.st_size) < size && ftruncate(fd_, static_cast<off_t>(size)) != 0) return false;
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            base_ = (p == MAP_FAILED) ? nullptr : static_cast<std::byte*>(p);
+#endif
+            return base_ != nullptr;
+        }
+
+        std::byte* data() const { return base_; }
+        size_t size() const { return size_; }
+
+    private:
+        std::byte* base_ = nullptr;
+        size_t size_ = 0;
+#ifdef _WIN32
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+    };
+
+    constexpr uint32_t SPILL_MAGIC = 0x31425354; // "TSB1"
+
+    struct SpillHeader {
+        uint32_t magic;
+        uint32_t name_bytes;
+        int64_t first_ms;
+        int64_t last_ms;
+        uint32_t count;
+        uint32_t word_count;
+    };
+
+    size_t padTo8(size_t n) {
+        return (n + 7) & ~size_t{ 7 };
+    }
+
+} // namespace
+
+struct TimeSeriesStore::Impl {
+    struct SpilledBlock {
+        size_t segment;         // file number (see segmentPath)
+        size_t offset;          // of the first word
+        int64_t first_ms;
+        int64_t last_ms;
+        uint32_t count;
+        uint32_t word_count;
+    };
+
+    struct Series {
+        std::string unit;
+        std::deque<Block> blocks;           // oldest first; back() takes new points
+        std::vector<SpilledBlock> spilled;  // oldest first
+        int64_t last_ms = 0;
+        double last_value = 0.0;
+        size_t points = 0;                  // in memory
+    };
+
+    TimeSeriesOptions options;
+    mutable std::mutex mutex;
+    std::map<std::string, Series, std::less<>> series;
+
+    struct Segment {
+        size_t number = 0;                  // file number, increasing with age
+        int64_t newest_ms = INT64_MIN;      // last point of any block in it
+        std::unique_ptr<MappedSegment> map;
+    };
+
+    std::filesystem::path spillDir;
+    SpillRetention retention;
+    std::deque<Segment> segments;           // oldest first; back() takes new blocks
+    size_t segmentUsed = 0;                 // bytes used in segments.back()
+    uint64_t retiredSegments = 0;
+    uint64_t retiredBlocks = 0;
+
+    // Numbers increase along the deque but may skip a file that could not be mapped at startup.
+    const MappedSegment& segmentFor(const SpilledBlock& block) const {
+        auto it = std::lower_bound(segments.begin(), segments.end(), block.segment,
+            [](const Segment& seg, size_t number) { return seg.number < number; });
+        return *it->map;
+    }
+
+    void evict(const std::string& name, Series& s) {
+        Block& oldest = s.blocks.front();
+        if (!spillDir.empty()) spill(name, s, oldest);
+        s.points -= oldest.count;
+        s.blocks.pop_front();
+    }
+
+    void spill(const std::string& name, Series& s, const Block& block) {
+        const size_t record = sizeof(SpillHeader) + padTo8(name.size()) + block.words.size() * sizeof(uint64_t);
+        if (record > options.segment_bytes) return;
+        if (segments.empty() || segmentUsed + record > options.segment_bytes) {
+            if (!openSegment(segments.empty() ? 0 : segments.back().number + 1, false)) return;
+            enforceRetention();
+        }
+        std::byte* at = segments.back().map->data() + segmentUsed;
+        SpillHeader header{ SPILL_MAGIC, static_cast<uint32_t>(name.size()), block.first_ms, block.last_ms,
+            block.count, static_cast<uint32_t>(block.words.size()) };
+        std::memcpy(at, &header, sizeof(header));
+        std::memcpy(at + sizeof(header), name.data(), name.size());
+        const size_t wordsOffset = segmentUsed + sizeof(header) + padTo8(name.size());
+        std::memcpy(segments.back().map->data() + wordsOffset, block.words.data(), block.words.size() * sizeof(uint64_t));
+        s.spilled.push_back({ segments.back().number, wordsOffset, block.first_ms, block.last_ms, block.count, header.word_count });
+        segments.back().newest_ms = std::max(segments.back().newest_ms, block.last_ms);
+        segmentUsed += record;
+    }
+
+    // Retires the oldest segments while the limits are exceeded: their blocks are forgotten, then the
+    // mapping is released and the file deleted.
+    void enforceRetention() {
+        const int64_t oldestKept = retention.max_age.count() > 0 ? toMs(Clock::now() - retention.max_age) : INT64_MIN;
+        while (segments.size() > 1) {
+            const bool overSize = retention.max_bytes > 0 && segments.size() * options.segment_bytes > retention.max_bytes;
+            const bool tooOld = segments.front().newest_ms < oldestKept;
+            if (!overSize && !tooOld) break;
+
+            const size_t number = segments.front().number;
+            for (auto& [name, s] : series) {
+                retiredBlocks += std::erase_if(s.spilled, [number](const SpilledBlock& b) { return b.segment == number; });
+            }
+            segments.pop_front();
+            std::error_code ec;
+            std::filesystem::remove(segmentPath(number), ec);
+            ++retiredSegments;
+        }
+    }
+
+    std::filesystem::path segmentPath(size_t index) const {
+        std::ostringstream name;
+        name << "segment-" << std::setw(6) << std::setfill('0') << index << ".tsd";
+        return spillDir / name.str();
+    }
+
+    // Maps segment file 'number', which must follow every segment already open. Existing segments
+    // are indexed so their blocks are queryable again; a new segment starts empty.
+    bool openSegment(size_t number, bool existing) {
+        auto map = std::make_unique<MappedSegment>();
+        if (!map->open(segmentPath(number), options.segment_bytes)) return false;
+        segments.push_back({ number, INT64_MIN, std::move(map) });
+        segmentUsed = 0;
+        if (existing) indexSegment(segments.back());
+        return true;
+    }
+
+    void indexSegment(Segment& segment) {
+        const std::byte* base = segment.map->data();
+        const size_t size = segment.map->size();
+        size_t offset = 0;
+        while (offset + sizeof(SpillHeader) <= size) {
+            SpillHeader header{};
+            std::memcpy(&header, base + offset, sizeof(header));
+            if (header.magic != SPILL_MAGIC) break;
+            const size_t record = sizeof(SpillHeader) + padTo8(header.name_bytes) + size_t{ header.word_count } * sizeof(uint64_t);
+            if (offset + record > size) break;
+            std::string name(reinterpret_cast<const char*>(base + offset + sizeof(header)), header.name_bytes);
+            series[name].spilled.push_back({ segment.number, offset + sizeof(header) + padTo8(header.name_bytes),
+                header.first_ms, header.last_ms, header.count, header.word_count });
+            segment.newest_ms = std::max(segment.newest_ms, header.last_ms);
+            offset += record;
+        }
+        segmentUsed = offset;
+    }
+
+    template <typename Visit>
+    void visitSince(const Series& s, int64_t since_ms, Visit&& visit) const {
+        auto filtered = [&](int64_t ms, double v) { if (ms >= since_ms) visit(ms, v); };
+        for (const auto& block : s.spilled) {
+            if (block.last_ms < since_ms) continue;
+            const auto* words = reinterpret_cast<const uint64_t*>(segmentFor(block).data() + block.offset);
+            decodeBlock(words, block.word_count, block.count, filtered);
+        }
+        for (const auto& block : s.blocks) {
+            if (block.count == 0 || block.last_ms < since_ms) continue;
+            decodeBlock(block.words.data(), block.words.size(), block.count, filtered);
+        }
+    }
+};
+
+TimeSeriesStore::TimeSeriesStore(TimeSeriesOptions options) : pImpl(std::make_unique<Impl>()) {
+    options.points_per_block = std::max<size_t>(options.points_per_block, 2);
+    options.blocks_per_series = std::max<size_t>(options.blocks_per_series, 1);
+    pImpl->options = options;
+}
+
+TimeSeriesStore::~TimeSeriesStore() = default;
+
+TimeSeriesStore& TimeSeriesStore::instance() {
+    static TimeSeriesStore store;
+    return store;
+}
+
+void TimeSeriesStore::append(std::string_view metric, double value, std::string_view unit, Clock::time_point at) {
+    const int64_t ms = toMs(at);
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto it = pImpl->series.find(metric);
+    if (it == pImpl->series.end()) it = pImpl->series.emplace(std::string(metric), Impl::Series{}).first;
+    Impl::Series& s = it->second;
+    if (s.unit.empty() && !unit.empty()) s.unit = std::string(unit);
+    const bool hasPoints = s.points > 0 || !s.spilled.empty();
+    if (hasPoints && ms < s.last_ms) return;
+
+    if (s.blocks.empty() || s.blocks.back().count >= pImpl->options.points_per_block) {
+        s.blocks.emplace_back();
+        if (s.blocks.size() > pImpl->options.blocks_per_series) pImpl->evict(it->first, s);
+    }
+    s.blocks.back().append(ms, value);
+    s.last_ms = ms;
+    s.last_value = value;
+    ++s.points;
+}
+
+std::vector<TimeSeriesPoint> TimeSeriesStore::points(std::string_view metric, std::chrono::seconds window) const {
+    std::vector<TimeSeriesPoint> out;
+    const int64_t since = toMs(Clock::now() - window);
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto it = pImpl->series.find(metric);
+    if (it == pImpl->series.end()) return out;
+    pImpl->visitSince(it->second, since, [&](int64_t ms, double v) { out.push_back({ fromMs(ms), v }); });
+    return out;
+}
+
+std::optional<TimeSeriesStats> TimeSeriesStore::stats(std::string_view metric, std::chrono::seconds window) const {
+    const int64_t since = toMs(Clock::now() - window);
+    std::vector<double> values;
+    TimeSeriesStats st;
+    int64_t lastMs = 0;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        auto it = pImpl->series.find(metric);
+        if (it == pImpl->series.end()) return std::nullopt;
+        st.unit = it->second.unit;
+        pImpl->visitSince(it->second, since, [&](int64_t ms, double v) {
+            values.push_back(v);
+            lastMs = ms;
+        });
+    }
+    if (values.empty()) return std::nullopt;
+
+    st.count = values.size();
+    st.last = values.back();
+    st.last_at = fromMs(lastMs);
+    double sum = 0.0;
+    st.min = st.max = values.front();
+    for (double v : values) {
+        sum += v;
+        st.min = std::min(st.min, v);
+        st.max = std::max(st.max, v);
+    }
+    st.avg = sum / static_cast<double>(values.size());
+    const size_t rank = static_cast<size_t>(std::ceil(0.95 * static_cast<double>(values.size()))) - 1;
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(rank), values.end());
+    st.p95 = values[rank];
+    return st;
+}
+
+std::optional<TimeSeriesPoint> TimeSeriesStore::latest(std::string_view metric) const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    auto it = pImpl->series.find(metric);
+    if (it == pImpl->series.end() || (it->second.points == 0 && it->second.spilled.empty())) return std::nullopt;
+    return TimeSeriesPoint{ fromMs(it->second.last_ms), it->second.last_value };
+}
+
+std::vector<std::string> TimeSeriesStore::metrics() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    std::vector<std::string> names;
+    names.reserve(pImpl->series.size());
+    for (const auto& [name, s] : pImpl->series) names.push_back(name);
+    return names;
+}
+
+std::string TimeSeriesStore::describe(std::chrono::seconds window, std::string_view prefix) const {
+    std::ostringstream os;
+    for (const auto& name : metrics()) {
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        auto st = stats(name, window);
+        if (!st) continue;
+        os << name << ": last=" << st->last << " min=" << st->min << " max=" << st->max
+            << " avg=" << std::setprecision(4) << st->avg << " p95=" << st->p95 << std::setprecision(6)
+            << " n=" << st->count;
+        if (!st->unit.empty()) os << " " << st->unit;
+        os << "\n";
+    }
+    return os.str();
+}
+
+bool TimeSeriesStore::enableSpill(const std::filesystem::path& directory, const SpillRetention& retention) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    if (!pImpl->spillDir.empty()) {
+        if (pImpl->spillDir != directory) return false;
+        pImpl->retention = retention;
+        pImpl->enforceRetention();
+        return true;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) return false;
+    pImpl->spillDir = directory;
+    pImpl->retention = retention;
+
+    // Retention deletes the oldest files, so the surviving numbers need not start at zero.
+    std::vector<size_t> numbers;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        const std::string name = entry.path().filename().string();
+        size_t number = 0;
+        if (name.size() == 18 && name.starts_with("segment-") && name.ends_with(".tsd")
+            && std::from_chars(name.data() + 8, name.data() + 14, number).ptr == name.data() + 14) {
+            numbers.push_back(number);
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+    for (size_t number : numbers) {
+        if (!pImpl->openSegment(number, true)) break;
+    }
+    // Spilled history from an earlier run is older than anything appended now.
+    for (auto& [name, s] : pImpl->series) {
+        std::stable_sort(s.spilled.begin(), s.spilled.end(), [](const auto& a, const auto& b) { return a.first_ms < b.first_ms; });
+        if (s.points == 0 && !s.spilled.empty()) {
+            const auto& last = s.spilled.back();
+            const auto* words = reinterpret_cast<const uint64_t*>(pImpl->segmentFor(last).data() + last.offset);
+            decodeBlock(words, last.word_count, last.count, [&](int64_t ms, double v) {
+                s.last_ms = ms;
+                s.last_value = v;
+            });
+        }
+    }
+    if (pImpl->segments.empty() && !pImpl->openSegment(0, false)) {
+        pImpl->spillDir.clear();
+        return false;
+    }
+    pImpl->enforceRetention();
+    return true;
+}
+
+std::string TimeSeriesStore::spillStatus() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    if (pImpl->spillDir.empty()) return "spill off";
+    std::ostringstream os;
+    os << "spill " << pImpl->spillDir.string() << ": " << pImpl->segments.size() << " segments, "
+        << ((pImpl->segments.size() * pImpl->options.segment_bytes) >> 20) << " MiB; retired "
+        << pImpl->retiredSegments << " segments (" << pImpl->retiredBlocks << " blocks); keeps ";
+    if (pImpl->retention.max_bytes > 0) os << (pImpl->retention.max_bytes >> 20) << " MiB";
+    else os << "unlimited bytes";
+    if (pImpl->retention.max_age.count() > 0) os << ", " << pImpl->retention.max_age.count() << " h";
+    else os << ", any age";
+    return os.str();
+}
+
+size_t TimeSeriesStore::pointCount() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    size_t total = 0;
+    for (const auto& [name, s] : pImpl->series) total += s.points;
+    return total;
+}
+
+size_t TimeSeriesStore::compressedBytes() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    size_t total = 0;
+    for (const auto& [name, s] : pImpl->series) {
+        for (const auto& block : s.blocks) total += (block.bits + 7) / 8;
+    }
+    return total;
+}
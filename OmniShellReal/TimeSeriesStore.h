@@ -0,0 +1,106 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// TimeSeriesStore.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sizing for every series in a store.
+struct TimeSeriesOptions {
+    size_t points_per_block = 256;      // points compressed together; a block is the unit of eviction and spill
+    size_t blocks_per_series = 16;      // ring length; the oldest sealed block is evicted when it is full
+    size_t segment_bytes = 16u << 20;   // size of each mapped spill segment file
+};
+
+// How much spilled history is kept. Whole segments are retired oldest first, unmapped and deleted, once
+// the segment files together exceed 'max_bytes' or a segment's newest point is older than 'max_age'.
+// Checked whenever a segment fills and when spilling is enabled; the segment being written is never
+// retired. Zero disables a limit.
+struct SpillRetention {
+    uint64_t max_bytes = 256ull << 20;
+    std::chrono::hours max_age{ 24 * 7 };
+};
+
+struct TimeSeriesPoint {
+    std::chrono::system_clock::time_point at;
+    double value = 0.0;
+};
+
+// Aggregates over a query window.
+struct TimeSeriesStats {
+    size_t count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double avg = 0.0;
+    double p95 = 0.0;
+    double last = 0.0;
+    std::chrono::system_clock::time_point last_at;
+    std::string unit;
+};
+
+/**
+ * @class TimeSeriesStore
+ * @brief In-memory metric history shared by the daemon, the PMU monitor and AI context building.
+ *
+ * Each metric is a ring of blocks compressed Gorilla-style: timestamps as delta-of-delta and values
+ * as the XOR against the previous value, so a steady sensor costs a couple of bits per point. When
+ * spilling is enabled, evicted blocks are copied into memory-mapped segment files under the spill
+ * directory and stay queryable; otherwise they are dropped. Timestamps have millisecond resolution.
+ */
+class TimeSeriesStore {
+public:
+    explicit TimeSeriesStore(TimeSeriesOptions options = {});
+    ~TimeSeriesStore();
+    TimeSeriesStore(const TimeSeriesStore&) = delete;
+    TimeSeriesStore& operator=(const TimeSeriesStore&) = delete;
+
+    // The store the daemon, PMU and OmniAIManager share.
+    static TimeSeriesStore& instance();
+
+    // Appends one point. Points older than the metric's last point are ignored. 'unit' is recorded
+    // the first time a metric is seen.
+    void append(std::string_view metric, double value, std::string_view unit = {},
+        std::chrono::system_clock::time_point at = std::chrono::system_clock::now());
+
+    // Min/max/avg/p95 over the points newer than now - 'window', or nullopt if there are none.
+    std::optional<TimeSeriesStats> stats(std::string_view metric, std::chrono::seconds window) const;
+
+    // Points newer than now - 'window', oldest first.
+    std::vector<TimeSeriesPoint> points(std::string_view metric, std::chrono::seconds window) const;
+
+    // The most recent point of a metric, without decoding any block.
+    std::optional<TimeSeriesPoint> latest(std::string_view metric) const;
+
+    std::vector<std::string> metrics() const;
+
+    // One line per metric whose name starts with 'prefix': last, min, max, avg and p95 over 'window'.
+    // A window longer than the spill retention only covers what has not been retired.
+    std::string describe(std::chrono::seconds window, std::string_view prefix = {}) const;
+
+    /**
+     * @brief Starts copying evicted blocks into segment files under 'directory' (created if needed),
+     *        keeping at most what 'retention' allows. Segments left by an earlier run are indexed
+     *        again, then retired like any other.
+     * @return false if the directory or the first segment could not be created.
+     */
+    bool enableSpill(const std::filesystem::path& directory, const SpillRetention& retention = {});
+
+    // Spill directory, segments and bytes on disk, blocks retired so far and the retention limits.
+    std::string spillStatus() const;
+
+    // Points held in memory and compressed bytes used, over all metrics.
+    size_t pointCount() const;
+    size_t compressedBytes() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pImpl;
+};
@@ -0,0 +1,111 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// TimerWheel.cpp
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point origin)
+    : tickLength(tick > Clock::duration::zero() ? tick : Clock::duration(1)), origin(origin) {}
+
+void TimerWheel::schedule(uint64_t id, Clock::time_point due) {
+    // Round up so a timer never fires before its deadline.
+    uint64_t dueTick = 0;
+    if (due > origin) {
+        auto ticks = (due - origin + tickLength - Clock::duration(1)) / tickLength;
+        dueTick = static_cast<uint64_t>(ticks);
+    }
+    ++count;
+    if (dueTick <= currentTick) {
+        overdue.push_back({ id, dueTick });
+        return;
+    }
+    place({ id, dueTick });
+}
+
+// Files an entry in the finest level whose span covers its distance from the current tick. A slot at
+// level L is emptied when the level below wraps into it, i.e. at the tick whose low 6*L bits are zero,
+// which always lies after currentTick and no later than the deadline.
+void TimerWheel::place(const Entry& e) {
+    uint64_t delta = e.due_tick - currentTick;
+    unsigned level = 0;
+    while (level + 1 < LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) ++level;
+
+    uint64_t tick = e.due_tick;
+    const uint64_t span = uint64_t(1) << (SLOT_BITS * LEVELS);
+    if (delta >= span) {
+        // Beyond the top level: park it at the farthest top slot and re-file it on cascade.
+        tick = currentTick + span - 1;
+    }
+    wheel[level][(tick >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(e);
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<uint64_t>& expired) {
+    auto firedFrom = [&](std::vector<Entry>& list) {
+        std::sort(list.begin(), list.end(), [](const Entry& a, const Entry& b) { return a.due_tick < b.due_tick; });
+        for (const Entry& e : list) expired.push_back(e.id);
+        count -= list.size();
+        list.clear();
+    };
+    firedFrom(overdue);
+
+    if (now <= origin) return;
+    const uint64_t target = static_cast<uint64_t>((now - origin) / tickLength);
+    if (count == 0) {
+        currentTick = std::max(currentTick, target);
+        return;
+    }
+
+    std::vector<Entry> cascade;
+    while (currentTick < target) {
+        ++currentTick;
+        // Cascade every upper level whose lower neighbour just wrapped, coarsest first.
+        unsigned top = 0;
+        while (top + 1 < LEVELS && (currentTick & ((uint64_t(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) ++top;
+        for (unsigned level = top; level >= 1; --level) {
+            auto& slot = wheel[level][(currentTick >> (SLOT_BITS * level)) & (SLOTS - 1)];
+            if (slot.empty()) continue;
+            cascade.swap(slot);
+            for (const Entry& e : cascade) {
+                if (e.due_tick <= currentTick) overdue.push_back(e);
+                else place(e);
+            }
+            cascade.clear();
+        }
+
+        auto& slot = wheel[0][currentTick & (SLOTS - 1)];
+        for (const Entry& e : slot) overdue.push_back(e);
+        slot.clear();
+        if (!overdue.empty()) firedFrom(overdue);
+        if (count == 0) {
+            currentTick = target;
+            break;
+        }
+    }
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::nextWake() const {
+    if (count == 0) return std::nullopt;
+    if (!overdue.empty()) return timeOf(currentTick);
+
+    std::optional<uint64_t> best;
+    for (uint64_t k = 1; k <= SLOTS; ++k) {
+        uint64_t tick = currentTick + k;
+        if (!wheel[0][tick & (SLOTS - 1)].empty()) {
+            best = tick;
+            break;
+        }
+    }
+    for (unsigned level = 1; level < LEVELS; ++level) {
+        const unsigned shift = SLOT_BITS * level;
+        for (uint64_t k = 1; k <= SLOTS; ++k) {
+            uint64_t block = (currentTick >> shift) + k;
+            if (best && (block << shift) >= *best) break;
+            if (!wheel[level][block & (SLOTS - 1)].empty()) {
+                best = block << shift;
+                break;
+            }
+        }
+    }
+    return best ? std::optional<Clock::time_point>(timeOf(*best)) : std::nullopt;
+}
@@ -0,0 +1,61 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// TimerWheel.h
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/**
+ * @class TimerWheel
+ * @brief Hierarchical timing wheel: four levels of 64 slots, each level 64 times coarser than the last.
+ *
+ * With the default 10 ms tick, level 0 covers 640 ms, level 1 about 41 s, level 2 about 44 min and
+ * level 3 about 47 h; later deadlines are parked in the top level and re-filed when it cascades.
+ * Scheduling is O(1), and advancing costs one slot visit per elapsed tick plus re-filing cascaded
+ * timers. Timers never fire early; they fire at most one tick late. Not thread-safe: the owner
+ * serializes access.
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(10),
+        Clock::time_point origin = Clock::now());
+
+    // Arms timer 'id' for 'due'. An id may be armed more than once; each arming fires separately.
+    void schedule(uint64_t id, Clock::time_point due);
+
+    // Moves the wheel to 'now' and appends the id of every timer that came due, earliest first.
+    void advance(Clock::time_point now, std::vector<uint64_t>& expired);
+
+    // When advance() next has work: the exact deadline for timers in level 0, otherwise the time the
+    // next occupied upper slot cascades. nullopt when nothing is armed.
+    std::optional<Clock::time_point> nextWake() const;
+
+    size_t size() const { return count; }
+
+private:
+    static constexpr unsigned LEVELS = 4;
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr uint64_t SLOTS = uint64_t(1) << SLOT_BITS;
+
+    struct Entry {
+        uint64_t id;
+        uint64_t due_tick;
+    };
+
+    void place(const Entry& e);
+    Clock::time_point timeOf(uint64_t tick) const { return origin + tick * tickLength; }
+
+    Clock::duration tickLength;
+    Clock::time_point origin;
+    uint64_t currentTick = 0;
+    size_t count = 0;
+    std::vector<Entry> overdue;     // armed for a tick that has already passed
+    std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> wheel;
+};
@@ -0,0 +1,277 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// Trace.cpp
+
+#include "Trace.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Trace {
+
+    std::atomic_bool g_enabled{ false };
+
+    struct Event {
+        const char* category;
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+        uint64_t arg;
+    };
+
+    // Written only by its owning thread. 'head' counts every event ever recorded; the dumper reads it
+    // before and after copying to tell which slots were overwritten underneath it.
+    struct ThreadRing {
+        size_t capacity = 0;   // a power of two, so a slot is head & mask
+        size_t mask = 0;
+        std::unique_ptr<Event[]> events;
+        std::atomic<uint64_t> head{ 0 };
+        std::atomic<uint64_t> sessionStart{ 0 };
+        std::atomic_bool owned{ true };
+        // Threads that recorded into this ring, each from the head at which it took the ring over.
+        // Guarded by g_registryMutex.
+        std::vector<std::pair<uint64_t, uint32_t>> owners;
+    };
+
+    // A thread that exits hands its ring back, with its events still available to the next dump; a
+    // new thread takes over a free ring before a new one is allocated, so threads that come and go
+    // (one per read-ahead chunk, say) do not grow memory. At most MAX_TRACE_BYTES of rings exist;
+    // threads beyond that record nothing.
+    constexpr size_t MAX_TRACE_BYTES = 256u << 20;
+
+    static std::mutex g_registryMutex;
+    static std::vector<std::unique_ptr<ThreadRing>> g_rings;
+    static size_t g_ringBytes = 0;
+    static size_t g_ringCapacity = 32768;
+    static uint64_t g_startTicks = 0;
+    static std::chrono::steady_clock::time_point g_startTime;
+    static std::atomic<uint32_t> g_session{ 0 };
+    static std::atomic<uint64_t> g_unrecorded{ 0 };  // events from threads that could not get a ring
+
+    struct RingOwner {
+        ThreadRing* ring = nullptr;
+        uint32_t refusedSession = UINT32_MAX;   // no ring was available in this session; retry in the next
+
+        ~RingOwner() {
+            if (ring) ring->owned.store(false, std::memory_order_release);
+            ring = nullptr;
+        }
+    };
+    static thread_local RingOwner t_owner;
+
+    static uint32_t currentThreadId() {
+#ifdef _WIN32
+        return static_cast<uint32_t>(GetCurrentThreadId());
+#elif __linux__
+        return static_cast<uint32_t>(syscall(SYS_gettid));
+#else
+        return static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+#endif
+    }
+
+    static std::string threadName(uint32_t tid) {
+#ifdef __linux__
+        std::ifstream f("/proc/self/task/" + std::to_string(tid) + "/comm");
+        std::string name;
+        if (f && std::getline(f, name)) return name;
+#endif
+        (void)tid;
+        return {};
+    }
+
+    // Runs from Record, and so from ~Scope: never throws. nullptr if no ring can be had.
+    static ThreadRing* registerThread() noexcept {
+        const uint32_t tid = currentThreadId();
+        try {
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            for (auto& ring : g_rings) {
+                if (ring->owned.load(std::memory_order_acquire)) continue;
+                const uint64_t head = ring->head.load(std::memory_order_relaxed);
+                // Owners whose events have all been overwritten are no longer needed to label the dump.
+                const uint64_t oldest = head > ring->capacity ? head - ring->capacity : 0;
+                while (ring->owners.size() > 1 && ring->owners[1].first <= oldest) ring->owners.erase(ring->owners.begin());
+                ring->owners.emplace_back(head, tid);
+                ring->owned.store(true, std::memory_order_relaxed);
+                return ring.get();
+            }
+
+            const size_t bytes = g_ringCapacity * sizeof(Event);
+            if (g_ringBytes + bytes > MAX_TRACE_BYTES) return nullptr;
+            auto ring = std::make_unique<ThreadRing>();
+            ring->capacity = g_ringCapacity;
+            ring->mask = ring->capacity - 1;
+            ring->events.reset(new (std::nothrow) Event[ring->capacity]);
+            if (!ring->events) return nullptr;
+            ring->owners.emplace_back(0, tid);
+            g_rings.push_back(std::move(ring));
+            g_ringBytes += bytes;
+            return g_rings.back().get();
+        }
+        catch (...) {
+            return nullptr;
+        }
+    }
+
+    void Record(const char* category, const char* name, uint64_t begin, uint64_t end, uint64_t arg) {
+        ThreadRing* ring = t_owner.ring;
+        if (!ring) {
+            const uint32_t session = g_session.load(std::memory_order_relaxed);
+            if (t_owner.refusedSession == session || !(ring = registerThread())) {
+                t_owner.refusedSession = session;
+                g_unrecorded.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            t_owner.ring = ring;
+        }
+        const uint64_t slot = ring->head.load(std::memory_order_relaxed);
+        ring->events[slot & ring->mask] = Event{ category, name, begin, end, arg };
+        ring->head.store(slot + 1, std::memory_order_release);
+    }
+
+    void Start(size_t events_per_thread) {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        if (events_per_thread > 0) g_ringCapacity = std::bit_ceil(std::min(events_per_thread, MAX_EVENTS_PER_THREAD));
+        g_session.fetch_add(1, std::memory_order_relaxed);
+        g_unrecorded.store(0, std::memory_order_relaxed);
+        for (auto& ring : g_rings) {
+            ring->sessionStart.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+        g_startTime = std::chrono::steady_clock::now();
+        g_startTicks = Ticks();
+        g_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void Stop() {
+        g_enabled.store(false, std::memory_order_relaxed);
+    }
+
+    // Emits a JSON string literal; names are normally plain identifiers, but quotes and control
+    // characters would otherwise make the whole file unreadable.
+    static void writeJsonString(std::ostream& os, const char* s) {
+        os << '"';
+        for (; s && *s; ++s) {
+            const unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') os << '\\' << static_cast<char>(c);
+            else if (c < 0x20) os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+            else os << static_cast<char>(c);
+        }
+        os << '"';
+    }
+
+    long long DumpChromeJson(const std::string& path) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) return -1;
+
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+
+        // Ticks per microsecond from the span since Start(); with steady_clock ticks this is 1000.
+        const uint64_t nowTicks = Ticks();
+        const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_startTime).count();
+        const double ticksPerUs = (elapsedUs > 0.0 && nowTicks > g_startTicks)
+            ? static_cast<double>(nowTicks - g_startTicks) / elapsedUs : 1000.0;
+#ifdef _WIN32
+        const unsigned long pid = GetCurrentProcessId();
+#elif __linux__
+        const long pid = static_cast<long>(getpid());
+#else
+        const long pid = 0;
+#endif
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << pid << ",\"args\":{\"name\":\"OmniShell\"}}";
+        out << std::fixed << std::setprecision(3);
+
+        long long written = 0;
+        std::vector<Event> copy;
+        for (const auto& ring : g_rings) {
+            const uint64_t start = ring->sessionStart.load(std::memory_order_relaxed);
+            const uint64_t before = ring->head.load(std::memory_order_acquire);
+            uint64_t first = (before > ring->capacity) ? before - ring->capacity : 0;
+            if (first < start) first = start;
+            if (before <= first) continue;
+
+            copy.resize(static_cast<size_t>(before - first));
+            for (uint64_t i = first; i < before; ++i) copy[static_cast<size_t>(i - first)] = ring->events[i & ring->mask];
+
+            // The owner may have wrapped onto the oldest slots while they were being copied.
+            const uint64_t after = ring->head.load(std::memory_order_acquire);
+            const uint64_t valid = (after >= ring->capacity) ? after - ring->capacity + 1 : 0;
+            const size_t skip = (valid > first) ? static_cast<size_t>(std::min(valid, before) - first) : 0;
+
+            for (const auto& [from, tid] : ring->owners) {
+                if (from >= before) break;
+                const std::string name = threadName(tid);
+                if (name.empty()) continue;
+                out << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+                writeJsonString(out, name.c_str());
+                out << "}}";
+            }
+
+            size_t owner = 0;
+            for (size_t i = skip; i < copy.size(); ++i) {
+                const Event& e = copy[i];
+                while (owner + 1 < ring->owners.size() && ring->owners[owner + 1].first <= first + i) ++owner;
+                const uint32_t tid = ring->owners[owner].second;
+                if (e.begin < g_startTicks || e.end < e.begin) continue;
+                out << ",\n{\"ph\":\"X\",\"cat\":";
+                writeJsonString(out, e.category);
+                out << ",\"name\":";
+                writeJsonString(out, e.name);
+                out << ",\"pid\":" << pid << ",\"tid\":" << tid
+                    << ",\"ts\":" << static_cast<double>(e.begin - g_startTicks) / ticksPerUs
+                    << ",\"dur\":" << static_cast<double>(e.end - e.begin) / ticksPerUs
+                    << ",\"args\":{\"arg\":" << e.arg << "}}";
+                ++written;
+            }
+        }
+        out << "\n]}\n";
+        return out ? written : -1;
+    }
+
+    std::string Status() {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        uint64_t recorded = 0;
+        uint64_t dropped = 0;
+        for (const auto& ring : g_rings) {
+            const uint64_t count = ring->head.load(std::memory_order_acquire) - ring->sessionStart.load(std::memory_order_relaxed);
+            recorded += count;
+            if (count > ring->capacity) dropped += count - ring->capacity;
+        }
+        size_t live = 0;
+        for (const auto& ring : g_rings) {
+            if (ring->owned.load(std::memory_order_relaxed)) ++live;
+        }
+        std::ostringstream os;
+        os << (Enabled() ? "enabled" : "disabled")
+            << " rings=" << g_rings.size() << " (" << live << " in use, " << (g_ringBytes >> 10) << " KiB)"
+            << " events=" << recorded
+            << " dropped=" << dropped
+            << " unrecorded=" << g_unrecorded.load(std::memory_order_relaxed)
+            << " ring=" << g_ringCapacity;
+        return os.str();
+    }
+
+} // namespace Trace
@@ -0,0 +1,103 @@
+Copyright © 2025 Cadell Richard Anderson
+
+// Trace.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Scoped hot-path tracing. Every thread records into its own fixed-size ring, so an event costs two
+// timestamp reads and one store into thread-local memory; nothing is shared until a dump. With
+// OMNI_DISABLE_TRACE defined the macros below compile to nothing.
+//
+//   OMNI_TRACE_SCOPE("cloud", "encode_chunk");
+//   OMNI_TRACE_SCOPE_ARG("llm", "decode_layer", layer);
+//
+// Category and name must be string literals (or otherwise outlive the trace); only the pointers are
+// stored.
+namespace Trace {
+
+    // Set by start()/stop(); read on every scope entry.
+    extern std::atomic_bool g_enabled;
+
+    // Raw timestamp: the TSC on x86, steady_clock nanoseconds elsewhere. Converted to microseconds
+    // at dump time against a steady_clock calibration taken by start().
+    inline uint64_t Ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    inline bool Enabled() {
+        return g_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Appends one complete event to the calling thread's ring, overwriting the oldest when full.
+    void Record(const char* category, const char* name, uint64_t begin, uint64_t end, uint64_t arg);
+
+    constexpr size_t MAX_EVENTS_PER_THREAD = size_t(1) << 20;
+
+    // Starts a new session. Rings are allocated lazily per thread with 'events_per_thread' slots
+    // (at most MAX_EVENTS_PER_THREAD, rounded up to a power of two); threads that already have a
+    // ring keep its size, and rings of exited threads are reused. Events recorded before this call
+    // are not included in later dumps.
+    void Start(size_t events_per_thread = 32768);
+    void Stop();
+
+    /**
+     * @brief Writes the current session as Chrome trace JSON (loadable in chrome://tracing and Perfetto).
+     *        Safe while tracing is running; events overwritten during the copy are dropped.
+     * @return The number of events written, or -1 if the file could not be opened.
+     */
+    long long DumpChromeJson(const std::string& path);
+
+    // One-line state: enabled flag, rings and their memory, events recorded, dropped by ring wrap, and
+    // not recorded because no ring could be had.
+    std::string Status();
+
+    class Scope {
+    public:
+        Scope(const char* category, const char* name, uint64_t arg = 0)
+            : category_(category), name_(name), arg_(arg), begin_(Enabled() ? Ticks() : 0) {}
+
+        ~Scope() {
+            if (begin_ != 0) Record(category_, name_, begin_, Ticks(), arg_);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* category_;
+        const char* name_;
+        uint64_t arg_;
+        uint64_t begin_;
+    };
+
+} // namespace Trace
+
+#define OMNI_TRACE_CONCAT_INNER(a, b) a##b
+#define OMNI_TRACE_CONCAT(a, b) OMNI_TRACE_CONCAT_INNER(a, b)
+
+#if defined(OMNI_DISABLE_TRACE)
+#define OMNI_TRACE_SCOPE(category, name) ((void)0)
+#define OMNI_TRACE_SCOPE_ARG(category, name, arg) ((void)0)
+#else
+#define OMNI_TRACE_SCOPE(category, name) \
+    ::Trace::Scope OMNI_TRACE_CONCAT(omni_trace_scope_, __LINE__)(category, name)
+#define OMNI_TRACE_SCOPE_ARG(category, name, arg) \
+    ::Trace::Scope OMNI_TRACE_CONCAT(omni_trace_scope_, __LINE__)(category, name, static_cast<uint64_t>(arg))
+#endif
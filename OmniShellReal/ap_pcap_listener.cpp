@@ -4,6 +4,7 @@ Copyright © 2025 Cadell Richard Anderson
 
 #include "ap_pcap_listener.h"
 #include "live_capture.h" // For the actual capture logic
+#include "Trace.h"
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
@@ -157,6 +158,7 @@ namespace ironrouter {
                 std::vector<u8> pkt;
                 pcaprec_hdr_t hdr;
                 while (parser.nextPacket(pkt, hdr)) {
+                    OMNI_TRACE_SCOPE_ARG("net", "uplink_packet", hdr.incl_len);
                     packet_count++;
                     if (verbose) {
                         std::cout << "[ironrouter] #" << packet_count
@@ -5,6 +5,7 @@ Copyright © 2025 Cadell Richard Anderson
 #define _USE_MATH_DEFINES // Ensures M_PI is defined in <cmath>
 #include <cmath>
 #include <cassert>
+#include "Trace.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -56,6 +57,7 @@ namespace ironrouter {
     }
 
     size_t DDCEngine::process_block(const i16* in_iq_interleaved, size_t in_samples, std::vector<std::complex<f32>>& out) {
+        OMNI_TRACE_SCOPE_ARG("ddc", "process_block", in_samples);
         assert(in_samples > 0);
         out.clear();
         out.reserve(in_samples / decimation + 1);
@@ -39,6 +39,8 @@ Copyright © 2025 Cadell Richard Anderson
 #include <shellapi.h>
 #elif __linux__
 #include <unistd.h> 
+#include <poll.h>
+#include <cerrno>
 #endif
 
 // Global config object
@@ -477,6 +479,29 @@ Notes:
 } // namespace LLM
 // =================================================================
 
+#ifdef __linux__
+// Blocks until stdin has input, reporting background jobs the moment they finish rather than at the
+// next prompt. Only used on a terminal: canonical mode hands read() one line at a time, so nothing is
+// left buffered inside std::cin where poll() could not see it.
+static void waitForInputOrJobs(const std::string& prompt) {
+    const int jobFd = JobManager::completionFd();
+    if (jobFd < 0 || !isatty(STDIN_FILENO)) return;
+    std::cout << std::flush;
+    while (true) {
+        pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { jobFd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            JobManager::checkJobs();
+            std::cout << prompt << std::flush;
+        }
+        if (fds[0].revents) return;
+    }
+}
+#endif
+
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
     // Check for admin privileges and relaunch if necessary
@@ -596,9 +621,13 @@ int main(int argc, char* argv[]) {
         std::cout << "[OmniShell] Tip: try 'llm:help' to use the local LLM engine.\n"; // ADDED
     }
     while (true) {
-        JobManager::checkJobs(); // Check for completed background jobs
+        JobManager::checkJobs(); // Report jobs that finished while the last command ran
         if (!quietMode) {
-            std::cout << std::filesystem::current_path().string() << " >>> ";
+            const std::string prompt = std::filesystem::current_path().string() + " >>> ";
+            std::cout << prompt;
+#ifdef __linux__
+            waitForInputOrJobs(prompt);
+#endif
         }
         if (!std::getline(std::cin, input)) break;
         if (input == "exit") break;
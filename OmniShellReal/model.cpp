@@ -3,6 +3,7 @@ Copyright © 2025 Cadell Richard Anderson
 // model.cpp 
 #include "model.h"
 #include "math.h"  // added for softmax_inplace, top_k_filter
+#include "Trace.h"
 #include <fstream>
 #include <random>
 #include <algorithm>
@@ -310,6 +311,7 @@ void CLLF::reset_session() {
 }
 
 std::vector<f32> CLLF::prefill(const std::vector<int>& tokens) {
+    OMNI_TRACE_SCOPE_ARG("llm", "prefill", tokens.size());
     if (!Rt.W) Rt.W = &W;
     const i32 V = std::max<i32>(W.cfg.vocab_size, 2);
     const i32 D = W.cfg.d_model;
@@ -333,6 +335,7 @@ std::vector<f32> CLLF::prefill(const std::vector<int>& tokens) {
 
         // 2) pass through all layers, filling KV at pos
         for (i32 l = 0; l < L; ++l) {
+            OMNI_TRACE_SCOPE_ARG("llm", "prefill_layer", l);
             const LayerWeights& ly = W.layers[l];
             KVCache& kv = Rt.kv[l];
 
@@ -426,6 +429,7 @@ std::vector<f32> CLLF::prefill(const std::vector<int>& tokens) {
 }
 
 std::vector<f32> CLLF::decode_step(int token_id) {
+    OMNI_TRACE_SCOPE("llm", "decode_step");
     if (!Rt.W) Rt.W = &W;
     const i32 V = std::max<i32>(W.cfg.vocab_size, 2);
     const i32 D = W.cfg.d_model;
@@ -445,6 +449,7 @@ std::vector<f32> CLLF::decode_step(int token_id) {
 
     // === Loop over all decoder layers ===
     for (i32 l = 0; l < L; ++l) {
+        OMNI_TRACE_SCOPE_ARG("llm", "decode_layer", l);
         const LayerWeights& ly = W.layers[l];
         KVCache& kv = Rt.kv[l];
 
@@ -531,7 +536,10 @@ std::vector<f32> CLLF::decode_step(int token_id) {
         layernorm_row(x.data(), W.ln_f_g.data(), W.ln_f_b.data(), D);
 
     std::vector<f32> logits(static_cast<size_t>(V), 0.0f);
-    gemm_mm(x.data(), W.lm_head.data(), logits.data(), 1, D, V);
+    {
+        OMNI_TRACE_SCOPE("llm", "lm_head");
+        gemm_mm(x.data(), W.lm_head.data(), logits.data(), 1, D, V);
+    }
 
     return logits;
 }
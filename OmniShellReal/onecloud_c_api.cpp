@@ -15,7 +15,24 @@ Copyright © 2025 Cadell Richard Anderson
 
 // Helper to convert C++ CloudError to C OneCloud_Error
 static OneCloud_Error to_c_error(onecloud::CloudError err) {
-    return static_cast<OneCloud_Error>(err);
+    // The C and C++ enums do not share numeric values, so map them explicitly.
+    switch (err) {
+    case onecloud::CloudError::Success: return ONECLOUD_SUCCESS;
+    case onecloud::CloudError::FileExists: return ONECLOUD_ERROR_FILE_EXISTS;
+    case onecloud::CloudError::ContainerNotFound: return ONECLOUD_ERROR_CONTAINER_NOT_FOUND;
+    case onecloud::CloudError::IOError: return ONECLOUD_ERROR_IO_ERROR;
+    case onecloud::CloudError::InvalidContainerFormat: return ONECLOUD_ERROR_INVALID_CONTAINER_FORMAT;
+    case onecloud::CloudError::FileNotFound: return ONECLOUD_ERROR_FILE_NOT_FOUND;
+    case onecloud::CloudError::KeyDerivationFailed:
+    case onecloud::CloudError::EncryptionFailed:
+    case onecloud::CloudError::DecryptionFailed: return ONECLOUD_ERROR_ENCRYPTION_FAILED;
+    case onecloud::CloudError::InvalidPassword: return ONECLOUD_ERROR_INVALID_PASSWORD;
+    case onecloud::CloudError::OutOfMemory: return ONECLOUD_ERROR_OUT_OF_MEMORY;
+    case onecloud::CloudError::AccessDenied: return ONECLOUD_ERROR_ACCESS_DENIED;
+    case onecloud::CloudError::BufferTooSmall: return ONECLOUD_ERROR_BUFFER_TOO_SMALL;
+    case onecloud::CloudError::CompressionFailed: return ONECLOUD_ERROR_COMPRESSION_FAILED;
+    default: return ONECLOUD_ERROR_UNKNOWN;
+    }
 }
 
 extern "C" {
@@ -62,13 +79,75 @@ extern "C" {
         if (!handle || !virtual_path || !out_data || !out_size) return ONECLOUD_ERROR_UNKNOWN;
         auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
         try {
-            auto result = storage->readFile(virtual_path);
+            auto size_result = storage->fileSize(virtual_path);
+            if (!size_result) return to_c_error(size_result.error());
+
+            // Decompress straight into the buffer handed back to the caller; no intermediate vector.
+            const size_t size = static_cast<size_t>(*size_result);
+            uint8_t* data = static_cast<uint8_t*>(std::malloc(size > 0 ? size : 1));
+            if (!data) return ONECLOUD_ERROR_OUT_OF_MEMORY;
+
+            auto result = storage->readFileInto(virtual_path, std::span<std::byte>(reinterpret_cast<std::byte*>(data), size));
+            if (!result) {
+                std::free(data);
+                return to_c_error(result.error());
+            }
+            *out_data = data;
+            *out_size = *result;
+            return ONECLOUD_SUCCESS;
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_get_file_size(OneCloud_StorageHandle* handle, const char* virtual_path, uint64_t* out_size) {
+        if (!handle || !virtual_path || !out_size) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto result = storage->fileSize(virtual_path);
+            if (result) {
+                *out_size = *result;
+                return ONECLOUD_SUCCESS;
+            }
+            return to_c_error(result.error());
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_read_file_into(OneCloud_StorageHandle* handle, const char* virtual_path, uint8_t* buffer, size_t capacity, size_t* out_written) {
+        if (!handle || !virtual_path || !out_written || (!buffer && capacity > 0)) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto size_result = storage->fileSize(virtual_path);
+            if (!size_result) return to_c_error(size_result.error());
+            if (*size_result > capacity) {
+                *out_written = static_cast<size_t>(*size_result);
+                return ONECLOUD_ERROR_BUFFER_TOO_SMALL;
+            }
+
+            auto result = storage->readFileInto(virtual_path, std::span<std::byte>(reinterpret_cast<std::byte*>(buffer), capacity));
+            if (result) {
+                *out_written = *result;
+                return ONECLOUD_SUCCESS;
+            }
+            return to_c_error(result.error());
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_read_file_stream(OneCloud_StorageHandle* handle, const char* virtual_path, OneCloud_ChunkCallback callback, void* user_data) {
+        if (!handle || !virtual_path || !callback) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto result = storage->readFileChunked(virtual_path, [&](std::span<const std::byte> chunk) {
+                return callback(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size(), user_data) == 0;
+                });
             if (result) {
-                auto& vec = *result;
-                *out_data = static_cast<uint8_t*>(std::malloc(vec.size()));
-                if (!*out_data) return ONECLOUD_ERROR_OUT_OF_MEMORY;
-                std::memcpy(*out_data, vec.data(), vec.size());
-                *out_size = vec.size();
                 return ONECLOUD_SUCCESS;
             }
             return to_c_error(result.error());
@@ -148,6 +227,117 @@ extern "C" {
         }
     }
 
+    ONECLOUD_API OneCloud_Error onecloud_storage_list_directory(OneCloud_StorageHandle* handle, const char* directory, const char* start_after, size_t limit, OneCloud_ListCallback callback, void* user_data) {
+        if (!handle || !callback) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto result = storage->listDirectory(directory ? directory : "", start_after ? start_after : "", limit);
+            if (!result) return to_c_error(result.error());
+            for (const auto& entry : *result) {
+                if (callback(entry.name.c_str(), entry.size, entry.is_directory ? 1 : 0, user_data) != 0) break;
+            }
+            return ONECLOUD_SUCCESS;
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_find_files(OneCloud_StorageHandle* handle, const char* prefix, const char* glob, const char* start_after, size_t limit, OneCloud_ListCallback callback, void* user_data) {
+        if (!handle || !callback) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            onecloud::ListOptions options;
+            if (prefix) options.prefix = prefix;
+            if (glob) options.glob = glob;
+            if (start_after) options.start_after = start_after;
+            options.limit = limit;
+
+            std::string name; // Reused to NUL-terminate each path for the callback.
+            auto result = storage->forEachFile(options, [&](std::string_view path, const onecloud::FileInfo& info) {
+                name.assign(path);
+                return callback(name.c_str(), info.size, 0, user_data) == 0;
+                });
+            if (result) {
+                return ONECLOUD_SUCCESS;
+            }
+            return to_c_error(result.error());
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_set_compression_level(OneCloud_StorageHandle* handle, int level) {
+        if (!handle) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto result = storage->setCompressionLevel(level);
+            if (result) {
+                return ONECLOUD_SUCCESS;
+            }
+            return to_c_error(result.error());
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_train_dictionary(OneCloud_StorageHandle* handle, size_t max_dictionary_bytes, uint32_t* out_dictionary_id) {
+        if (!handle) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto result = max_dictionary_bytes ? storage->trainDictionary(max_dictionary_bytes) : storage->trainDictionary();
+            if (result) {
+                if (out_dictionary_id) *out_dictionary_id = *result;
+                return ONECLOUD_SUCCESS;
+            }
+            return to_c_error(result.error());
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_get_compression_stats(OneCloud_StorageHandle* handle, OneCloud_CompressionStats* out_stats) {
+        if (!handle || !out_stats) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            const auto stats = storage->compressionStats();
+            out_stats->level = stats.level;
+            out_stats->dictionaries = stats.dictionaries;
+            out_stats->zstd_chunks = stats.zstd_chunks;
+            out_stats->dictionary_chunks = stats.dictionary_chunks;
+            out_stats->raw_chunks = stats.raw_chunks;
+            out_stats->original_bytes = stats.original_bytes;
+            out_stats->stored_bytes = stats.stored_bytes;
+            return ONECLOUD_SUCCESS;
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
+    ONECLOUD_API OneCloud_Error onecloud_storage_compact(OneCloud_StorageHandle* handle, OneCloud_CompactionStats* out_stats) {
+        if (!handle) return ONECLOUD_ERROR_UNKNOWN;
+        auto storage = reinterpret_cast<onecloud::CloudStorage*>(handle);
+        try {
+            auto result = storage->compact();
+            if (result) {
+                if (out_stats) {
+                    out_stats->bytes_before = result->bytes_before;
+                    out_stats->bytes_after = result->bytes_after;
+                    out_stats->chunks_copied = result->chunks_copied;
+                }
+                return ONECLOUD_SUCCESS;
+            }
+            return to_c_error(result.error());
+        }
+        catch (...) {
+            return ONECLOUD_ERROR_UNKNOWN;
+        }
+    }
+
     // --- Memory Management for C API Allocations ---
 
     ONECLOUD_API void onecloud_free_file_list(char** file_list, size_t count) {
@@ -38,7 +38,10 @@ extern "C" {
         ONECLOUD_ERROR_IO_ERROR,
         ONECLOUD_ERROR_OUT_OF_MEMORY,
         ONECLOUD_ERROR_ENCRYPTION_FAILED, // <-- FIXED: Added missing error code
-        ONECLOUD_ERROR_UNKNOWN
+        ONECLOUD_ERROR_UNKNOWN = 10,
+        // Codes added later go here, so the values above keep their numbers.
+        ONECLOUD_ERROR_BUFFER_TOO_SMALL = 11,
+        ONECLOUD_ERROR_COMPRESSION_FAILED = 12
     } OneCloud_Error;
 
     // --- Container Operations ---
@@ -80,6 +83,46 @@ extern "C" {
      */
     ONECLOUD_API OneCloud_Error onecloud_storage_read_file(OneCloud_StorageHandle* handle, const char* virtual_path, uint8_t** out_data, size_t* out_size);
 
+    /**
+     * @brief Queries the uncompressed size of a virtual file without reading any of its data.
+     * @param handle A valid container handle.
+     * @param virtual_path The path of the file inside the container.
+     * @param out_size A pointer that will receive the file size in bytes.
+     * @return ONECLOUD_SUCCESS on success, or an error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_get_file_size(OneCloud_StorageHandle* handle, const char* virtual_path, uint64_t* out_size);
+
+    /**
+     * @brief Reads a virtual file directly into a caller-provided buffer, avoiding any intermediate allocation.
+     * @param handle A valid container handle.
+     * @param virtual_path The path of the file inside the container.
+     * @param buffer The destination buffer.
+     * @param capacity The size of the destination buffer in bytes.
+     * @param out_written A pointer that will receive the number of bytes written. If the buffer is too small,
+     *        it receives the required size and ONECLOUD_ERROR_BUFFER_TOO_SMALL is returned.
+     * @return ONECLOUD_SUCCESS on success, or an error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_read_file_into(OneCloud_StorageHandle* handle, const char* virtual_path, uint8_t* buffer, size_t capacity, size_t* out_written);
+
+    /**
+     * @brief Callback invoked by onecloud_storage_read_file_stream for each decompressed chunk, in file order.
+     * @param data The chunk data. Only valid for the duration of the call.
+     * @param size The size of the chunk in bytes.
+     * @param user_data The pointer passed to onecloud_storage_read_file_stream.
+     * @return 0 to continue reading, any other value to abort.
+     */
+    typedef int (*OneCloud_ChunkCallback)(const uint8_t* data, size_t size, void* user_data);
+
+    /**
+     * @brief Streams a virtual file chunk by chunk through a callback, so the whole file is never held in memory.
+     * @param handle A valid container handle.
+     * @param virtual_path The path of the file inside the container.
+     * @param callback The function that receives each chunk.
+     * @param user_data An opaque pointer forwarded to the callback.
+     * @return ONECLOUD_SUCCESS on success, ONECLOUD_ERROR_IO_ERROR if the callback aborted, or another error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_read_file_stream(OneCloud_StorageHandle* handle, const char* virtual_path, OneCloud_ChunkCallback callback, void* user_data);
+
     /**
      * @brief Writes data to a virtual file in the container, creating it if it doesn't exist or overwriting it if it does.
      * @param handle A valid container handle.
@@ -107,6 +150,99 @@ extern "C" {
      */
     ONECLOUD_API OneCloud_Error onecloud_storage_list_files(OneCloud_StorageHandle* handle, char*** out_file_list, size_t* out_count);
 
+    /**
+     * @brief Callback invoked by the listing functions for each entry, in path order.
+     * @param name The entry name (directory listing) or full virtual path (find). Only valid for the duration of the call.
+     * @param size The file size in bytes, or 0 for directories.
+     * @param is_directory Non-zero if the entry is a subdirectory.
+     * @param user_data The pointer passed to the listing function.
+     * @return 0 to continue, any other value to stop the listing.
+     */
+    typedef int (*OneCloud_ListCallback)(const char* name, uint64_t size, int is_directory, void* user_data);
+
+    /**
+     * @brief Lists the immediate children of a directory, one page at a time.
+     * @param handle A valid container handle.
+     * @param directory The directory to list ("" or NULL for the root).
+     * @param start_after Resume after this entry name (the last name of the previous page), or NULL to start at the beginning.
+     * @param limit The maximum number of entries to return, or 0 for no limit.
+     * @param callback The function that receives each entry.
+     * @param user_data An opaque pointer forwarded to the callback.
+     * @return ONECLOUD_SUCCESS on success, ONECLOUD_ERROR_FILE_NOT_FOUND if the directory does not exist, or another error code.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_list_directory(OneCloud_StorageHandle* handle, const char* directory, const char* start_after, size_t limit, OneCloud_ListCallback callback, void* user_data);
+
+    /**
+     * @brief Finds files by path prefix and/or glob ('*' and '?' stay within one directory, '**' crosses directories).
+     * @param handle A valid container handle.
+     * @param prefix Only paths starting with this prefix are visited, or NULL for all.
+     * @param glob Pattern the full path must match, or NULL to accept every path under the prefix.
+     * @param start_after Resume after this full path, or NULL to start at the beginning.
+     * @param limit The maximum number of files to return, or 0 for no limit.
+     * @param callback The function that receives each matching file.
+     * @param user_data An opaque pointer forwarded to the callback.
+     * @return ONECLOUD_SUCCESS on success, or an error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_find_files(OneCloud_StorageHandle* handle, const char* prefix, const char* glob, const char* start_after, size_t limit, OneCloud_ListCallback callback, void* user_data);
+
+
+    // --- Compression Settings ---
+
+    /**
+     * @brief Sets the ZSTD level used for chunks written from now on and saves it with the container.
+     * @param handle A valid container handle.
+     * @param level The compression level (clamped to ZSTD's range), or 0 for the default.
+     * @return ONECLOUD_SUCCESS on success, or an error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_set_compression_level(OneCloud_StorageHandle* handle, int level);
+
+    /**
+     * @brief Trains a ZSTD dictionary from the container's small files and uses it for later small writes.
+     * @param handle A valid container handle.
+     * @param max_dictionary_bytes The largest dictionary to produce (0 for the default of 112 KB).
+     * @param out_dictionary_id Optional; receives the ID of the new dictionary.
+     * @return ONECLOUD_SUCCESS on success, ONECLOUD_ERROR_COMPRESSION_FAILED if there were too few samples, or another error code.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_train_dictionary(OneCloud_StorageHandle* handle, size_t max_dictionary_bytes, uint32_t* out_dictionary_id);
+
+    // How the container's chunks are stored, summed from its manifest.
+    typedef struct {
+        int level;
+        size_t dictionaries;
+        uint64_t zstd_chunks;
+        uint64_t dictionary_chunks;
+        uint64_t raw_chunks;
+        uint64_t original_bytes;
+        uint64_t stored_bytes;
+    } OneCloud_CompressionStats;
+
+    /**
+     * @brief Reports the compression level, dictionaries and per-codec chunk counts of a container.
+     * @param handle A valid container handle.
+     * @param out_stats A pointer that will receive the statistics.
+     * @return ONECLOUD_SUCCESS on success, or an error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_get_compression_stats(OneCloud_StorageHandle* handle, OneCloud_CompressionStats* out_stats);
+
+
+    // --- Maintenance ---
+
+    // What onecloud_storage_compact reclaimed.
+    typedef struct {
+        uint64_t bytes_before;
+        uint64_t bytes_after;
+        uint64_t chunks_copied;
+    } OneCloud_CompactionStats;
+
+    /**
+     * @brief Rewrites the container without deleted files, replaced versions or old manifests.
+     *        The new file is renamed over the old one, so an interrupted compaction leaves the original intact.
+     * @param handle A valid container handle.
+     * @param out_stats Optional; receives the container size before and after.
+     * @return ONECLOUD_SUCCESS on success, or an error code on failure.
+     */
+    ONECLOUD_API OneCloud_Error onecloud_storage_compact(OneCloud_StorageHandle* handle, OneCloud_CompactionStats* out_stats);
+
 
     // --- Memory Management for C API Allocations ---
 
@@ -26,6 +26,7 @@ Copyright © 2025 Cadell Richard Anderson
 #include "model.h"              // Your Transformer model API
 #include "types.h"               // Your scalar/typedefs (e.g., f32)
 #include "math.h"               // Your math kernels (softmax, etc.)
+#include "Trace.h"              // OMNI_TRACE_SCOPE
 
 // Optional: compile-time integration hooks.
 // Define these macros at build time if you have the headers available.
@@ -305,6 +306,7 @@ namespace ai {
             std::string& err) override
         {
             AiRunScope scope("scratch.chat", user_prompt.substr(0, 120));
+            OMNI_TRACE_SCOPE("ai", "scratch.chat");
             TokenRate tr;
             try {
                 recent_ids_.clear();
@@ -4,6 +4,7 @@ Copyright © 2025 Cadell Richard Anderson
 #pragma once
 #include "types.h"
 #include "packet_frame.h"
+#include "Trace.h"
 #include <pcap.h>
 #include <functional>
 #include <string>
@@ -194,6 +195,7 @@ namespace ironrouter {
         static void pcap_packet_handler(u_char* user, const struct pcap_pkthdr* header, const u_char* bytes) {
             SourceNetworkPcap* self = reinterpret_cast<SourceNetworkPcap*>(user);
             if (self && self->sink_) {
+                OMNI_TRACE_SCOPE_ARG("net", "frame_sink", header->caplen);
                 PcapRecordHeader rhdr;
                 rhdr.ts_sec = header->ts.tv_sec;
                 rhdr.ts_usec = header->ts.tv_usec;
@@ -119,11 +119,33 @@ namespace ironrouter {
 // =========================================================
 namespace onecloud {
 
+    // AEAD used for every encrypted blob in a container; stored in the low byte of the header flags.
+    enum class CipherSuite : uint8_t {
+        ChaCha20Poly1305 = 0,   // Default and the only suite in containers created before it was recorded.
+        Aes256Gcm = 1           // Chosen at creation when the CPU has AES and carry-less multiply instructions.
+    };
+
+    // How a chunk's plaintext was encoded before encryption.
+    enum class ChunkCodec : uint32_t {
+        Zstd = 0,            // Plain ZSTD frame (every chunk written before manifest version 3).
+        Raw = 1,             // Stored uncompressed; the data did not compress.
+        ZstdDictionary = 2   // ZSTD frame that needs the dictionary named by DataChunk::dictionary_id.
+    };
+
     // Represents a single chunk of file data within the container.
     struct DataChunk {
         uint64_t offset_in_container;
         uint32_t compressed_size;
         uint32_t original_size;
+        ChunkCodec codec;
+        uint32_t dictionary_id;
+    };
+
+    // A trained ZSTD dictionary stored (encrypted, uncompressed) as a blob in the container.
+    struct CompressionDictionary {
+        uint32_t id;
+        uint32_t reserved;
+        DataChunk location;
     };
 
     // Represents a single virtual file or directory within the container.
@@ -139,6 +161,23 @@ namespace onecloud {
     struct Manifest {
         uint32_t version = 1;
         std::vector<FileEntry> files;
+        int32_t compression_level = 0;                      // 0 selects the library default (version 3+).
+        std::vector<CompressionDictionary> dictionaries;    // Version 3+; the last one is used for new writes.
+    };
+
+    // One immediate child of a directory listing. Directories are implied by file paths.
+    struct DirEntry {
+        std::string name;
+        bool is_directory = false;
+        uint64_t size = 0;
+    };
+
+    // Filters for a paginated file listing.
+    struct ListOptions {
+        std::string prefix;       // Only paths starting with this.
+        std::string glob;         // Optional pattern: '*' and '?' stop at '/', '**' crosses it, [a-z] / [!x] classes.
+        std::string start_after;  // Resume after this path (the last path of the previous page).
+        size_t limit = 0;         // Maximum results; 0 for no limit.
     };
 
 } // namespace onecloud